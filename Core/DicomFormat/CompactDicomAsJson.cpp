@@ -0,0 +1,582 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2019 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "../PrecompiledHeaders.h"
+#include "CompactDicomAsJson.h"
+
+#include "../OrthancException.h"
+
+#include <algorithm>
+#include <boost/noncopyable.hpp>
+#include <json/reader.h>
+#include <map>
+#include <string.h>
+#include <vector>
+
+
+namespace Orthanc
+{
+  static const char MAGIC[4] = { '\0', 'D', 'J', 'C' };
+  static const uint32_t VERSION = 1;
+  static const size_t HEADER_SIZE = 16;
+  static const size_t ENTRY_SIZE = 20;
+  static const uint32_t NONE = 0xffffffffu;
+
+  // Protection against corrupted files whose offsets would loop
+  static const unsigned int MAX_DEPTH = 64;
+
+  enum EntryType
+  {
+    EntryType_Null = 0,
+    EntryType_String = 1,
+    EntryType_Binary = 2,
+    EntryType_TooLong = 3,
+    EntryType_Sequence = 4
+  };
+
+  static const char* GetTypeName(uint32_t type)
+  {
+    switch (type)
+    {
+      case EntryType_Null:
+        return "Null";
+
+      case EntryType_String:
+        return "String";
+
+      case EntryType_Binary:
+        return "Binary";
+
+      case EntryType_TooLong:
+        return "TooLong";
+
+      case EntryType_Sequence:
+        return "Sequence";
+
+      default:
+        throw OrthancException(ErrorCode_CorruptedFile);
+    }
+  }
+
+
+  static void Write32(std::string& target,
+                      size_t position,
+                      uint32_t value)
+  {
+    assert(position + 4 <= target.size());
+    target[position] = static_cast<char>(value & 0xff);
+    target[position + 1] = static_cast<char>((value >> 8) & 0xff);
+    target[position + 2] = static_cast<char>((value >> 16) & 0xff);
+    target[position + 3] = static_cast<char>((value >> 24) & 0xff);
+  }
+
+
+  static void Append32(std::string& target,
+                       uint32_t value)
+  {
+    target.resize(target.size() + 4);
+    Write32(target, target.size() - 4, value);
+  }
+
+
+  static inline uint32_t GetKey(const DicomTag& tag)
+  {
+    return (static_cast<uint32_t>(tag.GetGroup()) << 16) | tag.GetElement();
+  }
+
+
+  namespace
+  {
+    class Encoder : public boost::noncopyable
+    {
+    private:
+      typedef std::pair<uint32_t, std::string>  SortedTag;
+
+      std::string  structure_;  // Header, datasets and sequences
+      std::string  pool_;
+      std::map<std::string, uint32_t>  sharedStrings_;
+
+      uint32_t AddString(const std::string& value)
+      {
+        const uint32_t offset = static_cast<uint32_t>(pool_.size());
+        Append32(pool_, static_cast<uint32_t>(value.size()));
+        pool_.append(value);
+        return offset;
+      }
+
+      uint32_t AddSharedString(const std::string& value)
+      {
+        std::map<std::string, uint32_t>::const_iterator found = sharedStrings_.find(value);
+        if (found == sharedStrings_.end())
+        {
+          uint32_t offset = AddString(value);
+          sharedStrings_[value] = offset;
+          return offset;
+        }
+        else
+        {
+          return found->second;
+        }
+      }
+
+      bool EncodeSequence(uint32_t& offset,
+                          const Json::Value& items,
+                          unsigned int depth)
+      {
+        offset = static_cast<uint32_t>(structure_.size());
+        Append32(structure_, items.size());
+        structure_.resize(structure_.size() + 4 * items.size());
+
+        for (Json::Value::ArrayIndex i = 0; i < items.size(); i++)
+        {
+          uint32_t child;
+          if (!EncodeDataset(child, items[i], depth + 1))
+          {
+            return false;
+          }
+
+          Write32(structure_, offset + 4 + 4 * i, child);
+        }
+
+        return true;
+      }
+
+      bool EncodeDataset(uint32_t& offset,
+                         const Json::Value& dataset,
+                         unsigned int depth)
+      {
+        if (dataset.type() != Json::objectValue ||
+            depth > MAX_DEPTH)
+        {
+          return false;
+        }
+
+        std::vector<SortedTag> tags;
+        tags.reserve(dataset.size());
+
+        Json::Value::Members members = dataset.getMemberNames();
+        for (size_t i = 0; i < members.size(); i++)
+        {
+          DicomTag tag(0, 0);
+          if (!DicomTag::ParseHexadecimal(tag, members[i].c_str()) ||
+              tag.Format() != members[i])
+          {
+            return false;
+          }
+
+          tags.push_back(std::make_pair(GetKey(tag), members[i]));
+        }
+
+        std::sort(tags.begin(), tags.end());
+
+        offset = static_cast<uint32_t>(structure_.size());
+        Append32(structure_, static_cast<uint32_t>(tags.size()));
+        structure_.resize(structure_.size() + ENTRY_SIZE * tags.size());
+
+        for (size_t i = 0; i < tags.size(); i++)
+        {
+          const Json::Value& item = dataset[tags[i].second];
+
+          if (item.type() != Json::objectValue ||
+              !item.isMember("Name") ||
+              !item.isMember("Type") ||
+              !item.isMember("Value") ||
+              item["Name"].type() != Json::stringValue ||
+              item["Type"].type() != Json::stringValue)
+          {
+            return false;
+          }
+
+          uint32_t privateCreator = NONE;
+
+          if (item.isMember("PrivateCreator"))
+          {
+            if (item["PrivateCreator"].type() != Json::stringValue ||
+                item.size() != 4)
+            {
+              return false;
+            }
+
+            privateCreator = AddSharedString(item["PrivateCreator"].asString());
+          }
+          else if (item.size() != 3)
+          {
+            return false;
+          }
+
+          const std::string type = item["Type"].asString();
+          const Json::Value& value = item["Value"];
+
+          uint32_t entryType, entryValue;
+
+          if (type == "String" ||
+              type == "Binary")
+          {
+            if (value.type() != Json::stringValue)
+            {
+              return false;
+            }
+
+            entryType = (type == "String" ? EntryType_String : EntryType_Binary);
+            entryValue = AddString(value.asString());
+          }
+          else if (type == "Null" ||
+                   type == "TooLong")
+          {
+            if (value.type() != Json::nullValue)
+            {
+              return false;
+            }
+
+            entryType = (type == "Null" ? EntryType_Null : EntryType_TooLong);
+            entryValue = NONE;
+          }
+          else if (type == "Sequence")
+          {
+            if (value.type() != Json::arrayValue ||
+                !EncodeSequence(entryValue, value, depth))
+            {
+              return false;
+            }
+
+            entryType = EntryType_Sequence;
+          }
+          else
+          {
+            return false;
+          }
+
+          // "structure_" may have grown because of the sequences
+          const size_t position = offset + 4 + ENTRY_SIZE * i;
+          Write32(structure_, position, tags[i].first);
+          Write32(structure_, position + 4, entryType);
+          Write32(structure_, position + 8, AddSharedString(item["Name"].asString()));
+          Write32(structure_, position + 12, entryValue);
+          Write32(structure_, position + 16, privateCreator);
+        }
+
+        return true;
+      }
+
+    public:
+      Encoder() :
+        structure_(HEADER_SIZE, '\0')
+      {
+      }
+
+      bool Encode(std::string& target,
+                  const Json::Value& dicomAsJson)
+      {
+        uint32_t root;
+        if (!EncodeDataset(root, dicomAsJson, 0) ||
+            static_cast<uint64_t>(structure_.size()) + pool_.size() >= static_cast<uint64_t>(NONE))
+        {
+          return false;
+        }
+
+        assert(root == HEADER_SIZE);
+
+        memcpy(&structure_[0], MAGIC, sizeof(MAGIC));
+        Write32(structure_, 4, VERSION);
+        Write32(structure_, 8, static_cast<uint32_t>(structure_.size()));
+        Write32(structure_, 12, static_cast<uint32_t>(pool_.size()));
+
+        target.reserve(structure_.size() + pool_.size());
+        target.assign(structure_);
+        target.append(pool_);
+        return true;
+      }
+    };
+
+
+    class Decoder : public boost::noncopyable
+    {
+    private:
+      const std::string&  source_;
+      size_t              poolOffset_;
+      size_t              poolSize_;
+
+      static void Corrupted()
+      {
+        throw OrthancException(ErrorCode_CorruptedFile);
+      }
+
+      uint32_t Read32(size_t position) const
+      {
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(source_.c_str()) + position;
+        return (static_cast<uint32_t>(p[0]) |
+                (static_cast<uint32_t>(p[1]) << 8) |
+                (static_cast<uint32_t>(p[2]) << 16) |
+                (static_cast<uint32_t>(p[3]) << 24));
+      }
+
+      // Reads in the part of the buffer before the string pool
+      uint32_t ReadStructure(size_t position) const
+      {
+        if (position < HEADER_SIZE ||
+            position + 4 > poolOffset_)
+        {
+          Corrupted();
+        }
+
+        return Read32(position);
+      }
+
+      std::string ReadString(uint32_t offset) const
+      {
+        if (static_cast<size_t>(offset) + 4 > poolSize_)
+        {
+          Corrupted();
+        }
+
+        const uint32_t length = Read32(poolOffset_ + offset);
+        if (static_cast<size_t>(length) > poolSize_ - offset - 4)
+        {
+          Corrupted();
+        }
+
+        return std::string(source_.c_str() + poolOffset_ + offset + 4, length);
+      }
+
+      size_t ReadCount(uint32_t offset,
+                       size_t itemSize) const
+      {
+        const uint32_t count = ReadStructure(offset);
+        if (count > (poolOffset_ - offset - 4) / itemSize)
+        {
+          Corrupted();
+        }
+
+        return count;
+      }
+
+    public:
+      Decoder(const std::string& source) :
+        source_(source)
+      {
+        if (!CompactDicomAsJson::IsCompact(source) ||
+            source.size() < HEADER_SIZE ||
+            Read32(4) != VERSION)
+        {
+          Corrupted();
+        }
+
+        poolOffset_ = Read32(8);
+        poolSize_ = Read32(12);
+
+        if (poolOffset_ < HEADER_SIZE ||
+            poolOffset_ > source.size() ||
+            poolSize_ != source.size() - poolOffset_)
+        {
+          Corrupted();
+        }
+      }
+
+      void DecodeDataset(Json::Value& target,
+                         uint32_t offset,
+                         unsigned int depth) const
+      {
+        if (depth > MAX_DEPTH)
+        {
+          Corrupted();
+        }
+
+        target = Json::objectValue;
+
+        const size_t count = ReadCount(offset, ENTRY_SIZE);
+
+        for (size_t i = 0; i < count; i++)
+        {
+          const size_t position = offset + 4 + ENTRY_SIZE * i;
+          const uint32_t key = ReadStructure(position);
+          const uint32_t type = ReadStructure(position + 4);
+          const uint32_t value = ReadStructure(position + 12);
+          const uint32_t privateCreator = ReadStructure(position + 16);
+
+          DicomTag tag(static_cast<uint16_t>(key >> 16), static_cast<uint16_t>(key & 0xffff));
+
+          Json::Value& item = target[tag.Format()];
+          item["Name"] = ReadString(ReadStructure(position + 8));
+          item["Type"] = GetTypeName(type);
+
+          switch (type)
+          {
+            case EntryType_String:
+            case EntryType_Binary:
+              item["Value"] = ReadString(value);
+              break;
+
+            case EntryType_Null:
+            case EntryType_TooLong:
+              item["Value"] = Json::nullValue;
+              break;
+
+            case EntryType_Sequence:
+            {
+              Json::Value& items = item["Value"];
+              items = Json::arrayValue;
+
+              const size_t countItems = ReadCount(value, 4);
+              for (size_t j = 0; j < countItems; j++)
+              {
+                DecodeDataset(items.append(Json::objectValue),
+                              ReadStructure(value + 4 + 4 * j), depth + 1);
+              }
+
+              break;
+            }
+
+            default:
+              Corrupted();
+          }
+
+          if (privateCreator != NONE)
+          {
+            item["PrivateCreator"] = ReadString(privateCreator);
+          }
+        }
+      }
+
+      void DecodeRoot(Json::Value& target) const
+      {
+        DecodeDataset(target, HEADER_SIZE, 0);
+      }
+
+      // Looks for a string value in the root dataset, by dichotomy
+      bool LookupString(std::string& target,
+                        const DicomTag& tag) const
+      {
+        const uint32_t key = GetKey(tag);
+        const size_t count = ReadCount(HEADER_SIZE, ENTRY_SIZE);
+
+        size_t low = 0;
+        size_t high = count;
+
+        while (low < high)
+        {
+          const size_t middle = low + (high - low) / 2;
+          const size_t position = HEADER_SIZE + 4 + ENTRY_SIZE * middle;
+          const uint32_t current = ReadStructure(position);
+
+          if (current < key)
+          {
+            low = middle + 1;
+          }
+          else if (current > key)
+          {
+            high = middle;
+          }
+          else if (ReadStructure(position + 4) == EntryType_String)
+          {
+            target = ReadString(ReadStructure(position + 12));
+            return true;
+          }
+          else
+          {
+            return false;
+          }
+        }
+
+        return false;
+      }
+    };
+  }
+
+
+  bool CompactDicomAsJson::IsCompact(const std::string& dicomAsJson)
+  {
+    // A JSON text cannot start with a NUL character
+    return (dicomAsJson.size() >= sizeof(MAGIC) &&
+            memcmp(dicomAsJson.c_str(), MAGIC, sizeof(MAGIC)) == 0);
+  }
+
+
+  bool CompactDicomAsJson::Encode(std::string& target,
+                                  const Json::Value& dicomAsJson)
+  {
+    Encoder encoder;
+    return encoder.Encode(target, dicomAsJson);
+  }
+
+
+  void CompactDicomAsJson::Decode(Json::Value& target,
+                                  const std::string& compact)
+  {
+    Decoder decoder(compact);
+    decoder.DecodeRoot(target);
+  }
+
+
+  void CompactDicomAsJson::Parse(Json::Value& target,
+                                 const std::string& dicomAsJson)
+  {
+    if (IsCompact(dicomAsJson))
+    {
+      Decode(target, dicomAsJson);
+    }
+    else
+    {
+      Json::Reader reader;
+      if (!reader.parse(dicomAsJson, target))
+      {
+        throw OrthancException(ErrorCode_CorruptedFile);
+      }
+    }
+  }
+
+
+  void CompactDicomAsJson::ExtractTags(DicomMap& target,
+                                       const std::string& dicomAsJson,
+                                       const std::set<DicomTag>& tags)
+  {
+    if (IsCompact(dicomAsJson))
+    {
+      target.Clear();
+
+      Decoder decoder(dicomAsJson);
+
+      std::string value;
+      for (std::set<DicomTag>::const_iterator it = tags.begin(); it != tags.end(); ++it)
+      {
+        if (decoder.LookupString(value, *it))
+        {
+          target.SetValue(*it, value, false /* not binary */);
+        }
+      }
+    }
+    else
+    {
+      target.FromDicomAsJson(dicomAsJson, tags);
+    }
+  }
+}
@@ -0,0 +1,87 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2019 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+
+#include "DicomMap.h"
+
+#include <json/value.h>
+#include <set>
+#include <stdint.h>
+#include <string>
+
+namespace Orthanc
+{
+  /**
+   * Compact binary encoding of the "DICOM-as-JSON" summary of an
+   * instance (i.e. "DicomToJsonFormat_Full"). The tags of each
+   * dataset are stored in a table sorted by tag, and the strings are
+   * stored in a pool in which the names of the tags are shared. A
+   * tag can be looked up by dichotomy, without parsing the summary.
+   *
+   * Layout (little-endian 32-bit integers, offsets from the start):
+   *  - Header: Magic, version, offset of the string pool, size of
+   *    the string pool.
+   *  - Dataset: Number of tags, then one entry per tag: Tag, type,
+   *    name, value, private creator (strings are offsets in the pool,
+   *    the value of a sequence is the offset of its list of items).
+   *  - Sequence: Number of items, then the offset of each dataset.
+   *  - String pool: Each string is its length followed by its bytes.
+   **/
+  class CompactDicomAsJson
+  {
+  public:
+    // Whether the "DICOM-as-JSON" attachment uses the compact binary
+    // encoding (otherwise, it is JSON text)
+    static bool IsCompact(const std::string& dicomAsJson);
+
+    // Returns "false" if the JSON does not correspond to a
+    // "DICOM-as-JSON" summary, that must then be stored as text
+    static bool Encode(std::string& target,
+                       const Json::Value& dicomAsJson);
+
+    static void Decode(Json::Value& target,
+                       const std::string& compact);
+
+    // The two functions below accept both the JSON text and the
+    // compact encoding of a "DICOM-as-JSON" attachment
+
+    static void Parse(Json::Value& target,
+                      const std::string& dicomAsJson);
+
+    // Only extracts the given top-level tags, as in "DicomMap::FromDicomAsJson()"
+    static void ExtractTags(DicomMap& target,
+                            const std::string& dicomAsJson,
+                            const std::set<DicomTag>& tags);
+  };
+}
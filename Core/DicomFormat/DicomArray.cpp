@@ -40,12 +40,12 @@ namespace Orthanc
 {
   DicomArray::DicomArray(const DicomMap& map)
   {
-    elements_.reserve(map.map_.size());
+    elements_.reserve(map.GetSize());
     
-    for (DicomMap::Map::const_iterator it = 
-           map.map_.begin(); it != map.map_.end(); ++it)
+    for (size_t i = 0; i < map.GetSize(); i++)
     {
-      elements_.push_back(new DicomElement(it->first, *it->second));
+      const DicomMap::Record& record = map.GetSortedRecord(i);
+      elements_.push_back(new DicomElement(record.first, record.second));
     }
   }
 
@@ -0,0 +1,773 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2019 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "../PrecompiledHeaders.h"
+#include "DicomFrameOffsets.h"
+
+#include "../OrthancException.h"
+#include "../Toolbox.h"
+
+#include <boost/noncopyable.hpp>
+#include <cassert>
+#include <json/reader.h>
+#include <json/writer.h>
+#include <string.h>
+
+namespace Orthanc
+{
+  static const uint32_t UNDEFINED_LENGTH = 0xffffffffu;
+
+  namespace
+  {
+    /**
+     * Minimal reader of the elements of a raw DICOM stream, in
+     * little endian. It only decodes the tags and the lengths, which
+     * is sufficient to skip over the elements until the pixel data.
+     **/
+    class DicomStreamScanner : public boost::noncopyable
+    {
+    private:
+      const uint8_t*  buffer_;
+      size_t          size_;
+
+      static bool HasLongLength(const uint8_t* vr)
+      {
+        // PS3.5 Table 7.1-1: VRs with a reserved field and a 32bit length
+        return ((vr[0] == 'O' && (vr[1] == 'B' || vr[1] == 'D' || vr[1] == 'F' ||
+                                  vr[1] == 'L' || vr[1] == 'V' || vr[1] == 'W')) ||
+                (vr[0] == 'S' && (vr[1] == 'Q' || vr[1] == 'V')) ||
+                (vr[0] == 'U' && (vr[1] == 'C' || vr[1] == 'N' || vr[1] == 'R' ||
+                                  vr[1] == 'T' || vr[1] == 'V')));
+      }
+
+    public:
+      DicomStreamScanner(const void* buffer,
+                         size_t size) :
+        buffer_(reinterpret_cast<const uint8_t*>(buffer)),
+        size_(size)
+      {
+      }
+
+      size_t GetSize() const
+      {
+        return size_;
+      }
+
+      const uint8_t* GetBuffer() const
+      {
+        return buffer_;
+      }
+
+      uint16_t ReadUInt16(size_t position) const
+      {
+        if (position + 2 > size_)
+        {
+          throw OrthancException(ErrorCode_BadFileFormat);
+        }
+
+        return (static_cast<uint16_t>(buffer_[position]) |
+                (static_cast<uint16_t>(buffer_[position + 1]) << 8));
+      }
+
+      uint32_t ReadUInt32(size_t position) const
+      {
+        if (position + 4 > size_)
+        {
+          throw OrthancException(ErrorCode_BadFileFormat);
+        }
+
+        return (static_cast<uint32_t>(buffer_[position]) |
+                (static_cast<uint32_t>(buffer_[position + 1]) << 8) |
+                (static_cast<uint32_t>(buffer_[position + 2]) << 16) |
+                (static_cast<uint32_t>(buffer_[position + 3]) << 24));
+      }
+
+      std::string ReadString(size_t position,
+                             uint32_t length) const
+      {
+        if (length == UNDEFINED_LENGTH ||
+            position + length > size_)
+        {
+          throw OrthancException(ErrorCode_BadFileFormat);
+        }
+
+        // Remove the padding (space or NULL byte)
+        std::string s(reinterpret_cast<const char*>(buffer_) + position, length);
+        while (!s.empty() &&
+               (s[s.size() - 1] == '\0' || s[s.size() - 1] == ' '))
+        {
+          s.resize(s.size() - 1);
+        }
+
+        return Toolbox::StripSpaces(s);
+      }
+
+      // Reads the header of the element at "position". "isUN" is set
+      // if the VR is explicitly "UN", whose content is always encoded
+      // with the implicit VR if its length is undefined.
+      void ReadHeader(uint16_t& group,
+                      uint16_t& element,
+                      uint32_t& length,
+                      size_t& headerSize,
+                      bool& isUN,
+                      size_t position,
+                      bool explicitVR) const
+      {
+        group = ReadUInt16(position);
+        element = ReadUInt16(position + 2);
+        isUN = false;
+
+        if (group == 0xfffe)
+        {
+          // Items and delimiters never have a VR
+          length = ReadUInt32(position + 4);
+          headerSize = 8;
+        }
+        else if (explicitVR)
+        {
+          if (position + 6 > size_)
+          {
+            throw OrthancException(ErrorCode_BadFileFormat);
+          }
+
+          const uint8_t* vr = buffer_ + position + 4;
+          isUN = (vr[0] == 'U' && vr[1] == 'N');
+
+          if (HasLongLength(vr))
+          {
+            length = ReadUInt32(position + 8);
+            headerSize = 12;
+          }
+          else
+          {
+            length = ReadUInt16(position + 6);
+            headerSize = 8;
+          }
+        }
+        else
+        {
+          length = ReadUInt32(position + 4);
+          headerSize = 8;
+        }
+      }
+
+      // Skips the items of a sequence with undefined length, whose
+      // content starts at "position". Returns the position that
+      // follows the sequence delimitation item.
+      size_t SkipSequence(size_t position,
+                          bool explicitVR) const
+      {
+        for (;;)
+        {
+          uint16_t group, element;
+          uint32_t length;
+          size_t headerSize;
+          bool isUN;
+          ReadHeader(group, element, length, headerSize, isUN, position, explicitVR);
+
+          if (group != 0xfffe)
+          {
+            throw OrthancException(ErrorCode_BadFileFormat);
+          }
+
+          position += headerSize;
+
+          if (element == 0xe0dd)
+          {
+            return position;  // Sequence delimitation item
+          }
+          else if (element != 0xe000)
+          {
+            throw OrthancException(ErrorCode_BadFileFormat);
+          }
+          else if (length == UNDEFINED_LENGTH)
+          {
+            position = SkipItem(position, explicitVR);
+          }
+          else
+          {
+            position += length;
+          }
+        }
+      }
+
+      // Skips the elements of an item with undefined length. Returns
+      // the position that follows the item delimitation item.
+      size_t SkipItem(size_t position,
+                      bool explicitVR) const
+      {
+        for (;;)
+        {
+          uint16_t group, element;
+          uint32_t length;
+          size_t headerSize;
+          bool isUN;
+          ReadHeader(group, element, length, headerSize, isUN, position, explicitVR);
+
+          position += headerSize;
+
+          if (group == 0xfffe &&
+              element == 0xe00d)
+          {
+            return position;  // Item delimitation item
+          }
+          else if (length == UNDEFINED_LENGTH)
+          {
+            position = SkipSequence(position, explicitVR && !isUN);
+          }
+          else
+          {
+            position += length;
+          }
+        }
+      }
+    };
+  }
+
+
+  static bool IsVideoTransferSyntax(const std::string& transferSyntax)
+  {
+    // Video standards supported in DICOM 2016a, for which
+    // "DicomFrameIndex" assumes 1 frame
+    return (transferSyntax == "1.2.840.10008.1.2.4.100" ||
+            transferSyntax == "1.2.840.10008.1.2.4.101" ||
+            transferSyntax == "1.2.840.10008.1.2.4.102" ||
+            transferSyntax == "1.2.840.10008.1.2.4.103" ||
+            transferSyntax == "1.2.840.10008.1.2.4.104" ||
+            transferSyntax == "1.2.840.10008.1.2.4.105" ||
+            transferSyntax == "1.2.840.10008.1.2.4.106");
+  }
+
+
+  /**
+   * Locates the top-level "Pixel Data" element of a DICOM stream. On
+   * success, "position" is set to the offset of the header of this
+   * element. Throws "BadFileFormat" if the stream is malformed.
+   **/
+  static bool LocatePixelData(size_t& position,
+                              std::string& transferSyntax,
+                              bool& explicitVR,
+                              bool& isPmsctRle1,
+                              const DicomStreamScanner& scanner)
+  {
+    isPmsctRle1 = false;
+
+    // The file must start with the 128-byte preamble and "DICM"
+    if (scanner.GetSize() < 132 ||
+        memcmp(scanner.GetBuffer() + 128, "DICM", 4) != 0)
+    {
+      return false;
+    }
+
+    // Read the transfer syntax from the meta-header, that is always
+    // encoded as explicit VR little endian
+    transferSyntax.clear();
+    position = 132;
+
+    for (;;)
+    {
+      uint16_t group, element;
+      uint32_t length;
+      size_t headerSize;
+      bool isUN;
+      scanner.ReadHeader(group, element, length, headerSize, isUN, position, true);
+
+      if (group != 0x0002)
+      {
+        break;
+      }
+      else if (length == UNDEFINED_LENGTH)
+      {
+        return false;
+      }
+      else if (element == 0x0010)
+      {
+        transferSyntax = scanner.ReadString(position + headerSize, length);
+      }
+
+      position += headerSize + length;
+    }
+
+    if (transferSyntax == "1.2.840.10008.1.2")
+    {
+      explicitVR = false;
+    }
+    else if (transferSyntax.empty() ||
+             transferSyntax == "1.2.840.10008.1.2.1.99" ||  // Deflated
+             transferSyntax == "1.2.840.10008.1.2.2")       // Big endian
+    {
+      return false;
+    }
+    else
+    {
+      explicitVR = true;
+    }
+
+    // Loop over the top-level elements, until the pixel data
+    for (;;)
+    {
+      if (position >= scanner.GetSize())
+      {
+        return false;  // No pixel data
+      }
+
+      uint16_t group, element;
+      uint32_t length;
+      size_t headerSize;
+      bool isUN;
+      scanner.ReadHeader(group, element, length, headerSize, isUN, position, explicitVR);
+
+      if (group == 0x7fe0 &&
+          element == 0x0010)
+      {
+        return true;
+      }
+
+      position += headerSize;
+
+      if (group == 0x07a1 &&
+          element == 0x1011 &&
+          length != UNDEFINED_LENGTH &&
+          scanner.ReadString(position, length) == "PMSCT_RLE1")
+      {
+        // Private Philips compression
+        isPmsctRle1 = true;
+      }
+
+      if (length == UNDEFINED_LENGTH)
+      {
+        position = scanner.SkipSequence(position, explicitVR && !isUN);
+      }
+      else
+      {
+        position += length;
+      }
+    }
+  }
+
+
+  bool DicomFrameOffsets::LookupPixelDataOffset(uint64_t& offset,
+                                                const void* dicom,
+                                                size_t size)
+  {
+    DicomStreamScanner scanner(dicom, size);
+
+    try
+    {
+      size_t position;
+      std::string transferSyntax;
+      bool explicitVR, isPmsctRle1;
+
+      if (LocatePixelData(position, transferSyntax, explicitVR, isPmsctRle1, scanner))
+      {
+        offset = position;
+        return true;
+      }
+      else
+      {
+        return false;
+      }
+    }
+    catch (OrthancException&)
+    {
+      // Truncated or malformed file
+      return false;
+    }
+  }
+
+
+  bool DicomFrameOffsets::Compute(const void* dicom,
+                                  size_t size,
+                                  unsigned int countFrames,
+                                  size_t frameSize)
+  {
+    frames_.clear();
+    mime_ = MimeType_Binary;
+
+    if (countFrames == 0)
+    {
+      return false;
+    }
+
+    DicomStreamScanner scanner(dicom, size);
+
+    try
+    {
+      size_t position;
+      std::string transferSyntax;
+      bool explicitVR, isPmsctRle1;
+
+      if (!LocatePixelData(position, transferSyntax, explicitVR, isPmsctRle1, scanner) ||
+          IsVideoTransferSyntax(transferSyntax) ||
+          isPmsctRle1)  // Private Philips compression, decoded by "DicomFrameIndex"
+      {
+        return false;
+      }
+
+      {
+        uint16_t group, element;
+        uint32_t length;
+        size_t headerSize;
+        bool isUN;
+        scanner.ReadHeader(group, element, length, headerSize, isUN, position, explicitVR);
+        position += headerSize;
+
+        if (length != UNDEFINED_LENGTH)
+        {
+          if (static_cast<uint64_t>(position) + length > size ||
+              static_cast<uint64_t>(frameSize) * countFrames > length)
+          {
+            return false;
+          }
+
+          // Uncompressed pixel data: The frames are contiguous
+          frames_.resize(countFrames);
+          for (unsigned int i = 0; i < countFrames; i++)
+          {
+            frames_[i].push_back(std::make_pair(static_cast<uint64_t>(position) +
+                                                static_cast<uint64_t>(i) * frameSize,
+                                                static_cast<uint64_t>(frameSize)));
+          }
+
+          return true;
+        }
+      }
+
+      // Encapsulated pixel data: The first item is the basic offset
+      // table, followed by the fragments (PS3.5 Section A.4)
+      std::vector<uint32_t> offsetTable;
+      Fragments fragments;
+      std::vector<uint64_t> fragmentItems;  // Offset of each item, relative to the first fragment
+
+      size_t firstFragment = 0;
+      bool isFirst = true;
+
+      for (;;)
+      {
+        uint16_t group, element;
+        uint32_t length;
+        size_t headerSize;
+        bool isUN;
+        scanner.ReadHeader(group, element, length, headerSize, isUN, position, explicitVR);
+
+        if (group != 0xfffe)
+        {
+          return false;
+        }
+        else if (element == 0xe0dd)
+        {
+          break;  // End of the pixel data
+        }
+        else if (element != 0xe000 ||
+                 length == UNDEFINED_LENGTH ||
+                 static_cast<uint64_t>(position) + headerSize + length > size)
+        {
+          return false;
+        }
+
+        if (isFirst)
+        {
+          if (length % 4 != 0)
+          {
+            return false;
+          }
+
+          offsetTable.resize(length / 4);
+          for (size_t i = 0; i < offsetTable.size(); i++)
+          {
+            offsetTable[i] = scanner.ReadUInt32(position + headerSize + 4 * i);
+          }
+
+          isFirst = false;
+          firstFragment = position + headerSize + length;
+        }
+        else
+        {
+          fragmentItems.push_back(position - firstFragment);
+          fragments.push_back(std::make_pair(static_cast<uint64_t>(position + headerSize),
+                                             static_cast<uint64_t>(length)));
+        }
+
+        position += headerSize + length;
+      }
+
+      if (fragments.size() < countFrames)
+      {
+        return false;
+      }
+
+      frames_.resize(countFrames);
+
+      if (fragments.size() == countFrames)
+      {
+        // Simple case: There is one fragment per frame
+        for (unsigned int i = 0; i < countFrames; i++)
+        {
+          frames_[i].push_back(fragments[i]);
+        }
+      }
+      else if (countFrames == 1)
+      {
+        frames_[0] = fragments;
+      }
+      else
+      {
+        // Several fragments per frame: Use the basic offset table
+        if (offsetTable.size() != countFrames ||
+            offsetTable[0] != 0)
+        {
+          frames_.clear();
+          return false;
+        }
+
+        unsigned int currentFrame = 0;
+        for (size_t i = 0; i < fragments.size(); i++)
+        {
+          if (currentFrame + 1 < countFrames &&
+              fragmentItems[i] == offsetTable[currentFrame + 1])
+          {
+            currentFrame++;
+          }
+
+          frames_[currentFrame].push_back(fragments[i]);
+        }
+
+        if (currentFrame + 1 != countFrames)
+        {
+          frames_.clear();
+          return false;
+        }
+      }
+
+      if (transferSyntax == "1.2.840.10008.1.2.4.50")
+      {
+        mime_ = MimeType_Jpeg;
+      }
+      else if (transferSyntax == "1.2.840.10008.1.2.4.90" ||
+               transferSyntax == "1.2.840.10008.1.2.4.91")
+      {
+        mime_ = MimeType_Jpeg2000;
+      }
+
+      return true;
+    }
+    catch (OrthancException&)
+    {
+      // Truncated or malformed file
+      frames_.clear();
+      mime_ = MimeType_Binary;
+      return false;
+    }
+  }
+
+
+  const DicomFrameOffsets::Fragments& DicomFrameOffsets::GetFragments(unsigned int frame) const
+  {
+    if (frame >= frames_.size())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    assert(!frames_[frame].empty());
+    return frames_[frame];
+  }
+
+
+  void DicomFrameOffsets::GetFrameRange(uint64_t& start,
+                                        uint64_t& end,
+                                        unsigned int frame) const
+  {
+    const Fragments& fragments = GetFragments(frame);
+
+    // The fragments of one frame are stored in increasing order
+    start = fragments.front().first;
+    end = fragments.back().first + fragments.back().second;
+  }
+
+
+  void DicomFrameOffsets::ExtractFrame(std::string& target,
+                                       const std::string& region,
+                                       uint64_t regionStart,
+                                       unsigned int frame) const
+  {
+    const Fragments& fragments = GetFragments(frame);
+
+    uint64_t size = 0;
+    for (size_t i = 0; i < fragments.size(); i++)
+    {
+      if (fragments[i].first < regionStart ||
+          fragments[i].first + fragments[i].second > regionStart + region.size())
+      {
+        throw OrthancException(ErrorCode_ParameterOutOfRange);
+      }
+
+      size += fragments[i].second;
+    }
+
+    target.resize(static_cast<size_t>(size));
+
+    size_t pos = 0;
+    for (size_t i = 0; i < fragments.size(); i++)
+    {
+      if (fragments[i].second > 0)
+      {
+        memcpy(&target[pos], region.c_str() + (fragments[i].first - regionStart),
+               static_cast<size_t>(fragments[i].second));
+        pos += static_cast<size_t>(fragments[i].second);
+      }
+    }
+  }
+
+
+  static const char* const MIME_TYPE = "MimeType";
+  static const char* const OFFSET = "Offset";
+  static const char* const FRAME_SIZE = "FrameSize";
+  static const char* const FRAMES_COUNT = "FramesCount";
+  static const char* const FRAGMENTS = "Fragments";
+
+
+  void DicomFrameOffsets::Serialize(std::string& target) const
+  {
+    Json::Value value = Json::objectValue;
+    value[MIME_TYPE] = EnumerationToString(mime_);
+
+    // Uncompressed frames are summarized by their offset and size
+    bool isContiguous = !frames_.empty();
+    for (size_t i = 0; isContiguous && i < frames_.size(); i++)
+    {
+      isContiguous = (frames_[i].size() == 1 &&
+                      frames_[i][0].second == frames_[0][0].second &&
+                      frames_[i][0].first == frames_[0][0].first + i * frames_[0][0].second);
+    }
+
+    if (isContiguous)
+    {
+      value[OFFSET] = static_cast<Json::UInt64>(frames_[0][0].first);
+      value[FRAME_SIZE] = static_cast<Json::UInt64>(frames_[0][0].second);
+      value[FRAMES_COUNT] = static_cast<unsigned int>(frames_.size());
+    }
+    else
+    {
+      // One array per frame, made of the (offset, size) of its fragments
+      Json::Value frames = Json::arrayValue;
+      for (size_t i = 0; i < frames_.size(); i++)
+      {
+        Json::Value fragments = Json::arrayValue;
+        for (size_t j = 0; j < frames_[i].size(); j++)
+        {
+          fragments.append(static_cast<Json::UInt64>(frames_[i][j].first));
+          fragments.append(static_cast<Json::UInt64>(frames_[i][j].second));
+        }
+
+        frames.append(fragments);
+      }
+
+      value[FRAGMENTS] = frames;
+    }
+
+    Json::FastWriter writer;
+    target = writer.write(value);
+  }
+
+
+  void DicomFrameOffsets::Unserialize(const std::string& source)
+  {
+    frames_.clear();
+
+    Json::Value value;
+    Json::Reader reader;
+    if (!reader.parse(source, value) ||
+        value.type() != Json::objectValue ||
+        !value.isMember(MIME_TYPE) ||
+        value[MIME_TYPE].type() != Json::stringValue)
+    {
+      throw OrthancException(ErrorCode_BadFileFormat);
+    }
+
+    mime_ = StringToMimeType(value[MIME_TYPE].asString());
+
+    if (value.isMember(FRAGMENTS))
+    {
+      const Json::Value& frames = value[FRAGMENTS];
+      if (frames.type() != Json::arrayValue)
+      {
+        throw OrthancException(ErrorCode_BadFileFormat);
+      }
+
+      frames_.resize(frames.size());
+
+      for (Json::Value::ArrayIndex i = 0; i < frames.size(); i++)
+      {
+        const Json::Value& fragments = frames[i];
+        if (fragments.type() != Json::arrayValue ||
+            fragments.size() == 0 ||
+            fragments.size() % 2 != 0)
+        {
+          throw OrthancException(ErrorCode_BadFileFormat);
+        }
+
+        for (Json::Value::ArrayIndex j = 0; j < fragments.size(); j += 2)
+        {
+          if (!fragments[j].isIntegral() ||
+              !fragments[j + 1].isIntegral())
+          {
+            throw OrthancException(ErrorCode_BadFileFormat);
+          }
+
+          frames_[i].push_back(std::make_pair(static_cast<uint64_t>(fragments[j].asUInt64()),
+                                              static_cast<uint64_t>(fragments[j + 1].asUInt64())));
+        }
+      }
+    }
+    else if (value.isMember(OFFSET) &&
+             value.isMember(FRAME_SIZE) &&
+             value.isMember(FRAMES_COUNT) &&
+             value[OFFSET].isIntegral() &&
+             value[FRAME_SIZE].isIntegral() &&
+             value[FRAMES_COUNT].isIntegral())
+    {
+      uint64_t offset = value[OFFSET].asUInt64();
+      uint64_t frameSize = value[FRAME_SIZE].asUInt64();
+
+      frames_.resize(value[FRAMES_COUNT].asUInt());
+      for (size_t i = 0; i < frames_.size(); i++)
+      {
+        frames_[i].push_back(std::make_pair(offset + i * frameSize, frameSize));
+      }
+    }
+    else
+    {
+      throw OrthancException(ErrorCode_BadFileFormat);
+    }
+  }
+}
@@ -0,0 +1,107 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2019 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#pragma once
+
+#include "../Enumerations.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace Orthanc
+{
+  /**
+   * Table of the byte offsets of the frames inside a DICOM file. It
+   * is computed once by scanning the raw DICOM stream (without
+   * DCMTK), and can be serialized, so that a single frame can later
+   * be read from the storage area without parsing the whole file.
+   **/
+  class DicomFrameOffsets
+  {
+  private:
+    // Each frame is made of a list of (offset, size) fragments
+    typedef std::vector< std::pair<uint64_t, uint64_t> >  Fragments;
+
+    MimeType                mime_;
+    std::vector<Fragments>  frames_;
+
+    const Fragments& GetFragments(unsigned int frame) const;
+
+  public:
+    DicomFrameOffsets() :
+      mime_(MimeType_Binary)
+    {
+    }
+
+    // Returns "false" if the frames cannot be indexed (no pixel data,
+    // deflated or big endian transfer syntax, video, PMSCT_RLE1...).
+    // "frameSize" is only used by uncompressed transfer syntaxes.
+    bool Compute(const void* dicom,
+                 size_t size,
+                 unsigned int countFrames,
+                 size_t frameSize);
+
+    // Offset of the top-level "Pixel Data" element (i.e. of its
+    // header) in a DICOM file in little endian. Everything that
+    // precedes this offset can be parsed without the pixel data.
+    static bool LookupPixelDataOffset(uint64_t& offset,
+                                      const void* dicom,
+                                      size_t size);
+
+    MimeType GetMimeType() const
+    {
+      return mime_;
+    }
+
+    unsigned int GetFramesCount() const
+    {
+      return static_cast<unsigned int>(frames_.size());
+    }
+
+    // Range [start, end[ of the file that contains the given frame
+    void GetFrameRange(uint64_t& start,
+                       uint64_t& end,
+                       unsigned int frame) const;
+
+    // "region" contains the bytes of the file starting at offset
+    // "regionStart", and must include the range of the frame
+    void ExtractFrame(std::string& target,
+                      const std::string& region,
+                      uint64_t regionStart,
+                      unsigned int frame) const;
+
+    void Serialize(std::string& target) const;
+
+    void Unserialize(const std::string& source);
+  };
+}
@@ -36,11 +36,14 @@
 
 #include <stdio.h>
 #include <memory>
+#include <algorithm>
 
 #include "../Endianness.h"
 #include "../Logging.h"
 #include "../OrthancException.h"
 
+#include <json/reader.h>
+
 
 namespace Orthanc
 {
@@ -154,40 +157,113 @@ namespace Orthanc
   }
 
 
-  void DicomMap::SetValue(uint16_t group, 
-                          uint16_t element, 
-                          DicomValue* value)
+  static inline uint32_t GetKey(const DicomTag& tag)
   {
-    DicomTag tag(group, element);
-    Map::iterator it = map_.find(tag);
+    return ((static_cast<uint32_t>(tag.GetGroup()) << 16) |
+            static_cast<uint32_t>(tag.GetElement()));
+  }
+
 
-    if (it != map_.end())
+  bool DicomMap::FindIndexEntry(size_t& position,
+                                const DicomTag& tag) const
+  {
+    const uint32_t key = GetKey(tag);
+
+    // Fast path: The tags are most often inserted in increasing order
+    if (index_.empty() ||
+        index_.back().first < key)
     {
-      delete it->second;
-      it->second = value;
+      position = index_.size();
+      return false;
     }
-    else
+
+    // Dichotomy
+    size_t low = 0;
+    size_t high = index_.size();
+
+    while (low < high)
     {
-      map_.insert(std::make_pair(tag, value));
+      const size_t middle = low + (high - low) / 2;
+      if (index_[middle].first < key)
+      {
+        low = middle + 1;
+      }
+      else
+      {
+        high = middle;
+      }
     }
+
+    position = low;
+    return (low < index_.size() &&
+            index_[low].first == key);
   }
 
-  void DicomMap::SetValue(DicomTag tag, 
-                          DicomValue* value)
+
+  DicomValue& DicomMap::InsertRecord(const DicomTag& tag)
   {
-    SetValue(tag.GetGroup(), tag.GetElement(), value);
+    size_t position;
+    if (FindIndexEntry(position, tag))
+    {
+      return records_[index_[position].second].second;
+    }
+
+    if (records_.size() == records_.capacity())
+    {
+      // Grow the storage by swapping the values, which avoids copying
+      // their content, as C++03 has no move semantics
+      std::vector<Record> grown;
+      grown.reserve(records_.empty() ? 16 : 2 * records_.size());
+
+      for (size_t i = 0; i < records_.size(); i++)
+      {
+        grown.push_back(Record(records_[i].first, DicomValue()));
+        grown.back().second.Swap(records_[i].second);
+      }
+
+      records_.swap(grown);
+    }
+
+    const uint32_t index = static_cast<uint32_t>(records_.size());
+    records_.push_back(Record(tag, DicomValue()));
+    index_.insert(index_.begin() + position, IndexEntry(GetKey(tag), index));
+
+    return records_.back().second;
   }
 
 
-  void DicomMap::Clear()
+  void DicomMap::SwapValue(const DicomTag& tag,
+                           DicomValue& value)
+  {
+    InsertRecord(tag).Swap(value);
+  }
+
+
+  void DicomMap::SetValue(uint16_t group, 
+                          uint16_t element, 
+                          DicomValue* value)
+  {
+    SetValue(DicomTag(group, element), value);
+  }
+
+  void DicomMap::SetValue(DicomTag tag, 
+                          DicomValue* value)
   {
-    for (Map::iterator it = map_.begin(); it != map_.end(); ++it)
+    std::auto_ptr<DicomValue> protection(value);
+
+    if (value == NULL)
     {
-      assert(it->second != NULL);
-      delete it->second;
+      throw OrthancException(ErrorCode_NullPointer);
     }
 
-    map_.clear();
+    SwapValue(tag, *value);
+  }
+
+
+  void DicomMap::Clear()
+  {
+    records_.clear();
+    index_.clear();
   }
 
 
@@ -199,10 +275,10 @@ namespace Orthanc
 
     for (unsigned int i = 0; i < count; i++)
     {
-      Map::const_iterator it = map_.find(tags[i]);
-      if (it != map_.end())
+      const DicomValue* value = TestAndGetValue(tags[i]);
+      if (value != NULL)
       {
-        result.SetValue(it->first, it->second->Clone());
+        result.InsertRecord(tags[i]) = *value;
       }
     }
   }
@@ -233,23 +309,18 @@ namespace Orthanc
   DicomMap* DicomMap::Clone() const
   {
     std::auto_ptr<DicomMap> result(new DicomMap);
-
-    for (Map::const_iterator it = map_.begin(); it != map_.end(); ++it)
-    {
-      result->map_.insert(std::make_pair(it->first, it->second->Clone()));
-    }
-
+    result->records_ = records_;
+    result->index_ = index_;
     return result.release();
   }
 
 
   void DicomMap::Assign(const DicomMap& other)
   {
-    Clear();
-
-    for (Map::const_iterator it = other.map_.begin(); it != other.map_.end(); ++it)
+    if (&other != this)
     {
-      map_.insert(std::make_pair(it->first, it->second->Clone()));
+      records_ = other.records_;
+      index_ = other.index_;
     }
   }
 
@@ -271,26 +342,43 @@ namespace Orthanc
 
   const DicomValue* DicomMap::TestAndGetValue(const DicomTag& tag) const
   {
-    Map::const_iterator it = map_.find(tag);
-
-    if (it == map_.end())
+    size_t position;
+    if (FindIndexEntry(position, tag))
     {
-      return NULL;
+      return &records_[index_[position].second].second;
     }
     else
     {
-      return it->second;
+      return NULL;
     }
   }
 
 
   void DicomMap::Remove(const DicomTag& tag) 
   {
-    Map::iterator it = map_.find(tag);
-    if (it != map_.end())
+    size_t position;
+    if (FindIndexEntry(position, tag))
     {
-      delete it->second;
-      map_.erase(it);
+      const uint32_t removed = index_[position].second;
+      index_.erase(index_.begin() + position);
+
+      // Move the last record into the freed slot, then drop it
+      const uint32_t last = static_cast<uint32_t>(records_.size() - 1);
+      if (removed != last)
+      {
+        std::swap(records_[removed].first, records_[last].first);
+        records_[removed].second.Swap(records_[last].second);
+
+        size_t moved;
+        if (!FindIndexEntry(moved, records_[removed].first))
+        {
+          throw OrthancException(ErrorCode_InternalError);
+        }
+
+        index_[moved].second = removed;
+      }
+
+      records_.pop_back();
     }
   }
 
@@ -477,10 +565,9 @@ namespace Orthanc
   {
     tags.clear();
 
-    for (Map::const_iterator it = map_.begin();
-         it != map_.end(); ++it)
+    for (size_t i = 0; i < index_.size(); i++)
     {
-      tags.insert(it->first);
+      tags.insert(tags.end(), GetSortedRecord(i).first);
     }
   }
 
@@ -981,6 +1068,32 @@ namespace Orthanc
     }
   }
 
+
+  static void AddDicomAsJsonValue(DicomMap& target,
+                                  const DicomTag& tag,
+                                  const Json::Value& value)
+  {
+    if (value.type() != Json::objectValue ||
+        !value.isMember("Type") ||
+        !value.isMember("Value") ||
+        value["Type"].type() != Json::stringValue)
+    {
+      throw OrthancException(ErrorCode_CorruptedFile);
+    }
+
+    if (value["Type"] == "String")
+    {
+      if (value["Value"].type() != Json::stringValue)
+      {
+        throw OrthancException(ErrorCode_CorruptedFile);
+      }
+      else
+      {
+        target.SetValue(tag, value["Value"].asString(), false /* not binary */);
+      }
+    }
+  }
+
   
   void DicomMap::FromDicomAsJson(const Json::Value& dicomAsJson)
   {
@@ -996,41 +1109,242 @@ namespace Orthanc
         throw OrthancException(ErrorCode_CorruptedFile);
       }
 
-      const Json::Value& value = dicomAsJson[*it];
+      AddDicomAsJsonValue(*this, tag, dicomAsJson[*it]);
+    }
+  }
+
+
+  namespace
+  {
+    // Lightweight scanner over the text of a JSON document, that
+    // skips values without building them
+    class JsonTextScanner : public boost::noncopyable
+    {
+    private:
+      const char*  current_;
+      const char*  end_;
+
+      static void Corrupted()
+      {
+        throw OrthancException(ErrorCode_CorruptedFile);
+      }
+
+    public:
+      JsonTextScanner(const std::string& text) :
+        current_(text.c_str()),
+        end_(text.c_str() + text.size())
+      {
+      }
+
+      const char* GetPosition() const
+      {
+        return current_;
+      }
+
+      char Peek()
+      {
+        while (current_ < end_ &&
+               (*current_ == ' ' || *current_ == '\t' ||
+                *current_ == '\n' || *current_ == '\r'))
+        {
+          current_++;
+        }
+
+        if (current_ == end_)
+        {
+          Corrupted();
+        }
+
+        return *current_;
+      }
+
+      void Expect(char c)
+      {
+        if (Peek() != c)
+        {
+          Corrupted();
+        }
+
+        current_++;
+      }
+
+      // Returns the raw content of a string, without unescaping
+      void ReadRawString(const char*& begin,
+                         const char*& end)
+      {
+        Expect('"');
+        begin = current_;
+
+        while (current_ < end_ &&
+               *current_ != '"')
+        {
+          if (*current_ == '\\')
+          {
+            current_++;  // Skip the escaped character
+          }
+
+          current_++;
+        }
+
+        if (current_ >= end_)
+        {
+          Corrupted();
+        }
+
+        end = current_;
+        current_++;  // Skip the closing quote
+      }
+
+      void SkipValue()
+      {
+        const char* begin;
+        const char* end;
+
+        switch (Peek())
+        {
+          case '"':
+            ReadRawString(begin, end);
+            break;
+
+          case '{':
+          case '[':
+          {
+            unsigned int depth = 0;
+
+            do
+            {
+              switch (Peek())
+              {
+                case '"':
+                  ReadRawString(begin, end);
+                  break;
+
+                case '{':
+                case '[':
+                  depth++;
+                  current_++;
+                  break;
+
+                case '}':
+                case ']':
+                  depth--;
+                  current_++;
+                  break;
+
+                default:
+                  current_++;
+                  break;
+              }
+            }
+            while (depth > 0);
+
+            break;
+          }
+
+          default:
+            // Literal ("null", "true", "false", or a number)
+            while (current_ < end_ &&
+                   *current_ != ',' &&
+                   *current_ != '}' &&
+                   *current_ != ']')
+            {
+              current_++;
+            }
+        }
+      }
+    };
+  }
+
+
+  void DicomMap::FromDicomAsJson(const std::string& dicomAsJson,
+                                 const std::set<DicomTag>& tags)
+  {
+    Clear();
+
+    if (tags.empty())
+    {
+      return;
+    }
+
+    JsonTextScanner scanner(dicomAsJson);
+    scanner.Expect('{');
+
+    if (scanner.Peek() == '}')
+    {
+      return;  // Empty dataset
+    }
+
+    size_t found = 0;
+
+    for (;;)
+    {
+      const char* begin;
+      const char* end;
+      scanner.ReadRawString(begin, end);
+      scanner.Expect(':');
 
-      if (value.type() != Json::objectValue ||
-          !value.isMember("Type") ||
-          !value.isMember("Value") ||
-          value["Type"].type() != Json::stringValue)
+      DicomTag tag(0, 0);
+      if (!DicomTag::ParseHexadecimal(tag, std::string(begin, end).c_str()))
       {
         throw OrthancException(ErrorCode_CorruptedFile);
       }
 
-      if (value["Type"] == "String")
+      if (tags.find(tag) == tags.end())
+      {
+        scanner.SkipValue();
+      }
+      else
       {
-        if (value["Value"].type() != Json::stringValue)
+        scanner.Peek();
+        begin = scanner.GetPosition();
+        scanner.SkipValue();
+
+        Json::Value value;
+        Json::Reader reader;
+        if (!reader.parse(begin, scanner.GetPosition(), value))
         {
           throw OrthancException(ErrorCode_CorruptedFile);
         }
-        else
+
+        AddDicomAsJsonValue(*this, tag, value);
+
+        found++;
+        if (found == tags.size())
         {
-          SetValue(tag, value["Value"].asString(), false /* not binary */);
+          return;  // All the requested tags have been found
         }
       }
+
+      char c = scanner.Peek();
+      if (c == '}')
+      {
+        return;
+      }
+      else if (c == ',')
+      {
+        scanner.Expect(',');
+      }
+      else
+      {
+        throw OrthancException(ErrorCode_CorruptedFile);
+      }
     }
   }
 
 
   void DicomMap::Merge(const DicomMap& other)
   {
-    for (Map::const_iterator it = other.map_.begin();
-         it != other.map_.end(); ++it)
+    if (&other == this)
     {
-      assert(it->second != NULL);
+      return;
+    }
 
-      if (map_.find(it->first) == map_.end())
+    for (size_t i = 0; i < other.records_.size(); i++)
+    {
+      const Record& record = other.records_[i];
+      if (!HasTag(record.first))
       {
-        map_[it->first] = it->second->Clone();
+        InsertRecord(record.first) = record.second;
       }
     }
   }
@@ -1047,13 +1361,12 @@ namespace Orthanc
 
     for (size_t i = 0; i < size; i++)
     {
-      Map::const_iterator found = other.map_.find(tags[i]);
+      const DicomValue* found = other.TestAndGetValue(tags[i]);
 
-      if (found != other.map_.end() &&
-          map_.find(tags[i]) == map_.end())
+      if (found != NULL &&
+          !HasTag(tags[i]))
       {
-        assert(found->second != NULL);
-        map_[tags[i]] = found->second->Clone();
+        InsertRecord(tags[i]) = *found;
       }
     }
   }
@@ -1076,9 +1389,9 @@ namespace Orthanc
     std::set<DicomTag> mainDicomTags;
     GetMainDicomTags(mainDicomTags);
 
-    for (Map::const_iterator it = map_.begin(); it != map_.end(); ++it)
+    for (size_t i = 0; i < records_.size(); i++)
     {
-      if (mainDicomTags.find(it->first) == mainDicomTags.end())
+      if (mainDicomTags.find(records_[i].first) == mainDicomTags.end())
       {
         return false;
       }
@@ -1092,14 +1405,12 @@ namespace Orthanc
   {
     target = Json::objectValue;
 
-    for (Map::const_iterator it = map_.begin(); it != map_.end(); ++it)
+    for (size_t i = 0; i < records_.size(); i++)
     {
-      assert(it->second != NULL);
-      
-      std::string tag = it->first.Format();
+      std::string tag = records_[i].first.Format();
 
       Json::Value value;
-      it->second->Serialize(value);
+      records_[i].second.Serialize(value);
 
       target[tag] = value;
     }
@@ -1122,15 +1433,12 @@ namespace Orthanc
       DicomTag tag(0, 0);
       
       if (!DicomTag::ParseHexadecimal(tag, tags[i].c_str()) ||
-          map_.find(tag) != map_.end())
+          HasTag(tag))
       {
         throw OrthancException(ErrorCode_BadFileFormat);
       }
 
-      std::auto_ptr<DicomValue> value(new DicomValue);
-      value->Unserialize(source[tags[i]]);
-
-      map_[tag] = value.release();
+      InsertRecord(tag).Unserialize(source[tags[i]]);
     }
   }
 }
@@ -39,6 +39,7 @@
 
 #include <set>
 #include <map>
+#include <vector>
 #include <json/json.h>
 
 namespace Orthanc
@@ -50,9 +51,35 @@ namespace Orthanc
     friend class FromDcmtkBridge;
     friend class ParsedDicomFile;
 
-    typedef std::map<DicomTag, DicomValue*>  Map;
+    // Instead of a "std::map" of heap-allocated values, the values
+    // are stored by value in a contiguous vector, in their order of
+    // insertion. They are indexed by a compact vector of 32-bit keys
+    // "(group << 16) | element" that is sorted, and that is searched
+    // by dichotomy. This is much more cache-friendly.
+    typedef std::pair<DicomTag, DicomValue>  Record;
+    typedef std::pair<uint32_t, uint32_t>    IndexEntry;  // Key, position in "records_"
 
-    Map map_;
+    std::vector<Record>      records_;
+    std::vector<IndexEntry>  index_;
+
+    // Returns "true" iff the tag is present. In any case, "position"
+    // is set to where the tag is or should be inserted in "index_".
+    bool FindIndexEntry(size_t& position,
+                        const DicomTag& tag) const;
+
+    // Returns the existing value, or inserts a null value. Beware
+    // that this invalidates the pointers to the values of the map.
+    DicomValue& InsertRecord(const DicomTag& tag);
+
+    // Stores a copy of "value", by swapping its content
+    void SwapValue(const DicomTag& tag,
+                   DicomValue& value);
+
+    // Access to the records, sorted by tag
+    const Record& GetSortedRecord(size_t i) const
+    {
+      return records_[index_[i].second];
+    }
 
     // Warning: This takes the ownership of "value"
     void SetValue(uint16_t group, 
@@ -83,7 +110,7 @@ namespace Orthanc
 
     size_t GetSize() const
     {
-      return map_.size();
+      return records_.size();
     }
     
     DicomMap* Clone() const;
@@ -95,32 +122,36 @@ namespace Orthanc
     void SetNullValue(uint16_t group, 
                       uint16_t element)
     {
-      SetValue(group, element, new DicomValue);
+      SetNullValue(DicomTag(group, element));
     }
     
     void SetNullValue(const DicomTag& tag)
     {
-      SetValue(tag, new DicomValue);
+      DicomValue value;
+      SwapValue(tag, value);
     }
     
     void SetValue(uint16_t group, 
                   uint16_t element, 
                   const DicomValue& value)
     {
-      SetValue(group, element, value.Clone());
+      SetValue(DicomTag(group, element), value);
     }
 
     void SetValue(const DicomTag& tag,
                   const DicomValue& value)
     {
-      SetValue(tag, value.Clone());
+      // The copy protects against "value" being stored in this map
+      DicomValue copy(value);
+      SwapValue(tag, copy);
     }
 
     void SetValue(const DicomTag& tag,
                   const std::string& str,
                   bool isBinary)
     {
-      SetValue(tag, new DicomValue(str, isBinary));
+      DicomValue value(str, isBinary);
+      SwapValue(tag, value);
     }
 
     void SetValue(uint16_t group, 
@@ -128,7 +159,7 @@ namespace Orthanc
                   const std::string& str,
                   bool isBinary)
     {
-      SetValue(group, element, new DicomValue(str, isBinary));
+      SetValue(DicomTag(group, element), str, isBinary);
     }
 
     bool HasTag(uint16_t group, uint16_t element) const
@@ -138,7 +169,8 @@ namespace Orthanc
 
     bool HasTag(const DicomTag& tag) const
     {
-      return map_.find(tag) != map_.end();
+      size_t position;
+      return FindIndexEntry(position, tag);
     }
 
     const DicomValue& GetValue(uint16_t group, uint16_t element) const
@@ -154,7 +186,8 @@ namespace Orthanc
       return TestAndGetValue(DicomTag(group, element));
     }       
 
-    // DO NOT delete the returned value!
+    // DO NOT delete the returned value! The pointer is invalidated
+    // by any subsequent modification of the map.
     const DicomValue* TestAndGetValue(const DicomTag& tag) const;
 
     void Remove(const DicomTag& tag);
@@ -222,6 +255,11 @@ namespace Orthanc
 
     void FromDicomAsJson(const Json::Value& dicomAsJson);
 
+    // Only extracts the given tags from the text of a "DICOM-as-JSON"
+    // summary: The other values are skipped without being parsed
+    void FromDicomAsJson(const std::string& dicomAsJson,
+                         const std::set<DicomTag>& tags);
+
     void Merge(const DicomMap& other);
 
     void ExtractMainDicomTags(const DicomMap& other);
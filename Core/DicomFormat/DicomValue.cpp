@@ -38,6 +38,7 @@
 #include "../SerializationToolbox.h"
 #include "../Toolbox.h"
 
+#include <algorithm>
 #include <boost/lexical_cast.hpp>
 
 namespace Orthanc
@@ -84,6 +85,13 @@ namespace Orthanc
     return new DicomValue(*this);
   }
 
+
+  void DicomValue::Swap(DicomValue& other)
+  {
+    std::swap(type_, other.type_);
+    content_.swap(other.content_);
+  }
+
   
 #if ORTHANC_ENABLE_BASE64 == 1
   void DicomValue::FormatDataUriScheme(std::string& target,
@@ -37,6 +37,7 @@
 
 #include <stdint.h>
 #include <boost/noncopyable.hpp>
+#include <string>
 #include <json/value.h>
 
 #if !defined(ORTHANC_ENABLE_BASE64)
@@ -46,7 +47,9 @@
 
 namespace Orthanc
 {
-  class DicomValue : public boost::noncopyable
+  // This class is copyable, as it is stored by value inside the
+  // flat storage of "DicomMap"
+  class DicomValue
   {
   private:
     enum Type
@@ -59,12 +62,12 @@ namespace Orthanc
     Type         type_;
     std::string  content_;
 
-    DicomValue(const DicomValue& other);
-
   public:
     DicomValue() : type_(Type_Null)
     {
     }
+
+    DicomValue(const DicomValue& other);
     
     DicomValue(const std::string& content,
                bool isBinary);
@@ -87,6 +90,9 @@ namespace Orthanc
     
     DicomValue* Clone() const;
 
+    // Exchanges the content of two values, without copying the strings
+    void Swap(DicomValue& other);
+
 #if ORTHANC_ENABLE_BASE64 == 1
     void FormatDataUriScheme(std::string& target,
                              const std::string& mime) const;
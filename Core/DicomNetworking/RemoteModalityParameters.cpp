@@ -326,4 +326,11 @@ namespace Orthanc
         throw OrthancException(ErrorCode_BadFileFormat);
     }
   }
+
+
+  std::string RemoteModalityParameters::FormatTarget() const
+  {
+    return ("DICOM:" + aet_ + "@" + host_ + ":" +
+            boost::lexical_cast<std::string>(port_));
+  }
 }
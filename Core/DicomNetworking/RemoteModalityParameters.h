@@ -129,5 +129,9 @@ namespace Orthanc
 
     void Serialize(Json::Value& target,
                    bool forceAdvancedFormat) const;
+
+    // Identifies the remote modality in the scheduling of the jobs,
+    // as "DICOM:AET@host:port" (new in Orthanc 1.5.7)
+    std::string FormatTarget() const;
   };
 }
@@ -55,6 +55,7 @@ namespace Orthanc
   {
   private:
     DicomModification&  that_;
+    const DicomMap&     source_;
     
     bool IsEnabled(const DicomTag& tag) const
     {
@@ -74,8 +75,10 @@ namespace Orthanc
                          
 
   public:
-    RelationshipsVisitor(DicomModification&  that) :
-    that_(that)
+    RelationshipsVisitor(DicomModification&  that,
+                         const DicomMap& source) :
+      that_(that),
+      source_(source)
     {
     }
 
@@ -140,14 +143,14 @@ namespace Orthanc
                tag == DICOM_TAG_REFERENCED_SOP_INSTANCE_UID ||
                tag == DICOM_TAG_RELATED_FRAME_OF_REFERENCE_UID)
       {
-        newValue = that_.MapDicomIdentifier(Toolbox::StripSpaces(value), ResourceType_Instance);
+        newValue = that_.MapDicomIdentifier(Toolbox::StripSpaces(value), ResourceType_Instance, source_);
         return Action_Replace;
       }
       else if (parentTags.size() == 1 &&
                parentTags[0] == DICOM_TAG_CURRENT_REQUESTED_PROCEDURE_EVIDENCE_SEQUENCE &&
                tag == DICOM_TAG_STUDY_INSTANCE_UID)
       {
-        newValue = that_.MapDicomIdentifier(Toolbox::StripSpaces(value), ResourceType_Study);
+        newValue = that_.MapDicomIdentifier(Toolbox::StripSpaces(value), ResourceType_Study, source_);
         return Action_Replace;
       }
       else if (parentTags.size() == 2 &&
@@ -155,7 +158,7 @@ namespace Orthanc
                parentTags[1] == DICOM_TAG_REFERENCED_SERIES_SEQUENCE &&
                tag == DICOM_TAG_SERIES_INSTANCE_UID)
       {
-        newValue = that_.MapDicomIdentifier(Toolbox::StripSpaces(value), ResourceType_Series);
+        newValue = that_.MapDicomIdentifier(Toolbox::StripSpaces(value), ResourceType_Series, source_);
         return Action_Replace;
       }
       else
@@ -245,10 +248,19 @@ namespace Orthanc
 
 
   std::string DicomModification::MapDicomIdentifier(const std::string& original,
-                                                    ResourceType level)
+                                                    ResourceType level,
+                                                    const DicomMap& source)
   {
     std::string mapped;
 
+    /**
+     * The lookup and the insertion must be atomic, so that two
+     * instances of the same study/series that are modified
+     * concurrently (e.g. by a parallel ResourceModificationJob) are
+     * given the same new identifier.
+     **/
+    boost::mutex::scoped_lock lock(uidMapMutex_);
+
     UidMap::const_iterator previous = uidMap_.find(std::make_pair(level, original));
 
     if (previous == uidMap_.end())
@@ -259,7 +271,7 @@ namespace Orthanc
       }
       else
       {
-        if (!identifierGenerator_->Apply(mapped, original, level, currentSource_))
+        if (!identifierGenerator_->Apply(mapped, original, level, source))
         {
           throw OrthancException(ErrorCode_InternalError,
                                  "Unable to generate an anonymized ID");
@@ -278,7 +290,8 @@ namespace Orthanc
 
 
   void DicomModification::MapDicomTags(ParsedDicomFile& dicom,
-                                       ResourceType level)
+                                       ResourceType level,
+                                       const DicomMap& source)
   {
     std::auto_ptr<DicomTag> tag;
 
@@ -306,7 +319,7 @@ namespace Orthanc
       original = "";
     }
 
-    std::string mapped = MapDicomIdentifier(Toolbox::StripSpaces(original), level);
+    std::string mapped = MapDicomIdentifier(Toolbox::StripSpaces(original), level, source);
 
     dicom.Replace(*tag, mapped, 
                   false /* don't try and decode data URI scheme for UIDs */, 
@@ -971,10 +984,12 @@ namespace Orthanc
 
 
     // (0) Create a summary of the source file, if a custom generator
-    // is provided
+    // is provided. This summary is local to this call, as "Apply()"
+    // can be invoked from several threads at once.
+    DicomMap source;
     if (identifierGenerator_ != NULL)
     {
-      toModify.ExtractDicomSummary(currentSource_);
+      toModify.ExtractDicomSummary(source);
     }
 
 
@@ -1015,7 +1030,7 @@ namespace Orthanc
       }
       else
       {
-        MapDicomTags(toModify, ResourceType_Study);
+        MapDicomTags(toModify, ResourceType_Study, source);
       }
     }
 
@@ -1028,20 +1043,20 @@ namespace Orthanc
       }
       else
       {
-        MapDicomTags(toModify, ResourceType_Series);
+        MapDicomTags(toModify, ResourceType_Series, source);
       }
     }
 
     if (level_ <= ResourceType_Instance &&  // Always true
         !IsReplaced(DICOM_TAG_SOP_INSTANCE_UID))
     {
-      MapDicomTags(toModify, ResourceType_Instance);
+      MapDicomTags(toModify, ResourceType_Instance, source);
     }
 
     // (6) Update the "referenced" relationships in the case of an anonymization
     if (isAnonymization_)
     {
-      RelationshipsVisitor visitor(*this);
+      RelationshipsVisitor visitor(*this, source);
 
       if (updateReferencedRelationships_)
       {
@@ -1314,6 +1329,8 @@ namespace Orthanc
     mapSeries = Json::objectValue;
     mapInstances = Json::objectValue;
 
+    boost::mutex::scoped_lock lock(uidMapMutex_);
+
     for (UidMap::const_iterator it = uidMap_.begin(); it != uidMap_.end(); ++it)
     {
       Json::Value* tmp = NULL;
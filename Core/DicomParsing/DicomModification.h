@@ -35,6 +35,8 @@
 
 #include "ParsedDicomFile.h"
 
+#include <boost/thread/mutex.hpp>
+
 namespace Orthanc
 {
   class DicomModification : public boost::noncopyable
@@ -79,21 +81,23 @@ namespace Orthanc
     bool removePrivateTags_;
     ResourceType level_;
     UidMap uidMap_;
+    mutable boost::mutex uidMapMutex_;   // Apply() can be invoked concurrently
     SetOfTags privateTagsToKeep_;
     bool allowManualIdentifiers_;
     bool keepStudyInstanceUid_;
     bool keepSeriesInstanceUid_;
     bool updateReferencedRelationships_;
     bool isAnonymization_;
-    DicomMap currentSource_;
 
     IDicomIdentifierGenerator* identifierGenerator_;
 
     std::string MapDicomIdentifier(const std::string& original,
-                                   ResourceType level);
+                                   ResourceType level,
+                                   const DicomMap& source);
 
     void MapDicomTags(ParsedDicomFile& dicom,
-                      ResourceType level);
+                      ResourceType level,
+                      const DicomMap& source);
 
     void MarkNotOrthancAnonymization();
 
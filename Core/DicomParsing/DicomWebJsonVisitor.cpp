@@ -358,14 +358,140 @@ namespace Orthanc
 #endif
 
 
+  void DicomWebJsonVisitor::CloseStreamedSequence()
+  {
+    assert(stream_.get() != NULL &&
+           !streamTags_.empty());
+
+    stream_->EndObject();  // Item
+    stream_->EndArray();   // Value
+    stream_->EndObject();  // Sequence
+
+    streamTags_.pop_back();
+    streamIndexes_.pop_back();
+  }
+
+
+  void DicomWebJsonVisitor::MoveStream(const std::vector<DicomTag>& parentTags,
+                                       const std::vector<size_t>& parentIndexes)
+  {
+    // The DCMTK datasets are visited depth-first: Close the items
+    // that are not shared by the path to the new node, then open the
+    // missing ones. This mimics "CreateNode()".
+    assert(stream_.get() != NULL &&
+           parentTags.size() == parentIndexes.size() &&
+           streamTags_.size() == streamIndexes_.size());
+
+    size_t common = 0;
+    while (common < streamTags_.size() &&
+           common < parentTags.size() &&
+           streamTags_[common] == parentTags[common] &&
+           streamIndexes_[common] == parentIndexes[common])
+    {
+      common++;
+    }
+
+    while (streamTags_.size() > common + 1)
+    {
+      CloseStreamedSequence();
+    }
+
+    if (streamTags_.size() == common + 1)
+    {
+      if (common < parentTags.size() &&
+          streamTags_[common] == parentTags[common])
+      {
+        // Next item in the same sequence
+        if (parentIndexes[common] < streamIndexes_[common])
+        {
+          throw OrthancException(ErrorCode_InternalError);
+        }
+
+        stream_->EndObject();
+        stream_->StartObject();
+        streamIndexes_[common] = parentIndexes[common];
+        common++;
+      }
+      else
+      {
+        CloseStreamedSequence();
+      }
+    }
+
+    for (size_t i = common; i < parentTags.size(); i++)
+    {
+      stream_->WriteKey(FormatTag(parentTags[i]));
+      stream_->StartObject();
+      stream_->WriteKey(KEY_VR);
+      stream_->WriteString(KEY_SQ);
+      stream_->WriteKey(KEY_VALUE);
+      stream_->StartArray();
+      stream_->StartObject();
+
+      streamTags_.push_back(parentTags[i]);
+      streamIndexes_.push_back(parentIndexes[i]);
+    }
+  }
+
+
+  void DicomWebJsonVisitor::AddNode(const std::vector<DicomTag>& parentTags,
+                                    const std::vector<size_t>& parentIndexes,
+                                    const DicomTag& tag,
+                                    Json::Value& node)
+  {
+    if (stream_.get() == NULL)
+    {
+      CreateNode(parentTags, parentIndexes, tag).swap(node);
+    }
+    else
+    {
+      MoveStream(parentTags, parentIndexes);
+      stream_->WriteKey(FormatTag(tag));
+      stream_->WriteValue(node);
+    }
+  }
+
+
+  void DicomWebJsonVisitor::OpenStream(std::string& target)
+  {
+    target.clear();
+
+    stream_.reset(new JsonStreamWriter(target));
+    stream_->StartObject();
+
+    streamTags_.clear();
+    streamIndexes_.clear();
+  }
+
+
+  void DicomWebJsonVisitor::CloseStream()
+  {
+    if (stream_.get() == NULL)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    while (!streamTags_.empty())
+    {
+      CloseStreamedSequence();
+    }
+
+    stream_->EndObject();
+    assert(stream_->IsComplete());
+
+    stream_.reset(NULL);
+  }
+
+
   void DicomWebJsonVisitor::VisitEmptySequence(const std::vector<DicomTag>& parentTags,
                                                const std::vector<size_t>& parentIndexes,
                                                const DicomTag& tag)
   {
     if (tag.GetElement() != 0x0000)
     {
-      Json::Value& node = CreateNode(parentTags, parentIndexes, tag);
+      Json::Value node = Json::objectValue;
       node[KEY_VR] = EnumerationToString(ValueRepresentation_Sequence);
+      AddNode(parentTags, parentIndexes, tag, node);
     }
   }
   
@@ -400,7 +526,7 @@ namespace Orthanc
 
       if (mode != BinaryMode_Ignore)
       {
-        Json::Value& node = CreateNode(parentTags, parentIndexes, tag);
+        Json::Value node = Json::objectValue;
         node[KEY_VR] = EnumerationToString(vr);
 
         switch (mode)
@@ -423,6 +549,8 @@ namespace Orthanc
           default:
             throw OrthancException(ErrorCode_ParameterOutOfRange);
         }
+
+        AddNode(parentTags, parentIndexes, tag, node);
       }
     }
   }
@@ -437,7 +565,7 @@ namespace Orthanc
     if (tag.GetElement() != 0x0000 &&
         vr != ValueRepresentation_NotSupported)
     {
-      Json::Value& node = CreateNode(parentTags, parentIndexes, tag);
+      Json::Value node = Json::objectValue;
       node[KEY_VR] = EnumerationToString(vr);
 
       if (!values.empty())
@@ -450,6 +578,8 @@ namespace Orthanc
 
         node[KEY_VALUE] = content;
       }
+
+      AddNode(parentTags, parentIndexes, tag, node);
     }
   }
 
@@ -462,7 +592,7 @@ namespace Orthanc
     if (tag.GetElement() != 0x0000 &&
         vr != ValueRepresentation_NotSupported)
     {
-      Json::Value& node = CreateNode(parentTags, parentIndexes, tag);
+      Json::Value node = Json::objectValue;
       node[KEY_VR] = EnumerationToString(vr);
 
       if (!values.empty())
@@ -475,6 +605,8 @@ namespace Orthanc
           
         node[KEY_VALUE] = content;
       }
+
+      AddNode(parentTags, parentIndexes, tag, node);
     }
   }
 
@@ -486,7 +618,7 @@ namespace Orthanc
   {
     if (tag.GetElement() != 0x0000)
     {
-      Json::Value& node = CreateNode(parentTags, parentIndexes, tag);
+      Json::Value node = Json::objectValue;
       node[KEY_VR] = EnumerationToString(ValueRepresentation_AttributeTag);
 
       if (!values.empty())
@@ -499,6 +631,8 @@ namespace Orthanc
           
         node[KEY_VALUE] = content;
       }
+
+      AddNode(parentTags, parentIndexes, tag, node);
     }
   }
 
@@ -518,7 +652,7 @@ namespace Orthanc
     }
     else
     {
-      Json::Value& node = CreateNode(parentTags, parentIndexes, tag);
+      Json::Value node = Json::objectValue;
       node[KEY_VR] = EnumerationToString(vr);
 
       if (tag == DICOM_TAG_SPECIFIC_CHARACTER_SET)
@@ -628,6 +762,8 @@ namespace Orthanc
           }
         }
       }
+
+      AddNode(parentTags, parentIndexes, tag, node);
     }
       
     return Action_None;
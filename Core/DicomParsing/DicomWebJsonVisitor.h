@@ -38,8 +38,10 @@
 #endif
 
 #include "ITagVisitor.h"
+#include "../JsonStreamWriter.h"
 
 #include <json/value.h>
+#include <memory>
 
 
 namespace Orthanc
@@ -72,12 +74,28 @@ namespace Orthanc
     Json::Value        result_;
     IBinaryFormatter  *formatter_;
 
+    // Streaming mode: The path to the sequence items that are open
+    std::auto_ptr<JsonStreamWriter>  stream_;
+    std::vector<DicomTag>            streamTags_;
+    std::vector<size_t>              streamIndexes_;
+
     static std::string FormatTag(const DicomTag& tag);
     
     Json::Value& CreateNode(const std::vector<DicomTag>& parentTags,
                             const std::vector<size_t>& parentIndexes,
                             const DicomTag& tag);
 
+    void CloseStreamedSequence();
+
+    void MoveStream(const std::vector<DicomTag>& parentTags,
+                    const std::vector<size_t>& parentIndexes);
+
+    // Warning: The content of "node" is swapped
+    void AddNode(const std::vector<DicomTag>& parentTags,
+                 const std::vector<size_t>& parentIndexes,
+                 const DicomTag& tag,
+                 Json::Value& node);
+
     static Json::Value FormatInteger(int64_t value);
 
     static Json::Value FormatDouble(double value);
@@ -108,6 +126,14 @@ namespace Orthanc
     void FormatXml(std::string& target) const;
 #endif
 
+    // Streaming mode: The DICOMweb JSON of the visited dataset is
+    // directly written as compact text into "target", without
+    // building "GetResult()" (which is thus not available). The
+    // "target" string must stay alive until "CloseStream()".
+    void OpenStream(std::string& target);
+
+    void CloseStream();
+
     virtual void VisitNotSupported(const std::vector<DicomTag>& parentTags,
                                    const std::vector<size_t>& parentIndexes,
                                    const DicomTag& tag,
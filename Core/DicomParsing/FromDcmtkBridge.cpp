@@ -47,6 +47,7 @@
 
 #include "FromDcmtkBridge.h"
 #include "ToDcmtkBridge.h"
+#include "../DicomFormat/DicomFrameOffsets.h"
 #include "../Logging.h"
 #include "../Toolbox.h"
 #include "../OrthancException.h"
@@ -982,6 +983,231 @@ DCMTK_TO_CTYPE_CONVERTER(DcmtkToFloat64Converter, Float64, DcmFloatingPointDoubl
   }
 
 
+  static void LeafValueToJson(JsonStreamWriter& writer,
+                              const DicomValue& value,
+                              DicomToJsonFormat format,
+                              DicomToJsonFlags flags,
+                              unsigned int maxStringLength)
+  {
+    // Mimics "LeafValueToJson()" on a "Json::Value"
+    const char* type;
+    std::string content;
+    bool isNull = false;
+
+    if (value.IsNull())
+    {
+      type = "Null";
+      isNull = true;
+    }
+    else if (value.IsBinary())
+    {
+      if (flags & DicomToJsonFlags_ConvertBinaryToAscii)
+      {
+        content = Toolbox::ConvertToAscii(value.GetContent());
+      }
+      else
+      {
+        value.FormatDataUriScheme(content);
+      }
+
+      type = "Binary";
+    }
+    else if (maxStringLength == 0 ||
+             value.GetContent().size() <= maxStringLength)
+    {
+      type = "String";
+    }
+    else
+    {
+      type = "TooLong";
+      isNull = true;
+    }
+
+    if (format == DicomToJsonFormat_Full)
+    {
+      writer.WriteKey("Type");
+      writer.WriteString(type);
+      writer.WriteKey("Value");
+    }
+
+    if (isNull)
+    {
+      writer.WriteNull();
+    }
+    else if (value.IsBinary())
+    {
+      writer.WriteString(content);
+    }
+    else
+    {
+      writer.WriteString(value.GetContent());
+    }
+  }
+
+
+  void FromDcmtkBridge::ElementToJson(JsonStreamWriter& writer,
+                                      DcmElement& element,
+                                      DicomToJsonFormat format,
+                                      DicomToJsonFlags flags,
+                                      unsigned int maxStringLength,
+                                      Encoding encoding,
+                                      bool hasCodeExtensions,
+                                      const std::set<DicomTag>& ignoreTagLength)
+  {
+    const DicomTag tag(GetTag(element));
+
+    switch (format)
+    {
+      case DicomToJsonFormat_Short:
+        writer.WriteKey(tag.Format());
+        break;
+
+      case DicomToJsonFormat_Human:
+        writer.WriteKey(GetTagName(element));
+        break;
+
+      case DicomToJsonFormat_Full:
+        writer.WriteKey(tag.Format());
+        writer.StartObject();
+        writer.WriteKey("Name");
+        writer.WriteString(GetTagName(element));
+
+        if (element.isLeaf() &&
+            element.getTag().getPrivateCreator() != NULL)
+        {
+          writer.WriteKey("PrivateCreator");
+          writer.WriteString(element.getTag().getPrivateCreator());
+        }
+        break;
+
+      default:
+        throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    if (element.isLeaf())
+    {
+      // The "0" below lets "LeafValueToJson()" take care of "TooLong" values
+      std::auto_ptr<DicomValue> v(FromDcmtkBridge::ConvertLeafElement
+                                  (element, flags, 0, encoding, hasCodeExtensions, ignoreTagLength));
+
+      if (ignoreTagLength.find(tag) == ignoreTagLength.end())
+      {
+        LeafValueToJson(writer, *v, format, flags, maxStringLength);
+      }
+      else
+      {
+        LeafValueToJson(writer, *v, format, flags, 0);
+      }
+    }
+    else
+    {
+      if (format == DicomToJsonFormat_Full)
+      {
+        writer.WriteKey("Type");
+        writer.WriteString("Sequence");
+        writer.WriteKey("Value");
+      }
+
+      // The dynamic_cast is OK, as in the "Json::Value" version
+      DcmSequenceOfItems& sequence = dynamic_cast<DcmSequenceOfItems&>(element);
+
+      writer.StartArray();
+
+      for (unsigned long i = 0; i < sequence.card(); i++)
+      {
+        writer.StartObject();
+        DatasetToJson(writer, *sequence.getItem(i), format, flags, maxStringLength,
+                      encoding, hasCodeExtensions, ignoreTagLength);
+        writer.EndObject();
+      }
+
+      writer.EndArray();
+    }
+
+    if (format == DicomToJsonFormat_Full)
+    {
+      writer.EndObject();
+    }
+  }
+
+
+  void FromDcmtkBridge::DatasetToJson(JsonStreamWriter& writer,
+                                      DcmItem& item,
+                                      DicomToJsonFormat format,
+                                      DicomToJsonFlags flags,
+                                      unsigned int maxStringLength,
+                                      Encoding encoding,
+                                      bool hasCodeExtensions,
+                                      const std::set<DicomTag>& ignoreTagLength)
+  {
+    for (unsigned long i = 0; i < item.card(); i++)
+    {
+      DcmElement* element = item.getElement(i);
+      if (element == NULL)
+      {
+        throw OrthancException(ErrorCode_InternalError);
+      }
+
+      // Same filtering as in the "Json::Value" version
+      DicomTag tag(FromDcmtkBridge::Convert(element->getTag()));
+
+      if (tag.IsPrivate() &&
+          !(flags & DicomToJsonFlags_IncludePrivateTags))    
+      {
+        continue;
+      }
+
+      if (!(flags & DicomToJsonFlags_IncludeUnknownTags))
+      {
+        DictionaryLocker locker;
+        if (locker->findEntry(element->getTag(), NULL) == NULL)
+        {
+          continue;
+        }
+      }
+
+      DcmEVR evr = element->getTag().getEVR();
+      if (evr == EVR_OB ||
+          evr == EVR_OF ||
+          evr == EVR_OW ||
+          evr == EVR_UN ||
+          evr == EVR_ox)
+      {
+        if ((tag == DICOM_TAG_PIXEL_DATA && !(flags & DicomToJsonFlags_IncludePixelData)) ||
+            (tag != DICOM_TAG_PIXEL_DATA && !(flags & DicomToJsonFlags_IncludeBinary)))
+        {
+          continue;
+        }
+      }
+
+      ElementToJson(writer, *element, format, flags,
+                    maxStringLength, encoding, hasCodeExtensions, ignoreTagLength);
+    }
+  }
+
+
+  void FromDcmtkBridge::ExtractDicomAsJson(std::string& target, 
+                                           DcmDataset& dataset,
+                                           DicomToJsonFormat format,
+                                           DicomToJsonFlags flags,
+                                           unsigned int maxStringLength,
+                                           Encoding defaultEncoding,
+                                           const std::set<DicomTag>& ignoreTagLength)
+  {
+    bool hasCodeExtensions;
+    Encoding encoding = DetectEncoding(hasCodeExtensions, dataset, defaultEncoding);
+
+    target.clear();
+
+    JsonStreamWriter writer(target);
+    writer.StartObject();
+    DatasetToJson(writer, dataset, format, flags, maxStringLength, encoding, hasCodeExtensions, ignoreTagLength);
+    writer.EndObject();
+
+    assert(writer.IsComplete());
+  }
+
+
   void FromDcmtkBridge::ExtractHeaderAsJson(Json::Value& target, 
                                             DcmMetaInfo& dataset,
                                             DicomToJsonFormat format,
@@ -1118,22 +1344,23 @@ DCMTK_TO_CTYPE_CONVERTER(DcmtkToFloat64Converter, Float64, DcmFloatingPointDoubl
 
     result.clear();
 
-    for (DicomMap::Map::const_iterator 
-           it = values.map_.begin(); it != values.map_.end(); ++it)
+    for (size_t i = 0; i < values.GetSize(); i++)
     {
+      const DicomMap::Record& record = values.GetSortedRecord(i);
+
       // TODO Inject PrivateCreator if some is available in the DicomMap?
-      const std::string tagName = GetTagName(it->first, "");
+      const std::string tagName = GetTagName(record.first, "");
 
       if (simplify)
       {
-        if (it->second->IsNull())
+        if (record.second.IsNull())
         {
           result[tagName] = Json::nullValue;
         }
         else
         {
           // TODO IsBinary
-          result[tagName] = it->second->GetContent();
+          result[tagName] = record.second.GetContent();
         }
       }
       else
@@ -1142,7 +1369,7 @@ DCMTK_TO_CTYPE_CONVERTER(DcmtkToFloat64Converter, Float64, DcmFloatingPointDoubl
 
         value["Name"] = tagName;
 
-        if (it->second->IsNull())
+        if (record.second.IsNull())
         {
           value["Type"] = "Null";
           value["Value"] = Json::nullValue;
@@ -1151,10 +1378,10 @@ DCMTK_TO_CTYPE_CONVERTER(DcmtkToFloat64Converter, Float64, DcmFloatingPointDoubl
         {
           // TODO IsBinary
           value["Type"] = "String";
-          value["Value"] = it->second->GetContent();
+          value["Value"] = record.second.GetContent();
         }
 
-        result[it->first.Format()] = value;
+        result[record.first.Format()] = value;
       }
     }
   }
@@ -2015,6 +2242,29 @@ DCMTK_TO_CTYPE_CONVERTER(DcmtkToFloat64Converter, Float64, DcmFloatingPointDoubl
   }
 
 
+  DcmFileFormat* FromDcmtkBridge::LoadFromMemoryBufferWithoutPixelData(const void* buffer,
+                                                                       size_t size)
+  {
+    uint64_t offset;
+    if (!DicomFrameOffsets::LookupPixelDataOffset(offset, buffer, size))
+    {
+      return LoadFromMemoryBuffer(buffer, size);
+    }
+
+    // The stream is truncated at the boundary of a top-level element
+    std::auto_ptr<DcmFileFormat> result(LoadFromMemoryBuffer(buffer, static_cast<size_t>(offset)));
+
+    // Insert a placeholder, so that the JSON and the summary are the
+    // same as with the whole file, where binary data is reported as null
+    if (!result->getDataset()->insertEmptyElement(DCM_PixelData).good())
+    {
+      throw OrthancException(ErrorCode_InternalError);
+    }
+
+    return result.release();
+  }
+
+
   void FromDcmtkBridge::FromJson(DicomMap& target,
                                  const Json::Value& source)
   {
@@ -2169,6 +2419,19 @@ DCMTK_TO_CTYPE_CONVERTER(DcmtkToFloat64Converter, Float64, DcmFloatingPointDoubl
   }
 
 
+  void FromDcmtkBridge::ExtractDicomAsJson(std::string& target, 
+                                           DcmDataset& dataset,
+                                           const std::set<DicomTag>& ignoreTagLength)
+  {
+    ExtractDicomAsJson(target, dataset, 
+                       DicomToJsonFormat_Full,
+                       DicomToJsonFlags_Default, 
+                       ORTHANC_MAXIMUM_TAG_LENGTH,
+                       GetDefaultDicomEncoding(),
+                       ignoreTagLength);
+  }
+
+
   void FromDcmtkBridge::InitializeCodecs()
   {
 #if ORTHANC_ENABLE_DCMTK_JPEG_LOSSLESS == 1
@@ -36,6 +36,7 @@
 #include "ITagVisitor.h"
 #include "../DicomFormat/DicomElement.h"
 #include "../DicomFormat/DicomMap.h"
+#include "../JsonStreamWriter.h"
 
 #include <dcmtk/dcmdata/dcdatset.h>
 #include <dcmtk/dcmdata/dcmetinf.h>
@@ -112,6 +113,32 @@ namespace Orthanc
                                    Encoding defaultEncoding,
                                    const std::set<DicomTag>& ignoreTagLength);
 
+    static void DatasetToJson(JsonStreamWriter& writer,
+                              DcmItem& item,
+                              DicomToJsonFormat format,
+                              DicomToJsonFlags flags,
+                              unsigned int maxStringLength,
+                              Encoding encoding,
+                              bool hasCodeExtensions,
+                              const std::set<DicomTag>& ignoreTagLength);
+
+    static void ElementToJson(JsonStreamWriter& writer,
+                              DcmElement& element,
+                              DicomToJsonFormat format,
+                              DicomToJsonFlags flags,
+                              unsigned int maxStringLength,
+                              Encoding dicomEncoding,
+                              bool hasCodeExtensions,
+                              const std::set<DicomTag>& ignoreTagLength);
+
+    static void ExtractDicomAsJson(std::string& target, 
+                                   DcmDataset& dataset,
+                                   DicomToJsonFormat format,
+                                   DicomToJsonFlags flags,
+                                   unsigned int maxStringLength,
+                                   Encoding defaultEncoding,
+                                   const std::set<DicomTag>& ignoreTagLength);
+
     static void ChangeStringEncoding(DcmItem& dataset,
                                      Encoding source,
                                      bool hasSourceCodeExtensions,
@@ -233,6 +260,16 @@ namespace Orthanc
     static DcmFileFormat* LoadFromMemoryBuffer(const void* buffer,
                                                size_t size);
 
+    // Only parses the elements that precede the top-level "Pixel
+    // Data" element, which is replaced by an empty element. This is
+    // much faster and uses much less memory on large images, if only
+    // the tags are needed. Falls back to "LoadFromMemoryBuffer()" if
+    // the pixel data cannot be located (e.g. deflated or big endian
+    // transfer syntaxes). Note that the elements that follow the
+    // pixel data (such as trailing padding) are ignored.
+    static DcmFileFormat* LoadFromMemoryBufferWithoutPixelData(const void* buffer,
+                                                               size_t size);
+
     static void FromJson(DicomMap& values,
                          const Json::Value& result);
 
@@ -251,6 +288,12 @@ namespace Orthanc
                                    DcmDataset& dataset,
                                    const std::set<DicomTag>& ignoreTagLength);
 
+    // Same as above, but the "DICOM-as-JSON" is directly written as
+    // compact text, without building a "Json::Value"
+    static void ExtractDicomAsJson(std::string& target, 
+                                   DcmDataset& dataset,
+                                   const std::set<DicomTag>& ignoreTagLength);
+
     static void InitializeCodecs();
 
     static void FinalizeCodecs();
@@ -88,11 +88,11 @@ namespace Orthanc
 
     static bool PreviewDecodedImage(std::auto_ptr<ImageAccessor>& image);
 
+  public:
     static void ApplyExtractionMode(std::auto_ptr<ImageAccessor>& image,
                                     ImageExtractionMode mode,
                                     bool invert);
 
-  public:
     static bool IsPsmctRle1(DcmDataset& dataset);
 
     static bool DecodePsmctRle1(std::string& output,
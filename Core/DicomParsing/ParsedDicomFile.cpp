@@ -85,6 +85,7 @@
 #include "Internals/DicomFrameIndex.h"
 #include "ToDcmtkBridge.h"
 
+#include "../DicomFormat/DicomFrameOffsets.h"
 #include "../Images/PamReader.h"
 #include "../Logging.h"
 #include "../OrthancException.h"
@@ -993,15 +994,16 @@ namespace Orthanc
       }
     }
 
-    for (DicomMap::Map::const_iterator 
-           it = source.map_.begin(); it != source.map_.end(); ++it)
+    for (size_t i = 0; i < source.GetSize(); i++)
     {
-      if (it->first != DICOM_TAG_SPECIFIC_CHARACTER_SET &&
-          !it->second->IsNull())
+      const DicomMap::Record& record = source.GetSortedRecord(i);
+
+      if (record.first != DICOM_TAG_SPECIFIC_CHARACTER_SET &&
+          !record.second.IsNull())
       {
         try
         {
-          ReplacePlainString(it->first, it->second->GetContent());
+          ReplacePlainString(record.first, record.second.GetContent());
         }
         catch (OrthancException&)
         {
@@ -1377,6 +1379,32 @@ namespace Orthanc
   }
 
 
+  void ParsedDicomFile::DatasetToJson(std::string& target, 
+                                      DicomToJsonFormat format,
+                                      DicomToJsonFlags flags,
+                                      unsigned int maxStringLength)
+  {
+    std::set<DicomTag> ignoreTagLength;
+    FromDcmtkBridge::ExtractDicomAsJson(target, *pimpl_->file_->getDataset(),
+                                        format, flags, maxStringLength,
+                                        GetDefaultDicomEncoding(), ignoreTagLength);
+  }
+
+
+  void ParsedDicomFile::DatasetToJson(std::string& target,
+                                      const std::set<DicomTag>& ignoreTagLength)
+  {
+    FromDcmtkBridge::ExtractDicomAsJson(target, *pimpl_->file_->getDataset(), ignoreTagLength);
+  }
+
+
+  void ParsedDicomFile::DatasetToJson(std::string& target)
+  {
+    const std::set<DicomTag> ignoreTagLength;
+    FromDcmtkBridge::ExtractDicomAsJson(target, *pimpl_->file_->getDataset(), ignoreTagLength);
+  }
+
+
   void ParsedDicomFile::HeaderToJson(Json::Value& target, 
                                      DicomToJsonFormat format)
   {
@@ -1475,6 +1503,72 @@ namespace Orthanc
   }
 
 
+  ParsedDicomFile* ParsedDicomFile::CreateWithoutPixelData(const void* content,
+                                                           size_t size)
+  {
+    std::auto_ptr<DcmFileFormat> file
+      (FromDcmtkBridge::LoadFromMemoryBufferWithoutPixelData(content, size));
+    return new ParsedDicomFile(*file);
+  }
+
+
+  ParsedDicomFile* ParsedDicomFile::CreateHeader(uint64_t& pixelDataOffset,
+                                                 const void* content,
+                                                 size_t size)
+  {
+    if (!DicomFrameOffsets::LookupPixelDataOffset(pixelDataOffset, content, size))
+    {
+      return NULL;
+    }
+
+    // The stream is truncated at the boundary of a top-level element
+    std::auto_ptr<DcmFileFormat> file
+      (FromDcmtkBridge::LoadFromMemoryBuffer(content, static_cast<size_t>(pixelDataOffset)));
+
+    if (file->getDataset()->getOriginalXfer() == EXS_Unknown)
+    {
+      // The header would not be written back using the transfer
+      // syntax of the raw pixel data
+      return NULL;
+    }
+
+    return new ParsedDicomFile(*file);
+  }
+
+
+  void ParsedDicomFile::SaveHeaderWithRawPixelData(std::string& target,
+                                                   const void* content,
+                                                   size_t size,
+                                                   uint64_t pixelDataOffset)
+  {
+    if (pixelDataOffset > static_cast<uint64_t>(size))
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    if (pimpl_->file_->getDataset()->tagExists(DCM_PixelData))
+    {
+      // This object was not created by "CreateHeader()"
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    // The original transfer syntax is kept by "SaveToMemoryBuffer()",
+    // and the top-level dataset has no length field, so the raw
+    // elements can simply be appended to the new header
+    SaveToMemoryBuffer(target);
+
+    const size_t headerSize = target.size();
+    const size_t pixelDataSize = size - static_cast<size_t>(pixelDataOffset);
+
+    if (pixelDataSize > 0)
+    {
+      target.resize(headerSize + pixelDataSize);
+      memcpy(&target[headerSize],
+             reinterpret_cast<const uint8_t*>(content) + pixelDataOffset, pixelDataSize);
+    }
+  }
+
+
   ParsedDicomFile* ParsedDicomFile::CreateFromJson(const Json::Value& json,
                                                    DicomFromJsonFlags flags)
   {
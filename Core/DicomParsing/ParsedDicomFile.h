@@ -212,6 +212,20 @@ namespace Orthanc
 
     void DatasetToJson(Json::Value& target);
 
+    // Direct serialization to compact JSON text, without building a
+    // "Json::Value", which is faster on large datasets
+    void DatasetToJson(std::string& target, 
+                       DicomToJsonFormat format,
+                       DicomToJsonFlags flags,
+                       unsigned int maxStringLength);
+
+    // This version uses the default parameters for
+    // FileContentType_DicomAsJson
+    void DatasetToJson(std::string& target,
+                       const std::set<DicomTag>& ignoreTagLength);
+
+    void DatasetToJson(std::string& target);
+
     void HeaderToJson(Json::Value& target, 
                       DicomToJsonFormat format);
 
@@ -230,6 +244,31 @@ namespace Orthanc
     static ParsedDicomFile* CreateFromJson(const Json::Value& value,
                                            DicomFromJsonFlags flags);
 
+    // The resulting object only contains the tags that precede the
+    // pixel data: It must only be used to read the tags
+    static ParsedDicomFile* CreateWithoutPixelData(const void* content,
+                                                   size_t size);
+
+    // Only parses the elements that precede the top-level "Pixel
+    // Data" element, whose offset is stored in "pixelDataOffset". The
+    // tags of the resulting object can be modified, then written back
+    // with "SaveHeaderWithRawPixelData()". Returns NULL if the pixel
+    // data cannot be located (e.g. deflated or big endian transfer
+    // syntaxes, or no pixel data at all): The whole file must be
+    // parsed in such a case.
+    static ParsedDicomFile* CreateHeader(uint64_t& pixelDataOffset,
+                                         const void* content,
+                                         size_t size);
+
+    // Writes the tags of an object created by "CreateHeader()",
+    // followed by the bytes of the original file starting at
+    // "pixelDataOffset", that are copied verbatim: The pixel data is
+    // neither parsed, nor decoded, nor re-encoded
+    void SaveHeaderWithRawPixelData(std::string& target,
+                                    const void* content,
+                                    size_t size,
+                                    uint64_t pixelDataOffset);
+
     void ChangeEncoding(Encoding target);
 
     void ExtractDicomSummary(DicomMap& target) const;
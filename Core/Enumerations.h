@@ -682,6 +682,11 @@ namespace Orthanc
     FileContentType_Dicom = 1,
     FileContentType_DicomAsJson = 2,
 
+    // Internal content types, that are not part of the plugin SDK,
+    // and that are given as "OrthancPluginContentType_Unknown" to
+    // the storage area plugins (new in Orthanc 1.5.7)
+    FileContentType_Thumbnail = 1023,
+
     // Make sure that the value "65535" can be stored into this enumeration
     FileContentType_StartUser = 1024,
     FileContentType_EndUser = 65535
@@ -104,6 +104,9 @@ namespace Orthanc
       case FileContentType_DicomAsJson:
         return "JSON summary of DICOM";
 
+      case FileContentType_Thumbnail:
+        return "Thumbnail";
+
       default:
         return "User-defined";
     }
@@ -160,6 +163,19 @@ namespace Orthanc
   }
 
 
+  void FilesystemStorage::ReadRange(std::string& content,
+                                    const std::string& uuid,
+                                    FileContentType type,
+                                    uint64_t start,
+                                    uint64_t end)
+  {
+    LOG(INFO) << "Reading range [" << start << "," << end << "[ of attachment \"" << uuid
+              << "\" of \"" << GetDescriptionInternal(type) << "\" content type";
+
+    SystemToolbox::ReadFileRange(content, GetPath(uuid).string(), start, end);
+  }
+
+
   uintmax_t FilesystemStorage::GetSize(const std::string& uuid) const
   {
     boost::filesystem::path path = GetPath(uuid);
@@ -75,6 +75,17 @@ namespace Orthanc
     virtual void Remove(const std::string& uuid,
                         FileContentType type);
 
+    virtual bool HasReadRange() const
+    {
+      return true;
+    }
+
+    virtual void ReadRange(std::string& content,
+                           const std::string& uuid,
+                           FileContentType type,
+                           uint64_t start,
+                           uint64_t end);
+
     void ListAllFiles(std::set<std::string>& result) const;
 
     uintmax_t GetSize(const std::string& uuid) const;
@@ -34,9 +34,11 @@
 #pragma once
 
 #include "../Enumerations.h"
+#include "../OrthancException.h"
 
 #include <string>
 #include <boost/noncopyable.hpp>
+#include <stdint.h>
 
 namespace Orthanc
 {
@@ -58,5 +60,36 @@ namespace Orthanc
 
     virtual void Remove(const std::string& uuid,
                         FileContentType type) = 0;
+
+    // Whether "ReadRange()" is able to read a part of a file without
+    // reading the whole file
+    virtual bool HasReadRange() const
+    {
+      return false;
+    }
+
+    // Reads the bytes in the range [start, end[ of a file. By
+    // default, the whole file is read, then the range is extracted.
+    virtual void ReadRange(std::string& content,
+                           const std::string& uuid,
+                           FileContentType type,
+                           uint64_t start,
+                           uint64_t end)
+    {
+      if (start > end)
+      {
+        throw OrthancException(ErrorCode_ParameterOutOfRange);
+      }
+
+      std::string full;
+      Read(full, uuid, type);
+
+      if (end > full.size())
+      {
+        throw OrthancException(ErrorCode_ParameterOutOfRange);
+      }
+
+      content.assign(full, static_cast<size_t>(start), static_cast<size_t>(end - start));
+    }
   };
 }
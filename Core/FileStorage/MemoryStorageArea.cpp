@@ -102,6 +102,40 @@ namespace Orthanc
   }
       
 
+  void MemoryStorageArea::ReadRange(std::string& content,
+                                    const std::string& uuid,
+                                    FileContentType type,
+                                    uint64_t start,
+                                    uint64_t end)
+  {
+    if (start > end)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    boost::mutex::scoped_lock lock(mutex_);
+
+    Content::const_iterator found = content_.find(uuid);
+
+    if (found == content_.end())
+    {
+      throw OrthancException(ErrorCode_InexistentFile);
+    }
+    else if (found->second == NULL)
+    {
+      throw OrthancException(ErrorCode_InternalError);
+    }
+    else if (end > found->second->size())
+    {
+      throw OrthancException(ErrorCode_CorruptedFile);
+    }
+    else
+    {
+      content.assign(*found->second, static_cast<size_t>(start), static_cast<size_t>(end - start));
+    }
+  }
+
+
   void MemoryStorageArea::Remove(const std::string& uuid,
                                  FileContentType type)
   {
@@ -62,5 +62,16 @@ namespace Orthanc
 
     virtual void Remove(const std::string& uuid,
                         FileContentType type);
+
+    virtual bool HasReadRange() const
+    {
+      return true;
+    }
+
+    virtual void ReadRange(std::string& content,
+                           const std::string& uuid,
+                           FileContentType type,
+                           uint64_t start,
+                           uint64_t end);
   };
 }
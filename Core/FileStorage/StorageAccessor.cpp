@@ -175,6 +175,38 @@ namespace Orthanc
   }
 
 
+  void StorageAccessor::ReadRange(std::string& content,
+                                  const FileInfo& info,
+                                  uint64_t start,
+                                  uint64_t end)
+  {
+    if (start > end ||
+        end > info.GetUncompressedSize())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    if (info.GetCompressionType() == CompressionType_None &&
+        area_.HasReadRange())
+    {
+      MetricsTimer timer(*this, METRICS_READ);
+      area_.ReadRange(content, info.GetUuid(), info.GetContentType(), start, end);
+    }
+    else
+    {
+      std::string full;
+      Read(full, info);
+
+      if (end > full.size())
+      {
+        throw OrthancException(ErrorCode_CorruptedFile);
+      }
+
+      content.assign(full, static_cast<size_t>(start), static_cast<size_t>(end - start));
+    }
+  }
+
+
   void StorageAccessor::Remove(const std::string& fileUuid,
                                FileContentType type)
   {
@@ -206,6 +238,10 @@ namespace Orthanc
         extension = ".json";
         break;
 
+      case FileContentType_Thumbnail:
+        extension = ".jpg";
+        break;
+
       default:
         // Non-standard content type
         extension = "";
@@ -120,6 +120,14 @@ namespace Orthanc
     void ReadRaw(std::string& content,
                  const FileInfo& info);
 
+    // Reads the bytes in the range [start, end[ of the uncompressed
+    // file. Only this range is loaded if the storage area supports
+    // it and if the file is not compressed.
+    void ReadRange(std::string& content,
+                   const FileInfo& info,
+                   uint64_t start,
+                   uint64_t end);
+
     void Remove(const std::string& fileUuid,
                 FileContentType type);
 
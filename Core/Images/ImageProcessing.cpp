@@ -34,12 +34,17 @@
 #include "../PrecompiledHeaders.h"
 #include "ImageProcessing.h"
 
+#include "ParallelImageProcessing.h"
 #include "PixelTraits.h"
+#include "ScalarKernels.h"
+#include "SimdKernels.h"
 #include "../OrthancException.h"
 
 #include <boost/math/special_functions/round.hpp>
+#include <boost/thread/mutex.hpp>
 
 #include <cassert>
+#include <cmath>
 #include <string.h>
 #include <limits>
 #include <stdint.h>
@@ -58,32 +63,13 @@ namespace Orthanc
   static void ConvertInternal(ImageAccessor& target,
                               const ImageAccessor& source)
   {
-    const TargetType minValue = std::numeric_limits<TargetType>::min();
-    const TargetType maxValue = std::numeric_limits<TargetType>::max();
-
     const unsigned int width = source.GetWidth();
     const unsigned int height = source.GetHeight();
     
     for (unsigned int y = 0; y < height; y++)
     {
-      TargetType* t = reinterpret_cast<TargetType*>(target.GetRow(y));
-      const SourceType* s = reinterpret_cast<const SourceType*>(source.GetConstRow(y));
-
-      for (unsigned int x = 0; x < width; x++, t++, s++)
-      {
-        if (static_cast<int32_t>(*s) < static_cast<int32_t>(minValue))
-        {
-          *t = minValue;
-        }
-        else if (static_cast<int32_t>(*s) > static_cast<int32_t>(maxValue))
-        {
-          *t = maxValue;
-        }
-        else
-        {
-          *t = static_cast<TargetType>(*s);
-        }
-      }
+      ScalarKernels::Convert(reinterpret_cast<TargetType*>(target.GetRow(y)),
+                             reinterpret_cast<const SourceType*>(source.GetConstRow(y)), width);
     }
   }
 
@@ -244,20 +230,8 @@ namespace Orthanc
 
     for (unsigned int y = 0; y < height; y++)
     {
-      const PixelType* p = reinterpret_cast<const PixelType*>(source.GetConstRow(y));
-
-      for (unsigned int x = 0; x < width; x++, p++)
-      {
-        if (*p < minValue)
-        {
-          minValue = *p;
-        }
-
-        if (*p > maxValue)
-        {
-          maxValue = *p;
-        }
-      }
+      ScalarKernels::GetMinMax(minValue, maxValue,
+                               reinterpret_cast<const PixelType*>(source.GetConstRow(y)), width);
     }
   }
 
@@ -272,33 +246,12 @@ namespace Orthanc
       return;
     }
 
-    const int64_t minValue = std::numeric_limits<PixelType>::min();
-    const int64_t maxValue = std::numeric_limits<PixelType>::max();
-
     const unsigned int width = image.GetWidth();
     const unsigned int height = image.GetHeight();
     
     for (unsigned int y = 0; y < height; y++)
     {
-      PixelType* p = reinterpret_cast<PixelType*>(image.GetRow(y));
-
-      for (unsigned int x = 0; x < width; x++, p++)
-      {
-        int64_t v = static_cast<int64_t>(*p) + constant;
-
-        if (v > maxValue)
-        {
-          *p = std::numeric_limits<PixelType>::max();
-        }
-        else if (v < minValue)
-        {
-          *p = std::numeric_limits<PixelType>::min();
-        }
-        else
-        {
-          *p = static_cast<PixelType>(v);
-        }
-      }
+      ScalarKernels::AddConstant(reinterpret_cast<PixelType*>(image.GetRow(y)), width, constant);
     }
   }
 
@@ -360,40 +313,136 @@ namespace Orthanc
                                  float offset,
                                  float scaling)
   {
-    const float minFloatValue = static_cast<float>(std::numeric_limits<PixelType>::min());
-    const float maxFloatValue = static_cast<float>(std::numeric_limits<PixelType>::max());
-    const PixelType minPixelValue = std::numeric_limits<PixelType>::min();
-    const PixelType maxPixelValue = std::numeric_limits<PixelType>::max();
-
     const unsigned int height = image.GetHeight();
     const unsigned int width = image.GetWidth();
     
     for (unsigned int y = 0; y < height; y++)
     {
-      PixelType* p = reinterpret_cast<PixelType*>(image.GetRow(y));
+      ScalarKernels::ShiftScale<PixelType, UseRound>(
+        reinterpret_cast<PixelType*>(image.GetRow(y)), width, offset, scaling);
+    }
+  }
 
-      for (unsigned int x = 0; x < width; x++, p++)
-      {
-        float v = (static_cast<float>(*p) + offset) * scaling;
 
-        if (v > maxFloatValue)
-        {
-          *p = maxPixelValue;
-        }
-        else if (v < minFloatValue)
-        {
-          *p = minPixelValue;
-        }
-        else if (UseRound)
-        {
-          // The "round" operation is very costly
-          *p = static_cast<PixelType>(boost::math::iround(v));
-        }
-        else
-        {
-          *p = static_cast<PixelType>(v);
-        }
-      }
+  /**
+   * Row-wise implementations that rely on the vectorized kernels, if
+   * the CPU supports them. They give the same results as the scalar
+   * implementations above.
+   **/
+
+  template <typename TargetType, typename SourceType>
+  static void ConvertSimd(ImageAccessor& target,
+                          const ImageAccessor& source)
+  {
+    const unsigned int width = source.GetWidth();
+    const unsigned int height = source.GetHeight();
+
+    for (unsigned int y = 0; y < height; y++)
+    {
+      SimdKernels::Convert(reinterpret_cast<TargetType*>(target.GetRow(y)),
+                           reinterpret_cast<const SourceType*>(source.GetConstRow(y)), width);
+    }
+  }
+
+
+  template <typename PixelType>
+  static void GetMinMaxValueSimd(PixelType& minValue,
+                                 PixelType& maxValue,
+                                 const ImageAccessor& source)
+  {
+    if (source.GetWidth() == 0 ||
+        source.GetHeight() == 0)
+    {
+      minValue = 0;
+      maxValue = 0;
+      return;
+    }
+
+    minValue = std::numeric_limits<PixelType>::max();
+    maxValue = std::numeric_limits<PixelType>::min();
+
+    const unsigned int height = source.GetHeight();
+    const unsigned int width = source.GetWidth();
+
+    for (unsigned int y = 0; y < height; y++)
+    {
+      SimdKernels::GetMinMax(minValue, maxValue,
+                             reinterpret_cast<const PixelType*>(source.GetConstRow(y)), width);
+    }
+  }
+
+
+  template <typename PixelType>
+  static void AddConstantSimd(ImageAccessor& image,
+                              int64_t constant)
+  {
+    if (constant == 0)
+    {
+      return;
+    }
+
+    const unsigned int width = image.GetWidth();
+    const unsigned int height = image.GetHeight();
+
+    for (unsigned int y = 0; y < height; y++)
+    {
+      SimdKernels::AddConstant(reinterpret_cast<PixelType*>(image.GetRow(y)), width, constant);
+    }
+  }
+
+
+  template <typename PixelType>
+  static void MultiplyConstantSimd(ImageAccessor& image,
+                                   float factor,
+                                   bool useRound)
+  {
+    if (std::abs(factor - 1.0f) <= std::numeric_limits<float>::epsilon())
+    {
+      return;
+    }
+
+    // Multiplying by a constant is a "shift-scale" with a null
+    // offset. The saturation to the range of the pixels is done in
+    // floating-point, which is equivalent as the bounds are integers.
+    const unsigned int width = image.GetWidth();
+    const unsigned int height = image.GetHeight();
+
+    for (unsigned int y = 0; y < height; y++)
+    {
+      SimdKernels::ShiftScale(reinterpret_cast<PixelType*>(image.GetRow(y)), width, 0.0f, factor, useRound);
+    }
+  }
+
+
+  template <typename PixelType>
+  static void ShiftScaleSimd(ImageAccessor& image,
+                             float offset,
+                             float scaling,
+                             bool useRound)
+  {
+    const unsigned int width = image.GetWidth();
+    const unsigned int height = image.GetHeight();
+
+    for (unsigned int y = 0; y < height; y++)
+    {
+      SimdKernels::ShiftScale(reinterpret_cast<PixelType*>(image.GetRow(y)), width, offset, scaling, useRound);
+    }
+  }
+
+
+  template <typename PixelType>
+  static void InvertSimd(ImageAccessor& image,
+                         int64_t maxValue)
+  {
+    const PixelType m = static_cast<PixelType>(
+      std::min(maxValue, static_cast<int64_t>(std::numeric_limits<PixelType>::max())));
+
+    const unsigned int width = image.GetWidth();
+    const unsigned int height = image.GetHeight();
+
+    for (unsigned int y = 0; y < height; y++)
+    {
+      SimdKernels::Invert(reinterpret_cast<PixelType*>(image.GetRow(y)), width, m);
     }
   }
 
@@ -423,7 +472,7 @@ namespace Orthanc
   }
 
 
-  void ImageProcessing::Convert(ImageAccessor& target,
+  static void ConvertSequential(ImageAccessor& target,
                                 const ImageAccessor& source)
   {
     if (target.GetWidth() != source.GetWidth() ||
@@ -437,14 +486,21 @@ namespace Orthanc
 
     if (source.GetFormat() == target.GetFormat())
     {
-      Copy(target, source);
+      ImageProcessing::Copy(target, source);
       return;
     }
 
     if (target.GetFormat() == PixelFormat_Grayscale16 &&
         source.GetFormat() == PixelFormat_Grayscale8)
     {
-      ConvertInternal<uint16_t, uint8_t>(target, source);
+      if (SimdKernels::IsEnabled())
+      {
+        ConvertSimd<uint16_t, uint8_t>(target, source);
+      }
+      else
+      {
+        ConvertInternal<uint16_t, uint8_t>(target, source);
+      }
       return;
     }
 
@@ -458,7 +514,14 @@ namespace Orthanc
     if (target.GetFormat() == PixelFormat_Grayscale8 &&
         source.GetFormat() == PixelFormat_Grayscale16)
     {
-      ConvertInternal<uint8_t, uint16_t>(target, source);
+      if (SimdKernels::IsEnabled())
+      {
+        ConvertSimd<uint8_t, uint16_t>(target, source);
+      }
+      else
+      {
+        ConvertInternal<uint8_t, uint16_t>(target, source);
+      }
       return;
     }
 
@@ -472,7 +535,14 @@ namespace Orthanc
     if (target.GetFormat() == PixelFormat_Grayscale8 &&
         source.GetFormat() == PixelFormat_SignedGrayscale16)
     {
-      ConvertInternal<uint8_t, int16_t>(target, source);
+      if (SimdKernels::IsEnabled())
+      {
+        ConvertSimd<uint8_t, int16_t>(target, source);
+      }
+      else
+      {
+        ConvertInternal<uint8_t, int16_t>(target, source);
+      }
       return;
     }
 
@@ -791,7 +861,7 @@ namespace Orthanc
 
 
 
-  void ImageProcessing::Set(ImageAccessor& image,
+  static void SetSequential(ImageAccessor& image,
                             int64_t value)
   {
     switch (image.GetFormat())
@@ -900,7 +970,7 @@ namespace Orthanc
   }
 
 
-  void ImageProcessing::GetMinMaxIntegerValue(int64_t& minValue,
+  static void GetMinMaxIntegerValueSequential(int64_t& minValue,
                                               int64_t& maxValue,
                                               const ImageAccessor& image)
   {
@@ -909,7 +979,14 @@ namespace Orthanc
     case PixelFormat_Grayscale8:
     {
       uint8_t a, b;
-      GetMinMaxValueInternal<uint8_t>(a, b, image);
+      if (SimdKernels::IsEnabled())
+      {
+        GetMinMaxValueSimd<uint8_t>(a, b, image);
+      }
+      else
+      {
+        GetMinMaxValueInternal<uint8_t>(a, b, image);
+      }
       minValue = a;
       maxValue = b;
       break;
@@ -918,7 +995,14 @@ namespace Orthanc
     case PixelFormat_Grayscale16:
     {
       uint16_t a, b;
-      GetMinMaxValueInternal<uint16_t>(a, b, image);
+      if (SimdKernels::IsEnabled())
+      {
+        GetMinMaxValueSimd<uint16_t>(a, b, image);
+      }
+      else
+      {
+        GetMinMaxValueInternal<uint16_t>(a, b, image);
+      }
       minValue = a;
       maxValue = b;
       break;
@@ -936,7 +1020,14 @@ namespace Orthanc
     case PixelFormat_SignedGrayscale16:
     {
       int16_t a, b;
-      GetMinMaxValueInternal<int16_t>(a, b, image);
+      if (SimdKernels::IsEnabled())
+      {
+        GetMinMaxValueSimd<int16_t>(a, b, image);
+      }
+      else
+      {
+        GetMinMaxValueInternal<int16_t>(a, b, image);
+      }
       minValue = a;
       maxValue = b;
       break;
@@ -948,7 +1039,7 @@ namespace Orthanc
   }
 
 
-  void ImageProcessing::GetMinMaxFloatValue(float& minValue,
+  static void GetMinMaxFloatValueSequential(float& minValue,
                                             float& maxValue,
                                             const ImageAccessor& image)
   {
@@ -971,21 +1062,42 @@ namespace Orthanc
 
 
 
-  void ImageProcessing::AddConstant(ImageAccessor& image,
+  static void AddConstantSequential(ImageAccessor& image,
                                     int64_t value)
   {
     switch (image.GetFormat())
     {
     case PixelFormat_Grayscale8:
-      AddConstantInternal<uint8_t>(image, value);
+      if (SimdKernels::IsEnabled())
+      {
+        AddConstantSimd<uint8_t>(image, value);
+      }
+      else
+      {
+        AddConstantInternal<uint8_t>(image, value);
+      }
       return;
 
     case PixelFormat_Grayscale16:
-      AddConstantInternal<uint16_t>(image, value);
+      if (SimdKernels::IsEnabled())
+      {
+        AddConstantSimd<uint16_t>(image, value);
+      }
+      else
+      {
+        AddConstantInternal<uint16_t>(image, value);
+      }
       return;
 
     case PixelFormat_SignedGrayscale16:
-      AddConstantInternal<int16_t>(image, value);
+      if (SimdKernels::IsEnabled())
+      {
+        AddConstantSimd<int16_t>(image, value);
+      }
+      else
+      {
+        AddConstantInternal<int16_t>(image, value);
+      }
       return;
 
     default:
@@ -994,14 +1106,18 @@ namespace Orthanc
   }
 
 
-  void ImageProcessing::MultiplyConstant(ImageAccessor& image,
+  static void MultiplyConstantSequential(ImageAccessor& image,
                                          float factor,
                                          bool useRound)
   {
     switch (image.GetFormat())
     {
     case PixelFormat_Grayscale8:
-      if (useRound)
+      if (SimdKernels::IsEnabled())
+      {
+        MultiplyConstantSimd<uint8_t>(image, factor, useRound);
+      }
+      else if (useRound)
       {
         MultiplyConstantInternal<uint8_t, true>(image, factor);
       }
@@ -1012,7 +1128,11 @@ namespace Orthanc
       return;
 
     case PixelFormat_Grayscale16:
-      if (useRound)
+      if (SimdKernels::IsEnabled())
+      {
+        MultiplyConstantSimd<uint16_t>(image, factor, useRound);
+      }
+      else if (useRound)
       {
         MultiplyConstantInternal<uint16_t, true>(image, factor);
       }
@@ -1023,7 +1143,11 @@ namespace Orthanc
       return;
 
     case PixelFormat_SignedGrayscale16:
-      if (useRound)
+      if (SimdKernels::IsEnabled())
+      {
+        MultiplyConstantSimd<int16_t>(image, factor, useRound);
+      }
+      else if (useRound)
       {
         MultiplyConstantInternal<int16_t, true>(image, factor);
       }
@@ -1039,7 +1163,7 @@ namespace Orthanc
   }
 
 
-  void ImageProcessing::ShiftScale(ImageAccessor& image,
+  static void ShiftScaleSequential(ImageAccessor& image,
                                    float offset,
                                    float scaling,
                                    bool useRound)
@@ -1047,7 +1171,11 @@ namespace Orthanc
     switch (image.GetFormat())
     {
     case PixelFormat_Grayscale8:
-      if (useRound)
+      if (SimdKernels::IsEnabled())
+      {
+        ShiftScaleSimd<uint8_t>(image, offset, scaling, useRound);
+      }
+      else if (useRound)
       {
         ShiftScaleInternal<uint8_t, true>(image, offset, scaling);
       }
@@ -1058,7 +1186,11 @@ namespace Orthanc
       return;
 
     case PixelFormat_Grayscale16:
-      if (useRound)
+      if (SimdKernels::IsEnabled())
+      {
+        ShiftScaleSimd<uint16_t>(image, offset, scaling, useRound);
+      }
+      else if (useRound)
       {
         ShiftScaleInternal<uint16_t, true>(image, offset, scaling);
       }
@@ -1069,7 +1201,11 @@ namespace Orthanc
       return;
 
     case PixelFormat_SignedGrayscale16:
-      if (useRound)
+      if (SimdKernels::IsEnabled())
+      {
+        ShiftScaleSimd<int16_t>(image, offset, scaling, useRound);
+      }
+      else if (useRound)
       {
         ShiftScaleInternal<int16_t, true>(image, offset, scaling);
       }
@@ -1085,7 +1221,7 @@ namespace Orthanc
   }
 
 
-  void ImageProcessing::Invert(ImageAccessor& image, int64_t maxValue)
+  static void InvertSequential(ImageAccessor& image, int64_t maxValue)
   {
     const unsigned int width = image.GetWidth();
     const unsigned int height = image.GetHeight();
@@ -1094,32 +1230,34 @@ namespace Orthanc
     {
     case PixelFormat_Grayscale16:
     {
+      if (SimdKernels::IsEnabled())
+      {
+        InvertSimd<uint16_t>(image, maxValue);
+        return;
+      }
+
       uint16_t maxValueUint16 = (uint16_t)(std::min(maxValue, static_cast<int64_t>(std::numeric_limits<uint16_t>::max())));
 
       for (unsigned int y = 0; y < height; y++)
       {
-        uint16_t* p = reinterpret_cast<uint16_t*>(image.GetRow(y));
-
-        for (unsigned int x = 0; x < width; x++, p++)
-        {
-          *p = maxValueUint16 - (*p);
-        }
+        ScalarKernels::Invert(reinterpret_cast<uint16_t*>(image.GetRow(y)), width, maxValueUint16);
       }
 
       return;
     }
     case PixelFormat_Grayscale8:
     {
+      if (SimdKernels::IsEnabled())
+      {
+        InvertSimd<uint8_t>(image, maxValue);
+        return;
+      }
+
       uint8_t maxValueUint8 = (uint8_t)(std::min(maxValue, static_cast<int64_t>(std::numeric_limits<uint8_t>::max())));
 
       for (unsigned int y = 0; y < height; y++)
       {
-        uint8_t* p = reinterpret_cast<uint8_t*>(image.GetRow(y));
-
-        for (unsigned int x = 0; x < width; x++, p++)
-        {
-          *p = maxValueUint8 - (*p);
-        }
+        ScalarKernels::Invert(reinterpret_cast<uint8_t*>(image.GetRow(y)), width, maxValueUint8);
       }
 
       return;
@@ -1131,26 +1269,355 @@ namespace Orthanc
 
   }
 
-  void ImageProcessing::Invert(ImageAccessor& image)
+
+  namespace
   {
-    switch (image.GetFormat())
+    // Operations on the bands of rows of large images, that are
+    // processed in parallel (cf. "ParallelImageProcessing")
+
+    class ConvertOperation : public ParallelImageProcessing::IBandOperation
     {
-    case PixelFormat_Grayscale8:
-      return Invert(image, 255);
-    default:
-      throw OrthancException(ErrorCode_NotImplemented); // you should use the Invert(image, maxValue) overload
-    }
-  }
+    private:
+      ImageAccessor&        target_;
+      const ImageAccessor&  source_;
+
+    public:
+      ConvertOperation(ImageAccessor& target,
+                       const ImageAccessor& source) :
+        target_(target),
+        source_(source)
+      {
+      }
 
+      virtual void Apply(unsigned int firstRow,
+                         unsigned int endRow)
+      {
+        ImageAccessor target, source;
+        target_.GetRegion(target, 0, firstRow, target_.GetWidth(), endRow - firstRow);
+        source_.GetRegion(source, 0, firstRow, source_.GetWidth(), endRow - firstRow);
+        ConvertSequential(target, source);
+      }
+    };
 
 
-  namespace
-  {
-    template <Orthanc::PixelFormat Format>
-    class BresenhamPixelWriter
+    class SetOperation : public ParallelImageProcessing::IBandOperation
     {
     private:
-      typedef typename PixelTraits<Format>::PixelType  PixelType;
+      ImageAccessor&  image_;
+      int64_t         value_;
+
+    public:
+      SetOperation(ImageAccessor& image,
+                   int64_t value) :
+        image_(image),
+        value_(value)
+      {
+      }
+
+      virtual void Apply(unsigned int firstRow,
+                         unsigned int endRow)
+      {
+        ImageAccessor band;
+        image_.GetRegion(band, 0, firstRow, image_.GetWidth(), endRow - firstRow);
+        SetSequential(band, value_);
+      }
+    };
+
+
+    template <typename ValueType>
+    class GetMinMaxOperation : public ParallelImageProcessing::IBandOperation
+    {
+    private:
+      typedef void (*Function) (ValueType&, ValueType&, const ImageAccessor&);
+
+      boost::mutex          mutex_;
+      const ImageAccessor&  image_;
+      Function              function_;
+      bool                  hasValue_;
+      ValueType             minValue_;
+      ValueType             maxValue_;
+
+    public:
+      GetMinMaxOperation(const ImageAccessor& image,
+                         Function function) :
+        image_(image),
+        function_(function),
+        hasValue_(false),
+        minValue_(0),
+        maxValue_(0)
+      {
+      }
+
+      virtual void Apply(unsigned int firstRow,
+                         unsigned int endRow)
+      {
+        ImageAccessor band;
+        image_.GetRegion(band, 0, firstRow, image_.GetWidth(), endRow - firstRow);
+
+        ValueType a, b;
+        function_(a, b, band);
+
+        boost::mutex::scoped_lock lock(mutex_);
+
+        if (hasValue_)
+        {
+          minValue_ = std::min(minValue_, a);
+          maxValue_ = std::max(maxValue_, b);
+        }
+        else
+        {
+          hasValue_ = true;
+          minValue_ = a;
+          maxValue_ = b;
+        }
+      }
+
+      ValueType GetMinValue() const
+      {
+        return minValue_;
+      }
+
+      ValueType GetMaxValue() const
+      {
+        return maxValue_;
+      }
+    };
+
+
+    class AddConstantOperation : public ParallelImageProcessing::IBandOperation
+    {
+    private:
+      ImageAccessor&  image_;
+      int64_t         value_;
+
+    public:
+      AddConstantOperation(ImageAccessor& image,
+                           int64_t value) :
+        image_(image),
+        value_(value)
+      {
+      }
+
+      virtual void Apply(unsigned int firstRow,
+                         unsigned int endRow)
+      {
+        ImageAccessor band;
+        image_.GetRegion(band, 0, firstRow, image_.GetWidth(), endRow - firstRow);
+        AddConstantSequential(band, value_);
+      }
+    };
+
+
+    class MultiplyConstantOperation : public ParallelImageProcessing::IBandOperation
+    {
+    private:
+      ImageAccessor&  image_;
+      float           factor_;
+      bool            useRound_;
+
+    public:
+      MultiplyConstantOperation(ImageAccessor& image,
+                                float factor,
+                                bool useRound) :
+        image_(image),
+        factor_(factor),
+        useRound_(useRound)
+      {
+      }
+
+      virtual void Apply(unsigned int firstRow,
+                         unsigned int endRow)
+      {
+        ImageAccessor band;
+        image_.GetRegion(band, 0, firstRow, image_.GetWidth(), endRow - firstRow);
+        MultiplyConstantSequential(band, factor_, useRound_);
+      }
+    };
+
+
+    class ShiftScaleOperation : public ParallelImageProcessing::IBandOperation
+    {
+    private:
+      ImageAccessor&  image_;
+      float           offset_;
+      float           scaling_;
+      bool            useRound_;
+
+    public:
+      ShiftScaleOperation(ImageAccessor& image,
+                          float offset,
+                          float scaling,
+                          bool useRound) :
+        image_(image),
+        offset_(offset),
+        scaling_(scaling),
+        useRound_(useRound)
+      {
+      }
+
+      virtual void Apply(unsigned int firstRow,
+                         unsigned int endRow)
+      {
+        ImageAccessor band;
+        image_.GetRegion(band, 0, firstRow, image_.GetWidth(), endRow - firstRow);
+        ShiftScaleSequential(band, offset_, scaling_, useRound_);
+      }
+    };
+
+
+    class InvertOperation : public ParallelImageProcessing::IBandOperation
+    {
+    private:
+      ImageAccessor&  image_;
+      int64_t         maxValue_;
+
+    public:
+      InvertOperation(ImageAccessor& image,
+                      int64_t maxValue) :
+        image_(image),
+        maxValue_(maxValue)
+      {
+      }
+
+      virtual void Apply(unsigned int firstRow,
+                         unsigned int endRow)
+      {
+        ImageAccessor band;
+        image_.GetRegion(band, 0, firstRow, image_.GetWidth(), endRow - firstRow);
+        InvertSequential(band, maxValue_);
+      }
+    };
+  }
+
+
+  void ImageProcessing::Convert(ImageAccessor& target,
+                                const ImageAccessor& source)
+  {
+    if (target.GetWidth() != source.GetWidth() ||
+        target.GetHeight() != source.GetHeight())
+    {
+      throw OrthancException(ErrorCode_IncompatibleImageSize);
+    }
+
+    ConvertOperation operation(target, source);
+    if (!ParallelImageProcessing::Apply(operation, source))
+    {
+      ConvertSequential(target, source);
+    }
+  }
+
+
+  void ImageProcessing::Set(ImageAccessor& image,
+                            int64_t value)
+  {
+    SetOperation operation(image, value);
+    if (!ParallelImageProcessing::Apply(operation, image))
+    {
+      SetSequential(image, value);
+    }
+  }
+
+
+  void ImageProcessing::GetMinMaxIntegerValue(int64_t& minValue,
+                                              int64_t& maxValue,
+                                              const ImageAccessor& image)
+  {
+    GetMinMaxOperation<int64_t> operation(image, GetMinMaxIntegerValueSequential);
+    if (ParallelImageProcessing::Apply(operation, image))
+    {
+      minValue = operation.GetMinValue();
+      maxValue = operation.GetMaxValue();
+    }
+    else
+    {
+      GetMinMaxIntegerValueSequential(minValue, maxValue, image);
+    }
+  }
+
+
+  void ImageProcessing::GetMinMaxFloatValue(float& minValue,
+                                            float& maxValue,
+                                            const ImageAccessor& image)
+  {
+    GetMinMaxOperation<float> operation(image, GetMinMaxFloatValueSequential);
+    if (ParallelImageProcessing::Apply(operation, image))
+    {
+      minValue = operation.GetMinValue();
+      maxValue = operation.GetMaxValue();
+    }
+    else
+    {
+      GetMinMaxFloatValueSequential(minValue, maxValue, image);
+    }
+  }
+
+
+  void ImageProcessing::AddConstant(ImageAccessor& image,
+                                    int64_t value)
+  {
+    AddConstantOperation operation(image, value);
+    if (!ParallelImageProcessing::Apply(operation, image))
+    {
+      AddConstantSequential(image, value);
+    }
+  }
+
+
+  void ImageProcessing::MultiplyConstant(ImageAccessor& image,
+                                         float factor,
+                                         bool useRound)
+  {
+    MultiplyConstantOperation operation(image, factor, useRound);
+    if (!ParallelImageProcessing::Apply(operation, image))
+    {
+      MultiplyConstantSequential(image, factor, useRound);
+    }
+  }
+
+
+  void ImageProcessing::ShiftScale(ImageAccessor& image,
+                                   float offset,
+                                   float scaling,
+                                   bool useRound)
+  {
+    ShiftScaleOperation operation(image, offset, scaling, useRound);
+    if (!ParallelImageProcessing::Apply(operation, image))
+    {
+      ShiftScaleSequential(image, offset, scaling, useRound);
+    }
+  }
+
+
+  void ImageProcessing::Invert(ImageAccessor& image, int64_t maxValue)
+  {
+    InvertOperation operation(image, maxValue);
+    if (!ParallelImageProcessing::Apply(operation, image))
+    {
+      InvertSequential(image, maxValue);
+    }
+  }
+
+
+  void ImageProcessing::Invert(ImageAccessor& image)
+  {
+    switch (image.GetFormat())
+    {
+    case PixelFormat_Grayscale8:
+      return Invert(image, 255);
+    default:
+      throw OrthancException(ErrorCode_NotImplemented); // you should use the Invert(image, maxValue) overload
+    }
+  }
+
+
+
+  namespace
+  {
+    template <Orthanc::PixelFormat Format>
+    class BresenhamPixelWriter
+    {
+    private:
+      typedef typename PixelTraits<Format>::PixelType  PixelType;
 
       Orthanc::ImageAccessor&  image_;
       PixelType                value_;
@@ -1532,4 +1999,535 @@ namespace Orthanc
     }
   }
 
+
+
+  namespace
+  {
+    class WindowingFunction
+    {
+    private:
+      double  center_;
+      double  width_;
+      double  slope_;
+      double  intercept_;
+      double  lower_;
+      double  upper_;
+      bool    invert_;
+
+    public:
+      WindowingFunction(float windowCenter,
+                        float windowWidth,
+                        float rescaleSlope,
+                        float rescaleIntercept,
+                        bool invert) :
+        center_(windowCenter),
+        width_(windowWidth),
+        slope_(rescaleSlope),
+        intercept_(rescaleIntercept),
+        lower_(center_ - 0.5 - (width_ - 1.0) / 2.0),
+        upper_(center_ - 0.5 + (width_ - 1.0) / 2.0),
+        invert_(invert)
+      {
+        if (windowWidth < 1.0f)
+        {
+          // As required by the DICOM standard
+          throw OrthancException(ErrorCode_ParameterOutOfRange);
+        }
+      }
+
+      uint8_t Apply(double storedValue) const
+      {
+        const double x = storedValue * slope_ + intercept_;
+
+        uint8_t y;
+        if (x <= lower_)
+        {
+          y = 0;
+        }
+        else if (x > upper_)
+        {
+          y = 255;
+        }
+        else
+        {
+          // Not reached if the width is 1, as "lower_ == upper_"
+          double v = ((x - (center_ - 0.5)) / (width_ - 1.0) + 0.5) * 255.0;
+          y = static_cast<uint8_t>(std::max(0.0, std::min(255.0, v + 0.5)));
+        }
+
+        return (invert_ ? 255 - y : y);
+      }
+    };
+
+
+    // Windowing of integer pixels through a lookup table that
+    // covers the full range of the pixel type
+    template <typename PixelType>
+    class WindowingLookupTable : public ParallelImageProcessing::IBandOperation
+    {
+    private:
+      ImageAccessor&        target_;
+      const ImageAccessor&  source_;
+      std::vector<uint8_t>  table_;
+      int32_t               offset_;
+
+    public:
+      WindowingLookupTable(ImageAccessor& target,
+                           const ImageAccessor& source,
+                           const WindowingFunction& function) :
+        target_(target),
+        source_(source),
+        offset_(-static_cast<int32_t>(std::numeric_limits<PixelType>::min()))
+      {
+        const int32_t size = (static_cast<int32_t>(std::numeric_limits<PixelType>::max()) + offset_ + 1);
+        table_.resize(size);
+
+        for (int32_t i = 0; i < size; i++)
+        {
+          table_[i] = function.Apply(static_cast<double>(i - offset_));
+        }
+      }
+
+      virtual void Apply(unsigned int firstRow,
+                         unsigned int endRow)
+      {
+        const unsigned int width = source_.GetWidth();
+        const uint8_t* table = &table_[0];
+
+        for (unsigned int y = firstRow; y < endRow; y++)
+        {
+          uint8_t* t = reinterpret_cast<uint8_t*>(target_.GetRow(y));
+          const PixelType* s = reinterpret_cast<const PixelType*>(source_.GetConstRow(y));
+
+          for (unsigned int x = 0; x < width; x++, t++, s++)
+          {
+            *t = table[static_cast<int32_t>(*s) + offset_];
+          }
+        }
+      }
+    };
+
+
+    // Windowing of the pixels whose range is too large for a lookup table
+    template <typename PixelType>
+    class WindowingDirect : public ParallelImageProcessing::IBandOperation
+    {
+    private:
+      ImageAccessor&            target_;
+      const ImageAccessor&      source_;
+      const WindowingFunction&  function_;
+
+    public:
+      WindowingDirect(ImageAccessor& target,
+                      const ImageAccessor& source,
+                      const WindowingFunction& function) :
+        target_(target),
+        source_(source),
+        function_(function)
+      {
+      }
+
+      virtual void Apply(unsigned int firstRow,
+                         unsigned int endRow)
+      {
+        const unsigned int width = source_.GetWidth();
+
+        for (unsigned int y = firstRow; y < endRow; y++)
+        {
+          uint8_t* t = reinterpret_cast<uint8_t*>(target_.GetRow(y));
+          const PixelType* s = reinterpret_cast<const PixelType*>(source_.GetConstRow(y));
+
+          for (unsigned int x = 0; x < width; x++, t++, s++)
+          {
+            *t = function_.Apply(static_cast<double>(*s));
+          }
+        }
+      }
+    };
+  }
+
+
+  static void ApplyOperation(ParallelImageProcessing::IBandOperation& operation,
+                             const ImageAccessor& image)
+  {
+    if (!ParallelImageProcessing::Apply(operation, image))
+    {
+      operation.Apply(0, image.GetHeight());
+    }
+  }
+
+
+  void ImageProcessing::ApplyWindowing(ImageAccessor& target,
+                                       const ImageAccessor& source,
+                                       float windowCenter,
+                                       float windowWidth,
+                                       float rescaleSlope,
+                                       float rescaleIntercept,
+                                       bool invert)
+  {
+    if (target.GetWidth() != source.GetWidth() ||
+        target.GetHeight() != source.GetHeight())
+    {
+      throw OrthancException(ErrorCode_IncompatibleImageSize);
+    }
+
+    if (target.GetFormat() != PixelFormat_Grayscale8)
+    {
+      throw OrthancException(ErrorCode_IncompatibleImageFormat);
+    }
+
+    WindowingFunction function(windowCenter, windowWidth, rescaleSlope, rescaleIntercept, invert);
+
+    switch (source.GetFormat())
+    {
+      case PixelFormat_Grayscale8:
+      {
+        WindowingLookupTable<uint8_t> operation(target, source, function);
+        ApplyOperation(operation, source);
+        break;
+      }
+
+      case PixelFormat_Grayscale16:
+      {
+        WindowingLookupTable<uint16_t> operation(target, source, function);
+        ApplyOperation(operation, source);
+        break;
+      }
+
+      case PixelFormat_SignedGrayscale16:
+      {
+        WindowingLookupTable<int16_t> operation(target, source, function);
+        ApplyOperation(operation, source);
+        break;
+      }
+
+      case PixelFormat_Grayscale32:
+      {
+        WindowingDirect<uint32_t> operation(target, source, function);
+        ApplyOperation(operation, source);
+        break;
+      }
+
+      case PixelFormat_Float32:
+      {
+        WindowingDirect<float> operation(target, source, function);
+        ApplyOperation(operation, source);
+        break;
+      }
+
+      default:
+        throw OrthancException(ErrorCode_NotImplemented);
+    }
+  }
+
+
+  namespace
+  {
+    class BilinearResize : public ParallelImageProcessing::IBandOperation
+    {
+    private:
+      ImageAccessor&             target_;
+      const ImageAccessor&       source_;
+      unsigned int               channels_;
+      std::vector<unsigned int>  x0_;
+      std::vector<unsigned int>  x1_;
+      std::vector<float>         wx_;
+      std::vector<unsigned int>  y0_;
+      std::vector<unsigned int>  y1_;
+      std::vector<float>         wy_;
+
+      static void ComputeWeights(std::vector<unsigned int>& index0,
+                                 std::vector<unsigned int>& index1,
+                                 std::vector<float>& weight,
+                                 unsigned int targetSize,
+                                 unsigned int sourceSize)
+      {
+        index0.resize(targetSize);
+        index1.resize(targetSize);
+        weight.resize(targetSize);
+
+        const float scale = static_cast<float>(sourceSize) / static_cast<float>(targetSize);
+
+        for (unsigned int i = 0; i < targetSize; i++)
+        {
+          // Align the centers of the pixels
+          float s = std::max(0.0f, (static_cast<float>(i) + 0.5f) * scale - 0.5f);
+          unsigned int a = static_cast<unsigned int>(s);
+
+          if (a + 1 >= sourceSize)
+          {
+            index0[i] = sourceSize - 1;
+            index1[i] = sourceSize - 1;
+            weight[i] = 0;
+          }
+          else
+          {
+            index0[i] = a;
+            index1[i] = a + 1;
+            weight[i] = s - static_cast<float>(a);
+          }
+        }
+      }
+
+    public:
+      BilinearResize(ImageAccessor& target,
+                     const ImageAccessor& source,
+                     unsigned int channels) :
+        target_(target),
+        source_(source),
+        channels_(channels)
+      {
+        ComputeWeights(x0_, x1_, wx_, target.GetWidth(), source.GetWidth());
+        ComputeWeights(y0_, y1_, wy_, target.GetHeight(), source.GetHeight());
+      }
+
+      virtual void Apply(unsigned int firstRow,
+                         unsigned int endRow)
+      {
+        const unsigned int width = target_.GetWidth();
+
+        for (unsigned int y = firstRow; y < endRow; y++)
+        {
+          uint8_t* t = reinterpret_cast<uint8_t*>(target_.GetRow(y));
+          const uint8_t* a = reinterpret_cast<const uint8_t*>(source_.GetConstRow(y0_[y]));
+          const uint8_t* b = reinterpret_cast<const uint8_t*>(source_.GetConstRow(y1_[y]));
+          const float wy = wy_[y];
+
+          for (unsigned int x = 0; x < width; x++)
+          {
+            const unsigned int x0 = x0_[x] * channels_;
+            const unsigned int x1 = x1_[x] * channels_;
+            const float wx = wx_[x];
+
+            for (unsigned int c = 0; c < channels_; c++, t++)
+            {
+              float top = static_cast<float>(a[x0 + c]) * (1.0f - wx) + static_cast<float>(a[x1 + c]) * wx;
+              float bottom = static_cast<float>(b[x0 + c]) * (1.0f - wx) + static_cast<float>(b[x1 + c]) * wx;
+              *t = static_cast<uint8_t>(top * (1.0f - wy) + bottom * wy + 0.5f);
+            }
+          }
+        }
+      }
+    };
+  }
+
+
+  namespace
+  {
+    class AreaAveragingResize : public ParallelImageProcessing::IBandOperation
+    {
+    private:
+      ImageAccessor&             target_;
+      const ImageAccessor&       source_;
+      unsigned int               channels_;
+      std::vector<unsigned int>  xFirst_;
+      std::vector<unsigned int>  xCount_;
+      std::vector<float>         xWeights_;
+      std::vector<unsigned int>  yFirst_;
+      std::vector<unsigned int>  yCount_;
+      std::vector<float>         yWeights_;
+
+      // For each target pixel, compute the range of the source pixels
+      // it covers, together with the (normalized) fraction of each
+      // source pixel that lies inside the target pixel. The weights
+      // of all the target pixels are packed in "weights".
+      static void ComputeWeights(std::vector<unsigned int>& first,
+                                 std::vector<unsigned int>& count,
+                                 std::vector<float>& weights,
+                                 unsigned int targetSize,
+                                 unsigned int sourceSize)
+      {
+        assert(targetSize <= sourceSize);
+
+        first.resize(targetSize);
+        count.resize(targetSize);
+        weights.clear();
+        weights.reserve(sourceSize + 2 * targetSize);
+
+        const double scale = static_cast<double>(sourceSize) / static_cast<double>(targetSize);
+
+        for (unsigned int i = 0; i < targetSize; i++)
+        {
+          const double start = static_cast<double>(i) * scale;
+          const double end = std::min(static_cast<double>(sourceSize),
+                                      static_cast<double>(i + 1) * scale);
+
+          unsigned int a = static_cast<unsigned int>(start);
+          unsigned int b = std::min(sourceSize, static_cast<unsigned int>(std::ceil(end)));
+
+          first[i] = a;
+          count[i] = b - a;
+
+          for (unsigned int j = a; j < b; j++)
+          {
+            double overlap = (std::min(end, static_cast<double>(j + 1)) -
+                              std::max(start, static_cast<double>(j)));
+            weights.push_back(static_cast<float>(overlap / scale));
+          }
+        }
+      }
+
+    public:
+      AreaAveragingResize(ImageAccessor& target,
+                          const ImageAccessor& source,
+                          unsigned int channels) :
+        target_(target),
+        source_(source),
+        channels_(channels)
+      {
+        ComputeWeights(xFirst_, xCount_, xWeights_, target.GetWidth(), source.GetWidth());
+        ComputeWeights(yFirst_, yCount_, yWeights_, target.GetHeight(), source.GetHeight());
+      }
+
+      virtual void Apply(unsigned int firstRow,
+                         unsigned int endRow)
+      {
+        const unsigned int width = target_.GetWidth();
+        const unsigned int rowSize = source_.GetWidth() * channels_;
+
+        // Locate the weights of the first row of this band
+        size_t yWeight = 0;
+        for (unsigned int y = 0; y < firstRow; y++)
+        {
+          yWeight += yCount_[y];
+        }
+
+        // Vertical pass: Accumulate the source rows that are covered
+        // by one target row. Then, horizontal pass over this buffer.
+        std::vector<float> accumulator(rowSize);
+
+        for (unsigned int y = firstRow; y < endRow; y++)
+        {
+          std::fill(accumulator.begin(), accumulator.end(), 0.0f);
+
+          for (unsigned int j = 0; j < yCount_[y]; j++, yWeight++)
+          {
+            const uint8_t* s = reinterpret_cast<const uint8_t*>(source_.GetConstRow(yFirst_[y] + j));
+            const float w = yWeights_[yWeight];
+
+            for (unsigned int k = 0; k < rowSize; k++)
+            {
+              accumulator[k] += w * static_cast<float>(s[k]);
+            }
+          }
+
+          uint8_t* t = reinterpret_cast<uint8_t*>(target_.GetRow(y));
+          size_t xWeight = 0;
+
+          for (unsigned int x = 0; x < width; x++)
+          {
+            const float* a = &accumulator[xFirst_[x] * channels_];
+
+            for (unsigned int c = 0; c < channels_; c++, t++)
+            {
+              float v = 0;
+              for (unsigned int j = 0; j < xCount_[x]; j++)
+              {
+                v += xWeights_[xWeight + j] * a[j * channels_ + c];
+              }
+
+              v += 0.5f;
+              *t = (v >= 255.0f ? 255 : static_cast<uint8_t>(v));
+            }
+
+            xWeight += xCount_[x];
+          }
+        }
+      }
+    };
+  }
+
+
+  void ImageProcessing::Resize(ImageAccessor& target,
+                               const ImageAccessor& source)
+  {
+    if (target.GetFormat() != source.GetFormat())
+    {
+      throw OrthancException(ErrorCode_IncompatibleImageFormat);
+    }
+
+    unsigned int channels;
+
+    switch (source.GetFormat())
+    {
+      case PixelFormat_Grayscale8:
+        channels = 1;
+        break;
+
+      case PixelFormat_RGB24:
+        channels = 3;
+        break;
+
+      case PixelFormat_RGBA32:
+      case PixelFormat_BGRA32:
+        channels = 4;
+        break;
+
+      default:
+        throw OrthancException(ErrorCode_NotImplemented);
+    }
+
+    if (target.GetWidth() == 0 ||
+        target.GetHeight() == 0)
+    {
+      return;
+    }
+
+    if (source.GetWidth() == 0 ||
+        source.GetHeight() == 0)
+    {
+      throw OrthancException(ErrorCode_IncompatibleImageSize);
+    }
+
+    if (target.GetWidth() == source.GetWidth() &&
+        target.GetHeight() == source.GetHeight())
+    {
+      Copy(target, source);
+    }
+    else if (target.GetWidth() <= source.GetWidth() &&
+             target.GetHeight() <= source.GetHeight())
+    {
+      AreaAveragingResize operation(target, source, channels);
+      ApplyOperation(operation, target);
+    }
+    else
+    {
+      BilinearResize operation(target, source, channels);
+      ApplyOperation(operation, target);
+    }
+  }
+
+
+  void ImageProcessing::FitInside(unsigned int& targetWidth,
+                                  unsigned int& targetHeight,
+                                  unsigned int sourceWidth,
+                                  unsigned int sourceHeight,
+                                  unsigned int maxWidth,
+                                  unsigned int maxHeight)
+  {
+    double ratio = 1;
+
+    if (maxWidth != 0 &&
+        sourceWidth > maxWidth)
+    {
+      ratio = std::min(ratio, static_cast<double>(maxWidth) / static_cast<double>(sourceWidth));
+    }
+
+    if (maxHeight != 0 &&
+        sourceHeight > maxHeight)
+    {
+      ratio = std::min(ratio, static_cast<double>(maxHeight) / static_cast<double>(sourceHeight));
+    }
+
+    if (ratio == 1)
+    {
+      targetWidth = sourceWidth;
+      targetHeight = sourceHeight;
+    }
+    else
+    {
+      targetWidth = std::max(1u, static_cast<unsigned int>(boost::math::iround(ratio * static_cast<double>(sourceWidth))));
+      targetHeight = std::max(1u, static_cast<unsigned int>(boost::math::iround(ratio * static_cast<double>(sourceHeight))));
+    }
+  }
 }
@@ -131,5 +131,34 @@ namespace Orthanc
     void FillPolygon(ImageAccessor& image,
                      const std::vector<ImagePoint>& points,
                      int64_t value);
+
+    // Applies the modality LUT (rescale slope and intercept), then
+    // the linear VOI LUT (window center and width) of DICOM PS3.3
+    // C.11.2.1.2. The target must be Grayscale8. Integer pixels of
+    // at most 16bpp go through a precomputed lookup table.
+    void ApplyWindowing(ImageAccessor& target,
+                        const ImageAccessor& source,
+                        float windowCenter,
+                        float windowWidth,
+                        float rescaleSlope,
+                        float rescaleIntercept,
+                        bool invert);
+
+    // Resize between images with the same format, whose channels are
+    // 8bpp (Grayscale8, RGB24, RGBA32 or BGRA32). Downscaling averages
+    // the source area covered by each target pixel, which avoids the
+    // aliasing of thumbnails. Otherwise, bilinear interpolation is used.
+    void Resize(ImageAccessor& target,
+                const ImageAccessor& source);
+
+    // Computes the size of an image that is downscaled to fit inside
+    // a "maxWidth" x "maxHeight" box, keeping its aspect ratio ("0"
+    // means no constraint). Images are never upscaled.
+    void FitInside(unsigned int& targetWidth,
+                   unsigned int& targetHeight,
+                   unsigned int sourceWidth,
+                   unsigned int sourceHeight,
+                   unsigned int maxWidth,
+                   unsigned int maxHeight);
   }
 }
@@ -0,0 +1,408 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2019 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#include "../PrecompiledHeaders.h"
+#include "ParallelImageProcessing.h"
+
+#if !defined(ORTHANC_SANDBOXED)
+#  error The macro ORTHANC_SANDBOXED must be defined
+#endif
+
+#if ORTHANC_SANDBOXED == 1
+
+namespace Orthanc
+{
+  namespace ParallelImageProcessing
+  {
+    // No thread in sandboxed environments: Always process sequentially
+
+    void Initialize(unsigned int countThreads,
+                    uint64_t minimumPixels)
+    {
+    }
+
+    void Finalize()
+    {
+    }
+
+    unsigned int GetThreadsCount()
+    {
+      return 1;
+    }
+
+    uint64_t GetMinimumPixels()
+    {
+      return 0;
+    }
+
+    bool IsParallelizable(const ImageAccessor& image)
+    {
+      return false;
+    }
+
+    bool Apply(IBandOperation& operation,
+               const ImageAccessor& image)
+    {
+      return false;
+    }
+
+    bool ApplyToItems(IBandOperation& operation,
+                      unsigned int countItems)
+    {
+      return false;
+    }
+  }
+}
+
+#else
+
+#include "../Logging.h"
+#include "../MultiThreading/RunnableWorkersPool.h"
+#include "../OrthancException.h"
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread.hpp>
+
+#include <algorithm>
+
+namespace Orthanc
+{
+  namespace ParallelImageProcessing
+  {
+    // Number of bands per thread, to balance the load
+    static const unsigned int BANDS_PER_THREAD = 4;
+
+
+    namespace
+    {
+      class BandsJob : public boost::noncopyable
+      {
+      private:
+        boost::mutex               mutex_;
+        boost::condition_variable  finished_;
+        IBandOperation&            operation_;
+        unsigned int               height_;
+        unsigned int               bandHeight_;
+        unsigned int               nextRow_;
+        unsigned int               activeBands_;
+        bool                       failed_;
+        ErrorCode                  error_;
+        std::string                details_;
+
+        void SetError(ErrorCode error,
+                      const std::string& details)
+        {
+          boost::mutex::scoped_lock lock(mutex_);
+          if (!failed_)
+          {
+            failed_ = true;
+            error_ = error;
+            details_ = details;
+          }
+        }
+
+      public:
+        BandsJob(IBandOperation& operation,
+                 unsigned int height,
+                 unsigned int countBands) :
+          operation_(operation),
+          height_(height),
+          bandHeight_((height + countBands - 1) / countBands),
+          nextRow_(0),
+          activeBands_(0),
+          failed_(false),
+          error_(ErrorCode_Success)
+        {
+          assert(countBands > 0 &&
+                 bandHeight_ > 0);
+        }
+
+        // Returns "false" iff. there is no band left. Once the caller
+        // has returned from "Apply()", this method never accesses the
+        // operation anymore, so the job can safely outlive it.
+        bool ProcessNextBand()
+        {
+          unsigned int firstRow, endRow;
+
+          {
+            boost::mutex::scoped_lock lock(mutex_);
+
+            if (failed_ ||
+                nextRow_ >= height_)
+            {
+              return false;
+            }
+
+            firstRow = nextRow_;
+            endRow = std::min(height_, firstRow + bandHeight_);
+            nextRow_ = endRow;
+            activeBands_++;
+          }
+
+          try
+          {
+            operation_.Apply(firstRow, endRow);
+          }
+          catch (OrthancException& e)
+          {
+            SetError(e.GetErrorCode(), e.HasDetails() ? e.GetDetails() : "");
+          }
+          catch (std::bad_alloc&)
+          {
+            SetError(ErrorCode_NotEnoughMemory, "");
+          }
+          catch (...)
+          {
+            SetError(ErrorCode_InternalError, "Native exception while processing a band of an image");
+          }
+
+          {
+            boost::mutex::scoped_lock lock(mutex_);
+            assert(activeBands_ > 0);
+            activeBands_--;
+
+            if (activeBands_ == 0)
+            {
+              finished_.notify_all();
+            }
+          }
+
+          return true;
+        }
+
+        void WaitAndCheck()
+        {
+          boost::mutex::scoped_lock lock(mutex_);
+
+          // All the bands have been started by the caller
+          while (activeBands_ > 0)
+          {
+            finished_.wait(lock);
+          }
+
+          if (failed_)
+          {
+            if (details_.empty())
+            {
+              throw OrthancException(error_);
+            }
+            else
+            {
+              throw OrthancException(error_, details_);
+            }
+          }
+        }
+      };
+
+
+      class BandsRunnable : public IRunnableBySteps
+      {
+      private:
+        boost::shared_ptr<BandsJob>  job_;
+
+      public:
+        explicit BandsRunnable(const boost::shared_ptr<BandsJob>& job) :
+          job_(job)
+        {
+        }
+
+        virtual bool Step()
+        {
+          while (job_->ProcessNextBand())
+          {
+          }
+
+          return false;  // Done with this job
+        }
+      };
+    }
+
+
+    static boost::mutex                          mutex_;
+    static unsigned int                          countThreads_ = 1;
+    static uint64_t                              minimumPixels_ = 0;
+    static boost::shared_ptr<RunnableWorkersPool>  pool_;
+
+
+    void Initialize(unsigned int countThreads,
+                    uint64_t minimumPixels)
+    {
+      if (countThreads == 0)
+      {
+        countThreads = std::max(1u, boost::thread::hardware_concurrency());
+      }
+
+      boost::shared_ptr<RunnableWorkersPool> previous;
+
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+
+        previous = pool_;
+        pool_.reset();
+
+        countThreads_ = countThreads;
+        minimumPixels_ = minimumPixels;
+
+        if (countThreads > 1)
+        {
+          // The calling thread processes bands too
+          pool_.reset(new RunnableWorkersPool(countThreads - 1));
+        }
+      }
+
+      if (countThreads > 1)
+      {
+        LOG(INFO) << "Images with at least " << minimumPixels << " pixels are processed using "
+                  << countThreads << " threads";
+      }
+
+      // The previous pool (if any) is stopped outside of the mutex,
+      // once its pending operations are over
+    }
+
+
+    void Finalize()
+    {
+      boost::shared_ptr<RunnableWorkersPool> previous;
+
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        previous = pool_;
+        pool_.reset();
+        countThreads_ = 1;
+      }
+    }
+
+
+    unsigned int GetThreadsCount()
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      return countThreads_;
+    }
+
+
+    uint64_t GetMinimumPixels()
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      return minimumPixels_;
+    }
+
+
+    static void RunBands(RunnableWorkersPool& pool,
+                         unsigned int countThreads,
+                         IBandOperation& operation,
+                         unsigned int height,
+                         unsigned int countBands)
+    {
+      boost::shared_ptr<BandsJob> job(new BandsJob(operation, height, countBands));
+
+      for (unsigned int i = 1; i < countThreads; i++)
+      {
+        pool.Add(new BandsRunnable(job));
+      }
+
+      while (job->ProcessNextBand())
+      {
+      }
+
+      job->WaitAndCheck();
+    }
+
+
+    bool IsParallelizable(const ImageAccessor& image)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      return (pool_.get() != NULL &&
+              image.GetWidth() > 0 &&
+              image.GetHeight() > 1 &&
+              static_cast<uint64_t>(image.GetWidth()) * static_cast<uint64_t>(image.GetHeight()) >= minimumPixels_);
+    }
+
+
+    bool Apply(IBandOperation& operation,
+               const ImageAccessor& image)
+    {
+      boost::shared_ptr<RunnableWorkersPool> pool;
+      unsigned int countThreads;
+
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+
+        if (pool_.get() == NULL ||
+            image.GetWidth() == 0 ||
+            image.GetHeight() <= 1 ||
+            static_cast<uint64_t>(image.GetWidth()) * static_cast<uint64_t>(image.GetHeight()) < minimumPixels_)
+        {
+          return false;
+        }
+
+        pool = pool_;
+        countThreads = countThreads_;
+      }
+
+      const unsigned int countBands = std::min(image.GetHeight(), countThreads * BANDS_PER_THREAD);
+      RunBands(*pool, countThreads, operation, image.GetHeight(), countBands);
+      return true;
+    }
+
+
+    bool ApplyToItems(IBandOperation& operation,
+                      unsigned int countItems)
+    {
+      boost::shared_ptr<RunnableWorkersPool> pool;
+      unsigned int countThreads;
+
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+
+        if (pool_.get() == NULL ||
+            countItems <= 1)
+        {
+          return false;
+        }
+
+        pool = pool_;
+        countThreads = countThreads_;
+      }
+
+      // Items are typically expensive (e.g. decoding a compressed
+      // frame), so each band is made of one single item
+      RunBands(*pool, std::min(countThreads, countItems), operation, countItems, countItems);
+      return true;
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,93 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2019 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#pragma once
+
+#include "ImageAccessor.h"
+
+#include <boost/noncopyable.hpp>
+#include <stdint.h>
+
+namespace Orthanc
+{
+  /**
+   * Optional parallel execution of the pixel-wise operations of
+   * "ImageProcessing" on large images. The image is split into bands
+   * of rows, that are processed by a thread pool shared by all the
+   * callers. The calling thread processes bands as well, which means
+   * that an operation never waits for an available worker.
+   **/
+  namespace ParallelImageProcessing
+  {
+    class IBandOperation : public boost::noncopyable
+    {
+    public:
+      virtual ~IBandOperation()
+      {
+      }
+
+      // Processes the rows in the range [firstRow, endRow[. This
+      // method is invoked concurrently on disjoint ranges.
+      virtual void Apply(unsigned int firstRow,
+                         unsigned int endRow) = 0;
+    };
+
+    // If "countThreads" is 0, the number of CPU cores is used. If it
+    // is 1, the parallel execution is disabled. Images with less
+    // than "minimumPixels" pixels are processed sequentially.
+    void Initialize(unsigned int countThreads,
+                    uint64_t minimumPixels);
+
+    void Finalize();
+
+    unsigned int GetThreadsCount();
+
+    uint64_t GetMinimumPixels();
+
+    bool IsParallelizable(const ImageAccessor& image);
+
+    // Returns "false" (and does nothing) if the image is to be
+    // processed sequentially by the caller
+    bool Apply(IBandOperation& operation,
+               const ImageAccessor& image);
+
+    // Processes "countItems" independent items (e.g. the frames of a
+    // multi-frame image) in parallel, using the same thread pool. The
+    // operation receives ranges of item indices instead of ranges of
+    // rows. Returns "false" (and does nothing) if the items are to be
+    // processed sequentially by the caller.
+    bool ApplyToItems(IBandOperation& operation,
+                      unsigned int countItems);
+  }
+}
@@ -0,0 +1,179 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2019 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#pragma once
+
+#include <boost/math/special_functions/round.hpp>
+#include <limits>
+#include <stdint.h>
+#include <cstddef>
+
+
+namespace Orthanc
+{
+  /**
+   * Reference implementations of the kernels that process one row of
+   * pixels. They are used by "ImageProcessing" if no vectorized
+   * instruction set is available, and by "SimdKernels" to process
+   * the elements at the tail of the rows.
+   **/
+  namespace ScalarKernels
+  {
+    // Updates "minValue" and "maxValue", that must be initialized by
+    // the caller
+    template <typename PixelType>
+    void GetMinMax(PixelType& minValue,
+                          PixelType& maxValue,
+                          const PixelType* p,
+                          size_t count)
+    {
+      for (size_t i = 0; i < count; i++, p++)
+      {
+        if (*p < minValue)
+        {
+          minValue = *p;
+        }
+
+        if (*p > maxValue)
+        {
+          maxValue = *p;
+        }
+      }
+    }
+
+
+    template <typename PixelType,
+              bool UseRound>
+    void ShiftScale(PixelType* p,
+                           size_t count,
+                           float offset,
+                           float scaling)
+    {
+      const float minFloatValue = static_cast<float>(std::numeric_limits<PixelType>::min());
+      const float maxFloatValue = static_cast<float>(std::numeric_limits<PixelType>::max());
+      const PixelType minPixelValue = std::numeric_limits<PixelType>::min();
+      const PixelType maxPixelValue = std::numeric_limits<PixelType>::max();
+
+      for (size_t i = 0; i < count; i++, p++)
+      {
+        float v = (static_cast<float>(*p) + offset) * scaling;
+
+        if (v > maxFloatValue)
+        {
+          *p = maxPixelValue;
+        }
+        else if (v < minFloatValue)
+        {
+          *p = minPixelValue;
+        }
+        else if (UseRound)
+        {
+          // The "round" operation is very costly
+          *p = static_cast<PixelType>(boost::math::iround(v));
+        }
+        else
+        {
+          *p = static_cast<PixelType>(v);
+        }
+      }
+    }
+
+
+    template <typename PixelType>
+    void AddConstant(PixelType* p,
+                            size_t count,
+                            int64_t constant)
+    {
+      const int64_t minValue = std::numeric_limits<PixelType>::min();
+      const int64_t maxValue = std::numeric_limits<PixelType>::max();
+
+      for (size_t i = 0; i < count; i++, p++)
+      {
+        int64_t v = static_cast<int64_t>(*p) + constant;
+
+        if (v > maxValue)
+        {
+          *p = std::numeric_limits<PixelType>::max();
+        }
+        else if (v < minValue)
+        {
+          *p = std::numeric_limits<PixelType>::min();
+        }
+        else
+        {
+          *p = static_cast<PixelType>(v);
+        }
+      }
+    }
+
+
+    template <typename PixelType>
+    void Invert(PixelType* p,
+                       size_t count,
+                       PixelType maxValue)
+    {
+      for (size_t i = 0; i < count; i++, p++)
+      {
+        *p = maxValue - (*p);
+      }
+    }
+
+
+    // Conversion with saturation
+    template <typename TargetType, typename SourceType>
+    void Convert(TargetType* target,
+                        const SourceType* source,
+                        size_t count)
+    {
+      const TargetType minValue = std::numeric_limits<TargetType>::min();
+      const TargetType maxValue = std::numeric_limits<TargetType>::max();
+
+      for (size_t i = 0; i < count; i++, target++, source++)
+      {
+        if (static_cast<int32_t>(*source) < static_cast<int32_t>(minValue))
+        {
+          *target = minValue;
+        }
+        else if (static_cast<int32_t>(*source) > static_cast<int32_t>(maxValue))
+        {
+          *target = maxValue;
+        }
+        else
+        {
+          *target = static_cast<TargetType>(*source);
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,1178 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2019 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#include "../PrecompiledHeaders.h"
+#include "SimdKernels.h"
+
+#include "ScalarKernels.h"
+#include "../OrthancException.h"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+
+#if !defined(ORTHANC_SANDBOXED)
+#  error The macro ORTHANC_SANDBOXED must be defined
+#endif
+
+#if ORTHANC_SANDBOXED != 1
+#  include <boost/thread/once.hpp>
+#endif
+
+#if ORTHANC_ENABLE_SIMD == 1
+#  include <emmintrin.h>
+#  if defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+#    define ORTHANC_SIMD_AVX2 1
+#    define ORTHANC_TARGET_AVX2 __attribute__((target("avx2")))
+#    include <immintrin.h>
+#  elif defined(_MSC_VER) && _MSC_VER >= 1900
+#    define ORTHANC_SIMD_AVX2 1
+#    define ORTHANC_TARGET_AVX2
+#    include <immintrin.h>
+#    include <intrin.h>
+#  else
+#    define ORTHANC_SIMD_AVX2 0
+#  endif
+#else
+#  define ORTHANC_SIMD_AVX2 0
+#endif
+
+
+namespace Orthanc
+{
+  template <typename PixelType>
+  static void ShiftScaleScalar(PixelType* p,
+                               size_t count,
+                               float offset,
+                               float scaling,
+                               bool useRound)
+  {
+    if (useRound)
+    {
+      ScalarKernels::ShiftScale<PixelType, true>(p, count, offset, scaling);
+    }
+    else
+    {
+      ScalarKernels::ShiftScale<PixelType, false>(p, count, offset, scaling);
+    }
+  }
+
+
+  template <typename PixelType>
+  static int64_t ClampConstant(int64_t constant)
+  {
+    // Adding a constant whose magnitude is larger than the dynamic
+    // range saturates all the pixels
+    const int64_t range = (static_cast<int64_t>(std::numeric_limits<PixelType>::max()) -
+                           static_cast<int64_t>(std::numeric_limits<PixelType>::min()));
+
+    if (constant > range)
+    {
+      return range;
+    }
+    else if (constant < -range)
+    {
+      return -range;
+    }
+    else
+    {
+      return constant;
+    }
+  }
+
+
+
+#if ORTHANC_ENABLE_SIMD == 1
+
+  /**
+   * SSE2 implementations
+   **/
+
+  static inline __m128i ShiftScaleSse2(__m128i v,
+                                       __m128 offset,
+                                       __m128 scaling,
+                                       __m128 minValue,
+                                       __m128 maxValue,
+                                       bool useRound)
+  {
+    // Same order of the floating-point operations as the scalar version
+    __m128 f = _mm_mul_ps(_mm_add_ps(_mm_cvtepi32_ps(v), offset), scaling);
+    f = _mm_min_ps(_mm_max_ps(f, minValue), maxValue);
+
+    __m128i t = _mm_cvttps_epi32(f);
+
+    if (useRound)
+    {
+      // Round half away from zero, as "boost::math::iround()". The
+      // fractional part is exact, as |f| < 2^23.
+      __m128 fraction = _mm_sub_ps(f, _mm_cvtepi32_ps(t));
+      __m128i up = _mm_castps_si128(_mm_cmpge_ps(fraction, _mm_set1_ps(0.5f)));
+      __m128i down = _mm_castps_si128(_mm_cmple_ps(fraction, _mm_set1_ps(-0.5f)));
+      t = _mm_add_epi32(_mm_sub_epi32(t, up), down);  // Masks are equal to -1
+    }
+
+    return t;
+  }
+
+
+  static void GetMinMaxSse2(uint8_t& minValue,
+                            uint8_t& maxValue,
+                            const uint8_t* p,
+                            size_t count)
+  {
+    size_t i = 0;
+
+    if (count >= 16)
+    {
+      __m128i a = _mm_set1_epi8(static_cast<char>(minValue));
+      __m128i b = _mm_set1_epi8(static_cast<char>(maxValue));
+
+      for (; i + 16 <= count; i += 16)
+      {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        a = _mm_min_epu8(a, v);
+        b = _mm_max_epu8(b, v);
+      }
+
+      uint8_t x[16], y[16];
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(x), a);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(y), b);
+      ScalarKernels::GetMinMax(minValue, maxValue, x, 16);
+      ScalarKernels::GetMinMax(minValue, maxValue, y, 16);
+    }
+
+    ScalarKernels::GetMinMax(minValue, maxValue, p + i, count - i);
+  }
+
+
+  static void GetMinMaxSse2(int16_t& minValue,
+                            int16_t& maxValue,
+                            const int16_t* p,
+                            size_t count)
+  {
+    size_t i = 0;
+
+    if (count >= 8)
+    {
+      __m128i a = _mm_set1_epi16(minValue);
+      __m128i b = _mm_set1_epi16(maxValue);
+
+      for (; i + 8 <= count; i += 8)
+      {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        a = _mm_min_epi16(a, v);
+        b = _mm_max_epi16(b, v);
+      }
+
+      int16_t x[8], y[8];
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(x), a);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(y), b);
+      ScalarKernels::GetMinMax(minValue, maxValue, x, 8);
+      ScalarKernels::GetMinMax(minValue, maxValue, y, 8);
+    }
+
+    ScalarKernels::GetMinMax(minValue, maxValue, p + i, count - i);
+  }
+
+
+  static void GetMinMaxSse2(uint16_t& minValue,
+                            uint16_t& maxValue,
+                            const uint16_t* p,
+                            size_t count)
+  {
+    size_t i = 0;
+
+    if (count >= 8)
+    {
+      // SSE2 has no unsigned 16-bit min/max: Flip the sign bit to
+      // work with the signed comparisons
+      const __m128i bias = _mm_set1_epi16(static_cast<short>(0x8000));
+
+      __m128i a = _mm_xor_si128(_mm_set1_epi16(static_cast<short>(minValue)), bias);
+      __m128i b = _mm_xor_si128(_mm_set1_epi16(static_cast<short>(maxValue)), bias);
+
+      for (; i + 8 <= count; i += 8)
+      {
+        __m128i v = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i)), bias);
+        a = _mm_min_epi16(a, v);
+        b = _mm_max_epi16(b, v);
+      }
+
+      uint16_t x[8], y[8];
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(x), _mm_xor_si128(a, bias));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(y), _mm_xor_si128(b, bias));
+      ScalarKernels::GetMinMax(minValue, maxValue, x, 8);
+      ScalarKernels::GetMinMax(minValue, maxValue, y, 8);
+    }
+
+    ScalarKernels::GetMinMax(minValue, maxValue, p + i, count - i);
+  }
+
+
+  static void ShiftScaleSse2(uint8_t* p,
+                             size_t count,
+                             float offset,
+                             float scaling,
+                             bool useRound)
+  {
+    const __m128 o = _mm_set1_ps(offset);
+    const __m128 s = _mm_set1_ps(scaling);
+    const __m128 minValue = _mm_set1_ps(0.0f);
+    const __m128 maxValue = _mm_set1_ps(255.0f);
+    const __m128i zero = _mm_setzero_si128();
+
+    size_t i = 0;
+
+    for (; i + 16 <= count; i += 16)
+    {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+      __m128i lo = _mm_unpacklo_epi8(v, zero);
+      __m128i hi = _mm_unpackhi_epi8(v, zero);
+
+      __m128i a = ShiftScaleSse2(_mm_unpacklo_epi16(lo, zero), o, s, minValue, maxValue, useRound);
+      __m128i b = ShiftScaleSse2(_mm_unpackhi_epi16(lo, zero), o, s, minValue, maxValue, useRound);
+      __m128i c = ShiftScaleSse2(_mm_unpacklo_epi16(hi, zero), o, s, minValue, maxValue, useRound);
+      __m128i d = ShiftScaleSse2(_mm_unpackhi_epi16(hi, zero), o, s, minValue, maxValue, useRound);
+
+      __m128i r = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(p + i), r);
+    }
+
+    ShiftScaleScalar(p + i, count - i, offset, scaling, useRound);
+  }
+
+
+  static void ShiftScaleSse2(uint16_t* p,
+                             size_t count,
+                             float offset,
+                             float scaling,
+                             bool useRound)
+  {
+    const __m128 o = _mm_set1_ps(offset);
+    const __m128 s = _mm_set1_ps(scaling);
+    const __m128 minValue = _mm_set1_ps(0.0f);
+    const __m128 maxValue = _mm_set1_ps(65535.0f);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias32 = _mm_set1_epi32(32768);
+    const __m128i bias16 = _mm_set1_epi16(static_cast<short>(0x8000));
+
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+      __m128i a = ShiftScaleSse2(_mm_unpacklo_epi16(v, zero), o, s, minValue, maxValue, useRound);
+      __m128i b = ShiftScaleSse2(_mm_unpackhi_epi16(v, zero), o, s, minValue, maxValue, useRound);
+
+      // SSE2 has no unsigned saturated packing from 32 to 16 bits
+      __m128i r = _mm_packs_epi32(_mm_sub_epi32(a, bias32), _mm_sub_epi32(b, bias32));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(p + i), _mm_xor_si128(r, bias16));
+    }
+
+    ShiftScaleScalar(p + i, count - i, offset, scaling, useRound);
+  }
+
+
+  static void ShiftScaleSse2(int16_t* p,
+                             size_t count,
+                             float offset,
+                             float scaling,
+                             bool useRound)
+  {
+    const __m128 o = _mm_set1_ps(offset);
+    const __m128 s = _mm_set1_ps(scaling);
+    const __m128 minValue = _mm_set1_ps(-32768.0f);
+    const __m128 maxValue = _mm_set1_ps(32767.0f);
+
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+      __m128i a = ShiftScaleSse2(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16), o, s, minValue, maxValue, useRound);
+      __m128i b = ShiftScaleSse2(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16), o, s, minValue, maxValue, useRound);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(p + i), _mm_packs_epi32(a, b));
+    }
+
+    ShiftScaleScalar(p + i, count - i, offset, scaling, useRound);
+  }
+
+
+  static void AddConstantSse2(uint8_t* p,
+                              size_t count,
+                              int64_t constant)
+  {
+    constant = ClampConstant<uint8_t>(constant);
+
+    const bool add = (constant >= 0);
+    const __m128i c = _mm_set1_epi8(static_cast<char>(add ? constant : -constant));
+
+    size_t i = 0;
+
+    for (; i + 16 <= count; i += 16)
+    {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+      v = (add ? _mm_adds_epu8(v, c) : _mm_subs_epu8(v, c));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(p + i), v);
+    }
+
+    ScalarKernels::AddConstant(p + i, count - i, constant);
+  }
+
+
+  static void AddConstantSse2(uint16_t* p,
+                              size_t count,
+                              int64_t constant)
+  {
+    constant = ClampConstant<uint16_t>(constant);
+
+    const bool add = (constant >= 0);
+    const __m128i c = _mm_set1_epi16(static_cast<short>(add ? constant : -constant));
+
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+      v = (add ? _mm_adds_epu16(v, c) : _mm_subs_epu16(v, c));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(p + i), v);
+    }
+
+    ScalarKernels::AddConstant(p + i, count - i, constant);
+  }
+
+
+  static void AddConstantSse2(int16_t* p,
+                              size_t count,
+                              int64_t constant)
+  {
+    constant = ClampConstant<int16_t>(constant);
+
+    // Split the constant into chunks that fit into 16 bits, all with
+    // the same sign: Saturating the chunks one after the other gives
+    // the same result as saturating the whole sum
+    __m128i chunks[3];
+    size_t countChunks = 0;
+
+    for (int64_t remaining = constant; remaining != 0; countChunks++)
+    {
+      assert(countChunks < 3);
+      int64_t chunk = std::max(static_cast<int64_t>(-32768), std::min(static_cast<int64_t>(32767), remaining));
+      chunks[countChunks] = _mm_set1_epi16(static_cast<short>(chunk));
+      remaining -= chunk;
+    }
+
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+
+      for (size_t j = 0; j < countChunks; j++)
+      {
+        v = _mm_adds_epi16(v, chunks[j]);
+      }
+
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(p + i), v);
+    }
+
+    ScalarKernels::AddConstant(p + i, count - i, constant);
+  }
+
+
+  static void InvertSse2(uint8_t* p,
+                         size_t count,
+                         uint8_t maxValue)
+  {
+    const __m128i m = _mm_set1_epi8(static_cast<char>(maxValue));
+
+    size_t i = 0;
+
+    for (; i + 16 <= count; i += 16)
+    {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(p + i), _mm_sub_epi8(m, v));
+    }
+
+    ScalarKernels::Invert(p + i, count - i, maxValue);
+  }
+
+
+  static void InvertSse2(uint16_t* p,
+                         size_t count,
+                         uint16_t maxValue)
+  {
+    const __m128i m = _mm_set1_epi16(static_cast<short>(maxValue));
+
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(p + i), _mm_sub_epi16(m, v));
+    }
+
+    ScalarKernels::Invert(p + i, count - i, maxValue);
+  }
+
+
+  static void ConvertSse2(uint8_t* target,
+                          const uint16_t* source,
+                          size_t count)
+  {
+    const __m128i max = _mm_set1_epi16(255);
+
+    size_t i = 0;
+
+    for (; i + 16 <= count; i += 16)
+    {
+      __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+      __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i + 8));
+
+      // Unsigned "min(v, 255)", as SSE2 has no "_mm_min_epu16()"
+      a = _mm_subs_epu16(a, _mm_subs_epu16(a, max));
+      b = _mm_subs_epu16(b, _mm_subs_epu16(b, max));
+
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(target + i), _mm_packus_epi16(a, b));
+    }
+
+    ScalarKernels::Convert(target + i, source + i, count - i);
+  }
+
+
+  static void ConvertSse2(uint8_t* target,
+                          const int16_t* source,
+                          size_t count)
+  {
+    size_t i = 0;
+
+    for (; i + 16 <= count; i += 16)
+    {
+      __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+      __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i + 8));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(target + i), _mm_packus_epi16(a, b));
+    }
+
+    ScalarKernels::Convert(target + i, source + i, count - i);
+  }
+
+
+  static void ConvertSse2(uint16_t* target,
+                          const uint8_t* source,
+                          size_t count)
+  {
+    const __m128i zero = _mm_setzero_si128();
+
+    size_t i = 0;
+
+    for (; i + 16 <= count; i += 16)
+    {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(target + i), _mm_unpacklo_epi8(v, zero));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(target + i + 8), _mm_unpackhi_epi8(v, zero));
+    }
+
+    ScalarKernels::Convert(target + i, source + i, count - i);
+  }
+#endif
+
+
+
+#if ORTHANC_SIMD_AVX2 == 1
+
+  /**
+   * AVX2 implementations of the most time-consuming kernels. Note
+   * that the "unpack" and "pack" instructions work separately on the
+   * two 128-bit lanes, which preserves the order of the pixels if
+   * they are used in pairs.
+   **/
+
+  ORTHANC_TARGET_AVX2
+  static inline __m256i ShiftScaleAvx2(__m256i v,
+                                       __m256 offset,
+                                       __m256 scaling,
+                                       __m256 minValue,
+                                       __m256 maxValue,
+                                       bool useRound)
+  {
+    __m256 f = _mm256_mul_ps(_mm256_add_ps(_mm256_cvtepi32_ps(v), offset), scaling);
+    f = _mm256_min_ps(_mm256_max_ps(f, minValue), maxValue);
+
+    __m256i t = _mm256_cvttps_epi32(f);
+
+    if (useRound)
+    {
+      __m256 fraction = _mm256_sub_ps(f, _mm256_cvtepi32_ps(t));
+      __m256i up = _mm256_castps_si256(_mm256_cmp_ps(fraction, _mm256_set1_ps(0.5f), _CMP_GE_OQ));
+      __m256i down = _mm256_castps_si256(_mm256_cmp_ps(fraction, _mm256_set1_ps(-0.5f), _CMP_LE_OQ));
+      t = _mm256_add_epi32(_mm256_sub_epi32(t, up), down);
+    }
+
+    return t;
+  }
+
+
+  ORTHANC_TARGET_AVX2
+  static void GetMinMaxAvx2(uint8_t& minValue,
+                            uint8_t& maxValue,
+                            const uint8_t* p,
+                            size_t count)
+  {
+    size_t i = 0;
+
+    if (count >= 32)
+    {
+      __m256i a = _mm256_set1_epi8(static_cast<char>(minValue));
+      __m256i b = _mm256_set1_epi8(static_cast<char>(maxValue));
+
+      for (; i + 32 <= count; i += 32)
+      {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        a = _mm256_min_epu8(a, v);
+        b = _mm256_max_epu8(b, v);
+      }
+
+      uint8_t x[32], y[32];
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(x), a);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(y), b);
+      ScalarKernels::GetMinMax(minValue, maxValue, x, 32);
+      ScalarKernels::GetMinMax(minValue, maxValue, y, 32);
+    }
+
+    ScalarKernels::GetMinMax(minValue, maxValue, p + i, count - i);
+  }
+
+
+  ORTHANC_TARGET_AVX2
+  static void GetMinMaxAvx2(uint16_t& minValue,
+                            uint16_t& maxValue,
+                            const uint16_t* p,
+                            size_t count)
+  {
+    size_t i = 0;
+
+    if (count >= 16)
+    {
+      __m256i a = _mm256_set1_epi16(static_cast<short>(minValue));
+      __m256i b = _mm256_set1_epi16(static_cast<short>(maxValue));
+
+      for (; i + 16 <= count; i += 16)
+      {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        a = _mm256_min_epu16(a, v);
+        b = _mm256_max_epu16(b, v);
+      }
+
+      uint16_t x[16], y[16];
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(x), a);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(y), b);
+      ScalarKernels::GetMinMax(minValue, maxValue, x, 16);
+      ScalarKernels::GetMinMax(minValue, maxValue, y, 16);
+    }
+
+    ScalarKernels::GetMinMax(minValue, maxValue, p + i, count - i);
+  }
+
+
+  ORTHANC_TARGET_AVX2
+  static void GetMinMaxAvx2(int16_t& minValue,
+                            int16_t& maxValue,
+                            const int16_t* p,
+                            size_t count)
+  {
+    size_t i = 0;
+
+    if (count >= 16)
+    {
+      __m256i a = _mm256_set1_epi16(minValue);
+      __m256i b = _mm256_set1_epi16(maxValue);
+
+      for (; i + 16 <= count; i += 16)
+      {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        a = _mm256_min_epi16(a, v);
+        b = _mm256_max_epi16(b, v);
+      }
+
+      int16_t x[16], y[16];
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(x), a);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(y), b);
+      ScalarKernels::GetMinMax(minValue, maxValue, x, 16);
+      ScalarKernels::GetMinMax(minValue, maxValue, y, 16);
+    }
+
+    ScalarKernels::GetMinMax(minValue, maxValue, p + i, count - i);
+  }
+
+
+  ORTHANC_TARGET_AVX2
+  static void ShiftScaleAvx2(uint16_t* p,
+                             size_t count,
+                             float offset,
+                             float scaling,
+                             bool useRound)
+  {
+    const __m256 o = _mm256_set1_ps(offset);
+    const __m256 s = _mm256_set1_ps(scaling);
+    const __m256 minValue = _mm256_set1_ps(0.0f);
+    const __m256 maxValue = _mm256_set1_ps(65535.0f);
+    const __m256i zero = _mm256_setzero_si256();
+
+    size_t i = 0;
+
+    for (; i + 16 <= count; i += 16)
+    {
+      __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+      __m256i a = ShiftScaleAvx2(_mm256_unpacklo_epi16(v, zero), o, s, minValue, maxValue, useRound);
+      __m256i b = ShiftScaleAvx2(_mm256_unpackhi_epi16(v, zero), o, s, minValue, maxValue, useRound);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(p + i), _mm256_packus_epi32(a, b));
+    }
+
+    ShiftScaleScalar(p + i, count - i, offset, scaling, useRound);
+  }
+
+
+  ORTHANC_TARGET_AVX2
+  static void ShiftScaleAvx2(int16_t* p,
+                             size_t count,
+                             float offset,
+                             float scaling,
+                             bool useRound)
+  {
+    const __m256 o = _mm256_set1_ps(offset);
+    const __m256 s = _mm256_set1_ps(scaling);
+    const __m256 minValue = _mm256_set1_ps(-32768.0f);
+    const __m256 maxValue = _mm256_set1_ps(32767.0f);
+
+    size_t i = 0;
+
+    for (; i + 16 <= count; i += 16)
+    {
+      __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+      __m256i a = ShiftScaleAvx2(_mm256_srai_epi32(_mm256_unpacklo_epi16(v, v), 16), o, s, minValue, maxValue, useRound);
+      __m256i b = ShiftScaleAvx2(_mm256_srai_epi32(_mm256_unpackhi_epi16(v, v), 16), o, s, minValue, maxValue, useRound);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(p + i), _mm256_packs_epi32(a, b));
+    }
+
+    ShiftScaleScalar(p + i, count - i, offset, scaling, useRound);
+  }
+
+
+  ORTHANC_TARGET_AVX2
+  static void ConvertAvx2(uint8_t* target,
+                          const uint16_t* source,
+                          size_t count)
+  {
+    const __m256i max = _mm256_set1_epi16(255);
+
+    size_t i = 0;
+
+    for (; i + 32 <= count; i += 32)
+    {
+      __m256i a = _mm256_min_epu16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i)), max);
+      __m256i b = _mm256_min_epu16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i + 16)), max);
+
+      // Packing interleaves the lanes of "a" and "b": Restore the order
+      __m256i r = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xd8);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(target + i), r);
+    }
+
+    ScalarKernels::Convert(target + i, source + i, count - i);
+  }
+
+
+  ORTHANC_TARGET_AVX2
+  static void ConvertAvx2(uint8_t* target,
+                          const int16_t* source,
+                          size_t count)
+  {
+    size_t i = 0;
+
+    for (; i + 32 <= count; i += 32)
+    {
+      __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i));
+      __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i + 16));
+      __m256i r = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xd8);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(target + i), r);
+    }
+
+    ScalarKernels::Convert(target + i, source + i, count - i);
+  }
+#endif
+
+
+
+  /**
+   * Runtime dispatch
+   **/
+
+  static SimdInstructionSet DetectInstructionSet()
+  {
+#if ORTHANC_ENABLE_SIMD == 1
+#  if ORTHANC_SIMD_AVX2 == 1
+#    if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+
+    if (info[0] >= 7)
+    {
+      __cpuid(info, 1);
+      const bool osxsave = ((info[2] & (1 << 27)) != 0);
+
+      __cpuidex(info, 7, 0);
+      const bool avx2 = ((info[1] & (1 << 5)) != 0);
+
+      // Check that the OS saves the YMM registers
+      if (osxsave &&
+          avx2 &&
+          (_xgetbv(0) & 6) == 6)
+      {
+        return SimdInstructionSet_AVX2;
+      }
+    }
+#    else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+      return SimdInstructionSet_AVX2;
+    }
+#    endif
+#  endif
+
+    // SSE2 is part of the baseline of all the x86 targets for which
+    // "ORTHANC_ENABLE_SIMD" is automatically set
+    return SimdInstructionSet_SSE2;
+#else
+    return SimdInstructionSet_None;
+#endif
+  }
+
+
+  static SimdInstructionSet supportedInstructionSet_ = SimdInstructionSet_None;
+  static SimdInstructionSet instructionSet_ = SimdInstructionSet_None;
+
+  static void InitializeInstructionSet()
+  {
+    supportedInstructionSet_ = DetectInstructionSet();
+    instructionSet_ = supportedInstructionSet_;
+  }
+
+#if ORTHANC_SANDBOXED == 1
+  static bool isInitialized_ = false;
+#else
+  static boost::once_flag initialized_ = BOOST_ONCE_INIT;
+#endif
+
+  // The CPU is only queried once, on the first use of the kernels,
+  // which avoids depending on the order of the static initializations
+  static SimdInstructionSet GetActiveInstructionSet()
+  {
+#if ORTHANC_SANDBOXED == 1
+    // No thread in sandboxed environments
+    if (!isInitialized_)
+    {
+      InitializeInstructionSet();
+      isInitialized_ = true;
+    }
+#else
+    boost::call_once(InitializeInstructionSet, initialized_);
+#endif
+
+    return instructionSet_;
+  }
+
+
+  namespace SimdKernels
+  {
+    SimdInstructionSet GetSupportedInstructionSet()
+    {
+      GetActiveInstructionSet();
+      return supportedInstructionSet_;
+    }
+
+
+    SimdInstructionSet GetInstructionSet()
+    {
+      return GetActiveInstructionSet();
+    }
+
+
+    void SetInstructionSet(SimdInstructionSet instructionSet)
+    {
+      if (static_cast<int>(instructionSet) > static_cast<int>(GetSupportedInstructionSet()))
+      {
+        throw OrthancException(ErrorCode_NotImplemented,
+                               std::string("This CPU does not support the instruction set: ") +
+                               EnumerationToString(instructionSet));
+      }
+
+      instructionSet_ = instructionSet;
+    }
+
+
+    bool IsEnabled()
+    {
+      return GetActiveInstructionSet() != SimdInstructionSet_None;
+    }
+
+
+    const char* EnumerationToString(SimdInstructionSet instructionSet)
+    {
+      switch (instructionSet)
+      {
+        case SimdInstructionSet_None:
+          return "None";
+
+        case SimdInstructionSet_SSE2:
+          return "SSE2";
+
+        case SimdInstructionSet_AVX2:
+          return "AVX2";
+
+        default:
+          throw OrthancException(ErrorCode_ParameterOutOfRange);
+      }
+    }
+
+
+    void GetMinMax(uint8_t& minValue,
+                   uint8_t& maxValue,
+                   const uint8_t* p,
+                   size_t count)
+    {
+      switch (GetActiveInstructionSet())
+      {
+#if ORTHANC_SIMD_AVX2 == 1
+        case SimdInstructionSet_AVX2:
+          GetMinMaxAvx2(minValue, maxValue, p, count);
+          break;
+#endif
+
+#if ORTHANC_ENABLE_SIMD == 1
+        case SimdInstructionSet_SSE2:
+          GetMinMaxSse2(minValue, maxValue, p, count);
+          break;
+#endif
+
+        default:
+          ScalarKernels::GetMinMax(minValue, maxValue, p, count);
+      }
+    }
+
+
+    void GetMinMax(uint16_t& minValue,
+                   uint16_t& maxValue,
+                   const uint16_t* p,
+                   size_t count)
+    {
+      switch (GetActiveInstructionSet())
+      {
+#if ORTHANC_SIMD_AVX2 == 1
+        case SimdInstructionSet_AVX2:
+          GetMinMaxAvx2(minValue, maxValue, p, count);
+          break;
+#endif
+
+#if ORTHANC_ENABLE_SIMD == 1
+        case SimdInstructionSet_SSE2:
+          GetMinMaxSse2(minValue, maxValue, p, count);
+          break;
+#endif
+
+        default:
+          ScalarKernels::GetMinMax(minValue, maxValue, p, count);
+      }
+    }
+
+
+    void GetMinMax(int16_t& minValue,
+                   int16_t& maxValue,
+                   const int16_t* p,
+                   size_t count)
+    {
+      switch (GetActiveInstructionSet())
+      {
+#if ORTHANC_SIMD_AVX2 == 1
+        case SimdInstructionSet_AVX2:
+          GetMinMaxAvx2(minValue, maxValue, p, count);
+          break;
+#endif
+
+#if ORTHANC_ENABLE_SIMD == 1
+        case SimdInstructionSet_SSE2:
+          GetMinMaxSse2(minValue, maxValue, p, count);
+          break;
+#endif
+
+        default:
+          ScalarKernels::GetMinMax(minValue, maxValue, p, count);
+      }
+    }
+
+
+    void ShiftScale(uint8_t* p,
+                    size_t count,
+                    float offset,
+                    float scaling,
+                    bool useRound)
+    {
+      switch (GetActiveInstructionSet())
+      {
+#if ORTHANC_ENABLE_SIMD == 1
+        case SimdInstructionSet_AVX2:  // No specific AVX2 kernel
+        case SimdInstructionSet_SSE2:
+          ShiftScaleSse2(p, count, offset, scaling, useRound);
+          break;
+#endif
+
+        default:
+          ShiftScaleScalar(p, count, offset, scaling, useRound);
+      }
+    }
+
+
+    void ShiftScale(uint16_t* p,
+                    size_t count,
+                    float offset,
+                    float scaling,
+                    bool useRound)
+    {
+      switch (GetActiveInstructionSet())
+      {
+#if ORTHANC_SIMD_AVX2 == 1
+        case SimdInstructionSet_AVX2:
+          ShiftScaleAvx2(p, count, offset, scaling, useRound);
+          break;
+#endif
+
+#if ORTHANC_ENABLE_SIMD == 1
+        case SimdInstructionSet_SSE2:
+          ShiftScaleSse2(p, count, offset, scaling, useRound);
+          break;
+#endif
+
+        default:
+          ShiftScaleScalar(p, count, offset, scaling, useRound);
+      }
+    }
+
+
+    void ShiftScale(int16_t* p,
+                    size_t count,
+                    float offset,
+                    float scaling,
+                    bool useRound)
+    {
+      switch (GetActiveInstructionSet())
+      {
+#if ORTHANC_SIMD_AVX2 == 1
+        case SimdInstructionSet_AVX2:
+          ShiftScaleAvx2(p, count, offset, scaling, useRound);
+          break;
+#endif
+
+#if ORTHANC_ENABLE_SIMD == 1
+        case SimdInstructionSet_SSE2:
+          ShiftScaleSse2(p, count, offset, scaling, useRound);
+          break;
+#endif
+
+        default:
+          ShiftScaleScalar(p, count, offset, scaling, useRound);
+      }
+    }
+
+
+    void AddConstant(uint8_t* p,
+                     size_t count,
+                     int64_t constant)
+    {
+      switch (GetActiveInstructionSet())
+      {
+#if ORTHANC_ENABLE_SIMD == 1
+        case SimdInstructionSet_AVX2:  // No specific AVX2 kernel
+        case SimdInstructionSet_SSE2:
+          AddConstantSse2(p, count, constant);
+          break;
+#endif
+
+        default:
+          ScalarKernels::AddConstant(p, count, constant);
+      }
+    }
+
+
+    void AddConstant(uint16_t* p,
+                     size_t count,
+                     int64_t constant)
+    {
+      switch (GetActiveInstructionSet())
+      {
+#if ORTHANC_ENABLE_SIMD == 1
+        case SimdInstructionSet_AVX2:  // No specific AVX2 kernel
+        case SimdInstructionSet_SSE2:
+          AddConstantSse2(p, count, constant);
+          break;
+#endif
+
+        default:
+          ScalarKernels::AddConstant(p, count, constant);
+      }
+    }
+
+
+    void AddConstant(int16_t* p,
+                     size_t count,
+                     int64_t constant)
+    {
+      switch (GetActiveInstructionSet())
+      {
+#if ORTHANC_ENABLE_SIMD == 1
+        case SimdInstructionSet_AVX2:  // No specific AVX2 kernel
+        case SimdInstructionSet_SSE2:
+          AddConstantSse2(p, count, constant);
+          break;
+#endif
+
+        default:
+          ScalarKernels::AddConstant(p, count, constant);
+      }
+    }
+
+
+    void Invert(uint8_t* p,
+                size_t count,
+                uint8_t maxValue)
+    {
+      switch (GetActiveInstructionSet())
+      {
+#if ORTHANC_ENABLE_SIMD == 1
+        case SimdInstructionSet_AVX2:  // No specific AVX2 kernel
+        case SimdInstructionSet_SSE2:
+          InvertSse2(p, count, maxValue);
+          break;
+#endif
+
+        default:
+          ScalarKernels::Invert(p, count, maxValue);
+      }
+    }
+
+
+    void Invert(uint16_t* p,
+                size_t count,
+                uint16_t maxValue)
+    {
+      switch (GetActiveInstructionSet())
+      {
+#if ORTHANC_ENABLE_SIMD == 1
+        case SimdInstructionSet_AVX2:  // No specific AVX2 kernel
+        case SimdInstructionSet_SSE2:
+          InvertSse2(p, count, maxValue);
+          break;
+#endif
+
+        default:
+          ScalarKernels::Invert(p, count, maxValue);
+      }
+    }
+
+
+    void Convert(uint8_t* target,
+                 const uint16_t* source,
+                 size_t count)
+    {
+      switch (GetActiveInstructionSet())
+      {
+#if ORTHANC_SIMD_AVX2 == 1
+        case SimdInstructionSet_AVX2:
+          ConvertAvx2(target, source, count);
+          break;
+#endif
+
+#if ORTHANC_ENABLE_SIMD == 1
+        case SimdInstructionSet_SSE2:
+          ConvertSse2(target, source, count);
+          break;
+#endif
+
+        default:
+          ScalarKernels::Convert(target, source, count);
+      }
+    }
+
+
+    void Convert(uint8_t* target,
+                 const int16_t* source,
+                 size_t count)
+    {
+      switch (GetActiveInstructionSet())
+      {
+#if ORTHANC_SIMD_AVX2 == 1
+        case SimdInstructionSet_AVX2:
+          ConvertAvx2(target, source, count);
+          break;
+#endif
+
+#if ORTHANC_ENABLE_SIMD == 1
+        case SimdInstructionSet_SSE2:
+          ConvertSse2(target, source, count);
+          break;
+#endif
+
+        default:
+          ScalarKernels::Convert(target, source, count);
+      }
+    }
+
+
+    void Convert(uint16_t* target,
+                 const uint8_t* source,
+                 size_t count)
+    {
+      switch (GetActiveInstructionSet())
+      {
+#if ORTHANC_ENABLE_SIMD == 1
+        case SimdInstructionSet_AVX2:  // No specific AVX2 kernel
+        case SimdInstructionSet_SSE2:
+          ConvertSse2(target, source, count);
+          break;
+#endif
+
+        default:
+          ScalarKernels::Convert(target, source, count);
+      }
+    }
+  }
+}
@@ -0,0 +1,154 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2019 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#pragma once
+
+#include <stdint.h>
+#include <cstddef>
+
+#if !defined(ORTHANC_ENABLE_SIMD)
+#  if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    define ORTHANC_ENABLE_SIMD 1
+#  else
+#    define ORTHANC_ENABLE_SIMD 0
+#  endif
+#endif
+
+
+namespace Orthanc
+{
+  enum SimdInstructionSet
+  {
+    SimdInstructionSet_None,
+    SimdInstructionSet_SSE2,
+    SimdInstructionSet_AVX2
+  };
+
+
+  /**
+   * Vectorized kernels that are used by "ImageProcessing" on the
+   * hot paths of the rendering of the frames. Each kernel processes
+   * one row of pixels, and produces exactly the same results as the
+   * scalar implementation. The instruction set is selected at
+   * runtime, depending on the capabilities of the CPU.
+   **/
+  namespace SimdKernels
+  {
+    // Instruction set that is supported by both the compiler and the CPU
+    SimdInstructionSet GetSupportedInstructionSet();
+
+    SimdInstructionSet GetInstructionSet();
+
+    // Mostly useful for benchmarks and unit tests. Throws if the
+    // instruction set is not supported. Must not be called while
+    // images are being processed by other threads.
+    void SetInstructionSet(SimdInstructionSet instructionSet);
+
+    bool IsEnabled();
+
+    const char* EnumerationToString(SimdInstructionSet instructionSet);
+
+    // The min/max kernels update "minValue" and "maxValue", that must
+    // be initialized by the caller
+    void GetMinMax(uint8_t& minValue,
+                   uint8_t& maxValue,
+                   const uint8_t* p,
+                   size_t count);
+
+    void GetMinMax(uint16_t& minValue,
+                   uint16_t& maxValue,
+                   const uint16_t* p,
+                   size_t count);
+
+    void GetMinMax(int16_t& minValue,
+                   int16_t& maxValue,
+                   const int16_t* p,
+                   size_t count);
+
+    // Computes "(p + offset) * scaling", with saturation. The rounding
+    // is done half away from zero, as "boost::math::iround()".
+    void ShiftScale(uint8_t* p,
+                    size_t count,
+                    float offset,
+                    float scaling,
+                    bool useRound);
+
+    void ShiftScale(uint16_t* p,
+                    size_t count,
+                    float offset,
+                    float scaling,
+                    bool useRound);
+
+    void ShiftScale(int16_t* p,
+                    size_t count,
+                    float offset,
+                    float scaling,
+                    bool useRound);
+
+    // Adds a constant, with saturation
+    void AddConstant(uint8_t* p,
+                     size_t count,
+                     int64_t constant);
+
+    void AddConstant(uint16_t* p,
+                     size_t count,
+                     int64_t constant);
+
+    void AddConstant(int16_t* p,
+                     size_t count,
+                     int64_t constant);
+
+    // Computes "maxValue - p", with wrap-around
+    void Invert(uint8_t* p,
+                size_t count,
+                uint8_t maxValue);
+
+    void Invert(uint16_t* p,
+                size_t count,
+                uint16_t maxValue);
+
+    // Conversions with saturation
+    void Convert(uint8_t* target,
+                 const uint16_t* source,
+                 size_t count);
+
+    void Convert(uint8_t* target,
+                 const int16_t* source,
+                 size_t count);
+
+    void Convert(uint16_t* target,
+                 const uint8_t* source,
+                 size_t count);
+  }
+}
@@ -0,0 +1,63 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2019 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+
+#include <boost/noncopyable.hpp>
+
+namespace Orthanc
+{
+  /**
+   * Optional interface that can be implemented by a job, besides
+   * "IJob", if its work can be split into independent work items
+   * (New in Orthanc 1.5.7). While one worker of the JobsEngine runs
+   * the "Step()" method of such a job, the idle workers can execute
+   * its pending work items concurrently. The JobsEngine waits for all
+   * these work items to be over before calling "IJob::Stop()".
+   **/
+  class IParallelJob : public boost::noncopyable
+  {
+  public:
+    virtual ~IParallelJob()
+    {
+    }
+
+    // Executes one of the pending work items of the job, if any, and
+    // returns "false" iff no work item is currently available. This
+    // method is invoked concurrently with "IJob::Step()", and with
+    // the methods that report the status of the job ("GetProgress()",
+    // "GetPublicContent()" and "Serialize()"). It must not throw
+    // exceptions: Failures must be reported by the next "Step()".
+    virtual bool ExecuteWorkItem() = 0;
+  };
+}
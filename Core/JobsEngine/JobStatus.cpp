@@ -69,7 +69,13 @@ namespace Orthanc
     job.GetJobType(jobType_);
     job.GetPublicContent(publicContent_);
 
-    hasSerialized_ = job.Serialize(serialized_);
+    boost::shared_ptr<Json::Value> serialized(new Json::Value);
+    hasSerialized_ = job.Serialize(*serialized);
+
+    if (hasSerialized_)
+    {
+      serialized_ = serialized;
+    }
   }
 
 
@@ -81,7 +87,8 @@ namespace Orthanc
     }
     else
     {
-      return serialized_;
+      assert(serialized_.get() != NULL);
+      return *serialized_;
     }
   }
 }
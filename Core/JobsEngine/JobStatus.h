@@ -35,6 +35,8 @@
 
 #include "IJob.h"
 
+#include <boost/shared_ptr.hpp>
+
 namespace Orthanc
 {
   class JobStatus
@@ -44,10 +46,13 @@ namespace Orthanc
     float          progress_;
     std::string    jobType_;
     Json::Value    publicContent_;
-    Json::Value    serialized_;
     bool           hasSerialized_;
     std::string    details_;
 
+    // The serialized job is immutable, and shared between the copies
+    // of the status, as it can be large (new in Orthanc 1.5.7)
+    boost::shared_ptr<const Json::Value>  serialized_;
+
   public:
     JobStatus();
 
@@ -48,6 +48,124 @@ namespace Orthanc
   }
   
   
+  void JobsEngine::OpenToHelpers(IJob& job)
+  {
+    IParallelJob* parallel = dynamic_cast<IParallelJob*>(&job);
+
+    if (parallel != NULL)
+    {
+      boost::mutex::scoped_lock lock(helpersMutex_);
+
+      HelpedJob& helped = helpedJobs_[parallel];
+      helped.helpers_ = 0;
+      helped.isOpen_ = true;
+    }
+  }
+
+
+  void JobsEngine::CloseToHelpers(IJob& job)
+  {
+    IParallelJob* parallel = dynamic_cast<IParallelJob*>(&job);
+
+    if (parallel != NULL)
+    {
+      boost::mutex::scoped_lock lock(helpersMutex_);
+
+      HelpedJobs::iterator found = helpedJobs_.find(parallel);
+      if (found == helpedJobs_.end())
+      {
+        return;  // Already closed
+      }
+
+      // Prevent new helpers from entering the job, then wait for the
+      // work items that are being executed to be over
+      found->second.isOpen_ = false;
+
+      while (found->second.helpers_ > 0)
+      {
+        helperDone_.wait(lock);
+      }
+
+      helpedJobs_.erase(found);
+
+      if (lastHelpedJob_ == parallel)
+      {
+        lastHelpedJob_ = NULL;
+      }
+    }
+  }
+
+
+  bool JobsEngine::HelpRunningJob()
+  {
+    size_t attempts;
+
+    {
+      boost::mutex::scoped_lock lock(helpersMutex_);
+      attempts = helpedJobs_.size();
+    }
+
+    for (size_t i = 0; i < attempts; i++)
+    {
+      IParallelJob* job = NULL;
+
+      {
+        // Round-robin between the jobs that accept helpers
+        boost::mutex::scoped_lock lock(helpersMutex_);
+
+        HelpedJobs::iterator it = (lastHelpedJob_ == NULL ?
+                                   helpedJobs_.begin() :
+                                   helpedJobs_.upper_bound(lastHelpedJob_));
+
+        for (size_t j = 0; j < helpedJobs_.size() && job == NULL; j++)
+        {
+          if (it == helpedJobs_.end())
+          {
+            it = helpedJobs_.begin();
+          }
+
+          if (it->second.isOpen_)
+          {
+            job = it->first;
+            it->second.helpers_++;
+          }
+          else
+          {
+            ++it;
+          }
+        }
+
+        if (job == NULL)
+        {
+          return false;
+        }
+
+        lastHelpedJob_ = job;
+      }
+
+      bool done = job->ExecuteWorkItem();
+
+      {
+        boost::mutex::scoped_lock lock(helpersMutex_);
+
+        HelpedJobs::iterator found = helpedJobs_.find(job);
+        assert(found != helpedJobs_.end() &&
+               found->second.helpers_ > 0);
+        found->second.helpers_--;
+      }
+
+      helperDone_.notify_all();
+
+      if (done)
+      {
+        return true;
+      }
+    }
+
+    return false;
+  }
+  
+  
   bool JobsEngine::ExecuteStep(JobsRegistry::RunningJob& running,
                                size_t workerIndex)
   {
@@ -55,6 +173,7 @@ namespace Orthanc
 
     if (running.IsPauseScheduled())
     {
+      CloseToHelpers(running.GetJob());
       running.GetJob().Stop(JobStopReason_Paused);
       running.MarkPause();
       return false;
@@ -62,6 +181,7 @@ namespace Orthanc
 
     if (running.IsCancelScheduled())
     {
+      CloseToHelpers(running.GetJob());
       running.GetJob().Stop(JobStopReason_Canceled);
       running.MarkCanceled();
       return false;
@@ -86,6 +206,12 @@ namespace Orthanc
       result = JobStepResult::Failure(ErrorCode_InternalError, NULL);
     }
 
+    if (result.GetCode() != JobStepCode_Continue)
+    {
+      // The work items must be over before stopping the job
+      CloseToHelpers(running.GetJob());
+    }
+
     switch (result.GetCode())
     {
       case JobStepCode_Success:
@@ -137,6 +263,14 @@ namespace Orthanc
 
     while (engine->IsRunning())
     {
+      // If no job is pending, help the running jobs that can execute
+      // their work items concurrently
+      if (!engine->GetRegistry().HasPendingJobs() &&
+          engine->HelpRunningJob())
+      {
+        continue;
+      }
+
       JobsRegistry::RunningJob running(engine->GetRegistry(), engine->threadSleep_);
 
       if (running.IsValid())
@@ -144,6 +278,8 @@ namespace Orthanc
         LOG(INFO) << "Executing job with priority " << running.GetPriority()
                   << " in worker thread " << workerIndex << ": " << running.GetId();
 
+        engine->OpenToHelpers(running.GetJob());
+
         while (engine->IsRunning())
         {
           if (!engine->ExecuteStep(running, workerIndex))
@@ -151,6 +287,9 @@ namespace Orthanc
             break;
           }
         }
+
+        // No-op if the job has reached a final state
+        engine->CloseToHelpers(running.GetJob());
       }
     }      
   }
@@ -160,7 +299,8 @@ namespace Orthanc
     state_(State_Setup),
     registry_(new JobsRegistry(maxCompletedJobs)),
     threadSleep_(200),
-    workers_(1)
+    workers_(1),
+    lastHelpedJob_(NULL)
   {
   }
 
@@ -220,6 +360,23 @@ namespace Orthanc
   }
 
 
+  void JobsEngine::LoadRegistryFromRecords(IJobUnserializer& unserializer,
+                                           const JobsRegistry::SerializedJobs& records)
+  {
+    boost::mutex::scoped_lock lock(stateMutex_);
+      
+    if (state_ != State_Setup)
+    {
+      // Can only be invoked before calling "Start()"
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    assert(registry_.get() != NULL);
+    const size_t maxCompletedJobs = registry_->GetMaxCompletedJobs();
+    registry_.reset(new JobsRegistry(unserializer, records, maxCompletedJobs));
+  }
+
+
   void JobsEngine::SetWorkersCount(size_t count)
   {
     boost::mutex::scoped_lock lock(stateMutex_);
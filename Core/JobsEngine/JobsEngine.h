@@ -33,9 +33,11 @@
 
 #pragma once
 
+#include "IParallelJob.h"
 #include "JobsRegistry.h"
 
 #include <boost/thread.hpp>
+#include <map>
 
 namespace Orthanc
 {
@@ -50,6 +52,15 @@ namespace Orthanc
       State_Done
     };
 
+    struct HelpedJob
+    {
+      unsigned int  helpers_;   // Number of workers in "ExecuteWorkItem()"
+      bool          isOpen_;
+    };
+
+    // Running jobs whose work items can be executed by idle workers
+    typedef std::map<IParallelJob*, HelpedJob>  HelpedJobs;
+
     boost::mutex                 stateMutex_;
     State                        state_;
     std::auto_ptr<JobsRegistry>  registry_;
@@ -57,7 +68,18 @@ namespace Orthanc
     unsigned int                 threadSleep_;
     std::vector<boost::thread*>  workers_;
 
+    boost::mutex                 helpersMutex_;
+    boost::condition_variable    helperDone_;
+    HelpedJobs                   helpedJobs_;
+    IParallelJob*                lastHelpedJob_;
+
     bool IsRunning();
+
+    void OpenToHelpers(IJob& job);
+
+    void CloseToHelpers(IJob& job);
+
+    bool HelpRunningJob();
     
     bool ExecuteStep(JobsRegistry::RunningJob& running,
                      size_t workerIndex);
@@ -80,6 +102,10 @@ namespace Orthanc
     void LoadRegistryFromString(IJobUnserializer& unserializer,
                                 const std::string& serialized);
 
+    // The "unserializer" must live as long as the jobs engine
+    void LoadRegistryFromRecords(IJobUnserializer& unserializer,
+                                 const JobsRegistry::SerializedJobs& records);
+
     void SetWorkersCount(size_t count);
 
     void SetThreadSleep(unsigned int sleep);
@@ -34,11 +34,16 @@
 #include "../PrecompiledHeaders.h"
 #include "JobsRegistry.h"
 
+#include "ITargetedJob.h"
 #include "../Logging.h"
 #include "../OrthancException.h"
 #include "../Toolbox.h"
 #include "../SerializationToolbox.h"
 
+#include <algorithm>
+#include <json/reader.h>
+#include <json/writer.h>
+
 namespace Orthanc
 {
   static const char* STATE = "State";
@@ -50,6 +55,83 @@ namespace Orthanc
   static const char* CREATION_TIME = "CreationTime";
   static const char* LAST_CHANGE_TIME = "LastChangeTime";
   static const char* RUNTIME = "Runtime";
+  static const char* DEPENDENCIES = "Dependencies";
+
+  // Increment of the virtual time of a class of jobs with weight 1,
+  // each time one of its jobs is started (stride scheduling)
+  static const uint64_t STRIDE = 1 << 20;
+
+
+  namespace
+  {
+    // Placeholder for a job whose lazy unserialization has failed: It
+    // fails as soon as it is executed, but it keeps its original
+    // content so that the record of the job is not lost
+    class UnserializationFailureJob : public IJob
+    {
+    private:
+      std::string  jobType_;
+      Json::Value  serialized_;
+      ErrorCode    error_;
+      std::string  details_;
+
+    public:
+      UnserializationFailureJob(const std::string& jobType,
+                                const Json::Value& serialized,
+                                const OrthancException& e) :
+        jobType_(jobType),
+        serialized_(serialized),
+        error_(e.GetErrorCode()),
+        details_(e.What())
+      {
+      }
+
+      virtual void Start()
+      {
+      }
+    
+      virtual JobStepResult Step()
+      {
+        return JobStepResult::Failure(error_, details_.c_str());
+      }
+
+      virtual void Reset()
+      {
+      }
+
+      virtual void Stop(JobStopReason reason)
+      {
+      }
+
+      virtual float GetProgress()
+      {
+        return 0;
+      }
+
+      virtual void GetJobType(std::string& target)
+      {
+        target = jobType_;
+      }
+    
+      virtual void GetPublicContent(Json::Value& value)
+      {
+        value = Json::objectValue;
+      }
+
+      virtual bool Serialize(Json::Value& value)
+      {
+        value = serialized_;
+        return true;
+      }
+
+      virtual bool GetOutput(std::string& output,
+                             MimeType& mime,
+                             const std::string& key)
+      {
+        return false;
+      }
+    };
+  }
   
 
   class JobsRegistry::JobHandler : public boost::noncopyable
@@ -58,7 +140,9 @@ namespace Orthanc
     std::string                       id_;
     JobState                          state_;
     std::string                       jobType_;
-    std::auto_ptr<IJob>               job_;
+    std::auto_ptr<IJob>               job_;  // NULL until lazily unserialized
+    IJobUnserializer*                 unserializer_;
+    Json::Value                       serializedJob_;
     int                               priority_;  // "+inf()" means highest priority
     boost::posix_time::ptime          creationTime_;
     boost::posix_time::ptime          lastStateChangeTime_;
@@ -67,6 +151,11 @@ namespace Orthanc
     bool                              pauseScheduled_;
     bool                              cancelScheduled_;
     JobStatus                         lastStatus_;
+    JobClass*                         jobClass_;  // NULL until first enqueued
+    bool                              hasTarget_;
+    std::string                       target_;
+    std::set<std::string>             dependencies_;  // Jobs that have not succeeded yet
+    CompletedJobs::iterator           completedPosition_;  // Only valid if completed
 
     void Touch()
     {
@@ -94,13 +183,16 @@ namespace Orthanc
       id_(Toolbox::GenerateUuid()),
       state_(JobState_Pending),
       job_(job),
+      unserializer_(NULL),
       priority_(priority),
       creationTime_(boost::posix_time::microsec_clock::universal_time()),
       lastStateChangeTime_(creationTime_),
       runtime_(boost::posix_time::milliseconds(0)),
       retryTime_(creationTime_),
       pauseScheduled_(false),
-      cancelScheduled_(false)
+      cancelScheduled_(false),
+      jobClass_(NULL),
+      hasTarget_(false)
     {
       if (job == NULL)
       {
@@ -118,9 +210,91 @@ namespace Orthanc
       return id_;
     }
 
-    IJob& GetJob() const
+    const std::string& GetJobType() const
+    {
+      return jobType_;
+    }
+
+    // Must not be called while the job is running, as the job itself
+    // is accessed the first time
+    const std::string& GetTarget()
+    {
+      if (!hasTarget_)
+      {
+        ITargetedJob* targeted = dynamic_cast<ITargetedJob*>(&GetJob());
+        if (targeted != NULL)
+        {
+          targeted->GetTarget(target_);
+        }
+
+        hasTarget_ = true;
+      }
+
+      return target_;
+    }
+
+    JobClass* GetClass() const
+    {
+      return jobClass_;
+    }
+
+    const std::set<std::string>& GetDependencies() const
+    {
+      return dependencies_;
+    }
+
+    void SetDependencies(const std::set<std::string>& dependencies)
+    {
+      dependencies_ = dependencies;
+    }
+
+    void RemoveDependency(const std::string& id)
+    {
+      dependencies_.erase(id);
+    }
+
+    const CompletedJobs::iterator& GetCompletedPosition() const
+    {
+      return completedPosition_;
+    }
+
+    void SetCompletedPosition(const CompletedJobs::iterator& position)
     {
-      assert(job_.get() != NULL);
+      completedPosition_ = position;
+    }
+
+    void SetClass(JobClass& jobClass)
+    {
+      jobClass_ = &jobClass;
+    }
+
+    IJob& GetJob()
+    {
+      if (job_.get() == NULL)
+      {
+        assert(unserializer_ != NULL);
+
+        try
+        {
+          job_.reset(unserializer_->UnserializeJob(serializedJob_));
+          if (job_.get() == NULL)
+          {
+            throw OrthancException(ErrorCode_NullPointer);
+          }
+
+          job_->Start();
+        }
+        catch (OrthancException& e)
+        {
+          LOG(ERROR) << "Cannot unserialize job " << id_ << " of type "
+                     << jobType_ << ": " << e.What();
+          job_.reset(new UnserializationFailureJob(jobType_, serializedJob_, e));
+        }
+
+        serializedJob_ = Json::nullValue;  // Release memory
+        lastStatus_ = JobStatus(ErrorCode_Success, "", *job_);
+      }
+
       return *job_;
     }
 
@@ -235,8 +409,9 @@ namespace Orthanc
       return runtime_;
     }
 
-    const JobStatus& GetLastStatus() const
+    const JobStatus& GetLastStatus()
     {
+      GetJob();  // The status is only available once unserialized
       return lastStatus_;
     }
 
@@ -248,6 +423,7 @@ namespace Orthanc
 
     void SetLastErrorCode(ErrorCode code)
     {
+      GetJob();
       lastStatus_.SetErrorCode(code);
     }
 
@@ -275,6 +451,12 @@ namespace Orthanc
           ok = false;
         }
       }
+      else if (job_.get() == NULL)
+      {
+        // Not unserialized yet, the record is unchanged
+        target[JOB] = serializedJob_;
+        ok = true;
+      }
       else 
       {
         ok = job_->Serialize(target[JOB]);
@@ -287,6 +469,12 @@ namespace Orthanc
         target[CREATION_TIME] = boost::posix_time::to_iso_string(creationTime_);
         target[LAST_CHANGE_TIME] = boost::posix_time::to_iso_string(lastStateChangeTime_);
         target[RUNTIME] = static_cast<unsigned int>(runtime_.total_milliseconds());
+
+        if (!dependencies_.empty())
+        {
+          SerializationToolbox::WriteSetOfStrings(target, dependencies_, DEPENDENCIES);
+        }
+
         return true;
       }
       else
@@ -298,10 +486,14 @@ namespace Orthanc
 
     JobHandler(IJobUnserializer& unserializer,
                const Json::Value& serialized,
-               const std::string& id) :
+               const std::string& id,
+               bool lazy) :
       id_(id),
+      unserializer_(&unserializer),
       pauseScheduled_(false),
-      cancelScheduled_(false)
+      cancelScheduled_(false),
+      jobClass_(NULL),
+      hasTarget_(false)
     {
       state_ = StringToJobState(SerializationToolbox::ReadString(serialized, STATE));
       priority_ = SerializationToolbox::ReadInteger(serialized, PRIORITY);
@@ -314,11 +506,29 @@ namespace Orthanc
 
       retryTime_ = creationTime_;
 
-      job_.reset(unserializer.UnserializeJob(serialized[JOB]));
-      job_->GetJobType(jobType_);
-      job_->Start();
+      if (serialized.isMember(DEPENDENCIES))
+      {
+        SerializationToolbox::ReadSetOfStrings(dependencies_, serialized, DEPENDENCIES);
+      }
 
-      lastStatus_ = JobStatus(ErrorCode_Success, "", *job_);
+      if (lazy)
+      {
+        if (!serialized.isMember(JOB))
+        {
+          throw OrthancException(ErrorCode_BadFileFormat);
+        }
+
+        serializedJob_ = serialized[JOB];
+        jobType_ = SerializationToolbox::ReadString(serializedJob_, TYPE);
+      }
+      else
+      {
+        job_.reset(unserializer.UnserializeJob(serialized[JOB]));
+        job_->GetJobType(jobType_);
+        job_->Start();
+
+        lastStatus_ = JobStatus(ErrorCode_Success, "", *job_);
+      }
     }
   };
 
@@ -330,6 +540,98 @@ namespace Orthanc
   }                       
 
 
+  class JobsRegistry::JobClass : public boost::noncopyable
+  {
+  private:
+    std::string   type_;
+    std::string   target_;
+    PendingJobs   pendingJobs_;
+    unsigned int  running_;
+    uint64_t      pass_;        // Virtual time of the class
+    uint64_t      dispatched_;
+    uint64_t      totalWait_;   // In milliseconds
+
+  public:
+    JobClass(const std::string& type,
+             const std::string& target) :
+      type_(type),
+      target_(target),
+      running_(0),
+      pass_(0),
+      dispatched_(0),
+      totalWait_(0)
+    {
+    }
+
+    const std::string& GetType() const
+    {
+      return type_;
+    }
+
+    const std::string& GetTarget() const
+    {
+      return target_;
+    }
+
+    PendingJobs& GetPendingJobs()
+    {
+      return pendingJobs_;
+    }
+
+    const PendingJobs& GetPendingJobs() const
+    {
+      return pendingJobs_;
+    }
+
+    uint64_t GetPass() const
+    {
+      return pass_;
+    }
+
+    void SetPass(uint64_t pass)
+    {
+      pass_ = pass;
+    }
+
+    unsigned int GetRunningCount() const
+    {
+      return running_;
+    }
+
+    void SignalDispatched(uint64_t wait)
+    {
+      running_ ++;
+      dispatched_ ++;
+      totalWait_ += wait;
+    }
+
+    void SignalReleased()
+    {
+      assert(running_ > 0);
+      running_ --;
+    }
+
+    void GetStatistics(JobClassStatistics& target) const
+    {
+      target.type_ = type_;
+      target.target_ = target_;
+      target.pending_ = static_cast<unsigned int>(pendingJobs_.size());
+      target.running_ = running_;
+      target.dispatched_ = dispatched_;
+
+      if (dispatched_ == 0)
+      {
+        target.averageWait_ = 0;
+      }
+      else
+      {
+        target.averageWait_ = (static_cast<float>(totalWait_) /
+                               static_cast<float>(dispatched_));
+      }
+    }
+  };
+
+
 #if defined(NDEBUG)
   void JobsRegistry::CheckInvariants() const
   {
@@ -338,15 +640,19 @@ namespace Orthanc
 #else
   bool JobsRegistry::IsPendingJob(const JobHandler& job) const
   {
-    PendingJobs copy = pendingJobs_;
-    while (!copy.empty())
+    for (JobClasses::const_iterator it = jobClasses_.begin();
+         it != jobClasses_.end(); ++it)
     {
-      if (copy.top() == &job)
+      PendingJobs copy = it->second->GetPendingJobs();
+      while (!copy.empty())
       {
-        return true;
-      }
+        if (copy.top() == &job)
+        {
+          return true;
+        }
 
-      copy.pop();
+        copy.pop();
+      }
     }
 
     return false;
@@ -371,13 +677,21 @@ namespace Orthanc
     return retryJobs_.find(&job) != retryJobs_.end();
   }
 
+  bool JobsRegistry::IsWaitingJob(JobHandler& job) const
+  {
+    return waitingJobs_.find(&job) != waitingJobs_.end();
+  }
+
   void JobsRegistry::CheckInvariants() const
   {
+    for (JobClasses::const_iterator it = jobClasses_.begin();
+         it != jobClasses_.end(); ++it)
     {
-      PendingJobs copy = pendingJobs_;
+      PendingJobs copy = it->second->GetPendingJobs();
       while (!copy.empty())
       {
-        assert(copy.top()->GetState() == JobState_Pending);
+        assert(copy.top()->GetState() == JobState_Pending &&
+               copy.top()->GetClass() == it->second);
         copy.pop();
       }
     }
@@ -397,6 +711,13 @@ namespace Orthanc
       assert((*it)->GetState() == JobState_Retry);
     }
 
+    for (WaitingJobs::const_iterator it = waitingJobs_.begin();
+         it != waitingJobs_.end(); ++it)
+    {
+      assert((*it)->GetState() == JobState_Pending &&
+             !(*it)->GetDependencies().empty());
+    }
+
     for (JobsIndex::const_iterator it = jobsIndex_.begin();
          it != jobsIndex_.end(); ++it)
     {
@@ -407,21 +728,21 @@ namespace Orthanc
       switch (job.GetState())
       {
         case JobState_Pending:
-          assert(!IsRetryJob(job) && IsPendingJob(job) && !IsCompletedJob(job));
+          assert(!IsRetryJob(job) && IsPendingJob(job) != IsWaitingJob(job) && !IsCompletedJob(job));
           break;
             
         case JobState_Success:
         case JobState_Failure:
-          assert(!IsRetryJob(job) && !IsPendingJob(job) && IsCompletedJob(job));
+          assert(!IsRetryJob(job) && !IsPendingJob(job) && !IsWaitingJob(job) && IsCompletedJob(job));
           break;
             
         case JobState_Retry:
-          assert(IsRetryJob(job) && !IsPendingJob(job) && !IsCompletedJob(job));
+          assert(IsRetryJob(job) && !IsPendingJob(job) && !IsWaitingJob(job) && !IsCompletedJob(job));
           break;
             
         case JobState_Running:
         case JobState_Paused:
-          assert(!IsRetryJob(job) && !IsPendingJob(job) && !IsCompletedJob(job));
+          assert(!IsRetryJob(job) && !IsPendingJob(job) && !IsWaitingJob(job) && !IsCompletedJob(job));
           break;
 
         default:
@@ -432,6 +753,15 @@ namespace Orthanc
 #endif
 
 
+  void JobsRegistry::SignalChange(const JobHandler& job)
+  {
+    if (trackChanges_)
+    {
+      changedJobs_.insert(job.GetId());
+    }
+  }
+
+
   void JobsRegistry::ForgetOldCompletedJobs()
   {
     while (completedJobs_.size() > maxCompletedJobs_)
@@ -441,6 +771,12 @@ namespace Orthanc
       std::string id = completedJobs_.front()->GetId();
       assert(jobsIndex_.find(id) != jobsIndex_.end());
 
+      if (trackChanges_)
+      {
+        changedJobs_.erase(id);
+        removedJobs_.insert(id);
+      }
+
       jobsIndex_.erase(id);
       delete(completedJobs_.front());
       completedJobs_.pop_front();
@@ -454,9 +790,13 @@ namespace Orthanc
                                      bool success)
   {
     job.SetState(success ? JobState_Success : JobState_Failure);
+    SignalChange(job);
 
     completedJobs_.push_back(&job);
+    job.SetCompletedPosition(--completedJobs_.end());
     someJobComplete_.notify_all();
+
+    SignalPredecessorCompleted(job, success);
   }
 
 
@@ -525,6 +865,7 @@ namespace Orthanc
 
     retryJobs_.insert(&job);
     job.SetRetryState(timeout);
+    SignalChange(job);
 
     CheckInvariants();
   }
@@ -538,6 +879,7 @@ namespace Orthanc
     assert(job.GetState() == JobState_Running);
 
     job.SetState(JobState_Paused);
+    SignalChange(job);
 
     CheckInvariants();
   }
@@ -568,6 +910,12 @@ namespace Orthanc
       assert(it->second != NULL);
       delete it->second;
     }
+
+    for (JobClasses::iterator it = jobClasses_.begin(); it != jobClasses_.end(); ++it)
+    {
+      assert(it->second != NULL);
+      delete it->second;
+    }
   }
 
 
@@ -604,6 +952,120 @@ namespace Orthanc
   }
 
 
+  void JobsRegistry::ListJobsInternal(std::vector<JobHandler*>& target,
+                                      const std::set<JobState>& states,
+                                      const std::string& jobType,
+                                      size_t since,
+                                      size_t limit)
+  {
+    // The mutex must be locked. The filters only use the fields of
+    // the handlers, which avoids accessing (and possibly
+    // unserializing) the jobs themselves.
+    target.clear();
+
+    typedef std::pair<boost::posix_time::ptime, std::string>  Candidate;
+    
+    std::vector<Candidate> candidates;
+    candidates.reserve(jobsIndex_.size());
+
+    for (JobsIndex::const_iterator it = jobsIndex_.begin();
+         it != jobsIndex_.end(); ++it)
+    {
+      const JobHandler& handler = *it->second;
+
+      if ((states.empty() ||
+           states.find(handler.GetState()) != states.end()) &&
+          (jobType.empty() ||
+           handler.GetJobType() == jobType))
+      {
+        candidates.push_back(std::make_pair(handler.GetCreationTime(), handler.GetId()));
+      }
+    }
+
+    if (since >= candidates.size())
+    {
+      return;
+    }
+
+    size_t end = candidates.size();
+    if (limit != 0 &&
+        limit < end - since)
+    {
+      end = since + limit;
+    }
+
+    // Only sort the requested page
+    std::partial_sort(candidates.begin(), candidates.begin() + end, candidates.end());
+
+    target.reserve(end - since);
+
+    for (size_t i = since; i < end; i++)
+    {
+      JobsIndex::const_iterator found = jobsIndex_.find(candidates[i].second);
+      assert(found != jobsIndex_.end());
+      target.push_back(found->second);
+    }
+  }
+
+
+  void JobsRegistry::ListJobs(std::list<std::string>& target,
+                              const std::set<JobState>& states,
+                              const std::string& jobType,
+                              size_t since,
+                              size_t limit)
+  {
+    target.clear();
+
+    boost::mutex::scoped_lock lock(mutex_);
+    CheckInvariants();
+
+    std::vector<JobHandler*> handlers;
+    ListJobsInternal(handlers, states, jobType, since, limit);
+
+    for (size_t i = 0; i < handlers.size(); i++)
+    {
+      target.push_back(handlers[i]->GetId());
+    }
+  }
+
+
+  void JobsRegistry::ListJobs(std::list<JobInfo>& target,
+                              const std::set<JobState>& states,
+                              const std::string& jobType,
+                              size_t since,
+                              size_t limit)
+  {
+    target.clear();
+
+    boost::mutex::scoped_lock lock(mutex_);
+    CheckInvariants();
+
+    std::vector<JobHandler*> handlers;
+    ListJobsInternal(handlers, states, jobType, since, limit);
+
+    for (size_t i = 0; i < handlers.size(); i++)
+    {
+      target.push_back(JobInfo());
+      GetJobInfoInternal(target.back(), *handlers[i]);
+    }
+  }
+
+
+  void JobsRegistry::GetJobInfoInternal(JobInfo& target,
+                                        JobHandler& handler)
+  {
+    // This is cheap, as the serialized job is shared with the last
+    // status of the handler, instead of being copied
+    target = JobInfo(handler.GetId(),
+                     handler.GetPriority(),
+                     handler.GetState(),
+                     handler.GetLastStatus(),
+                     handler.GetCreationTime(),
+                     handler.GetLastStateChangeTime(),
+                     handler.GetRuntime());
+  }
+
+
   bool JobsRegistry::GetJobInfo(JobInfo& target,
                                 const std::string& id)
   {
@@ -618,14 +1080,7 @@ namespace Orthanc
     }
     else
     {
-      const JobHandler& handler = *found->second;
-      target = JobInfo(handler.GetId(),
-                       handler.GetPriority(),
-                       handler.GetState(),
-                       handler.GetLastStatus(),
-                       handler.GetCreationTime(),
-                       handler.GetLastStateChangeTime(),
-                       handler.GetRuntime());
+      GetJobInfoInternal(target, *found->second);
       return true;
     }
   }
@@ -647,7 +1102,7 @@ namespace Orthanc
     }
     else
     {
-      const JobHandler& handler = *found->second;
+      JobHandler& handler = *found->second;
 
       if (handler.GetState() == JobState_Success)
       {
@@ -662,7 +1117,8 @@ namespace Orthanc
 
 
   void JobsRegistry::SubmitInternal(std::string& id,
-                                    JobHandler* handler)
+                                    JobHandler* handler,
+                                    bool resolveDependencies)
   {
     if (handler == NULL)
     {
@@ -674,6 +1130,19 @@ namespace Orthanc
     {
       boost::mutex::scoped_lock lock(mutex_);
       CheckInvariants();
+
+      if (resolveDependencies)
+      {
+        for (std::set<std::string>::const_iterator it = handler->GetDependencies().begin();
+             it != handler->GetDependencies().end(); ++it)
+        {
+          if (jobsIndex_.find(*it) == jobsIndex_.end())
+          {
+            throw OrthancException(ErrorCode_InexistentItem,
+                                   "The job depends on an unknown job: " + *it);
+          }
+        }
+      }
       
       id = handler->GetId();
       int priority = handler->GetPriority();
@@ -686,8 +1155,20 @@ namespace Orthanc
         case JobState_Retry:
         case JobState_Running:
           handler->SetState(JobState_Pending);
-          pendingJobs_.push(handler);
-          pendingJobAvailable_.notify_one();
+
+          if (resolveDependencies)
+          {
+            SchedulePendingJob(*handler);
+          }
+          else if (handler->GetDependencies().empty())
+          {
+            EnqueuePendingJob(*handler);
+          }
+          else
+          {
+            // The jobs it depends on might not be loaded yet, cf. "ScheduleWaitingJobs()"
+            AddWaitingJob(*handler);
+          }
           break;
  
         case JobState_Success:
@@ -709,6 +1190,8 @@ namespace Orthanc
         }
       }
 
+      SignalChange(*handler);
+
       LOG(INFO) << "New job submitted with priority " << priority << ": " << id;
 
       if (observer_ != NULL)
@@ -727,7 +1210,7 @@ namespace Orthanc
                             IJob* job,        // Takes ownership
                             int priority)
   {
-    SubmitInternal(id, new JobHandler(job, priority));
+    SubmitInternal(id, new JobHandler(job, priority), true);
   }
 
 
@@ -735,16 +1218,36 @@ namespace Orthanc
                             int priority)
   {
     std::string id;
-    SubmitInternal(id, new JobHandler(job, priority));
+    SubmitInternal(id, new JobHandler(job, priority), true);
+  }
+
+
+  void JobsRegistry::Submit(std::string& id,
+                            IJob* job,        // Takes ownership
+                            int priority,
+                            const std::set<std::string>& dependencies)
+  {
+    std::auto_ptr<JobHandler> handler(new JobHandler(job, priority));
+    handler->SetDependencies(dependencies);
+    SubmitInternal(id, handler.release(), true);
   }
 
 
   void JobsRegistry::SubmitAndWait(Json::Value& successContent,
                                    IJob* job,        // Takes ownership
                                    int priority)
+  {
+    SubmitAndWait(successContent, job, priority, std::set<std::string>());
+  }
+
+
+  void JobsRegistry::SubmitAndWait(Json::Value& successContent,
+                                   IJob* job,        // Takes ownership
+                                   int priority,
+                                   const std::set<std::string>& dependencies)
   {
     std::string id;
-    Submit(id, job, priority);
+    Submit(id, job, priority, dependencies);
 
     JobState state = JobState_Pending;  // Dummy initialization
 
@@ -829,19 +1332,25 @@ namespace Orthanc
     else
     {
       found->second->SetPriority(priority);
+      SignalChange(*found->second);
 
-      if (found->second->GetState() == JobState_Pending)
+      if (found->second->GetState() == JobState_Pending &&
+          waitingJobs_.find(found->second) == waitingJobs_.end())
       {
         // If the job is pending, we need to reconstruct the
-        // priority queue, as the heap condition has changed
+        // priority queue of its class, as the heap condition has
+        // changed
+
+        assert(found->second->GetClass() != NULL);
+        PendingJobs& pendingJobs = found->second->GetClass()->GetPendingJobs();
 
         PendingJobs copy;
-        std::swap(copy, pendingJobs_);
+        std::swap(copy, pendingJobs);
 
-        assert(pendingJobs_.empty());
+        assert(pendingJobs.empty());
         while (!copy.empty())
         {
-          pendingJobs_.push(copy.top());
+          pendingJobs.push(copy.top());
           copy.pop();
         }
       }
@@ -852,19 +1361,66 @@ namespace Orthanc
   }
 
 
-  void JobsRegistry::RemovePendingJob(const std::string& id)
+  void JobsRegistry::EnqueuePendingJob(JobHandler& job)
   {
-    // If the job is pending, we need to reconstruct the priority
-    // queue to remove it
+    assert(job.GetState() == JobState_Pending);
+
+    const JobClassKey key(job.GetJobType(), job.GetTarget());
+
+    JobClass* jobClass = NULL;
+
+    JobClasses::iterator found = jobClasses_.find(key);
+    if (found == jobClasses_.end())
+    {
+      jobClass = new JobClass(key.first, key.second);
+      jobClasses_[key] = jobClass;
+    }
+    else
+    {
+      jobClass = found->second;
+    }
+
+    assert(jobClass != NULL);
+
+    if (jobClass->GetPendingJobs().empty() &&
+        jobClass->GetPass() < virtualTime_)
+    {
+      // The class was idle: It must not get credit for the time
+      // during which it had nothing to run
+      jobClass->SetPass(virtualTime_);
+    }
+
+    jobClass->GetPendingJobs().push(&job);
+    job.SetClass(*jobClass);
+
+    pendingJobAvailable_.notify_one();
+  }
+
+
+  void JobsRegistry::RemovePendingJob(JobHandler& job)
+  {
+    WaitingJobs::iterator waiting = waitingJobs_.find(&job);
+    if (waiting != waitingJobs_.end())
+    {
+      // The job is not queued yet, as it waits for other jobs
+      waitingJobs_.erase(waiting);
+      return;
+    }
+
+    // If the job is pending, we need to reconstruct the priority
+    // queue of its class to remove it
+    assert(job.GetClass() != NULL);
+    PendingJobs& pendingJobs = job.GetClass()->GetPendingJobs();
+
     PendingJobs copy;
-    std::swap(copy, pendingJobs_);
+    std::swap(copy, pendingJobs);
 
-    assert(pendingJobs_.empty());
+    assert(pendingJobs.empty());
     while (!copy.empty())
     {
-      if (copy.top()->GetId() != id)
+      if (copy.top() != &job)
       {
-        pendingJobs_.push(copy.top());
+        pendingJobs.push(copy.top());
       }
 
       copy.pop();
@@ -872,6 +1428,139 @@ namespace Orthanc
   }
 
 
+  bool JobsRegistry::IsBelowConcurrencyLimits(const JobClass& jobClass) const
+  {
+    Counters::const_iterator limit = typesMaxConcurrency_.find(jobClass.GetType());
+    if (limit != typesMaxConcurrency_.end() &&
+        limit->second != 0)
+    {
+      Counters::const_iterator running = runningPerType_.find(jobClass.GetType());
+      if (running != runningPerType_.end() &&
+          running->second >= limit->second)
+      {
+        return false;
+      }
+    }
+
+    if (targetMaxConcurrency_ != 0 &&
+        !jobClass.GetTarget().empty())
+    {
+      Counters::const_iterator running = runningPerTarget_.find(jobClass.GetTarget());
+      if (running != runningPerTarget_.end() &&
+          running->second >= targetMaxConcurrency_)
+      {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+
+  JobsRegistry::JobClass* JobsRegistry::SelectPendingJobClass() const
+  {
+    // The job with the highest priority is started first. Between
+    // the classes whose next jobs have the same priority, the class
+    // with the smallest virtual time is chosen, which shares the
+    // workers between the classes in proportion to their weights.
+    JobClass* best = NULL;
+    
+    for (JobClasses::const_iterator it = jobClasses_.begin();
+         it != jobClasses_.end(); ++it)
+    {
+      JobClass& candidate = *it->second;
+
+      if (!candidate.GetPendingJobs().empty() &&
+          IsBelowConcurrencyLimits(candidate))
+      {
+        if (best == NULL)
+        {
+          best = &candidate;
+        }
+        else
+        {
+          int a = candidate.GetPendingJobs().top()->GetPriority();
+          int b = best->GetPendingJobs().top()->GetPriority();
+
+          if (a > b ||
+              (a == b && candidate.GetPass() < best->GetPass()))
+          {
+            best = &candidate;
+          }
+        }
+      }
+    }
+
+    return best;
+  }
+
+
+  JobsRegistry::JobHandler& JobsRegistry::DispatchPendingJob(JobClass& jobClass)
+  {
+    assert(!jobClass.GetPendingJobs().empty());
+
+    JobHandler* job = jobClass.GetPendingJobs().top();
+    jobClass.GetPendingJobs().pop();
+
+    assert(job != NULL &&
+           job->GetClass() == &jobClass);
+
+    unsigned int weight = 1;
+
+    Counters::const_iterator found = typesWeight_.find(jobClass.GetType());
+    if (found != typesWeight_.end())
+    {
+      weight = found->second;
+    }
+
+    assert(weight > 0);
+    virtualTime_ = jobClass.GetPass();
+    jobClass.SetPass(jobClass.GetPass() + STRIDE / weight);
+
+    const boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+    const boost::posix_time::time_duration wait = now - job->GetLastStateChangeTime();
+
+    jobClass.SignalDispatched(wait.is_negative() ? 0 : wait.total_milliseconds());
+
+    runningPerType_[jobClass.GetType()] ++;
+
+    if (!jobClass.GetTarget().empty())
+    {
+      runningPerTarget_[jobClass.GetTarget()] ++;
+    }
+
+    return *job;
+  }
+
+
+  void JobsRegistry::ReleaseRunningJob(JobHandler& job)
+  {
+    JobClass* jobClass = job.GetClass();
+    assert(jobClass != NULL);
+
+    jobClass->SignalReleased();
+
+    Counters::iterator running = runningPerType_.find(jobClass->GetType());
+    assert(running != runningPerType_.end() && running->second > 0);
+    running->second --;
+
+    if (!jobClass->GetTarget().empty())
+    {
+      running = runningPerTarget_.find(jobClass->GetTarget());
+      assert(running != runningPerTarget_.end() && running->second > 0);
+      running->second --;
+    }
+
+    if (!typesMaxConcurrency_.empty() ||
+        targetMaxConcurrency_ != 0)
+    {
+      // Some pending job might have been blocked by the limits on
+      // the concurrency
+      pendingJobAvailable_.notify_all();
+    }
+  }
+
+
   void JobsRegistry::RemoveRetryJob(JobHandler* handler)
   {
     RetryJobs::iterator item = retryJobs_.find(handler);
@@ -880,6 +1569,139 @@ namespace Orthanc
   }
 
 
+  bool JobsRegistry::ResolveDependencies(JobHandler& job)
+  {
+    // Forget about the jobs that have already succeeded. Returns
+    // "false" if some job has failed, or is not known anymore.
+    std::set<std::string> remaining;
+    
+    for (std::set<std::string>::const_iterator it = job.GetDependencies().begin();
+         it != job.GetDependencies().end(); ++it)
+    {
+      JobsIndex::const_iterator found = jobsIndex_.find(*it);
+
+      if (found == jobsIndex_.end() ||
+          found->second->GetState() == JobState_Failure)
+      {
+        return false;
+      }
+      else if (found->second->GetState() != JobState_Success)
+      {
+        remaining.insert(*it);
+      }
+    }
+
+    job.SetDependencies(remaining);
+    return true;
+  }
+
+
+  void JobsRegistry::AddWaitingJob(JobHandler& job)
+  {
+    assert(job.GetState() == JobState_Pending &&
+           !job.GetDependencies().empty());
+
+    waitingJobs_.insert(&job);
+    
+    for (std::set<std::string>::const_iterator it = job.GetDependencies().begin();
+         it != job.GetDependencies().end(); ++it)
+    {
+      successors_[*it].insert(job.GetId());
+    }
+  }
+
+
+  void JobsRegistry::SchedulePendingJob(JobHandler& job)
+  {
+    assert(job.GetState() == JobState_Pending);
+
+    if (!ResolveDependencies(job))
+    {
+      LOG(INFO) << "Canceling job, as a job it depends on has failed: " << job.GetId();
+      SetCompletedJob(job, false);
+      job.SetLastErrorCode(ErrorCode_CanceledJob);
+    }
+    else if (job.GetDependencies().empty())
+    {
+      EnqueuePendingJob(job);
+    }
+    else
+    {
+      AddWaitingJob(job);
+    }
+  }
+
+
+  void JobsRegistry::ScheduleWaitingJobs()
+  {
+    // Once all the jobs are loaded, check whether the waiting jobs
+    // can be started, or must be canceled
+    WaitingJobs copy;
+    std::swap(copy, waitingJobs_);
+    
+    for (WaitingJobs::iterator it = copy.begin(); it != copy.end(); ++it)
+    {
+      SchedulePendingJob(**it);
+    }
+
+    ForgetOldCompletedJobs();
+  }
+
+
+  void JobsRegistry::SignalPredecessorCompleted(const JobHandler& job,
+                                                bool success)
+  {
+    Successors::iterator found = successors_.find(job.GetId());
+    if (found == successors_.end())
+    {
+      return;
+    }
+
+    std::set<std::string> successors;
+    successors.swap(found->second);
+    successors_.erase(found);
+
+    for (std::set<std::string>::const_iterator it = successors.begin();
+         it != successors.end(); ++it)
+    {
+      JobsIndex::iterator successor = jobsIndex_.find(*it);
+      if (successor == jobsIndex_.end())
+      {
+        continue;
+      }
+
+      JobHandler& handler = *successor->second;
+
+      if (success)
+      {
+        // The dependency is satisfied, even if the successor is paused
+        handler.RemoveDependency(job.GetId());
+        SignalChange(handler);
+      }
+
+      WaitingJobs::iterator waiting = waitingJobs_.find(&handler);
+      if (waiting != waitingJobs_.end())
+      {
+        if (!success)
+        {
+          LOG(INFO) << "Canceling job, as job " << job.GetId()
+                    << " it depends on has failed: " << handler.GetId();
+          waitingJobs_.erase(waiting);
+
+          // Recursively cancels the downstream jobs
+          SetCompletedJob(handler, false);
+          handler.SetLastErrorCode(ErrorCode_CanceledJob);
+        }
+        else if (handler.GetDependencies().empty())
+        {
+          waitingJobs_.erase(waiting);
+          EnqueuePendingJob(handler);
+        }
+      }
+    }
+  }
+
+
   bool JobsRegistry::Pause(const std::string& id)
   {
     LOG(INFO) << "Pausing job: " << id;
@@ -899,13 +1721,15 @@ namespace Orthanc
       switch (found->second->GetState())
       {
         case JobState_Pending:
-          RemovePendingJob(id);
+          RemovePendingJob(*found->second);
           found->second->SetState(JobState_Paused);
+          SignalChange(*found->second);
           break;
 
         case JobState_Retry:
           RemoveRetryJob(found->second);
           found->second->SetState(JobState_Paused);
+          SignalChange(*found->second);
           break;
 
         case JobState_Paused:
@@ -947,7 +1771,7 @@ namespace Orthanc
       switch (found->second->GetState())
       {
         case JobState_Pending:
-          RemovePendingJob(id);
+          RemovePendingJob(*found->second);
           SetCompletedJob(*found->second, false);
           found->second->SetLastErrorCode(ErrorCode_CanceledJob);
           break;
@@ -1007,9 +1831,12 @@ namespace Orthanc
     else
     {
       found->second->SetState(JobState_Pending);
-      pendingJobs_.push(found->second);
-      pendingJobAvailable_.notify_one();
-      CheckInvariants();
+      SignalChange(*found->second);
+      SchedulePendingJob(*found->second);
+
+      // WARNING: The following call might make "handler" invalid if
+      // the job history size is empty
+      ForgetOldCompletedJobs();
       return true;      
     }
   }
@@ -1037,26 +1864,17 @@ namespace Orthanc
     else
     {
       found->second->GetJob().Reset();
-      
-      bool ok = false;
-      for (CompletedJobs::iterator it = completedJobs_.begin(); 
-           it != completedJobs_.end(); ++it)
-      {
-        if (*it == found->second)
-        {
-          ok = true;
-          completedJobs_.erase(it);
-          break;
-        }
-      }
 
-      assert(ok);
+      assert(*found->second->GetCompletedPosition() == found->second);
+      completedJobs_.erase(found->second->GetCompletedPosition());
 
       found->second->SetState(JobState_Pending);
-      pendingJobs_.push(found->second);
-      pendingJobAvailable_.notify_one();
+      SignalChange(*found->second);
+      SchedulePendingJob(*found->second);
 
-      CheckInvariants();
+      // WARNING: The following call might make "handler" invalid if
+      // the job history size is empty
+      ForgetOldCompletedJobs();
       return true;
     }
   }
@@ -1079,8 +1897,8 @@ namespace Orthanc
       {
         LOG(INFO) << "Retrying job: " << (*it)->GetId();
         (*it)->SetState(JobState_Pending);
-        pendingJobs_.push(*it);
-        pendingJobAvailable_.notify_one();
+        SignalChange(**it);
+        EnqueuePendingJob(**it);
       }
       else
       {
@@ -1125,8 +1943,16 @@ namespace Orthanc
     {
       boost::mutex::scoped_lock lock(registry_.mutex_);
 
-      while (registry_.pendingJobs_.empty())
+      JobClass* jobClass = NULL;
+
+      for (;;)
       {
+        jobClass = registry_.SelectPendingJobClass();
+        if (jobClass != NULL)
+        {
+          break;
+        }
+
         if (timeout == 0)
         {
           registry_.pendingJobAvailable_.wait(lock);
@@ -1143,12 +1969,12 @@ namespace Orthanc
         }
       }
 
-      handler_ = registry_.pendingJobs_.top();
-      registry_.pendingJobs_.pop();
+      handler_ = &registry_.DispatchPendingJob(*jobClass);
 
       assert(handler_->GetState() == JobState_Pending);
       handler_->SetState(JobState_Running);
       handler_->SetLastErrorCode(ErrorCode_Success);
+      registry_.SignalChange(*handler_);
 
       job_ = &handler_->GetJob();
       id_ = handler_->GetId();
@@ -1163,6 +1989,8 @@ namespace Orthanc
     {
       boost::mutex::scoped_lock lock(registry_.mutex_);
 
+      registry_.ReleaseRunningJob(*handler_);
+
       switch (targetState_)
       {
         case JobState_Failure:
@@ -1352,6 +2180,7 @@ namespace Orthanc
       assert(handler_->GetState() == JobState_Running);
         
       handler_->SetLastStatus(status);
+      registry_.SignalChange(*handler_);
     }
   }
 
@@ -1382,7 +2211,10 @@ namespace Orthanc
                              const Json::Value& s,
                              size_t maxCompletedJobs) :
     maxCompletedJobs_(maxCompletedJobs),
-    observer_(NULL)
+    observer_(NULL),
+    trackChanges_(false),
+    targetMaxConcurrency_(0),
+    virtualTime_(0)
   {
     if (SerializationToolbox::ReadString(s, TYPE) != JOBS_REGISTRY ||
         !s.isMember(JOBS) ||
@@ -1400,7 +2232,7 @@ namespace Orthanc
 
       try
       {
-        job.reset(new JobHandler(unserializer, s[JOBS][*it], *it));
+        job.reset(new JobHandler(unserializer, s[JOBS][*it], *it, false /* eager */));
       }
       catch (OrthancException& e)
       {
@@ -1412,7 +2244,7 @@ namespace Orthanc
       const boost::posix_time::ptime lastChangeTime = job->GetLastStateChangeTime();
 
       std::string id;
-      SubmitInternal(id, job.release());
+      SubmitInternal(id, job.release(), false);
 
       // Check whether the job has not been removed (which could be
       // the case if the "maxCompletedJobs_" value gets smaller)
@@ -1425,6 +2257,269 @@ namespace Orthanc
         found->second->SetLastStateChangeTime(lastChangeTime);
       }
     }
+
+    ScheduleWaitingJobs();
+  }
+
+
+  namespace
+  {
+    struct LoadedJob
+    {
+      boost::posix_time::ptime  lastChangeTime_;
+      std::string               id_;
+      Json::Value               record_;
+
+      bool operator< (const LoadedJob& other) const
+      {
+        return lastChangeTime_ < other.lastChangeTime_;
+      }
+    };
+  }
+
+
+  JobsRegistry::JobsRegistry(IJobUnserializer& unserializer,
+                             const SerializedJobs& records,
+                             size_t maxCompletedJobs) :
+    maxCompletedJobs_(maxCompletedJobs),
+    observer_(NULL),
+    trackChanges_(true),
+    targetMaxConcurrency_(0),
+    virtualTime_(0)
+  {
+    // Submit the jobs in the chronological order of their last
+    // change, so that the oldest completed jobs are forgotten first
+    std::vector<LoadedJob> loaded;
+    loaded.reserve(records.size());
+
+    for (SerializedJobs::const_iterator it = records.begin(); it != records.end(); ++it)
+    {
+      LoadedJob job;
+      job.id_ = it->first;
+
+      Json::Reader reader;
+      if (!reader.parse(it->second, job.record_) ||
+          job.record_.type() != Json::objectValue ||
+          !job.record_.isMember(LAST_CHANGE_TIME) ||
+          job.record_[LAST_CHANGE_TIME].type() != Json::stringValue)
+      {
+        LOG(WARNING) << "Cannot parse the record of one job from previous execution, "
+                     << "skipping it: " << it->first;
+        removedJobs_.insert(it->first);
+        continue;
+      }
+
+      try
+      {
+        job.lastChangeTime_ = boost::posix_time::from_iso_string
+          (job.record_[LAST_CHANGE_TIME].asString());
+      }
+      catch (std::exception&)
+      {
+        LOG(WARNING) << "Bad time in the record of one job from previous execution, "
+                     << "skipping it: " << it->first;
+        removedJobs_.insert(it->first);
+        continue;
+      }
+
+      loaded.push_back(job);
+    }
+
+    std::stable_sort(loaded.begin(), loaded.end());
+
+    for (size_t i = 0; i < loaded.size(); i++)
+    {
+      std::auto_ptr<JobHandler> job;
+
+      try
+      {
+        // The job itself is only unserialized once it is accessed
+        job.reset(new JobHandler(unserializer, loaded[i].record_, loaded[i].id_, true /* lazy */));
+      }
+      catch (OrthancException& e)
+      {
+        LOG(WARNING) << "Cannot unserialize one job from previous execution, "
+                     << "skipping it: " << e.What();
+        removedJobs_.insert(loaded[i].id_);
+        continue;
+      }
+
+      std::string id;
+      SubmitInternal(id, job.release(), false);
+
+      JobsIndex::iterator found = jobsIndex_.find(id);
+      if (found != jobsIndex_.end())
+      {
+        assert(found->second != NULL);
+        found->second->SetLastStateChangeTime(loaded[i].lastChangeTime_);
+      }
+    }
+
+    // The records are already up-to-date: Only keep track of the jobs
+    // that could not be loaded, or that were removed from the history
+    changedJobs_.clear();
+
+    ScheduleWaitingJobs();
+  }
+
+
+  void JobsRegistry::SetTrackChanges(bool track)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    CheckInvariants();
+
+    if (track &&
+        !trackChanges_)
+    {
+      // All the jobs have to be stored from now
+      for (JobsIndex::const_iterator it = jobsIndex_.begin();
+           it != jobsIndex_.end(); ++it)
+      {
+        changedJobs_.insert(it->first);
+      }
+    }
+    else if (!track)
+    {
+      changedJobs_.clear();
+      removedJobs_.clear();
+    }
+
+    trackChanges_ = track;
+  }
+
+
+  void JobsRegistry::ConsumeChanges(SerializedJobs& changed,
+                                    std::set<std::string>& removed)
+  {
+    changed.clear();
+    removed.clear();
+
+    boost::mutex::scoped_lock lock(mutex_);
+    CheckInvariants();
+
+    Json::FastWriter writer;
+
+    for (std::set<std::string>::const_iterator it = changedJobs_.begin();
+         it != changedJobs_.end(); ++it)
+    {
+      JobsIndex::const_iterator found = jobsIndex_.find(*it);
+
+      Json::Value v;
+      if (found != jobsIndex_.end() &&
+          found->second->Serialize(v))
+      {
+        changed[*it] = writer.write(v);
+      }
+      else
+      {
+        // Not serializable: Make sure no outdated record remains
+        removed.insert(*it);
+      }
+    }
+
+    removed.insert(removedJobs_.begin(), removedJobs_.end());
+
+    changedJobs_.clear();
+    removedJobs_.clear();
+  }
+
+
+  void JobsRegistry::RestoreChanges(const SerializedJobs& changed,
+                                    const std::set<std::string>& removed)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    CheckInvariants();
+
+    if (!trackChanges_)
+    {
+      return;
+    }
+
+    // The records are serialized again at the next call to
+    // "ConsumeChanges()", which takes into account the changes that
+    // have occurred meanwhile
+    for (SerializedJobs::const_iterator it = changed.begin(); it != changed.end(); ++it)
+    {
+      if (jobsIndex_.find(it->first) != jobsIndex_.end())
+      {
+        changedJobs_.insert(it->first);
+      }
+      else
+      {
+        removedJobs_.insert(it->first);
+      }
+    }
+
+    for (std::set<std::string>::const_iterator it = removed.begin(); it != removed.end(); ++it)
+    {
+      if (jobsIndex_.find(*it) != jobsIndex_.end())
+      {
+        // Job that could not be serialized
+        changedJobs_.insert(*it);
+      }
+      else
+      {
+        removedJobs_.insert(*it);
+      }
+    }
+  }
+
+
+  bool JobsRegistry::HasPendingJobs()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return SelectPendingJobClass() != NULL;
+  }
+
+
+  void JobsRegistry::SetTypeMaxConcurrency(const std::string& type,
+                                           unsigned int maxConcurrency)
+  {
+    LOG(INFO) << "Maximum number of running jobs of type \"" << type << "\": "
+              << maxConcurrency << " (0 means unlimited)";
+
+    boost::mutex::scoped_lock lock(mutex_);
+    typesMaxConcurrency_[type] = maxConcurrency;
+    pendingJobAvailable_.notify_all();
+  }
+
+
+  void JobsRegistry::SetTypeWeight(const std::string& type,
+                                   unsigned int weight)
+  {
+    if (weight == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange,
+                             "The weight of a type of jobs must be strictly positive");
+    }
+
+    boost::mutex::scoped_lock lock(mutex_);
+    typesWeight_[type] = weight;
+  }
+
+
+  void JobsRegistry::SetTargetMaxConcurrency(unsigned int maxConcurrency)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    targetMaxConcurrency_ = maxConcurrency;
+    pendingJobAvailable_.notify_all();
+  }
+
+
+  void JobsRegistry::GetClassesStatistics(std::list<JobClassStatistics>& target)
+  {
+    target.clear();
+
+    boost::mutex::scoped_lock lock(mutex_);
+    CheckInvariants();
+
+    for (JobClasses::const_iterator it = jobClasses_.begin();
+         it != jobClasses_.end(); ++it)
+    {
+      JobClassStatistics statistics;
+      it->second->GetStatistics(statistics);
+      target.push_back(statistics);
+    }
   }
 
 
@@ -44,11 +44,15 @@
 #include "JobInfo.h"
 #include "IJobUnserializer.h"
 
+#include <stdint.h>
 #include <list>
+#include <map>
 #include <set>
 #include <queue>
+#include <vector>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/condition_variable.hpp>
+#include <boost/unordered_map.hpp>
 
 namespace Orthanc
 {
@@ -69,6 +73,22 @@ namespace Orthanc
 
       virtual void SignalJobFailure(const std::string& jobId) = 0;
     };
+
+    // Individual records of the jobs, as serialized JSON strings
+    // indexed by the ID of the jobs (new in Orthanc 1.5.7)
+    typedef std::map<std::string, std::string>  SerializedJobs;
+
+    // Statistics about one class of jobs, i.e. the jobs that share
+    // the same type and the same target (new in Orthanc 1.5.7)
+    struct JobClassStatistics
+    {
+      std::string   type_;
+      std::string   target_;    // Empty if the jobs have no target
+      unsigned int  pending_;
+      unsigned int  running_;
+      uint64_t      dispatched_;
+      float         averageWait_;  // In milliseconds
+    };
     
   private:
     enum CompletedReason
@@ -79,6 +99,7 @@ namespace Orthanc
     };
     
     class JobHandler;
+    class JobClass;
 
     struct PriorityComparator
     {
@@ -86,25 +107,49 @@ namespace Orthanc
                        JobHandler*& b) const;
     };
 
-    typedef std::map<std::string, JobHandler*>              JobsIndex;
+    typedef boost::unordered_map<std::string, JobHandler*>  JobsIndex;  // Hashed by ID
     typedef std::list<JobHandler*>                          CompletedJobs;
     typedef std::set<JobHandler*>                           RetryJobs;
+    typedef std::set<JobHandler*>                           WaitingJobs;
+    typedef std::map<std::string, std::set<std::string> >   Successors;
     typedef std::priority_queue<JobHandler*, 
                                 std::vector<JobHandler*>,   // Could be a "std::deque"
                                 PriorityComparator>         PendingJobs;
+    typedef std::pair<std::string, std::string>             JobClassKey;  // Type and target
+    typedef std::map<JobClassKey, JobClass*>                JobClasses;
+    typedef std::map<std::string, unsigned int>             Counters;
 
     boost::mutex               mutex_;
     JobsIndex                  jobsIndex_;
-    PendingJobs                pendingJobs_;
+    JobClasses                 jobClasses_;  // Each class has its own queue of pending jobs
     CompletedJobs              completedJobs_;
     RetryJobs                  retryJobs_;
 
+    // Pending jobs that wait for the success of the jobs they depend
+    // on, and reverse index of the dependencies (new in Orthanc 1.5.7)
+    WaitingJobs                waitingJobs_;
+    Successors                 successors_;
+
     boost::condition_variable  pendingJobAvailable_;
     boost::condition_variable  someJobComplete_;
     size_t                     maxCompletedJobs_;
 
     IObserver*                 observer_;
 
+    // Incremental persistence (new in Orthanc 1.5.7)
+    bool                       trackChanges_;
+    std::set<std::string>      changedJobs_;
+    std::set<std::string>      removedJobs_;
+
+    // Weighted fair scheduling between the classes of jobs, with
+    // limits on the number of running jobs (new in Orthanc 1.5.7)
+    Counters                   typesMaxConcurrency_;
+    Counters                   typesWeight_;
+    unsigned int               targetMaxConcurrency_;
+    Counters                   runningPerType_;
+    Counters                   runningPerTarget_;
+    uint64_t                   virtualTime_;
+
 
 #ifndef NDEBUG
     bool IsPendingJob(const JobHandler& job) const;
@@ -112,10 +157,14 @@ namespace Orthanc
     bool IsCompletedJob(JobHandler& job) const;
     
     bool IsRetryJob(JobHandler& job) const;
+
+    bool IsWaitingJob(JobHandler& job) const;
 #endif
 
     void CheckInvariants() const;
 
+    void SignalChange(const JobHandler& job);
+
     void ForgetOldCompletedJobs();
 
     void SetCompletedJob(JobHandler& job,
@@ -132,17 +181,51 @@ namespace Orthanc
     bool GetStateInternal(JobState& state,
                           const std::string& id);
 
-    void RemovePendingJob(const std::string& id);
+    void EnqueuePendingJob(JobHandler& job);
+
+    void RemovePendingJob(JobHandler& job);
+
+    bool IsBelowConcurrencyLimits(const JobClass& jobClass) const;
+
+    JobClass* SelectPendingJobClass() const;
+
+    JobHandler& DispatchPendingJob(JobClass& jobClass);
+
+    void ReleaseRunningJob(JobHandler& job);
       
     void RemoveRetryJob(JobHandler* handler);
+
+    bool ResolveDependencies(JobHandler& job);
+
+    void AddWaitingJob(JobHandler& job);
+
+    void SchedulePendingJob(JobHandler& job);
+
+    void ScheduleWaitingJobs();
+
+    void SignalPredecessorCompleted(const JobHandler& job,
+                                    bool success);
       
     void SubmitInternal(std::string& id,
-                        JobHandler* handler);
+                        JobHandler* handler,
+                        bool resolveDependencies);
+
+    void ListJobsInternal(std::vector<JobHandler*>& target,
+                          const std::set<JobState>& states,
+                          const std::string& jobType,
+                          size_t since,
+                          size_t limit);
+
+    static void GetJobInfoInternal(JobInfo& target,
+                                   JobHandler& handler);
     
   public:
     JobsRegistry(size_t maxCompletedJobs) :
       maxCompletedJobs_(maxCompletedJobs),
-      observer_(NULL)
+      observer_(NULL),
+      trackChanges_(false),
+      targetMaxConcurrency_(0),
+      virtualTime_(0)
     {
     }
 
@@ -150,6 +233,13 @@ namespace Orthanc
                  const Json::Value& s,
                  size_t maxCompletedJobs);
 
+    // The jobs are only unserialized once they are accessed, so the
+    // "unserializer" must live as long as the registry. Changes are
+    // tracked from the start.
+    JobsRegistry(IJobUnserializer& unserializer,
+                 const SerializedJobs& records,
+                 size_t maxCompletedJobs);
+
     ~JobsRegistry();
 
     void SetMaxCompletedJobs(size_t i);
@@ -158,6 +248,26 @@ namespace Orthanc
 
     void ListJobs(std::set<std::string>& target);
 
+    // Lists the jobs by increasing creation time, only keeping those
+    // whose state belongs to "states" and whose type is "jobType" (an
+    // empty set or an empty string disables the corresponding
+    // filter). The "since" first matching jobs are skipped, and at
+    // most "limit" jobs are returned (0 means no limit). Only the
+    // returned jobs are accessed (new in Orthanc 1.5.7).
+    void ListJobs(std::list<JobInfo>& target,
+                  const std::set<JobState>& states,
+                  const std::string& jobType,
+                  size_t since,
+                  size_t limit);
+
+    // Same as above, but only returns the IDs of the jobs, which
+    // never accesses the jobs themselves (new in Orthanc 1.5.7)
+    void ListJobs(std::list<std::string>& target,
+                  const std::set<JobState>& states,
+                  const std::string& jobType,
+                  size_t since,
+                  size_t limit);
+
     bool GetJobInfo(JobInfo& target,
                     const std::string& id);
 
@@ -167,6 +277,20 @@ namespace Orthanc
                       const std::string& key);
 
     void Serialize(Json::Value& target);
+
+    // Once enabled, the registry records the jobs whose state has
+    // changed, which can be retrieved with "ConsumeChanges()"
+    void SetTrackChanges(bool track);
+
+    // Returns the records of the jobs that have changed, and the IDs
+    // of the jobs that have left the registry, since the last call
+    void ConsumeChanges(SerializedJobs& changed,
+                        std::set<std::string>& removed);
+
+    // Gives back the changes returned by "ConsumeChanges()" if they
+    // could not be stored, so that the next call returns them again
+    void RestoreChanges(const SerializedJobs& changed,
+                        const std::set<std::string>& removed);
     
     void Submit(std::string& id,
                 IJob* job,        // Takes ownership
@@ -175,9 +299,22 @@ namespace Orthanc
     void Submit(IJob* job,        // Takes ownership
                 int priority);
 
+    // The job only starts once all the jobs whose IDs are listed in
+    // "dependencies" have succeeded. It is canceled if one of them
+    // fails or is canceled (new in Orthanc 1.5.7)
+    void Submit(std::string& id,
+                IJob* job,        // Takes ownership
+                int priority,
+                const std::set<std::string>& dependencies);
+
     void SubmitAndWait(Json::Value& successContent,
                        IJob* job,        // Takes ownership
                        int priority);
+
+    void SubmitAndWait(Json::Value& successContent,
+                       IJob* job,        // Takes ownership
+                       int priority,
+                       const std::set<std::string>& dependencies);
     
     bool SetPriority(const std::string& id,
                      int priority);
@@ -199,6 +336,25 @@ namespace Orthanc
 
     void ResetObserver();
 
+    // Tells whether some pending job could be started right now,
+    // given the limits on the concurrency
+    bool HasPendingJobs();
+
+    // Maximum number of running jobs of the given type (0 means no limit)
+    void SetTypeMaxConcurrency(const std::string& type,
+                               unsigned int maxConcurrency);
+
+    // The classes of jobs get a share of the workers that is
+    // proportional to the weight of their type (by default, 1)
+    void SetTypeWeight(const std::string& type,
+                       unsigned int weight);
+
+    // Maximum number of running jobs accessing the same target, as
+    // reported by "ITargetedJob" (0 means no limit)
+    void SetTargetMaxConcurrency(unsigned int maxConcurrency);
+
+    void GetClassesStatistics(std::list<JobClassStatistics>& target);
+
     void GetStatistics(unsigned int& pending,
                        unsigned int& running,
                        unsigned int& success,
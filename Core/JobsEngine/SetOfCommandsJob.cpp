@@ -46,7 +46,11 @@ namespace Orthanc
   SetOfCommandsJob::SetOfCommandsJob() :
     started_(false),
     permissive_(false),
-    position_(0)
+    position_(0),
+    maxConcurrency_(1),
+    nextCommand_(0),
+    runningCommands_(0),
+    hasFailure_(false)
   {
   }
 
@@ -104,11 +108,34 @@ namespace Orthanc
   }
 
 
+  void SetOfCommandsJob::SetMaxConcurrency(unsigned int count)
+  {
+    if (count == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+    else if (started_)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+    else
+    {
+      maxConcurrency_ = count;
+    }
+  }
+
+
   void SetOfCommandsJob::Reset()
   {
     if (started_)
     {
+      boost::mutex::scoped_lock lock(mutex_);
+      assert(runningCommands_ == 0);
+
       position_ = 0;
+      nextCommand_ = 0;
+      completedAhead_.clear();
+      hasFailure_ = false;
     }
     else
     {
@@ -125,7 +152,8 @@ namespace Orthanc
     }
     else
     {
-      return (static_cast<float>(position_) /
+      boost::mutex::scoped_lock lock(mutex_);
+      return (static_cast<float>(position_ + completedAhead_.size()) /
               static_cast<float>(commands_.size()));
     }
   }
@@ -145,6 +173,188 @@ namespace Orthanc
   }
       
 
+  bool SetOfCommandsJob::ClaimCommand(size_t& index)
+  {
+    // The mutex must be locked by the caller
+    if (started_ &&
+        !hasFailure_ &&
+        nextCommand_ < GetConcurrentCommandsCount() &&
+        runningCommands_ < maxConcurrency_)
+    {
+      index = nextCommand_;
+      nextCommand_++;
+      runningCommands_++;
+      return true;
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+
+  void SetOfCommandsJob::ExecuteClaimedCommand(size_t index)
+  {
+    assert(index < commands_.size() &&
+           commands_[index] != NULL);
+
+    bool failed = false;
+    JobStepResult failure;
+
+    try
+    {
+      if (!commands_[index]->Execute() &&
+          !permissive_)
+      {
+        failed = true;
+        failure = JobStepResult::Failure(ErrorCode_InternalError, NULL);
+      }
+    }
+    catch (OrthancException& e)
+    {
+      if (permissive_)
+      {
+        LOG(WARNING) << "Ignoring an error in a permissive job: " << e.What();
+      }
+      else
+      {
+        failed = true;
+        failure = JobStepResult::Failure(e);
+      }
+    }
+    catch (...)
+    {
+      // This method can be invoked by a helper worker of the jobs
+      // engine, which cannot handle exceptions
+      if (permissive_)
+      {
+        LOG(WARNING) << "Ignoring an error in a permissive job";
+      }
+      else
+      {
+        failed = true;
+        failure = JobStepResult::Failure(ErrorCode_InternalError, NULL);
+      }
+    }
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      assert(runningCommands_ > 0);
+      runningCommands_--;
+
+      if (failed)
+      {
+        // Only the first failure is reported
+        if (!hasFailure_)
+        {
+          hasFailure_ = true;
+          failure_ = failure;
+        }
+      }
+      else
+      {
+        completedAhead_.insert(index);
+
+        while (!completedAhead_.empty() &&
+               *completedAhead_.begin() == position_)
+        {
+          completedAhead_.erase(completedAhead_.begin());
+          position_++;
+        }
+      }
+    }
+
+    commandDone_.notify_all();
+  }
+
+
+  bool SetOfCommandsJob::StepConcurrent(JobStepResult& result)
+  {
+    size_t index;
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      for (;;)
+      {
+        if (hasFailure_)
+        {
+          result = failure_;
+          return true;
+        }
+        else if (ClaimCommand(index))
+        {
+          break;
+        }
+        else if (runningCommands_ == 0)
+        {
+          // All the concurrent commands are over
+          assert(completedAhead_.empty() &&
+                 position_ >= GetConcurrentCommandsCount());
+
+          if (position_ == commands_.size())
+          {
+            result = JobStepResult::Success();
+            return true;
+          }
+          else
+          {
+            return false;  // The trailing commands are run by "Step()"
+          }
+        }
+        else
+        {
+          // Wait for one of the helpers to complete its command
+          commandDone_.wait(lock);
+        }
+      }
+    }
+
+    ExecuteClaimedCommand(index);
+
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (hasFailure_)
+    {
+      result = failure_;
+    }
+    else if (position_ == commands_.size())
+    {
+      result = JobStepResult::Success();
+    }
+    else
+    {
+      result = JobStepResult::Continue();
+    }
+
+    return true;
+  }
+
+
+  bool SetOfCommandsJob::ExecuteWorkItem()
+  {
+    if (maxConcurrency_ <= 1)
+    {
+      return false;
+    }
+
+    size_t index;
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      if (!ClaimCommand(index))
+      {
+        return false;
+      }
+    }
+
+    ExecuteClaimedCommand(index);
+    return true;
+  }
+
+
   JobStepResult SetOfCommandsJob::Step()
   {
     if (!started_)
@@ -166,6 +376,15 @@ namespace Orthanc
       throw OrthancException(ErrorCode_BadSequenceOfCalls);
     }
 
+    if (maxConcurrency_ > 1)
+    {
+      JobStepResult result;
+      if (StepConcurrent(result))
+      {
+        return result;
+      }
+    }
+
     try
     {
       // Not at the trailing step: Handle the current command
@@ -190,7 +409,11 @@ namespace Orthanc
       }
     }
 
-    position_ += 1;
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      position_ += 1;
+      nextCommand_ = position_;
+    }
 
     if (position_ == commands_.size())
     {
@@ -210,6 +433,7 @@ namespace Orthanc
   static const char* KEY_POSITION = "Position";
   static const char* KEY_TYPE = "Type";
   static const char* KEY_COMMANDS = "Commands";
+  static const char* KEY_MAX_CONCURRENCY = "MaxConcurrency";
 
   
   void SetOfCommandsJob::GetPublicContent(Json::Value& value)
@@ -227,8 +451,13 @@ namespace Orthanc
     target[KEY_TYPE] = type;
     
     target[KEY_PERMISSIVE] = permissive_;
-    target[KEY_POSITION] = static_cast<unsigned int>(position_);
     target[KEY_DESCRIPTION] = description_;
+    target[KEY_MAX_CONCURRENCY] = maxConcurrency_;
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      target[KEY_POSITION] = static_cast<unsigned int>(position_);
+    }
 
     target[KEY_COMMANDS] = Json::arrayValue;
     Json::Value& tmp = target[KEY_COMMANDS];
@@ -248,13 +477,31 @@ namespace Orthanc
 
   SetOfCommandsJob::SetOfCommandsJob(ICommandUnserializer* unserializer,
                                      const Json::Value& source) :
-    started_(false)
+    started_(false),
+    runningCommands_(0),
+    hasFailure_(false)
   {
     std::auto_ptr<ICommandUnserializer> raii(unserializer);
 
     permissive_ = SerializationToolbox::ReadBoolean(source, KEY_PERMISSIVE);
     position_ = SerializationToolbox::ReadUnsignedInteger(source, KEY_POSITION);
     description_ = SerializationToolbox::ReadString(source, KEY_DESCRIPTION);
+    nextCommand_ = position_;
+
+    if (source.isMember(KEY_MAX_CONCURRENCY))
+    {
+      maxConcurrency_ = SerializationToolbox::ReadUnsignedInteger(source, KEY_MAX_CONCURRENCY);
+
+      if (maxConcurrency_ == 0)
+      {
+        throw OrthancException(ErrorCode_BadFileFormat);
+      }
+    }
+    else
+    {
+      // Backward compatibility with Orthanc <= 1.5.6
+      maxConcurrency_ = 1;
+    }
     
     if (!source.isMember(KEY_COMMANDS) ||
         source[KEY_COMMANDS].type() != Json::arrayValue)
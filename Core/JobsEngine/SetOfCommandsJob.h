@@ -34,12 +34,15 @@
 #pragma once
 
 #include "IJob.h"
+#include "IParallelJob.h"
 
 #include <set>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
 
 namespace Orthanc
 {
-  class SetOfCommandsJob : public IJob
+  class SetOfCommandsJob : public IJob, public IParallelJob
   {
   public:
     class ICommand : public boost::noncopyable
@@ -70,6 +73,47 @@ namespace Orthanc
     bool                    permissive_;
     size_t                  position_;
     std::string             description_;
+    unsigned int            maxConcurrency_;
+
+    /**
+     * Bookkeeping of the concurrent execution of the commands, if
+     * "maxConcurrency_ > 1". In this case, "position_" is the number
+     * of commands that are completed without gap since the beginning
+     * of the job, which is what is serialized: If the job is resumed
+     * after a restart of Orthanc, the few commands that were
+     * completed out of order are executed once again.
+     **/
+    boost::mutex               mutex_;
+    boost::condition_variable  commandDone_;
+    size_t                     nextCommand_;     // Next command to be claimed
+    std::set<size_t>           completedAhead_;  // Completed commands after "position_"
+    unsigned int               runningCommands_;
+    bool                       hasFailure_;
+    JobStepResult              failure_;
+
+    bool ClaimCommand(size_t& index);
+
+    void ExecuteClaimedCommand(size_t index);
+
+    bool StepConcurrent(JobStepResult& result);
+
+  protected:
+    /**
+     * Allows up to "count" commands of this job to be executed at the
+     * same time, by the worker that runs "Step()" and by the idle
+     * workers of the jobs engine (cf. "IParallelJob"). Only the
+     * subclasses whose commands are thread-safe and independent can
+     * enable this feature.
+     **/
+    void SetMaxConcurrency(unsigned int count);
+
+    // The commands whose index is above this value are not executed
+    // concurrently, but one by one once all the previous commands are
+    // over (e.g. the trailing step of SetOfInstancesJob)
+    virtual size_t GetConcurrentCommandsCount() const
+    {
+      return commands_.size();
+    }
 
   public:
     SetOfCommandsJob();
@@ -110,6 +154,11 @@ namespace Orthanc
 
     void SetPermissive(bool permissive);
 
+    unsigned int GetMaxConcurrency() const
+    {
+      return maxConcurrency_;
+    }
+
     virtual void Reset();
     
     virtual void Start()
@@ -127,6 +176,8 @@ namespace Orthanc
     const ICommand& GetCommand(size_t index) const;
       
     virtual JobStepResult Step();
+
+    virtual bool ExecuteWorkItem();
     
     virtual void GetPublicContent(Json::Value& value);
     
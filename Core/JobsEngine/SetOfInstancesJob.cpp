@@ -64,6 +64,7 @@ namespace Orthanc
     {
       if (!that_.HandleInstance(instance_))
       {
+        boost::mutex::scoped_lock lock(that_.failedInstancesMutex_);
         that_.failedInstances_.insert(instance_);
         return false;
       }
@@ -179,6 +180,13 @@ namespace Orthanc
   }
 
 
+  bool SetOfInstancesJob::IsFailedInstance(const std::string& instance) const
+  {
+    boost::mutex::scoped_lock lock(failedInstancesMutex_);
+    return failedInstances_.find(instance) != failedInstances_.end();
+  }
+
+
   void SetOfInstancesJob::Start()
   {
     SetOfCommandsJob::Start();    
@@ -189,6 +197,7 @@ namespace Orthanc
   {
     SetOfCommandsJob::Reset();
 
+    boost::mutex::scoped_lock lock(failedInstancesMutex_);
     failedInstances_.clear();
   }
 
@@ -197,6 +206,8 @@ namespace Orthanc
   {
     SetOfCommandsJob::GetPublicContent(target);
     target["InstancesCount"] = static_cast<uint32_t>(GetInstancesCount());
+
+    boost::mutex::scoped_lock lock(failedInstancesMutex_);
     target["FailedInstancesCount"] = static_cast<uint32_t>(failedInstances_.size());
   }    
 
@@ -210,6 +221,8 @@ namespace Orthanc
     if (SetOfCommandsJob::Serialize(target))
     {
       target[KEY_TRAILING_STEP] = hasTrailingStep_;
+
+      boost::mutex::scoped_lock lock(failedInstancesMutex_);
       SerializationToolbox::WriteSetOfStrings(target, failedInstances_, KEY_FAILED_INSTANCES);
       return true;
     }
@@ -48,6 +48,7 @@ namespace Orthanc
     class InstanceUnserializer;
     
     bool                   hasTrailingStep_;
+    mutable boost::mutex   failedInstancesMutex_;
     std::set<std::string>  failedInstances_;
 
   protected:
@@ -58,6 +59,12 @@ namespace Orthanc
     // Hiding this method, use AddInstance() instead
     using SetOfCommandsJob::AddCommand;
 
+    virtual size_t GetConcurrentCommandsCount() const
+    {
+      // The trailing step is never executed concurrently
+      return GetInstancesCount();
+    }
+
   public:
     SetOfInstancesJob();
 
@@ -76,15 +83,13 @@ namespace Orthanc
       return hasTrailingStep_;
     }
 
+    // Must not be called while the job is running
     const std::set<std::string>& GetFailedInstances() const
     {
       return failedInstances_;
     }
 
-    bool IsFailedInstance(const std::string& instance) const
-    {
-      return failedInstances_.find(instance) != failedInstances_.end();
-    }
+    bool IsFailedInstance(const std::string& instance) const;
 
     virtual void Start();
 
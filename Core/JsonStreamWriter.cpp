@@ -0,0 +1,370 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2019 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "PrecompiledHeaders.h"
+#include "JsonStreamWriter.h"
+
+#include "OrthancException.h"
+
+#include <boost/math/special_functions/fpclassify.hpp>
+#include <stdio.h>
+#include <string.h>
+
+
+namespace Orthanc
+{
+  JsonStreamWriter::JsonStreamWriter(std::string& target) :
+    target_(target),
+    afterKey_(false),
+    hasRoot_(false)
+  {
+  }
+
+
+  void JsonStreamWriter::StartValue()
+  {
+    if (afterKey_)
+    {
+      // This value is the member of an object
+      afterKey_ = false;
+    }
+    else if (isFirst_.empty())
+    {
+      // This value is the root of the document
+      if (hasRoot_)
+      {
+        throw OrthancException(ErrorCode_BadSequenceOfCalls);
+      }
+
+      hasRoot_ = true;
+    }
+    else if (isObject_.back())
+    {
+      // The members of an object must be preceded by a key
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+    else
+    {
+      // This value is an element of an array
+      if (!isFirst_.back())
+      {
+        target_.push_back(',');
+      }
+
+      isFirst_.back() = false;
+    }
+  }
+
+
+  void JsonStreamWriter::WriteQuotedString(const char* value,
+                                           size_t size)
+  {
+    static const char HEX[] = "0123456789abcdef";
+
+    target_.push_back('"');
+
+    // Copy the runs of characters that need no escaping at once
+    size_t start = 0;
+    for (size_t i = 0; i < size; i++)
+    {
+      const unsigned char c = static_cast<unsigned char>(value[i]);
+
+      if (c >= 0x20 &&
+          c != '"' &&
+          c != '\\')
+      {
+        continue;
+      }
+
+      target_.append(value + start, i - start);
+      start = i + 1;
+
+      switch (c)
+      {
+        case '"':
+          target_.append("\\\"", 2);
+          break;
+
+        case '\\':
+          target_.append("\\\\", 2);
+          break;
+
+        case '\b':
+          target_.append("\\b", 2);
+          break;
+
+        case '\f':
+          target_.append("\\f", 2);
+          break;
+
+        case '\n':
+          target_.append("\\n", 2);
+          break;
+
+        case '\r':
+          target_.append("\\r", 2);
+          break;
+
+        case '\t':
+          target_.append("\\t", 2);
+          break;
+
+        default:
+        {
+          char escaped[6] = { '\\', 'u', '0', '0', HEX[c >> 4], HEX[c & 0x0f] };
+          target_.append(escaped, 6);
+          break;
+        }
+      }
+    }
+
+    target_.append(value + start, size - start);
+    target_.push_back('"');
+  }
+
+
+  void JsonStreamWriter::StartObject()
+  {
+    StartValue();
+    target_.push_back('{');
+    isFirst_.push_back(true);
+    isObject_.push_back(true);
+  }
+
+
+  void JsonStreamWriter::EndObject()
+  {
+    if (isFirst_.empty() ||
+        !isObject_.back() ||
+        afterKey_)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    target_.push_back('}');
+    isFirst_.pop_back();
+    isObject_.pop_back();
+  }
+
+
+  void JsonStreamWriter::StartArray()
+  {
+    StartValue();
+    target_.push_back('[');
+    isFirst_.push_back(true);
+    isObject_.push_back(false);
+  }
+
+
+  void JsonStreamWriter::EndArray()
+  {
+    if (isFirst_.empty() ||
+        isObject_.back())
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    target_.push_back(']');
+    isFirst_.pop_back();
+    isObject_.pop_back();
+  }
+
+
+  void JsonStreamWriter::WriteKey(const char* key,
+                                  size_t size)
+  {
+    if (isFirst_.empty() ||
+        !isObject_.back() ||
+        afterKey_)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    if (!isFirst_.back())
+    {
+      target_.push_back(',');
+    }
+
+    isFirst_.back() = false;
+
+    WriteQuotedString(key, size);
+    target_.push_back(':');
+    afterKey_ = true;
+  }
+
+
+  void JsonStreamWriter::WriteKey(const char* key)
+  {
+    WriteKey(key, strlen(key));
+  }
+
+
+  void JsonStreamWriter::WriteString(const char* value,
+                                     size_t size)
+  {
+    StartValue();
+    WriteQuotedString(value, size);
+  }
+
+
+  void JsonStreamWriter::WriteString(const char* value)
+  {
+    WriteString(value, strlen(value));
+  }
+
+
+  void JsonStreamWriter::WriteNull()
+  {
+    StartValue();
+    target_.append("null", 4);
+  }
+
+
+  void JsonStreamWriter::WriteBoolean(bool value)
+  {
+    StartValue();
+
+    if (value)
+    {
+      target_.append("true", 4);
+    }
+    else
+    {
+      target_.append("false", 5);
+    }
+  }
+
+
+  void JsonStreamWriter::WriteInteger(int64_t value)
+  {
+    StartValue();
+
+    char buffer[32];
+    sprintf(buffer, "%lld", static_cast<long long>(value));
+    target_.append(buffer);
+  }
+
+
+  void JsonStreamWriter::WriteUnsignedInteger(uint64_t value)
+  {
+    StartValue();
+
+    char buffer[32];
+    sprintf(buffer, "%llu", static_cast<unsigned long long>(value));
+    target_.append(buffer);
+  }
+
+
+  void JsonStreamWriter::WriteDouble(double value)
+  {
+    if (!boost::math::isfinite(value))
+    {
+      // Infinity and NaN cannot be represented in JSON
+      WriteNull();
+      return;
+    }
+
+    StartValue();
+
+    char buffer[32];
+    sprintf(buffer, "%.17g", value);
+
+    // Make sure the value is parsed back as a real number
+    if (strpbrk(buffer, ".eE") == NULL)
+    {
+      strcat(buffer, ".0");
+    }
+
+    target_.append(buffer);
+  }
+
+
+  void JsonStreamWriter::WriteValue(const Json::Value& value)
+  {
+    switch (value.type())
+    {
+      case Json::nullValue:
+        WriteNull();
+        break;
+
+      case Json::intValue:
+        WriteInteger(value.asInt64());
+        break;
+
+      case Json::uintValue:
+        WriteUnsignedInteger(value.asUInt64());
+        break;
+
+      case Json::realValue:
+        WriteDouble(value.asDouble());
+        break;
+
+      case Json::stringValue:
+        WriteString(value.asString());
+        break;
+
+      case Json::booleanValue:
+        WriteBoolean(value.asBool());
+        break;
+
+      case Json::arrayValue:
+        StartArray();
+
+        for (Json::Value::ArrayIndex i = 0; i < value.size(); i++)
+        {
+          WriteValue(value[i]);
+        }
+
+        EndArray();
+        break;
+
+      case Json::objectValue:
+      {
+        StartObject();
+
+        Json::Value::Members members = value.getMemberNames();
+        for (size_t i = 0; i < members.size(); i++)
+        {
+          WriteKey(members[i]);
+          WriteValue(value[members[i]]);
+        }
+
+        EndObject();
+        break;
+      }
+
+      default:
+        throw OrthancException(ErrorCode_InternalError);
+    }
+  }
+}
@@ -0,0 +1,111 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2019 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+
+#include <boost/noncopyable.hpp>
+#include <json/value.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace Orthanc
+{
+  // Writes a compact JSON document directly into a string, without
+  // building an intermediate "Json::Value". The separators between
+  // the members of objects and arrays are inserted automatically.
+  class JsonStreamWriter : public boost::noncopyable
+  {
+  private:
+    std::string&       target_;
+    std::vector<bool>  isFirst_;   // One entry per open object or array
+    std::vector<bool>  isObject_;
+    bool               afterKey_;
+    bool               hasRoot_;
+
+    void StartValue();
+
+    void WriteQuotedString(const char* value,
+                           size_t size);
+
+  public:
+    explicit JsonStreamWriter(std::string& target);
+
+    // Whether a full JSON document has been written
+    bool IsComplete() const
+    {
+      return hasRoot_ && isFirst_.empty();
+    }
+
+    void StartObject();
+
+    void EndObject();
+
+    void StartArray();
+
+    void EndArray();
+
+    void WriteKey(const std::string& key)
+    {
+      WriteKey(key.c_str(), key.size());
+    }
+
+    void WriteKey(const char* key,
+                  size_t size);
+
+    void WriteKey(const char* key);
+
+    void WriteString(const std::string& value)
+    {
+      WriteString(value.c_str(), value.size());
+    }
+
+    void WriteString(const char* value,
+                     size_t size);
+
+    void WriteString(const char* value);
+
+    void WriteNull();
+
+    void WriteBoolean(bool value);
+
+    void WriteInteger(int64_t value);
+
+    void WriteUnsignedInteger(uint64_t value);
+
+    void WriteDouble(double value);
+
+    // Writes a (small) JSON tree
+    void WriteValue(const Json::Value& value);
+  };
+}
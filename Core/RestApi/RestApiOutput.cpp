@@ -58,7 +58,11 @@ namespace Orthanc
 
   void RestApiOutput::Finalize()
   {
-    if (!alreadySent_)
+    if (output_.IsWritingMultipart())
+    {
+      output_.CloseMultipart();
+    }
+    else if (!alreadySent_)
     {
       if (method_ == HttpMethod_Post)
       {
@@ -219,4 +223,29 @@ namespace Orthanc
     // empty string
     SetCookie(name, "", 1);
   }
+
+
+  void RestApiOutput::StartMultipart(const std::string& subType,
+                                     const std::string& contentType)
+  {
+    CheckStatus();
+    output_.StartMultipart(subType, contentType);
+    alreadySent_ = true;
+  }
+
+  void RestApiOutput::SendMultipartItem(const std::string& item,
+                                        const std::map<std::string, std::string>& headers)
+  {
+    if (!output_.IsWritingMultipart())
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+
+    output_.SendMultipartItem(item.empty() ? NULL : item.c_str(), item.size(), headers);
+  }
+
+  void RestApiOutput::CloseMultipart()
+  {
+    output_.CloseMultipart();
+  }
 }
@@ -94,6 +94,14 @@ namespace Orthanc
 
     void ResetCookie(const std::string& name);
 
+    void StartMultipart(const std::string& subType,
+                        const std::string& contentType);
+
+    void SendMultipartItem(const std::string& item,
+                           const std::map<std::string, std::string>& headers);
+
+    void CloseMultipart();
+
     void Finalize();
   };
 }
@@ -283,6 +283,54 @@ namespace Orthanc
   }
 
 
+  void SystemToolbox::ReadFileRange(std::string& content,
+                                    const std::string& path,
+                                    uint64_t start,
+                                    uint64_t end)
+  {
+    if (start > end)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    if (!IsRegularFile(path))
+    {
+      throw OrthancException(ErrorCode_RegularFileExpected,
+                             "The path does not point to a regular file: " + path);
+    }
+
+    boost::filesystem::ifstream f;
+    f.open(path, std::ifstream::in | std::ifstream::binary);
+    if (!f.good())
+    {
+      throw OrthancException(ErrorCode_InexistentFile);
+    }
+
+    std::streamsize size = GetStreamSize(f);
+    if (size < 0 ||
+        static_cast<uint64_t>(size) < end)
+    {
+      throw OrthancException(ErrorCode_CorruptedFile,
+                             "The range exceeds the size of the file: " + path);
+    }
+
+    content.resize(static_cast<size_t>(end - start));
+
+    if (!content.empty())
+    {
+      f.seekg(static_cast<std::streamoff>(start), std::ios::beg);
+      f.read(&content[0], static_cast<std::streamsize>(content.size()));
+
+      if (!f.good())
+      {
+        throw OrthancException(ErrorCode_CorruptedFile);
+      }
+    }
+
+    f.close();
+  }
+
+
   void SystemToolbox::WriteFile(const void* content,
                                 size_t size,
                                 const std::string& path)
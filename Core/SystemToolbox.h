@@ -65,6 +65,11 @@ namespace Orthanc
                     const std::string& path,
                     size_t headerSize);
 
+    void ReadFileRange(std::string& content,
+                       const std::string& path,
+                       uint64_t start,
+                       uint64_t end);
+
     void WriteFile(const void* content,
                    size_t size,
                    const std::string& path);
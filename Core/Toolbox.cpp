@@ -67,6 +67,19 @@
 
 #if ORTHANC_ENABLE_LOCALE == 1
 #  include <boost/locale.hpp>
+#  include <boost/shared_ptr.hpp>
+#endif
+
+#if !defined(ORTHANC_ENABLE_SIMD) || ORTHANC_ENABLE_SIMD == 1
+#  if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+// SSE2 is part of the baseline of the x86_64 architecture
+#    include <emmintrin.h>
+#    define ORTHANC_TOOLBOX_SSE2 1
+#  endif
+#endif
+
+#if !defined(ORTHANC_TOOLBOX_SSE2)
+#  define ORTHANC_TOOLBOX_SSE2 0
 #endif
 
 #if ORTHANC_ENABLE_SSL == 1
@@ -554,6 +567,280 @@ namespace Orthanc
 #endif
 
 
+#if ORTHANC_ENABLE_LOCALE == 1
+  // Returns "true" iff the string is valid UTF-8. Overlong forms,
+  // surrogates and code points above U+10FFFF are rejected, just like
+  // boost::locale does.
+  static bool IsValidUtf8(const std::string& s)
+  {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(s.c_str());
+    const size_t size = s.size();
+    size_t i = 0;
+
+    while (i < size)
+    {
+#if ORTHANC_TOOLBOX_SSE2 == 1
+      // Skip the blocks of 16 ASCII characters
+      while (i + 16 <= size &&
+             _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i))) == 0)
+      {
+        i += 16;
+      }
+
+      if (i == size)
+      {
+        break;
+      }
+#endif
+
+      const uint8_t c = p[i];
+      size_t length;
+      uint8_t low = 0x80, high = 0xbf;  // Range of the second byte
+
+      if (c < 0x80)
+      {
+        i++;
+        continue;
+      }
+      else if (c >= 0xc2 && c <= 0xdf)
+      {
+        length = 2;
+      }
+      else if (c >= 0xe0 && c <= 0xef)
+      {
+        length = 3;
+        if (c == 0xe0)
+        {
+          low = 0xa0;  // Overlong form
+        }
+        else if (c == 0xed)
+        {
+          high = 0x9f;  // Surrogates
+        }
+      }
+      else if (c >= 0xf0 && c <= 0xf4)
+      {
+        length = 4;
+        if (c == 0xf0)
+        {
+          low = 0x90;  // Overlong form
+        }
+        else if (c == 0xf4)
+        {
+          high = 0x8f;  // Above U+10FFFF
+        }
+      }
+      else
+      {
+        return false;
+      }
+
+      if (i + length > size ||
+          p[i + 1] < low ||
+          p[i + 1] > high)
+      {
+        return false;
+      }
+
+      for (size_t j = 2; j < length; j++)
+      {
+        if ((p[i + j] & 0xc0) != 0x80)
+        {
+          return false;
+        }
+      }
+
+      i += length;
+    }
+
+    return true;
+  }
+
+
+  // Tells whether the characters of the ASCII string (as defined by
+  // "IsAsciiString()") are unchanged by the conversion from/to UTF-8
+  static bool IsAsciiCompatible(Encoding encoding)
+  {
+    switch (encoding)
+    {
+      case Encoding_Ascii:
+      case Encoding_Utf8:
+      case Encoding_Latin1:
+      case Encoding_Latin2:
+      case Encoding_Latin3:
+      case Encoding_Latin4:
+      case Encoding_Latin5:
+      case Encoding_Cyrillic:
+      case Encoding_Windows1251:
+      case Encoding_Arabic:
+      case Encoding_Greek:
+      case Encoding_Hebrew:
+      case Encoding_Thai:
+      case Encoding_Chinese:
+      case Encoding_SimplifiedChinese:
+        return true;
+
+      default:
+        // Shift-JIS might map the backslash onto the Yen sign, and the
+        // Korean and JIS charsets have a specific handling of G0
+        return false;
+    }
+  }
+
+
+  /**
+   * Conversion tables for the single-byte charsets, that are computed
+   * once by "InitializeGlobalLocale()" using boost::locale. This
+   * avoids the creation of one boost::locale (i.e. iconv or ICU)
+   * converter for each converted string, which is costly. The tables
+   * are read-only afterwards, so they can be shared by all the threads.
+   **/
+  namespace
+  {
+    class SingleByteCharset : public boost::noncopyable
+    {
+    private:
+      typedef std::map<uint32_t, char>  FromUnicode;
+
+      std::string   toUtf8_[128];  // For the bytes in the range 0x80-0xff
+      FromUnicode   fromUnicode_;
+
+    public:
+      explicit SingleByteCharset(const char* encoding)
+      {
+        for (unsigned int i = 0; i < 128; i++)
+        {
+          const char c = static_cast<char>(0x80 + i);
+
+          // Empty string if the byte is not part of the charset
+          toUtf8_[i] = boost::locale::conv::to_utf<char>
+            (std::string(1, c), encoding, boost::locale::conv::skip);
+
+          if (!toUtf8_[i].empty())
+          {
+            uint32_t unicode;
+            size_t length;
+            Toolbox::Utf8ToUnicodeCharacter(unicode, length, toUtf8_[i], 0);
+
+            if (length == toUtf8_[i].size() &&
+                fromUnicode_.find(unicode) == fromUnicode_.end())
+            {
+              fromUnicode_[unicode] = c;
+            }
+          }
+        }
+      }
+
+      void ToUtf8(std::string& target,
+                  const std::string& source) const
+      {
+        target.clear();
+        target.reserve(source.size() + source.size() / 2);
+
+        for (size_t i = 0; i < source.size(); i++)
+        {
+          const uint8_t c = static_cast<uint8_t>(source[i]);
+          if (c < 0x80)
+          {
+            target.push_back(source[i]);
+          }
+          else
+          {
+            target.append(toUtf8_[c - 0x80]);
+          }
+        }
+      }
+
+      // The source must be valid UTF-8. The characters that are not
+      // part of the charset are skipped.
+      void FromUtf8(std::string& target,
+                    const std::string& source) const
+      {
+        target.clear();
+        target.reserve(source.size());
+
+        size_t i = 0;
+        while (i < source.size())
+        {
+          const uint8_t c = static_cast<uint8_t>(source[i]);
+          if (c < 0x80)
+          {
+            target.push_back(source[i]);
+            i++;
+          }
+          else
+          {
+            uint32_t unicode;
+            size_t length;
+            Toolbox::Utf8ToUnicodeCharacter(unicode, length, source, i);
+
+            FromUnicode::const_iterator found = fromUnicode_.find(unicode);
+            if (found != fromUnicode_.end())
+            {
+              target.push_back(found->second);
+            }
+
+            i += length;
+          }
+        }
+      }
+    };
+  }
+
+  typedef std::map<Encoding, boost::shared_ptr<SingleByteCharset> >  SingleByteCharsets;
+  static SingleByteCharsets  singleByteCharsets_;
+
+
+  static const SingleByteCharset* LookupSingleByteCharset(Encoding encoding)
+  {
+    SingleByteCharsets::const_iterator found = singleByteCharsets_.find(encoding);
+    if (found == singleByteCharsets_.end())
+    {
+      return NULL;
+    }
+    else
+    {
+      return found->second.get();
+    }
+  }
+
+
+  static void InitializeSingleByteCharsets()
+  {
+    static const Encoding ENCODINGS[] = {
+      Encoding_Latin1,
+      Encoding_Latin2,
+      Encoding_Latin3,
+      Encoding_Latin4,
+      Encoding_Latin5,
+      Encoding_Cyrillic,
+      Encoding_Windows1251,
+      Encoding_Arabic,
+      Encoding_Greek,
+      Encoding_Hebrew,
+      Encoding_Thai
+    };
+
+    singleByteCharsets_.clear();
+
+    for (size_t i = 0; i < sizeof(ENCODINGS) / sizeof(Encoding); i++)
+    {
+      try
+      {
+        singleByteCharsets_[ENCODINGS[i]].reset
+          (new SingleByteCharset(GetBoostLocaleEncoding(ENCODINGS[i])));
+      }
+      catch (std::runtime_error& e)
+      {
+        // Unsupported charset: Fallback to boost::locale for each string
+        LOG(INFO) << "No conversion table for encoding "
+                  << EnumerationToString(ENCODINGS[i]) << ": " << e.what();
+      }
+    }
+  }
+#endif
+
+
 #if ORTHANC_ENABLE_LOCALE == 1
   // http://dicom.nema.org/medical/dicom/current/output/chtml/part03/sect_C.12.html#sect_C.12.1.1.2
   std::string Toolbox::ConvertToUtf8(const std::string& source,
@@ -571,6 +858,14 @@ namespace Orthanc
     // The "::skip" flag makes boost skip invalid UTF-8
     // characters. This can occur in badly-encoded DICOM files.
     
+    if (IsAsciiCompatible(sourceEncoding) &&
+        IsAsciiString(source))
+    {
+      // Fast path: Most of the strings in DICOM files only contain
+      // ASCII characters, that are not modified by the conversion
+      return source;
+    }
+
     try
     {
       if (sourceEncoding == Encoding_Ascii)
@@ -580,12 +875,24 @@ namespace Orthanc
       else 
       {
         std::string s;
+        const SingleByteCharset* charset = LookupSingleByteCharset(sourceEncoding);
         
         if (sourceEncoding == Encoding_Utf8)
         {
           // Already in UTF-8: No conversion is required, but we ensure
           // the output is correctly encoded
-          s = boost::locale::conv::utf_to_utf<char>(source, boost::locale::conv::skip);
+          if (IsValidUtf8(source))
+          {
+            s = source;
+          }
+          else
+          {
+            s = boost::locale::conv::utf_to_utf<char>(source, boost::locale::conv::skip);
+          }
+        }
+        else if (charset != NULL)
+        {
+          charset->ToUtf8(s, source);
         }
         else
         {
@@ -630,12 +937,26 @@ namespace Orthanc
     // The "::skip" flag makes boost skip invalid UTF-8
     // characters. This can occur in badly-encoded DICOM files.
     
+    if (IsAsciiCompatible(targetEncoding) &&
+        IsAsciiString(source))
+    {
+      // Fast path, as in "ConvertToUtf8()"
+      return source;
+    }
+
     try
     {
       if (targetEncoding == Encoding_Utf8)
       {
         // Already in UTF-8: No conversion is required.
-        return boost::locale::conv::utf_to_utf<char>(source, boost::locale::conv::skip);
+        if (IsValidUtf8(source))
+        {
+          return source;
+        }
+        else
+        {
+          return boost::locale::conv::utf_to_utf<char>(source, boost::locale::conv::skip);
+        }
       }
       else if (targetEncoding == Encoding_Ascii)
       {
@@ -643,8 +964,20 @@ namespace Orthanc
       }
       else
       {
-        const char* encoding = GetBoostLocaleEncoding(targetEncoding);
-        return boost::locale::conv::from_utf<char>(source, encoding, boost::locale::conv::skip);
+        const SingleByteCharset* charset = LookupSingleByteCharset(targetEncoding);
+
+        if (charset != NULL &&
+            IsValidUtf8(source))
+        {
+          std::string s;
+          charset->FromUtf8(s, source);
+          return s;
+        }
+        else
+        {
+          const char* encoding = GetBoostLocaleEncoding(targetEncoding);
+          return boost::locale::conv::from_utf<char>(source, encoding, boost::locale::conv::skip);
+        }
       }
     }
     catch (std::runtime_error&)
@@ -668,10 +1001,38 @@ namespace Orthanc
                               size_t size)
   {
     const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
+    size_t i = 0;
+
+#if ORTHANC_TOOLBOX_SSE2 == 1
+    const __m128i space = _mm_set1_epi8(0x20);
+    const __m128i del = _mm_set1_epi8(0x7f);
 
-    for (size_t i = 0; i < size; i++, p++)
+    for (; i + 16 <= size; i += 16)
     {
-      if (!IsAsciiCharacter(*p))
+      // The comparison is signed, so the bytes above 0x7f are
+      // negative, hence considered as below the space character
+      const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+      const __m128i bad = _mm_or_si128(_mm_cmplt_epi8(v, space),
+                                       _mm_cmpeq_epi8(v, del));
+
+      if (_mm_movemask_epi8(bad) != 0)
+      {
+        // Control character or non-ASCII byte: Check this block byte
+        // per byte, as the newline character is allowed
+        for (size_t j = i; j < i + 16; j++)
+        {
+          if (!IsAsciiCharacter(p[j]))
+          {
+            return false;
+          }
+        }
+      }
+    }
+#endif
+
+    for (; i < size; i++)
+    {
+      if (!IsAsciiCharacter(p[i]))
       {
         return false;
       }
@@ -689,6 +1050,11 @@ namespace Orthanc
 
   std::string Toolbox::ConvertToAscii(const std::string& source)
   {
+    if (IsAsciiString(source))
+    {
+      return source;
+    }
+
     std::string result;
 
     result.reserve(source.size() + 1);
@@ -1402,10 +1768,17 @@ namespace Orthanc
 
 #if ORTHANC_ENABLE_LOCALE == 1
   static std::auto_ptr<std::locale>  globalLocale_;
+  static bool                        globalLocaleAsciiUpper_ = false;
+
+  static char ToUpperAscii(char c)
+  {
+    return (c >= 'a' && c <= 'z') ? static_cast<char>(c - 'a' + 'A') : c;
+  }
 
   static bool SetGlobalLocale(const char* locale)
   {
     globalLocale_.reset(NULL);
+    globalLocaleAsciiUpper_ = false;
 
     try
     {
@@ -1424,6 +1797,23 @@ namespace Orthanc
     {
     }
 
+    if (globalLocale_.get() != NULL)
+    {
+      // Check whether the ASCII letters are made uppercase as in the
+      // "C" locale, which is not the case of the Turkish locales
+      const std::ctype<wchar_t>& facet = std::use_facet< std::ctype<wchar_t> >(*globalLocale_);
+
+      globalLocaleAsciiUpper_ = true;
+      for (int c = 0; c < 128; c++)
+      {
+        if (facet.toupper(static_cast<wchar_t>(c)) !=
+            static_cast<wchar_t>(ToUpperAscii(static_cast<char>(c))))
+        {
+          globalLocaleAsciiUpper_ = false;
+        }
+      }
+    }
+
     return (globalLocale_.get() != NULL);
   }
 
@@ -1567,12 +1957,14 @@ namespace Orthanc
                              "Cannot initialize global locale");
     }
 
+    InitializeSingleByteCharsets();
   }
 
 
   void Toolbox::FinalizeGlobalLocale()
   {
     globalLocale_.reset();
+    singleByteCharsets_.clear();
   }
 
 
@@ -1620,6 +2012,19 @@ namespace Orthanc
      * "utf_to_utf" in order to convert to/from std::wstring.
      **/
 
+    if (globalLocaleAsciiUpper_ &&
+        IsAsciiString(source))
+    {
+      // Fast path for ASCII strings, that are frequent in C-FIND
+      std::string result = source;
+      for (size_t i = 0; i < result.size(); i++)
+      {
+        result[i] = ToUpperAscii(result[i]);
+      }
+
+      return result;
+    }
+
     std::wstring w = boost::locale::conv::utf_to_utf<wchar_t>(source, boost::locale::conv::skip);
     w = boost::algorithm::to_upper_copy<std::wstring>(w, *globalLocale_);
     return boost::locale::conv::utf_to_utf<char>(w, boost::locale::conv::skip);
@@ -0,0 +1,131 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2019 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "../../PrecompiledHeadersServer.h"
+#include "IStoredJobs.h"
+
+#include "../../../Core/OrthancException.h"
+
+#include <json/reader.h>
+#include <json/writer.h>
+
+namespace Orthanc
+{
+  namespace Compatibility
+  {
+    static const char* const TYPE = "Type";
+    static const char* const JOBS = "Jobs";
+    static const char* const JOBS_REGISTRY = "JobsRegistry";
+
+
+    static bool ParseRegistry(Json::Value& target,
+                              const std::string& serialized)
+    {
+      Json::Reader reader;
+      return (reader.parse(serialized, target) &&
+              target.type() == Json::objectValue &&
+              target.isMember(TYPE) &&
+              target[TYPE].type() == Json::stringValue &&
+              target[TYPE].asString() == JOBS_REGISTRY &&
+              target.isMember(JOBS) &&
+              target[JOBS].type() == Json::objectValue);
+    }
+
+
+    void IStoredJobs::Load(IStoredJobs& database,
+                           std::map<std::string, std::string>& target)
+    {
+      target.clear();
+
+      std::string serialized;
+      if (!database.LookupGlobalProperty(serialized, GlobalProperty_JobsRegistry))
+      {
+        return;
+      }
+
+      Json::Value registry;
+      if (!ParseRegistry(registry, serialized))
+      {
+        throw OrthancException(ErrorCode_BadFileFormat,
+                               "Cannot parse the global property containing the jobs");
+      }
+
+      Json::FastWriter writer;
+
+      Json::Value::Members members = registry[JOBS].getMemberNames();
+      for (size_t i = 0; i < members.size(); i++)
+      {
+        target[members[i]] = writer.write(registry[JOBS][members[i]]);
+      }
+    }
+
+
+    void IStoredJobs::Update(IStoredJobs& database,
+                             const std::map<std::string, std::string>& changed,
+                             const std::set<std::string>& removed)
+    {
+      std::string serialized;
+      Json::Value registry;
+      if (!database.LookupGlobalProperty(serialized, GlobalProperty_JobsRegistry) ||
+          !ParseRegistry(registry, serialized))
+      {
+        // Start from scratch if the global property is missing or invalid
+        registry = Json::objectValue;
+        registry[TYPE] = JOBS_REGISTRY;
+        registry[JOBS] = Json::objectValue;
+      }
+
+      for (std::set<std::string>::const_iterator it = removed.begin();
+           it != removed.end(); ++it)
+      {
+        registry[JOBS].removeMember(*it);
+      }
+
+      Json::Reader reader;
+      for (std::map<std::string, std::string>::const_iterator it = changed.begin();
+           it != changed.end(); ++it)
+      {
+        Json::Value record;
+        if (!reader.parse(it->second, record))
+        {
+          throw OrthancException(ErrorCode_BadFileFormat);
+        }
+
+        registry[JOBS][it->first] = record;
+      }
+
+      Json::FastWriter writer;
+      database.SetGlobalProperty(GlobalProperty_JobsRegistry, writer.write(registry));
+    }
+  }
+}
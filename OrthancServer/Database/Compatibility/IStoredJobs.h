@@ -0,0 +1,69 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2019 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+
+#include "../../ServerEnumerations.h"
+
+#include <boost/noncopyable.hpp>
+#include <map>
+#include <set>
+
+namespace Orthanc
+{
+  namespace Compatibility
+  {
+    /**
+     * Fallback storage of the records of the jobs, for the database
+     * backends that have no dedicated table: All the records are
+     * stored in the global property "JobsRegistry", using the format
+     * of the jobs registry of Orthanc <= 1.5.6.
+     **/
+    class IStoredJobs : public boost::noncopyable
+    {
+    public:
+      virtual bool LookupGlobalProperty(std::string& target,
+                                        GlobalProperty property) = 0;
+
+      virtual void SetGlobalProperty(GlobalProperty property,
+                                     const std::string& value) = 0;
+
+      static void Load(IStoredJobs& database,
+                       std::map<std::string, std::string>& target);
+
+      static void Update(IStoredJobs& database,
+                         const std::map<std::string, std::string>& changed,
+                         const std::set<std::string>& removed);
+    };
+  }
+}
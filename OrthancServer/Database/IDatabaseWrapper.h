@@ -42,6 +42,7 @@
 #include "IDatabaseListener.h"
 
 #include <list>
+#include <set>
 #include <boost/noncopyable.hpp>
 
 namespace Orthanc
@@ -116,6 +117,13 @@ namespace Orthanc
                                  size_t since,
                                  size_t limit) = 0;
 
+    // Keyset pagination: Returns, in increasing order, the public IDs
+    // that are greater than "after" (new in Orthanc 1.5.7)
+    virtual void GetAllPublicIdsAfter(std::list<std::string>& target,
+                                      ResourceType resourceType,
+                                      const std::string& after,
+                                      size_t limit) = 0;
+
     virtual void GetChanges(std::list<ServerIndexChange>& target /*out*/,
                             bool& done /*out*/,
                             int64_t since,
@@ -252,5 +260,17 @@ namespace Orthanc
                                          ResourceType& type,
                                          std::string& parentPublicId,
                                          const std::string& publicId) = 0;
+
+
+    /**
+     * Primitives introduced in Orthanc 1.5.7
+     **/
+
+    // Records of the jobs engine, as serialized JSON strings indexed
+    // by the ID of the jobs
+    virtual void GetStoredJobs(std::map<std::string, std::string>& target) = 0;
+
+    virtual void UpdateStoredJobs(const std::map<std::string, std::string>& changed,
+                                  const std::set<std::string>& removed) = 0;
   };
 }
@@ -418,6 +418,41 @@ namespace Orthanc
         }
       }
 
+      // New in Orthanc 1.5.7: The jobs are stored in their own table,
+      // instead of being serialized as one single global property
+      if (!db_.DoesTableExist("Jobs"))
+      {
+        LOG(INFO) << "Creating the table of the jobs";
+        db_.Execute("CREATE TABLE Jobs(id TEXT PRIMARY KEY, content TEXT);");
+
+        std::map<std::string, std::string> jobs;
+
+        try
+        {
+          Compatibility::IStoredJobs::Load(*this, jobs);
+        }
+        catch (OrthancException& e)
+        {
+          LOG(WARNING) << "Cannot read the jobs from the last execution of Orthanc: " << e.What();
+        }
+
+        if (!jobs.empty())
+        {
+          LOG(WARNING) << "Moving " << jobs.size() << " job(s) to the table of the jobs";
+          UpdateStoredJobs(jobs, std::set<std::string>());
+
+          // Empty the global property used by Orthanc <= 1.5.6
+          std::set<std::string> moved;
+          for (std::map<std::string, std::string>::const_iterator
+                 it = jobs.begin(); it != jobs.end(); ++it)
+          {
+            moved.insert(it->first);
+          }
+
+          Compatibility::IStoredJobs::Update(*this, std::map<std::string, std::string>(), moved);
+        }
+      }
+
       t.Commit();
     }
 
@@ -1052,6 +1087,34 @@ namespace Orthanc
   }
 
 
+  void SQLiteDatabaseWrapper::GetAllPublicIdsAfter(std::list<std::string>& target,
+                                                   ResourceType resourceType,
+                                                   const std::string& after,
+                                                   size_t limit)
+  {
+    target.clear();
+
+    if (limit == 0)
+    {
+      return;
+    }
+
+    // Uses the "PublicIndex" index, whatever the number of resources
+    // that have already been visited (as opposed to "OFFSET")
+    SQLite::Statement s(db_, SQLITE_FROM_HERE,
+                        "SELECT publicId FROM Resources WHERE "
+                        "publicId>? AND resourceType=? ORDER BY publicId LIMIT ?");
+    s.BindString(0, after);
+    s.BindInt(1, resourceType);
+    s.BindInt64(2, limit);
+
+    while (s.Step())
+    {
+      target.push_back(s.ColumnString(0));
+    }
+  }
+
+
   bool SQLiteDatabaseWrapper::SelectPatientToRecycle(int64_t& internalId)
   {
     SQLite::Statement s(db_, SQLITE_FROM_HERE,
@@ -1333,4 +1396,39 @@ namespace Orthanc
       s.Run();
     }
   }
+
+
+  void SQLiteDatabaseWrapper::GetStoredJobs(std::map<std::string, std::string>& target)
+  {
+    target.clear();
+
+    SQLite::Statement s(db_, SQLITE_FROM_HERE, "SELECT id, content FROM Jobs");
+
+    while (s.Step())
+    {
+      target[s.ColumnString(0)] = s.ColumnString(1);
+    }
+  }
+
+
+  void SQLiteDatabaseWrapper::UpdateStoredJobs(const std::map<std::string, std::string>& changed,
+                                               const std::set<std::string>& removed)
+  {
+    for (std::set<std::string>::const_iterator it = removed.begin();
+         it != removed.end(); ++it)
+    {
+      SQLite::Statement s(db_, SQLITE_FROM_HERE, "DELETE FROM Jobs WHERE id=?");
+      s.BindString(0, *it);
+      s.Run();
+    }
+
+    for (std::map<std::string, std::string>::const_iterator it = changed.begin();
+         it != changed.end(); ++it)
+    {
+      SQLite::Statement s(db_, SQLITE_FROM_HERE, "INSERT OR REPLACE INTO Jobs VALUES(?, ?)");
+      s.BindString(0, it->first);
+      s.BindString(1, it->second);
+      s.Run();
+    }
+  }
 }
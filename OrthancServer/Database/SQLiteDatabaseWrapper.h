@@ -40,6 +40,7 @@
 #include "Compatibility/IGetChildrenMetadata.h"
 #include "Compatibility/ILookupResourceAndParent.h"
 #include "Compatibility/ISetResourcesContent.h"
+#include "Compatibility/IStoredJobs.h"
 
 namespace Orthanc
 {
@@ -58,7 +59,8 @@ namespace Orthanc
     public Compatibility::ICreateInstance,
     public Compatibility::IGetChildrenMetadata,
     public Compatibility::ILookupResourceAndParent,
-    public Compatibility::ISetResourcesContent
+    public Compatibility::ISetResourcesContent,
+    public Compatibility::IStoredJobs
   {
   private:
     class Transaction;
@@ -303,6 +305,12 @@ namespace Orthanc
                                  size_t limit)
       ORTHANC_OVERRIDE;
 
+    virtual void GetAllPublicIdsAfter(std::list<std::string>& target,
+                                      ResourceType resourceType,
+                                      const std::string& after,
+                                      size_t limit)
+      ORTHANC_OVERRIDE;
+
     virtual bool SelectPatientToRecycle(int64_t& internalId)
       ORTHANC_OVERRIDE;
 
@@ -368,5 +376,12 @@ namespace Orthanc
     {
       return ILookupResourceAndParent::Apply(*this, id, type, parentPublicId, publicId);
     }
+
+    virtual void GetStoredJobs(std::map<std::string, std::string>& target)
+      ORTHANC_OVERRIDE;
+
+    virtual void UpdateStoredJobs(const std::map<std::string, std::string>& changed,
+                                  const std::set<std::string>& removed)
+      ORTHANC_OVERRIDE;
   };
 }
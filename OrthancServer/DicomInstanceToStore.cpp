@@ -159,11 +159,14 @@ namespace Orthanc
   private:
     std::auto_ptr<DicomInstanceHasher>  hasher_;
 
-    void ComputeMissingInformation()
+    // The JSON version is only computed if explicitly requested, as
+    // it is not needed if the "DICOM-as-JSON" attachment is not
+    // written at once (cf. option "StoreDicomAsJson")
+    void ComputeMissingInformation(bool withJson)
     {
       if (buffer_.HasContent() &&
           summary_.HasContent() &&
-          json_.HasContent())
+          (json_.HasContent() || !withJson))
       {
         // Fine, everything is available
         return; 
@@ -194,7 +197,7 @@ namespace Orthanc
       }
 
       if (summary_.HasContent() &&
-          json_.HasContent())
+          (json_.HasContent() || !withJson))
       {
         return;
       }
@@ -205,7 +208,16 @@ namespace Orthanc
 
       if (!parsed_.HasContent())
       {
-        parsed_.TakeOwnership(new ParsedDicomFile(buffer_.GetConstContent()));
+        // Only the tags are needed: Skip the parsing of the pixel data
+        const std::string& buffer = buffer_.GetConstContent();
+        if (buffer.empty())
+        {
+          parsed_.TakeOwnership(new ParsedDicomFile(buffer));
+        }
+        else
+        {
+          parsed_.TakeOwnership(ParsedDicomFile::CreateWithoutPixelData(buffer.c_str(), buffer.size()));
+        }
       }
 
       // At this point, we have parsed the DICOM file
@@ -217,7 +229,8 @@ namespace Orthanc
                                              *parsed_.GetContent().GetDcmtkObject().getDataset());
       }
     
-      if (!json_.HasContent())
+      if (withJson &&
+          !json_.HasContent())
       {
         json_.Allocate();
 
@@ -232,7 +245,7 @@ namespace Orthanc
   public:
     const char* GetBufferData()
     {
-      ComputeMissingInformation();
+      ComputeMissingInformation(false);
     
       if (!buffer_.HasContent())
       {
@@ -252,7 +265,7 @@ namespace Orthanc
 
     size_t GetBufferSize()
     {
-      ComputeMissingInformation();
+      ComputeMissingInformation(false);
     
       if (!buffer_.HasContent())
       {
@@ -265,7 +278,7 @@ namespace Orthanc
 
     const DicomMap& GetSummary()
     {
-      ComputeMissingInformation();
+      ComputeMissingInformation(false);
     
       if (!summary_.HasContent())
       {
@@ -278,7 +291,7 @@ namespace Orthanc
     
     const Json::Value& GetJson()
     {
-      ComputeMissingInformation();
+      ComputeMissingInformation(true);
     
       if (!json_.HasContent())
       {
@@ -307,7 +320,7 @@ namespace Orthanc
     
     bool LookupTransferSyntax(std::string& result)
     {
-      ComputeMissingInformation();
+      ComputeMissingInformation(false);
 
       DicomMap header;
       if (DicomMap::ParseDicomMetaInformation(header, GetBufferData(), GetBufferSize()))
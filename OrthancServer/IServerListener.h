@@ -55,5 +55,11 @@ namespace Orthanc
 
     virtual bool FilterIncomingInstance(const DicomInstanceToStore& instance,
                                         const Json::Value& simplified) = 0;
+
+    // Tells whether the listener makes use of the simplified tags
+    // that are provided to the callbacks above. If no listener needs
+    // them, their computation can be skipped while receiving
+    // instances (cf. option "StoreDicomAsJson").
+    virtual bool IsSimplifiedTagsRequired() = 0;
   };
 }
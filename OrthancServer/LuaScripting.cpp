@@ -758,6 +758,15 @@ namespace Orthanc
   }
 
 
+  bool LuaScripting::HasInstanceCallbacks()
+  {
+    boost::recursive_mutex::scoped_lock lock(mutex_);
+
+    return (lua_.IsExistingFunction("OnStoredInstance") ||
+            lua_.IsExistingFunction("ReceivedInstanceFilter"));
+  }
+
+
   void LuaScripting::Execute(const std::string& command)
   {
     pendingEvents_.Enqueue(new ExecuteEvent(command));
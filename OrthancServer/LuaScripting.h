@@ -127,6 +127,10 @@ namespace Orthanc
     bool FilterIncomingInstance(const DicomInstanceToStore& instance,
                                 const Json::Value& simplifiedTags);
 
+    // Tells whether the script defines one of the callbacks that
+    // receive the tags of the incoming instances
+    bool HasInstanceCallbacks();
+
     void Execute(const std::string& command);
 
     void SignalJobSubmitted(const std::string& jobId);
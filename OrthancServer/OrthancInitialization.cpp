@@ -42,6 +42,7 @@
 
 #include "../Core/DicomParsing/FromDcmtkBridge.h"
 #include "../Core/FileStorage/FilesystemStorage.h"
+#include "../Core/Images/ParallelImageProcessing.h"
 #include "../Core/Logging.h"
 #include "../Core/OrthancException.h"
 
@@ -270,6 +271,10 @@ namespace Orthanc
 
     lock.GetConfiguration().RegisterFont(EmbeddedResources::FONT_UBUNTU_MONO_BOLD_16);
 
+    ParallelImageProcessing::Initialize(
+      lock.GetConfiguration().GetUnsignedIntegerParameter("ImageProcessingThreadsCount", 1),
+      lock.GetConfiguration().GetUnsignedIntegerParameter("ImageProcessingParallelThreshold", 4000000));
+
     /* Disable "gethostbyaddr" (which results in memory leaks) and use raw IP addresses */
     dcmDisableGethostbyaddr.set(OFTrue);
   }
@@ -280,6 +285,7 @@ namespace Orthanc
   {
     OrthancConfiguration::WriterLock lock;
 
+    ParallelImageProcessing::Finalize();
     HttpClient::GlobalFinalize();
     FromDcmtkBridge::FinalizeCodecs();
     Toolbox::FinalizeOpenSsl();
@@ -359,6 +365,27 @@ namespace Orthanc
           storage_.Remove(uuid, type);
         }
       }
+
+      virtual bool HasReadRange() const
+      {
+        return true;
+      }
+
+      virtual void ReadRange(std::string& content,
+                             const std::string& uuid,
+                             FileContentType type,
+                             uint64_t start,
+                             uint64_t end)
+      {
+        if (type != FileContentType_Dicom)
+        {
+          storage_.ReadRange(content, uuid, type, start, end);
+        }
+        else
+        {
+          throw OrthancException(ErrorCode_UnknownResource);
+        }
+      }
     };
   }
 
@@ -170,6 +170,12 @@ namespace Orthanc
     
     job->SetModification(modification.release(), level, isAnonymization);
     job->SetOrigin(call);
+
+    static const char* THREADS = "Threads";
+    if (body.isMember(THREADS))
+    {
+      job->SetThreadsCount(SerializationToolbox::ReadUnsignedInteger(body, THREADS));
+    }
     
     context.AddChildInstances(*job, call.GetUriComponent("id", ""));
 
@@ -704,6 +710,12 @@ namespace Orthanc
       }
     }
 
+    static const char* CONCURRENCY = "Concurrency";
+    if (request.isMember(CONCURRENCY))
+    {
+      job->SetMaxConcurrency(SerializationToolbox::ReadUnsignedInteger(request, CONCURRENCY));
+    }
+
     OrthancRestApi::GetApi(call).SubmitCommandsJob
       (call, job.release(), true /* synchronous by default */, request);
   }
@@ -741,6 +753,12 @@ namespace Orthanc
       job->SetKeepSource(SerializationToolbox::ReadBoolean(request, KEEP_SOURCE));
     }
 
+    static const char* CONCURRENCY = "Concurrency";
+    if (request.isMember(CONCURRENCY))
+    {
+      job->SetMaxConcurrency(SerializationToolbox::ReadUnsignedInteger(request, CONCURRENCY));
+    }
+
     OrthancRestApi::GetApi(call).SubmitCommandsJob
       (call, job.release(), true /* synchronous by default */, request);
   }
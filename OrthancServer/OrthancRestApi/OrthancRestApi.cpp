@@ -196,6 +196,7 @@ namespace Orthanc
   static const char* KEY_PRIORITY = "Priority";
   static const char* KEY_SYNCHRONOUS = "Synchronous";
   static const char* KEY_ASYNCHRONOUS = "Asynchronous";
+  static const char* KEY_DEPENDENCIES = "Dependencies";
 
   
   bool OrthancRestApi::IsSynchronousJobRequest(bool isDefaultSynchronous,
@@ -232,13 +233,28 @@ namespace Orthanc
       return SerializationToolbox::ReadInteger(body, KEY_PRIORITY);
     }
   }
+
+
+  void OrthancRestApi::GetJobRequestDependencies(std::set<std::string>& target,
+                                                 const Json::Value& body)
+  {
+    target.clear();
+    
+    if (body.type() == Json::objectValue &&
+        body.isMember(KEY_DEPENDENCIES))
+    {
+      // IDs of the jobs that must succeed before this job starts
+      SerializationToolbox::ReadSetOfStrings(target, body, KEY_DEPENDENCIES);
+    }
+  }
   
 
   void OrthancRestApi::SubmitGenericJob(RestApiOutput& output,
                                         ServerContext& context,
                                         IJob* job,
                                         bool synchronous,
-                                        int priority)
+                                        int priority,
+                                        const std::set<std::string>& dependencies)
   {
     std::auto_ptr<IJob> raii(job);
     
@@ -251,7 +267,7 @@ namespace Orthanc
     {
       Json::Value successContent;
       context.GetJobsEngine().GetRegistry().SubmitAndWait
-        (successContent, raii.release(), priority);
+        (successContent, raii.release(), priority, dependencies);
 
       // Success in synchronous execution
       output.AnswerJson(successContent);
@@ -261,7 +277,7 @@ namespace Orthanc
       // Asynchronous mode: Submit the job, but don't wait for its completion
       std::string id;
       context.GetJobsEngine().GetRegistry().Submit
-        (id, raii.release(), priority);
+        (id, raii.release(), priority, dependencies);
 
       Json::Value v;
       v["ID"] = id;
@@ -286,7 +302,10 @@ namespace Orthanc
     bool synchronous = IsSynchronousJobRequest(isDefaultSynchronous, body);
     int priority = GetJobRequestPriority(body);
 
-    SubmitGenericJob(call.GetOutput(), context_, raii.release(), synchronous, priority);
+    std::set<std::string> dependencies;
+    GetJobRequestDependencies(dependencies, body);
+
+    SubmitGenericJob(call.GetOutput(), context_, raii.release(), synchronous, priority, dependencies);
   }
 
   
@@ -120,12 +120,16 @@ namespace Orthanc
                                         const Json::Value& body);
     
     static unsigned int GetJobRequestPriority(const Json::Value& body);
+
+    static void GetJobRequestDependencies(std::set<std::string>& target,
+                                          const Json::Value& body);
     
     static void SubmitGenericJob(RestApiOutput& output,
                                  ServerContext& context,
                                  IJob* job,
                                  bool synchronous,
-                                 int priority);
+                                 int priority,
+                                 const std::set<std::string>& dependencies);
     
     void SubmitGenericJob(RestApiPostCall& call,
                           IJob* job,
@@ -101,6 +101,7 @@ namespace Orthanc
   static void GetJobParameters(bool& synchronous,         /* out */
                                bool& extended,            /* out */
                                int& priority,             /* out */
+                               std::set<std::string>& dependencies,  /* out */
                                const Json::Value& body,   /* in */
                                const bool defaultExtended /* in */)
   {
@@ -109,6 +110,8 @@ namespace Orthanc
 
     priority = OrthancRestApi::GetJobRequestPriority(body);
 
+    OrthancRestApi::GetJobRequestDependencies(dependencies, body);
+
     if (body.type() == Json::objectValue &&
         body.isMember(KEY_EXTENDED))
     {
@@ -125,6 +128,7 @@ namespace Orthanc
                         ServerContext& context,
                         std::auto_ptr<ArchiveJob>& job,
                         int priority,
+                        const std::set<std::string>& dependencies,
                         bool synchronous,
                         const std::string& filename)
   {
@@ -148,7 +152,7 @@ namespace Orthanc
     
       Json::Value publicContent;
       context.GetJobsEngine().GetRegistry().SubmitAndWait
-        (publicContent, job.release(), priority);
+        (publicContent, job.release(), priority, dependencies);
       
       {
         // The archive is now created: Prepare the sending of the ZIP file
@@ -161,7 +165,8 @@ namespace Orthanc
     }
     else
     {
-      OrthancRestApi::SubmitGenericJob(output, context, job.release(), false, priority);
+      OrthancRestApi::SubmitGenericJob(output, context, job.release(), false,
+                                       priority, dependencies);
     }
   }
 
@@ -177,11 +182,12 @@ namespace Orthanc
     {
       bool synchronous, extended;
       int priority;
-      GetJobParameters(synchronous, extended, priority, body, DEFAULT_IS_EXTENDED);
+      std::set<std::string> dependencies;
+      GetJobParameters(synchronous, extended, priority, dependencies, body, DEFAULT_IS_EXTENDED);
       
       std::auto_ptr<ArchiveJob> job(new ArchiveJob(context, IS_MEDIA, extended));
       AddResourcesOfInterest(*job, body);
-      SubmitJob(call.GetOutput(), context, job, priority, synchronous, "Archive.zip");
+      SubmitJob(call.GetOutput(), context, job, priority, dependencies, synchronous, "Archive.zip");
     }
     else
     {
@@ -213,6 +219,7 @@ namespace Orthanc
     job->AddResource(id);
 
     SubmitJob(call.GetOutput(), context, job, 0 /* priority */,
+              std::set<std::string>() /* no dependency */,
               true /* synchronous */, id + ".zip");
   }
 
@@ -230,11 +237,12 @@ namespace Orthanc
     {
       bool synchronous, extended;
       int priority;
-      GetJobParameters(synchronous, extended, priority, body, DEFAULT_IS_EXTENDED);
+      std::set<std::string> dependencies;
+      GetJobParameters(synchronous, extended, priority, dependencies, body, DEFAULT_IS_EXTENDED);
       
       std::auto_ptr<ArchiveJob> job(new ArchiveJob(context, IS_MEDIA, extended));
       job->AddResource(id);
-      SubmitJob(call.GetOutput(), context, job, priority, synchronous, id + ".zip");
+      SubmitJob(call.GetOutput(), context, job, priority, dependencies, synchronous, id + ".zip");
     }
     else
     {
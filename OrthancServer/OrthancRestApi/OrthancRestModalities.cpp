@@ -1059,6 +1059,12 @@ namespace Orthanc
     std::auto_ptr<OrthancPeerStoreJob> job(new OrthancPeerStoreJob(context));
 
     GetInstancesToExport(request, *job, remote, call);
+
+    static const char* CONCURRENCY = "Concurrency";
+    if (request.isMember(CONCURRENCY))
+    {
+      job->SetMaxConcurrency(SerializationToolbox::ReadUnsignedInteger(request, CONCURRENCY));
+    }
     
     OrthancConfiguration::ReaderLock lock;
 
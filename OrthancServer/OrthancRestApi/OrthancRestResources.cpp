@@ -35,20 +35,33 @@
 #include "OrthancRestApi.h"
 
 #include "../../Core/Compression/GzipCompressor.h"
+#include "../../Core/DicomFormat/DicomFrameOffsets.h"
 #include "../../Core/DicomParsing/DicomWebJsonVisitor.h"
 #include "../../Core/DicomParsing/FromDcmtkBridge.h"
 #include "../../Core/DicomParsing/Internals/DicomImageDecoder.h"
 #include "../../Core/HttpServer/HttpContentNegociation.h"
+#include "../../Core/Images/Image.h"
+#include "../../Core/Images/ImageProcessing.h"
+#include "../../Core/Images/JpegReader.h"
+#include "../../Core/Images/JpegWriter.h"
+#include "../../Core/Images/ParallelImageProcessing.h"
+#include "../../Core/Images/PamWriter.h"
+#include "../../Core/Images/PngWriter.h"
 #include "../../Core/Logging.h"
+#include "../../Core/SerializationToolbox.h"
 #include "../DefaultDicomImageDecoder.h"
 #include "../OrthancConfiguration.h"
 #include "../Search/DatabaseLookup.h"
+#include "../ServerJobs/ReconstructDerivedDataJob.h"
+#include "../SeriesVolumeSender.h"
 #include "../ServerContext.h"
 #include "../ServerToolbox.h"
 #include "../SliceOrdering.h"
 
 #include "../../Plugins/Engine/OrthancPlugins.h"
 
+#include <boost/math/special_functions/round.hpp>
+
 
 namespace Orthanc
 {
@@ -258,19 +271,29 @@ namespace Orthanc
             mime == MimeType_DicomWebXml)
         {
           DicomWebJsonVisitor visitor;
-          
-          {
-            ServerContext::DicomCacheLocker locker(OrthancRestApi::GetContext(call), publicId);
-            locker.GetDicom().Apply(visitor);
-          }
 
           if (mime == MimeType_DicomWebJson)
           {
-            std::string s = visitor.GetResult().toStyledString();
+            // Directly serialize the JSON, without building the
+            // intermediate "Json::Value" (new in Orthanc 1.5.7)
+            std::string s;
+
+            {
+              ServerContext::DicomCacheLocker locker(OrthancRestApi::GetContext(call), publicId);
+              visitor.OpenStream(s);
+              locker.GetDicom().Apply(visitor);
+              visitor.CloseStream();
+            }
+
             call.GetOutput().AnswerBuffer(s, MimeType_DicomWebJson);
           }
           else
           {
+            {
+              ServerContext::DicomCacheLocker locker(OrthancRestApi::GetContext(call), publicId);
+              locker.GetDicom().Apply(visitor);
+            }
+
             std::string xml;
             visitor.FormatXml(xml);
             call.GetOutput().AnswerBuffer(xml, MimeType_DicomWebXml);
@@ -382,20 +405,32 @@ namespace Orthanc
     class ImageToEncode
     {
     private:
-      std::auto_ptr<ImageAccessor>&  image_;
       ImageExtractionMode            mode_;
-      bool                           invert_;
       MimeType                       format_;
+      unsigned int                   quality_;
       std::string                    answer_;
 
     public:
-      ImageToEncode(std::auto_ptr<ImageAccessor>& image,
-                    ImageExtractionMode mode,
-                    bool invert) :
-        image_(image),
+      ImageToEncode(ImageExtractionMode mode) :
         mode_(mode),
-        invert_(invert)
+        format_(MimeType_Png),
+        quality_(0)
+      {
+      }
+
+      MimeType GetFormat() const
+      {
+        return format_;
+      }
+
+      unsigned int GetQuality() const
+      {
+        return quality_;
+      }
+
+      std::string& GetAnswer()
       {
+        return answer_;
       }
 
       void Answer(RestApiOutput& output)
@@ -403,22 +438,76 @@ namespace Orthanc
         output.AnswerBuffer(answer_, format_);
       }
 
-      void EncodeUsingPng()
+      void SelectPng()
       {
         format_ = MimeType_Png;
-        DicomImageDecoder::ExtractPngImage(answer_, image_, mode_, invert_);
+        quality_ = 0;
       }
 
-      void EncodeUsingPam()
+      void SelectPam()
       {
         format_ = MimeType_Pam;
-        DicomImageDecoder::ExtractPamImage(answer_, image_, mode_, invert_);
+        quality_ = 0;
       }
 
-      void EncodeUsingJpeg(uint8_t quality)
+      void SelectJpeg(uint8_t quality)
       {
         format_ = MimeType_Jpeg;
-        DicomImageDecoder::ExtractJpegImage(answer_, image_, mode_, invert_, quality);
+        quality_ = quality;
+      }
+
+      void Encode(std::auto_ptr<ImageAccessor>& image,
+                  bool invert)
+      {
+        switch (format_)
+        {
+          case MimeType_Png:
+            DicomImageDecoder::ExtractPngImage(answer_, image, mode_, invert);
+            break;
+
+          case MimeType_Pam:
+            DicomImageDecoder::ExtractPamImage(answer_, image, mode_, invert);
+            break;
+
+          case MimeType_Jpeg:
+            DicomImageDecoder::ExtractJpegImage(answer_, image, mode_, invert, quality_);
+            break;
+
+          default:
+            throw OrthancException(ErrorCode_InternalError);
+        }
+      }
+
+      // Encodes an image that is already rendered (Grayscale8 or RGB24)
+      void EncodeRendered(const ImageAccessor& image)
+      {
+        switch (format_)
+        {
+          case MimeType_Png:
+          {
+            PngWriter writer;
+            writer.WriteToMemory(answer_, image);
+            break;
+          }
+
+          case MimeType_Pam:
+          {
+            PamWriter writer;
+            writer.WriteToMemory(answer_, image);
+            break;
+          }
+
+          case MimeType_Jpeg:
+          {
+            JpegWriter writer;
+            writer.SetQuality(static_cast<uint8_t>(quality_));
+            writer.WriteToMemory(answer_, image);
+            break;
+          }
+
+          default:
+            throw OrthancException(ErrorCode_InternalError);
+        }
       }
     };
 
@@ -437,7 +526,7 @@ namespace Orthanc
       {
         assert(type == "image");
         assert(subtype == "png");
-        image_.EncodeUsingPng();
+        image_.SelectPng();
       }
     };
 
@@ -456,7 +545,7 @@ namespace Orthanc
       {
         assert(type == "image");
         assert(subtype == "x-portable-arbitrarymap");
-        image_.EncodeUsingPam();
+        image_.SelectPam();
       }
     };
 
@@ -496,12 +585,70 @@ namespace Orthanc
       {
         assert(type == "image");
         assert(subtype == "jpeg");
-        image_.EncodeUsingJpeg(quality_);
+        image_.SelectJpeg(quality_);
       }
     };
   }
 
 
+  static void GetSizeArgument(unsigned int& maxWidth,
+                              unsigned int& maxHeight,
+                              const RestApiGetCall& call)
+  {
+    // Parse the "size=WxH" argument, if any ("0" means no constraint)
+    std::string value = call.GetArgument("size", "");
+    if (value.empty())
+    {
+      return;
+    }
+
+    std::string lower;
+    Toolbox::ToLowerCase(lower, value);
+
+    std::vector<std::string> tokens;
+    Toolbox::TokenizeString(tokens, lower, 'x');
+
+    if (tokens.size() == 2)
+    {
+      try
+      {
+        int w = boost::lexical_cast<int>(Toolbox::StripSpaces(tokens[0]));
+        int h = boost::lexical_cast<int>(Toolbox::StripSpaces(tokens[1]));
+
+        if (w > 0 && h > 0)
+        {
+          maxWidth = static_cast<unsigned int>(w);
+          maxHeight = static_cast<unsigned int>(h);
+          return;
+        }
+      }
+      catch (boost::bad_lexical_cast&)
+      {
+      }
+    }
+
+    throw OrthancException(ErrorCode_BadRequest,
+                           "The size must be formatted as \"WxH\", with positive integers: " + value);
+  }
+
+
+  static void ResizeToFit(std::auto_ptr<ImageAccessor>& image,
+                          unsigned int maxWidth,
+                          unsigned int maxHeight)
+  {
+    unsigned int width, height;
+    ImageProcessing::FitInside(width, height, image->GetWidth(), image->GetHeight(), maxWidth, maxHeight);
+
+    if (width != image->GetWidth() ||
+        height != image->GetHeight())
+    {
+      std::auto_ptr<ImageAccessor> resized(new Image(image->GetFormat(), width, height, false));
+      ImageProcessing::Resize(*resized, *image);
+      image = resized;
+    }
+  }
+
+
   template <enum ImageExtractionMode mode>
   static void GetImage(RestApiGetCall& call)
   {
@@ -519,13 +666,54 @@ namespace Orthanc
       return;
     }
 
+    std::string publicId = call.GetUriComponent("id", "");
+
+    ImageToEncode image(mode);
+
+    HttpContentNegociation negociation;
+    EncodePng png(image);
+    negociation.Register(MIME_PNG, png);
+
+    EncodeJpeg jpeg(image, call);
+    negociation.Register(MIME_JPEG, jpeg);
+
+    EncodePam pam(image);
+    negociation.Register(MIME_PAM, pam);
+
+    if (!negociation.Apply(call.GetHttpHeaders()))
+    {
+      return;
+    }
+
+    // Downscaling is only available for previews
+    unsigned int maxWidth = 0, maxHeight = 0;
+    std::string parameters;
+
+    if (mode == ImageExtractionMode_Preview)
+    {
+      GetSizeArgument(maxWidth, maxHeight, call);
+
+      if (maxWidth != 0)
+      {
+        parameters = ("size=" + boost::lexical_cast<std::string>(maxWidth) + "x" +
+                      boost::lexical_cast<std::string>(maxHeight));
+      }
+    }
+
+    RenderedFrameCache& cache = context.GetRenderedFrameCache();
+    uint64_t generation;
+    if (cache.Lookup(image.GetAnswer(), generation, publicId, frame, mode,
+                     image.GetFormat(), image.GetQuality(), parameters))
+    {
+      image.Answer(call.GetOutput());
+      return;
+    }
+
     bool invert = false;
     std::auto_ptr<ImageAccessor> decoded;
 
     try
     {
-      std::string publicId = call.GetUriComponent("id", "");
-
 #if ORTHANC_ENABLE_PLUGINS == 1
       if (context.GetPlugins().HasCustomImageDecoder())
       {
@@ -593,7 +781,131 @@ namespace Orthanc
       return;
     }
 
-    ImageToEncode image(decoded, mode, invert);
+    if (maxWidth != 0)
+    {
+      DicomImageDecoder::ApplyExtractionMode(decoded, mode, invert);
+      ResizeToFit(decoded, maxWidth, maxHeight);
+      image.EncodeRendered(*decoded);
+    }
+    else
+    {
+      image.Encode(decoded, invert);
+    }
+
+    cache.Store(generation, publicId, frame, mode, image.GetFormat(), image.GetQuality(), parameters, image.GetAnswer());
+    image.Answer(call.GetOutput());
+  }
+
+
+  static bool LookupFloatTag(float& target,
+                             ParsedDicomFile& dicom,
+                             const DicomTag& tag)
+  {
+    std::string value;
+    if (dicom.GetTagValue(value, tag))
+    {
+      // Only keep the first value of multi-valued tags (such as
+      // multiple window presets)
+      std::vector<std::string> tokens;
+      Toolbox::TokenizeString(tokens, value, '\\');
+
+      if (!tokens.empty())
+      {
+        try
+        {
+          target = boost::lexical_cast<float>(Toolbox::StripSpaces(tokens[0]));
+          return true;
+        }
+        catch (boost::bad_lexical_cast&)
+        {
+        }
+      }
+    }
+
+    return false;
+  }
+
+
+  static unsigned int GetUnsignedIntegerArgument(const RestApiGetCall& call,
+                                                 const std::string& name)
+  {
+    // Returns 0 if the argument is absent
+    std::string value = call.GetArgument(name, "");
+    if (value.empty())
+    {
+      return 0;
+    }
+
+    try
+    {
+      int v = boost::lexical_cast<int>(value);
+      if (v > 0)
+      {
+        return static_cast<unsigned int>(v);
+      }
+    }
+    catch (boost::bad_lexical_cast&)
+    {
+    }
+
+    throw OrthancException(ErrorCode_BadRequest,
+                           "The argument \"" + name + "\" must be a positive integer: " + value);
+  }
+
+
+  static void GetRenderedFrame(RestApiGetCall& call)
+  {
+    ServerContext& context = OrthancRestApi::GetContext(call);
+
+    std::string frameId = call.GetUriComponent("frame", "0");
+
+    unsigned int frame;
+    try
+    {
+      frame = boost::lexical_cast<unsigned int>(frameId);
+    }
+    catch (boost::bad_lexical_cast&)
+    {
+      return;
+    }
+
+    std::string publicId = call.GetUriComponent("id", "");
+
+    // Parse the "window=center,width" argument, if any
+    bool hasWindow = false;
+    float windowCenter = 0, windowWidth = 0;
+
+    if (call.HasArgument("window"))
+    {
+      std::string window = call.GetArgument("window", "");
+      std::vector<std::string> tokens;
+      Toolbox::TokenizeString(tokens, window, ',');
+
+      try
+      {
+        if (tokens.size() == 2)
+        {
+          windowCenter = boost::lexical_cast<float>(Toolbox::StripSpaces(tokens[0]));
+          windowWidth = boost::lexical_cast<float>(Toolbox::StripSpaces(tokens[1]));
+          hasWindow = (windowWidth >= 1.0f);
+        }
+      }
+      catch (boost::bad_lexical_cast&)
+      {
+      }
+
+      if (!hasWindow)
+      {
+        throw OrthancException(ErrorCode_BadRequest,
+                               "The window must be formatted as \"center,width\", with width >= 1: " + window);
+      }
+    }
+
+    unsigned int maxWidth = GetUnsignedIntegerArgument(call, "width");
+    unsigned int maxHeight = GetUnsignedIntegerArgument(call, "height");
+    GetSizeArgument(maxWidth, maxHeight, call);
+
+    ImageToEncode image(ImageExtractionMode_Preview);
 
     HttpContentNegociation negociation;
     EncodePng png(image);
@@ -605,9 +917,163 @@ namespace Orthanc
     EncodePam pam(image);
     negociation.Register(MIME_PAM, pam);
 
-    if (negociation.Apply(call.GetHttpHeaders()))
+    if (!negociation.Apply(call.GetHttpHeaders()))
+    {
+      return;
+    }
+
+    const std::string parameters = ("rendered;" + call.GetArgument("window", "") + ";" +
+                                    boost::lexical_cast<std::string>(maxWidth) + "x" +
+                                    boost::lexical_cast<std::string>(maxHeight));
+
+    RenderedFrameCache& cache = context.GetRenderedFrameCache();
+    uint64_t generation;
+    if (cache.Lookup(image.GetAnswer(), generation, publicId, frame, ImageExtractionMode_Preview,
+                     image.GetFormat(), image.GetQuality(), parameters))
     {
       image.Answer(call.GetOutput());
+      return;
+    }
+
+    float rescaleSlope = 1, rescaleIntercept = 0;
+    bool invert = false;
+    std::auto_ptr<ImageAccessor> decoded;
+
+    try
+    {
+      {
+        ServerContext::DicomCacheLocker locker(context, publicId);
+
+        if (!LookupFloatTag(rescaleSlope, locker.GetDicom(), DICOM_TAG_RESCALE_SLOPE) ||
+            !LookupFloatTag(rescaleIntercept, locker.GetDicom(), DICOM_TAG_RESCALE_INTERCEPT))
+        {
+          rescaleSlope = 1;
+          rescaleIntercept = 0;
+        }
+
+        if (!hasWindow &&
+            LookupFloatTag(windowCenter, locker.GetDicom(), DICOM_TAG_WINDOW_CENTER) &&
+            LookupFloatTag(windowWidth, locker.GetDicom(), DICOM_TAG_WINDOW_WIDTH) &&
+            windowWidth >= 1.0f)
+        {
+          hasWindow = true;
+        }
+
+        PhotometricInterpretation photometric;
+        if (locker.GetDicom().LookupPhotometricInterpretation(photometric))
+        {
+          invert = (photometric == PhotometricInterpretation_Monochrome1);
+        }
+
+#if ORTHANC_ENABLE_PLUGINS == 1
+        if (!context.GetPlugins().HasCustomImageDecoder())
+#endif
+        {
+          decoded.reset(DicomImageDecoder::Decode(locker.GetDicom(), frame));
+        }
+      }
+
+#if ORTHANC_ENABLE_PLUGINS == 1
+      if (decoded.get() == NULL)
+      {
+        std::string dicomContent;
+        context.ReadDicom(dicomContent, publicId);
+        decoded.reset(context.GetPlugins().Decode(dicomContent.c_str(), dicomContent.size(), frame));
+      }
+#endif
+    }
+    catch (OrthancException& e)
+    {
+      if (e.GetErrorCode() == ErrorCode_ParameterOutOfRange || e.GetErrorCode() == ErrorCode_UnknownResource)
+      {
+        // The frame number is out of the range for this DICOM
+        // instance, the resource is not existent
+      }
+      else
+      {
+        std::string root = "";
+        for (size_t i = 1; i < call.GetFullUri().size(); i++)
+        {
+          root += "../";
+        }
+
+        call.GetOutput().Redirect(root + "app/images/unsupported.png");
+      }
+      return;
+    }
+
+    if (decoded.get() == NULL)
+    {
+      throw OrthancException(ErrorCode_InternalError);
+    }
+
+    std::auto_ptr<ImageAccessor> rendered;
+
+    switch (decoded->GetFormat())
+    {
+      case PixelFormat_RGB24:
+        // No windowing on color images
+        rendered = decoded;
+        break;
+
+      case PixelFormat_RGB48:
+        rendered.reset(new Image(PixelFormat_RGB24, decoded->GetWidth(), decoded->GetHeight(), false));
+        ImageProcessing::Convert(*rendered, *decoded);
+        break;
+
+      default:
+      {
+        if (!hasWindow)
+        {
+          // No windowing is available: Use the full range of the
+          // modality values, as in the "preview" route
+          int64_t a, b;
+          ImageProcessing::GetMinMaxIntegerValue(a, b, *decoded);
+
+          float x = static_cast<float>(a) * rescaleSlope + rescaleIntercept;
+          float y = static_cast<float>(b) * rescaleSlope + rescaleIntercept;
+          windowCenter = (x + y) / 2.0f;
+          windowWidth = std::max(1.0f, std::abs(y - x) + 1.0f);
+        }
+
+        rendered.reset(new Image(PixelFormat_Grayscale8, decoded->GetWidth(), decoded->GetHeight(), false));
+        ImageProcessing::ApplyWindowing(*rendered, *decoded, windowCenter, windowWidth,
+                                        rescaleSlope, rescaleIntercept, invert);
+        break;
+      }
+    }
+
+    decoded.reset(NULL);
+
+    ResizeToFit(rendered, maxWidth, maxHeight);
+
+    image.EncodeRendered(*rendered);
+    cache.Store(generation, publicId, frame, ImageExtractionMode_Preview, image.GetFormat(),
+                image.GetQuality(), parameters, image.GetAnswer());
+    image.Answer(call.GetOutput());
+  }
+
+
+  static void GetSeriesThumbnail(RestApiGetCall& call)
+  {
+    ServerContext& context = OrthancRestApi::GetContext(call);
+
+    std::string publicId = call.GetUriComponent("id", "");
+
+    FileInfo info;
+    if (context.GetIndex().LookupAttachment(info, publicId, FileContentType_Thumbnail))
+    {
+      context.AnswerAttachment(call.GetOutput(), publicId, FileContentType_Thumbnail);
+    }
+    else
+    {
+      // The thumbnail was not generated when the series became
+      // stable, or it was invalidated by a change in the series:
+      // Render it now. Only the background thread that is triggered
+      // by "SeriesThumbnails" stores the thumbnails.
+      std::string jpeg;
+      context.RenderSeriesThumbnail(jpeg, publicId);
+      call.GetOutput().AnswerBuffer(jpeg, MimeType_Jpeg);
     }
   }
 
@@ -666,8 +1132,13 @@ namespace Orthanc
     std::string raw;
     MimeType mime;
 
+    ServerContext& context = OrthancRestApi::GetContext(call);
+
+    if (!context.ReadRawFrame(raw, mime, publicId, frame))
     {
-      ServerContext::DicomCacheLocker locker(OrthancRestApi::GetContext(call), publicId);
+      // No table of frame offsets is available for this instance, or
+      // the storage area cannot efficiently read the frame alone
+      ServerContext::DicomCacheLocker locker(context, publicId);
       locker.GetDicom().GetRawFrame(raw, mime, frame);
     }
 
@@ -685,6 +1156,307 @@ namespace Orthanc
   }
 
 
+  namespace
+  {
+    /**
+     * Decodes a batch of JPEG baseline frames. Each frame of such an
+     * instance is an independent JPEG stream, so that the frames can
+     * be decompressed concurrently by distinct libjpeg decoders.
+     **/
+    class JpegFramesDecoder : public ParallelImageProcessing::IBandOperation
+    {
+    private:
+      const std::vector<std::string>&  frames_;
+      std::vector<JpegReader*>         decoded_;
+
+    public:
+      explicit JpegFramesDecoder(const std::vector<std::string>& frames) :
+        frames_(frames),
+        decoded_(frames.size(), NULL)
+      {
+      }
+
+      virtual ~JpegFramesDecoder()
+      {
+        for (size_t i = 0; i < decoded_.size(); i++)
+        {
+          delete decoded_[i];
+        }
+      }
+
+      virtual void Apply(unsigned int firstFrame,
+                         unsigned int endFrame)
+      {
+        for (unsigned int i = firstFrame; i < endFrame; i++)
+        {
+          std::auto_ptr<JpegReader> reader(new JpegReader);
+          reader->ReadFromMemory(frames_[i]);
+          decoded_[i] = reader.release();
+        }
+      }
+
+      void Decode()
+      {
+        const unsigned int count = static_cast<unsigned int>(frames_.size());
+
+        if (!ParallelImageProcessing::ApplyToItems(*this, count))
+        {
+          Apply(0, count);
+        }
+      }
+
+      const ImageAccessor& GetFrame(size_t i) const
+      {
+        assert(i < decoded_.size() &&
+               decoded_[i] != NULL);
+        return *decoded_[i];
+      }
+    };
+  }
+
+
+  // Number of frames that are loaded at once by "GetRawFrames()", in
+  // order to bound the memory that is used by one request
+  static const unsigned int FRAMES_BATCH_SIZE = 16;
+
+
+  static void ParseFramesRange(unsigned int& firstFrame,
+                               unsigned int& endFrame,
+                               const RestApiGetCall& call,
+                               unsigned int countFrames)
+  {
+    // Parse the "range=A-B" argument, if any (both bounds included)
+    std::string value = call.GetArgument("range", "");
+    if (value.empty())
+    {
+      firstFrame = 0;
+      endFrame = countFrames;
+      return;
+    }
+
+    std::vector<std::string> tokens;
+    Toolbox::TokenizeString(tokens, value, '-');
+
+    if (tokens.size() == 2)
+    {
+      try
+      {
+        int a = boost::lexical_cast<int>(Toolbox::StripSpaces(tokens[0]));
+        int b = boost::lexical_cast<int>(Toolbox::StripSpaces(tokens[1]));
+
+        if (a >= 0 &&
+            a <= b &&
+            static_cast<unsigned int>(b) < countFrames)
+        {
+          firstFrame = static_cast<unsigned int>(a);
+          endFrame = static_cast<unsigned int>(b) + 1;
+          return;
+        }
+      }
+      catch (boost::bad_lexical_cast&)
+      {
+      }
+    }
+
+    throw OrthancException(ErrorCode_BadRequest,
+                           "The range must be formatted as \"A-B\", with 0 <= A <= B < " +
+                           boost::lexical_cast<std::string>(countFrames) + ": " + value);
+  }
+
+
+  static void ReadRawFramesBatch(std::vector<std::string>& frames,
+                                 MimeType& mime,
+                                 ServerContext& context,
+                                 const std::string& publicId,
+                                 bool hasOffsets,
+                                 const DicomFrameOffsets& offsets,
+                                 unsigned int firstFrame,
+                                 unsigned int endFrame)
+  {
+    if (hasOffsets &&
+        context.ReadRawFrames(frames, offsets, publicId, firstFrame, endFrame))
+    {
+      mime = offsets.GetMimeType();
+    }
+    else
+    {
+      // The whole batch is extracted from the same parsed DICOM file
+      ServerContext::DicomCacheLocker locker(context, publicId);
+
+      frames.resize(endFrame - firstFrame);
+      for (unsigned int i = firstFrame; i < endFrame; i++)
+      {
+        locker.GetDicom().GetRawFrame(frames[i - firstFrame], mime, i);
+      }
+    }
+  }
+
+
+  static void SendDecodedFrame(RestApiOutput& output,
+                               const ImageAccessor& frame,
+                               unsigned int index)
+  {
+    // Remove the padding at the end of the rows, if any
+    const size_t lineSize = frame.GetWidth() * frame.GetBytesPerPixel();
+
+    std::string buffer;
+    buffer.resize(lineSize * frame.GetHeight());
+
+    for (unsigned int y = 0; y < frame.GetHeight(); y++)
+    {
+      if (lineSize > 0)
+      {
+        memcpy(&buffer[y * lineSize], frame.GetConstRow(y), lineSize);
+      }
+    }
+
+    std::map<std::string, std::string> headers;
+    headers["X-Orthanc-Frame"] = boost::lexical_cast<std::string>(index);
+    headers["X-Orthanc-Width"] = boost::lexical_cast<std::string>(frame.GetWidth());
+    headers["X-Orthanc-Height"] = boost::lexical_cast<std::string>(frame.GetHeight());
+    headers["X-Orthanc-Pixel-Format"] = EnumerationToString(frame.GetFormat());
+    output.SendMultipartItem(buffer, headers);
+  }
+
+
+  static void GetRawFrames(RestApiGetCall& call)
+  {
+    ServerContext& context = OrthancRestApi::GetContext(call);
+
+    std::string publicId = call.GetUriComponent("id", "");
+    const bool decode = call.HasArgument("decode");
+
+    DicomFrameOffsets offsets;
+    const bool hasOffsets = context.LookupFrameOffsets(offsets, publicId);
+
+    unsigned int countFrames;
+    bool isJpegBaseline;
+
+    if (hasOffsets)
+    {
+      countFrames = offsets.GetFramesCount();
+      isJpegBaseline = (offsets.GetMimeType() == MimeType_Jpeg);
+    }
+    else
+    {
+      ServerContext::DicomCacheLocker locker(context, publicId);
+      countFrames = locker.GetDicom().GetFramesCount();
+
+      std::string transferSyntax;
+      isJpegBaseline = (locker.GetDicom().LookupTransferSyntax(transferSyntax) &&
+                        transferSyntax == "1.2.840.10008.1.2.4.50");
+    }
+
+    unsigned int firstFrame, endFrame;
+    ParseFramesRange(firstFrame, endFrame, call, countFrames);
+
+#if ORTHANC_ENABLE_PLUGINS == 1
+    const bool hasCustomDecoder = context.GetPlugins().HasCustomImageDecoder();
+#else
+    const bool hasCustomDecoder = false;
+#endif
+
+    std::string dicomContent;  // Only used by the decoder plugins
+    bool started = false;
+
+    for (unsigned int batch = firstFrame; batch < endFrame; batch += FRAMES_BATCH_SIZE)
+    {
+      const unsigned int batchEnd = std::min(endFrame, batch + FRAMES_BATCH_SIZE);
+
+      if (!decode ||
+          (isJpegBaseline && !hasCustomDecoder))
+      {
+        std::vector<std::string> frames;
+        MimeType mime;
+        ReadRawFramesBatch(frames, mime, context, publicId, hasOffsets, offsets, batch, batchEnd);
+
+        if (decode)
+        {
+          JpegFramesDecoder decoder(frames);
+          decoder.Decode();
+
+          if (!started)
+          {
+            call.GetOutput().StartMultipart("related", MIME_BINARY);
+            started = true;
+          }
+
+          for (unsigned int i = batch; i < batchEnd; i++)
+          {
+            SendDecodedFrame(call.GetOutput(), decoder.GetFrame(i - batch), i);
+          }
+        }
+        else
+        {
+          if (!started)
+          {
+            call.GetOutput().StartMultipart("related", EnumerationToString(mime));
+            started = true;
+          }
+
+          for (unsigned int i = batch; i < batchEnd; i++)
+          {
+            std::map<std::string, std::string> headers;
+            headers["X-Orthanc-Frame"] = boost::lexical_cast<std::string>(i);
+            call.GetOutput().SendMultipartItem(frames[i - batch], headers);
+          }
+        }
+      }
+      else
+      {
+        // Sequential decoding, that reuses the same parsed DICOM file
+        // (or the same DICOM buffer for the decoder plugins) for all
+        // the frames
+        for (unsigned int i = batch; i < batchEnd; i++)
+        {
+          std::auto_ptr<ImageAccessor> decoded;
+
+#if ORTHANC_ENABLE_PLUGINS == 1
+          if (hasCustomDecoder)
+          {
+            if (dicomContent.empty())
+            {
+              context.ReadDicom(dicomContent, publicId);
+            }
+
+            decoded.reset(context.GetPlugins().DecodeUnsafe(dicomContent.c_str(), dicomContent.size(), i));
+          }
+#endif
+
+          if (decoded.get() == NULL)
+          {
+            ServerContext::DicomCacheLocker locker(context, publicId);
+            decoded.reset(DicomImageDecoder::Decode(locker.GetDicom(), i));
+          }
+
+          if (decoded.get() == NULL)
+          {
+            throw OrthancException(ErrorCode_NotImplemented,
+                                   "Cannot decode frame " + boost::lexical_cast<std::string>(i) +
+                                   " of instance " + publicId);
+          }
+
+          if (!started)
+          {
+            call.GetOutput().StartMultipart("related", MIME_BINARY);
+            started = true;
+          }
+
+          SendDecodedFrame(call.GetOutput(), *decoded, i);
+        }
+      }
+    }
+
+    if (!started)
+    {
+      // Empty range of frames
+      call.GetOutput().StartMultipart("related", MIME_BINARY);
+    }
+
+    call.GetOutput().CloseMultipart();
+  }
+
+
   static void GetResourceStatistics(RestApiGetCall& call)
   {
     static const uint64_t MEGA_BYTES = 1024 * 1024;
@@ -920,7 +1692,16 @@ namespace Orthanc
     std::string publicId = call.GetUriComponent("id", "");
     FileContentType type = StringToContentType(call.GetUriComponent("name", ""));
 
-    if (uncompress)
+    if (uncompress &&
+        type == FileContentType_DicomAsJson)
+    {
+      // The attachment might use the compact binary encoding: Always
+      // answer with JSON text
+      std::string content;
+      context.ReadDicomAsJson(content, publicId);
+      call.GetOutput().AnswerBuffer(content, MimeType_Json);
+    }
+    else if (uncompress)
     {
       context.AnswerAttachment(call.GetOutput(), publicId, type);
     }
@@ -1060,8 +1841,10 @@ namespace Orthanc
     FileContentType contentType = StringToContentType(name);
 
     bool allowed;
-    if (IsUserContentType(contentType))
+    if (IsUserContentType(contentType) ||
+        contentType == FileContentType_Thumbnail)
     {
+      // Thumbnails are rendered again on the next GET call
       allowed = true;
     }
     else
@@ -1651,6 +2434,15 @@ namespace Orthanc
   }
 
 
+  static void GetSeriesVolume(RestApiGetCall& call)
+  {
+    ServerContext& context = OrthancRestApi::GetContext(call);
+
+    SeriesVolumeSender volume(context, call.GetUriComponent("id", ""));
+    call.GetOutput().AnswerStream(volume);
+  }
+
+
   static void GetInstanceHeader(RestApiGetCall& call)
   {
     ServerContext& context = OrthancRestApi::GetContext(call);
@@ -1698,6 +2490,77 @@ namespace Orthanc
   }
 
 
+  static void ConvertDicomAsJson(RestApiPostCall& call)
+  {
+    ServerContext& context = OrthancRestApi::GetContext(call);
+    ServerIndex& index = context.GetIndex();
+
+    // Same loop as in "InvalidateTags()"
+    std::list<std::string> studies;
+    index.GetAllUuids(studies, ResourceType_Study);
+
+    unsigned int count = 0;
+
+    for (std::list<std::string>::const_iterator 
+           study = studies.begin(); study != studies.end(); ++study)
+    {
+      std::list<std::string> instances;
+      index.GetChildInstances(instances, *study);
+
+      for (std::list<std::string>::const_iterator 
+             instance = instances.begin(); instance != instances.end(); ++instance)
+      {
+        if (context.ConvertDicomAsJson(*instance))
+        {
+          count++;
+        }
+      }
+    }
+
+    Json::Value result = Json::objectValue;
+    result["Compact"] = context.IsCompactDicomAsJson();
+    result["ConvertedInstances"] = count;
+    call.GetOutput().AnswerJson(result);
+  }
+
+
+  static void ReconstructDerivedData(RestApiPostCall& call)
+  {
+    ServerContext& context = OrthancRestApi::GetContext(call);
+
+    Json::Value request;
+    if (!call.ParseJsonRequest(request) ||
+        request.type() != Json::objectValue)
+    {
+      // Bad JSON request
+      throw OrthancException(ErrorCode_BadFileFormat);
+    }
+
+    std::auto_ptr<ReconstructDerivedDataJob> job(new ReconstructDerivedDataJob(context));
+
+    static const char* BATCH_SIZE = "BatchSize";
+    if (request.isMember(BATCH_SIZE))
+    {
+      job->SetBatchSize(SerializationToolbox::ReadUnsignedInteger(request, BATCH_SIZE));
+    }
+
+    static const char* THREADS = "Threads";
+    if (request.isMember(THREADS))
+    {
+      job->SetThreadsCount(SerializationToolbox::ReadUnsignedInteger(request, THREADS));
+    }
+
+    static const char* THROTTLE = "Throttle";
+    if (request.isMember(THROTTLE))
+    {
+      job->SetThrottle(SerializationToolbox::ReadUnsignedInteger(request, THROTTLE));
+    }
+
+    OrthancRestApi::GetApi(call).SubmitGenericJob
+      (call, job.release(), false /* asynchronous by default */, request);
+  }
+
+
   template <enum ResourceType type>
   static void ReconstructResource(RestApiPostCall& call)
   {
@@ -1747,6 +2610,7 @@ namespace Orthanc
 
     Register("/patients/{id}/shared-tags", GetSharedTags);
     Register("/series/{id}/shared-tags", GetSharedTags);
+    Register("/series/{id}/thumbnail", GetSeriesThumbnail);
     Register("/studies/{id}/shared-tags", GetSharedTags);
 
     Register("/instances/{id}/module", GetModule<ResourceType_Instance, DicomModule_Instance>);
@@ -1760,12 +2624,14 @@ namespace Orthanc
     Register("/instances/{id}/tags", GetInstanceTagsBis);
     Register("/instances/{id}/simplified-tags", GetInstanceTags<DicomToJsonFormat_Human>);
     Register("/instances/{id}/frames", ListFrames);
+    Register("/instances/{id}/frames/raw", GetRawFrames);
 
     Register("/instances/{id}/frames/{frame}/preview", GetImage<ImageExtractionMode_Preview>);
     Register("/instances/{id}/frames/{frame}/image-uint8", GetImage<ImageExtractionMode_UInt8>);
     Register("/instances/{id}/frames/{frame}/image-uint16", GetImage<ImageExtractionMode_UInt16>);
     Register("/instances/{id}/frames/{frame}/image-int16", GetImage<ImageExtractionMode_Int16>);
     Register("/instances/{id}/frames/{frame}/matlab", GetMatlabImage);
+    Register("/instances/{id}/frames/{frame}/rendered", GetRenderedFrame);
     Register("/instances/{id}/frames/{frame}/raw", GetRawFrame<false>);
     Register("/instances/{id}/frames/{frame}/raw.gz", GetRawFrame<true>);
     Register("/instances/{id}/pdf", ExtractPdf);
@@ -1774,6 +2640,7 @@ namespace Orthanc
     Register("/instances/{id}/image-uint16", GetImage<ImageExtractionMode_UInt16>);
     Register("/instances/{id}/image-int16", GetImage<ImageExtractionMode_Int16>);
     Register("/instances/{id}/matlab", GetMatlabImage);
+    Register("/instances/{id}/rendered", GetRenderedFrame);
     Register("/instances/{id}/header", GetInstanceHeader);
 
     Register("/patients/{id}/protected", IsProtectedPatient);
@@ -1800,6 +2667,8 @@ namespace Orthanc
     Register("/{resourceType}/{id}/attachments/{name}/verify-md5", VerifyAttachment);
 
     Register("/tools/invalidate-tags", InvalidateTags);
+    Register("/tools/convert-dicom-as-json", ConvertDicomAsJson);
+    Register("/tools/reconstruct-derived-data", ReconstructDerivedData);
     Register("/tools/lookup", Lookup);
     Register("/tools/find", Find);
 
@@ -1824,6 +2693,7 @@ namespace Orthanc
     Register("/instances/{id}/content/*", GetRawContent);
 
     Register("/series/{id}/ordered-slices", OrderSlices);
+    Register("/series/{id}/volume", GetSeriesVolume);
 
     Register("/patients/{id}/reconstruct", ReconstructResource<ResourceType_Patient>);
     Register("/studies/{id}/reconstruct", ReconstructResource<ResourceType_Study>);
@@ -295,31 +295,108 @@ namespace Orthanc
 
   // Jobs information ------------------------------------------------------
 
+  static size_t GetPaginationArgument(const RestApiGetCall& call,
+                                      const std::string& name)
+  {
+    // Parsed as a signed integer, as "boost::lexical_cast<size_t>"
+    // silently accepts negative values such as "-1"
+    const std::string value = call.GetArgument(name, "0");
+
+    try
+    {
+      int64_t tmp = boost::lexical_cast<int64_t>(value);
+      if (tmp >= 0)
+      {
+        return static_cast<size_t>(tmp);
+      }
+    }
+    catch (boost::bad_lexical_cast&)
+    {
+    }
+
+    throw OrthancException(ErrorCode_ParameterOutOfRange,
+                           "The \"" + name + "\" argument must be a non-negative integer: " + value);
+  }
+
+
   static void ListJobs(RestApiGetCall& call)
   {
     bool expand = call.HasArgument("expand");
 
     Json::Value v = Json::arrayValue;
 
-    std::set<std::string> jobs;
-    OrthancRestApi::GetContext(call).GetJobsEngine().GetRegistry().ListJobs(jobs);
-
-    for (std::set<std::string>::const_iterator it = jobs.begin();
-         it != jobs.end(); ++it)
+    if (call.HasArgument("state") ||
+        call.HasArgument("type") ||
+        call.HasArgument("since") ||
+        call.HasArgument("limit"))
     {
+      // Filtered and paginated listing, ordered by creation time
+      // (new in Orthanc 1.5.7)
+      std::set<JobState> states;
+
+      if (call.HasArgument("state"))
+      {
+        std::vector<std::string> tokens;
+        Toolbox::TokenizeString(tokens, call.GetArgument("state", ""), ',');
+
+        for (size_t i = 0; i < tokens.size(); i++)
+        {
+          states.insert(StringToJobState(Toolbox::StripSpaces(tokens[i])));
+        }
+      }
+
+      const size_t since = GetPaginationArgument(call, "since");
+      const size_t limit = GetPaginationArgument(call, "limit");
+      const std::string type = call.GetArgument("type", "");
+
+      JobsRegistry& registry = OrthancRestApi::GetContext(call).GetJobsEngine().GetRegistry();
+
       if (expand)
       {
-        JobInfo info;
-        if (OrthancRestApi::GetContext(call).GetJobsEngine().GetRegistry().GetJobInfo(info, *it))
+        std::list<JobInfo> jobs;
+        registry.ListJobs(jobs, states, type, since, limit);
+
+        for (std::list<JobInfo>::const_iterator it = jobs.begin(); it != jobs.end(); ++it)
         {
           Json::Value tmp;
-          info.Format(tmp);
+          it->Format(tmp);
           v.append(tmp);
         }
       }
       else
       {
-        v.append(*it);
+        // Only list the IDs, which never unserializes the jobs
+        std::list<std::string> jobs;
+        registry.ListJobs(jobs, states, type, since, limit);
+
+        for (std::list<std::string>::const_iterator it = jobs.begin(); it != jobs.end(); ++it)
+        {
+          v.append(*it);
+        }
+      }
+    }
+    else
+    {
+      std::set<std::string> jobs;
+      OrthancRestApi::GetContext(call).GetJobsEngine().GetRegistry().ListJobs(jobs);
+
+      for (std::set<std::string>::const_iterator it = jobs.begin();
+           it != jobs.end(); ++it)
+      {
+        if (expand)
+        {
+          JobInfo info;
+          if (OrthancRestApi::GetContext(call).GetJobsEngine().GetRegistry().GetJobInfo(info, *it))
+          {
+            Json::Value tmp;
+            info.Format(tmp);
+            v.append(tmp);
+          }
+        }
+        else
+        {
+          v.append(*it);
+        }
       }
     }
     
@@ -405,6 +482,36 @@ namespace Orthanc
   }
 
   
+  static std::string EscapePrometheusLabel(const std::string& value)
+  {
+    std::string s;
+    s.reserve(value.size());
+
+    for (size_t i = 0; i < value.size(); i++)
+    {
+      switch (value[i])
+      {
+        case '\\':
+          s += "\\\\";
+          break;
+
+        case '"':
+          s += "\\\"";
+          break;
+
+        case '\n':
+          s += "\\n";
+          break;
+
+        default:
+          s += value[i];
+      }
+    }
+
+    return s;
+  }
+
+
   static void GetMetricsPrometheus(RestApiGetCall& call)
   {
 #if ORTHANC_ENABLE_PLUGINS == 1
@@ -434,6 +541,43 @@ namespace Orthanc
     registry.SetValue("orthanc_jobs_completed", jobsSuccess + jobsFailed);
     registry.SetValue("orthanc_jobs_success", jobsSuccess);
     registry.SetValue("orthanc_jobs_failed", jobsFailed);
+
+    {
+      // One series of metrics for each class of jobs, i.e. for each
+      // pair (type of the jobs, remote target)
+      std::list<JobsRegistry::JobClassStatistics> classes;
+      context.GetJobsEngine().GetRegistry().GetClassesStatistics(classes);
+
+      for (std::list<JobsRegistry::JobClassStatistics>::const_iterator
+             it = classes.begin(); it != classes.end(); ++it)
+      {
+        const std::string labels = ("{type=\"" + EscapePrometheusLabel(it->type_) +
+                                    "\",target=\"" + EscapePrometheusLabel(it->target_) + "\"}");
+
+        registry.SetValue("orthanc_jobs_class_pending" + labels, it->pending_);
+        registry.SetValue("orthanc_jobs_class_running" + labels, it->running_);
+        registry.SetValue("orthanc_jobs_class_dispatched" + labels, static_cast<float>(it->dispatched_));
+        registry.SetValue("orthanc_jobs_class_average_wait_ms" + labels, it->averageWait_);
+      }
+    }
+    registry.SetValue("orthanc_dicom_cache_size_mb",
+                      static_cast<float>(context.GetDicomCache().GetCurrentSize()) / MEGA_BYTES);
+    registry.SetValue("orthanc_dicom_cache_count",
+                      static_cast<unsigned int>(context.GetDicomCache().GetNumberOfItems()));
+
+    size_t renderedSize, renderedCount;
+    uint64_t renderedHits, renderedMisses;
+    context.GetRenderedFrameCache().GetStatistics(renderedSize, renderedCount, renderedHits, renderedMisses);
+    registry.SetValue("orthanc_rendered_cache_size_mb", static_cast<float>(renderedSize) / MEGA_BYTES);
+    registry.SetValue("orthanc_rendered_cache_count", static_cast<unsigned int>(renderedCount));
+    registry.SetValue("orthanc_rendered_cache_hits", static_cast<unsigned int>(renderedHits));
+    registry.SetValue("orthanc_rendered_cache_misses", static_cast<unsigned int>(renderedMisses));
+
+    if (renderedHits + renderedMisses > 0)
+    {
+      registry.SetValue("orthanc_rendered_cache_hit_ratio", static_cast<float>(renderedHits) /
+                        static_cast<float>(renderedHits + renderedMisses));
+    }
     
     std::string s;
     registry.ExportPrometheusText(s);
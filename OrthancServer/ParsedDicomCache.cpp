@@ -0,0 +1,349 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2019 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#include "PrecompiledHeadersServer.h"
+#include "ParsedDicomCache.h"
+
+#include "../Core/Logging.h"
+#include "../Core/OrthancException.h"
+
+#include <boost/functional/hash.hpp>
+
+
+namespace Orthanc
+{
+  class ParsedDicomCache::Item : public boost::noncopyable
+  {
+  private:
+    boost::mutex                    mutex_;
+    std::auto_ptr<ParsedDicomFile>  dicom_;
+    size_t                          fileSize_;
+    uint64_t                        lastAccess_;  // Protected by the mutex of the shard
+
+  public:
+    Item(ParsedDicomFile* dicom,
+         size_t fileSize) :
+      dicom_(dicom),
+      fileSize_(fileSize),
+      lastAccess_(0)
+    {
+      if (dicom == NULL)
+      {
+        throw OrthancException(ErrorCode_NullPointer);
+      }
+    }
+
+    boost::mutex& GetMutex()
+    {
+      return mutex_;
+    }
+
+    ParsedDicomFile& GetDicom()
+    {
+      return *dicom_;
+    }
+
+    size_t GetFileSize() const
+    {
+      return fileSize_;
+    }
+
+    uint64_t GetLastAccess() const
+    {
+      return lastAccess_;
+    }
+
+    void SetLastAccess(uint64_t sequence)
+    {
+      lastAccess_ = sequence;
+    }
+  };
+
+
+  class ParsedDicomCache::Shard : public boost::noncopyable
+  {
+  public:
+    boost::mutex  mutex_;
+    LeastRecentlyUsedIndex<std::string, ItemPointer>  index_;
+
+    // Incremented by each invalidation, in order to detect instances
+    // that were invalidated while being parsed outside of the lock
+    uint64_t  generation_;
+
+    Shard() :
+      generation_(0)
+    {
+    }
+  };
+
+
+  ParsedDicomCache::Shard& ParsedDicomCache::GetShard(const std::string& instancePublicId)
+  {
+    assert(!shards_.empty());
+    size_t hash = boost::hash<std::string>()(instancePublicId);
+    return *shards_[hash % shards_.size()];
+  }
+
+
+  uint64_t ParsedDicomCache::GetNextSequence()
+  {
+    boost::mutex::scoped_lock lock(accountingMutex_);
+    sequence_++;
+    return sequence_;
+  }
+
+
+  void ParsedDicomCache::UpdateSize(size_t added,
+                                    size_t removed)
+  {
+    boost::mutex::scoped_lock lock(accountingMutex_);
+    assert(currentSize_ + added >= removed);
+    currentSize_ = currentSize_ + added - removed;
+  }
+
+
+  bool ParsedDicomCache::EvictOldest()
+  {
+    // Look for the shard containing the least recently used item
+    // (one shard is locked at a time, so this is only approximate)
+    Shard* victim = NULL;
+    uint64_t oldest = 0;
+
+    for (size_t i = 0; i < shards_.size(); i++)
+    {
+      boost::mutex::scoped_lock lock(shards_[i]->mutex_);
+
+      if (!shards_[i]->index_.IsEmpty())
+      {
+        uint64_t access = shards_[i]->index_.GetOldestPayload()->GetLastAccess();
+        if (victim == NULL ||
+            access < oldest)
+        {
+          victim = shards_[i];
+          oldest = access;
+        }
+      }
+    }
+
+    if (victim == NULL)
+    {
+      return false;
+    }
+
+    size_t removed = 0;
+
+    {
+      boost::mutex::scoped_lock lock(victim->mutex_);
+
+      if (!victim->index_.IsEmpty())
+      {
+        ItemPointer item;
+        victim->index_.RemoveOldest(item);
+        removed = item->GetFileSize();
+        UpdateSize(0, removed);
+      }
+    }
+
+    VLOG(1) << "Dropping the oldest entry of the DICOM cache (" << removed << " bytes)";
+    return true;
+  }
+
+
+  void ParsedDicomCache::MakeRoom()
+  {
+    for (;;)
+    {
+      {
+        boost::mutex::scoped_lock lock(accountingMutex_);
+        if (currentSize_ <= maxSize_)
+        {
+          return;
+        }
+      }
+
+      if (!EvictOldest())
+      {
+        return;
+      }
+    }
+  }
+
+
+  ParsedDicomCache::ItemPointer ParsedDicomCache::Acquire(const std::string& instancePublicId)
+  {
+    Shard& shard = GetShard(instancePublicId);
+    uint64_t generation;
+
+    {
+      boost::mutex::scoped_lock lock(shard.mutex_);
+
+      ItemPointer item;
+      if (shard.index_.Contains(instancePublicId, item))
+      {
+        VLOG(1) << "Reusing a parsed DICOM file from the cache: " << instancePublicId;
+        assert(item.get() != NULL);
+        shard.index_.MakeMostRecent(instancePublicId);
+        item->SetLastAccess(GetNextSequence());
+        return item;
+      }
+
+      generation = shard.generation_;
+    }
+
+    // The instance is not in the cache yet: Parse it without holding
+    // any lock, so that the other instances remain available
+    size_t fileSize = 0;
+    std::auto_ptr<ParsedDicomFile> dicom(provider_.Provide(fileSize, instancePublicId));
+    ItemPointer item(new Item(dicom.release(), fileSize));
+
+    if (fileSize > maxSize_)
+    {
+      // Too large to be cached (or cache disabled): Only used by the caller
+      return item;
+    }
+
+    {
+      boost::mutex::scoped_lock lock(shard.mutex_);
+
+      ItemPointer existing;
+      if (shard.index_.Contains(instancePublicId, existing))
+      {
+        // Another thread has concurrently parsed the same instance
+        assert(existing.get() != NULL);
+        shard.index_.MakeMostRecent(instancePublicId);
+        existing->SetLastAccess(GetNextSequence());
+        return existing;
+      }
+
+      if (shard.generation_ != generation)
+      {
+        // Some instance was invalidated while parsing, don't store a
+        // possibly outdated version of the file
+        return item;
+      }
+
+      item->SetLastAccess(GetNextSequence());
+      shard.index_.Add(instancePublicId, item);
+      UpdateSize(fileSize, 0);
+    }
+
+    MakeRoom();
+
+    return item;
+  }
+
+
+  ParsedDicomCache::Accessor::Accessor(ParsedDicomCache& cache,
+                                       const std::string& instancePublicId) :
+    item_(cache.Acquire(instancePublicId)),
+    lock_(item_->GetMutex())
+  {
+  }
+
+
+  ParsedDicomFile& ParsedDicomCache::Accessor::GetDicom()
+  {
+    assert(item_.get() != NULL);
+    return item_->GetDicom();
+  }
+
+
+  ParsedDicomCache::ParsedDicomCache(IProvider& provider,
+                                     size_t maxSize,
+                                     size_t countShards) :
+    provider_(provider),
+    maxSize_(maxSize),
+    currentSize_(0),
+    sequence_(0)
+  {
+    if (countShards == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    shards_.resize(countShards);
+    for (size_t i = 0; i < countShards; i++)
+    {
+      shards_[i] = new Shard;
+    }
+  }
+
+
+  ParsedDicomCache::~ParsedDicomCache()
+  {
+    for (size_t i = 0; i < shards_.size(); i++)
+    {
+      assert(shards_[i] != NULL);
+      delete shards_[i];
+    }
+  }
+
+
+  void ParsedDicomCache::Invalidate(const std::string& instancePublicId)
+  {
+    Shard& shard = GetShard(instancePublicId);
+
+    boost::mutex::scoped_lock lock(shard.mutex_);
+
+    shard.generation_++;
+
+    if (shard.index_.Contains(instancePublicId))
+    {
+      VLOG(1) << "Invalidating a parsed DICOM file in the cache: " << instancePublicId;
+      ItemPointer item = shard.index_.Invalidate(instancePublicId);
+      UpdateSize(0, item->GetFileSize());
+    }
+  }
+
+
+  size_t ParsedDicomCache::GetCurrentSize()
+  {
+    boost::mutex::scoped_lock lock(accountingMutex_);
+    return currentSize_;
+  }
+
+
+  size_t ParsedDicomCache::GetNumberOfItems()
+  {
+    size_t count = 0;
+
+    for (size_t i = 0; i < shards_.size(); i++)
+    {
+      boost::mutex::scoped_lock lock(shards_[i]->mutex_);
+      count += shards_[i]->index_.GetSize();
+    }
+
+    return count;
+  }
+}
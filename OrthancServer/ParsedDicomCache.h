@@ -0,0 +1,133 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2019 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#pragma once
+
+#include "../Core/Cache/LeastRecentlyUsedIndex.h"
+#include "../Core/DicomParsing/ParsedDicomFile.h"
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace Orthanc
+{
+  /**
+   * Thread-safe cache of parsed DICOM instances, whose memory
+   * footprint is bounded by a number of bytes (the size of the DICOM
+   * files). The cache is split into shards that are protected by
+   * distinct mutexes, so that accesses to different instances do not
+   * contend on the same lock, and so that parsing a DICOM file never
+   * blocks the rest of the cache. Each entry is pinned by the
+   * accessors that use it: It stays alive even if it is evicted from
+   * the cache in the meantime, and it can only be used by one thread
+   * at a time (DCMTK datasets are not thread-safe, even for reading).
+   **/
+  class ParsedDicomCache : public boost::noncopyable
+  {
+  public:
+    class IProvider : public boost::noncopyable
+    {
+    public:
+      virtual ~IProvider()
+      {
+      }
+
+      // "fileSize" must be set to the size of the DICOM file, which
+      // is used as an estimate of the memory used by the entry
+      virtual ParsedDicomFile* Provide(size_t& fileSize,
+                                       const std::string& instancePublicId) = 0;
+    };
+
+  private:
+    class Item;
+    class Shard;
+
+    typedef boost::shared_ptr<Item>  ItemPointer;
+
+    IProvider&           provider_;
+    size_t               maxSize_;
+    std::vector<Shard*>  shards_;
+
+    // This mutex protects "currentSize_" and "sequence_". It must
+    // always be locked *after* the mutex of a shard.
+    boost::mutex         accountingMutex_;
+    size_t               currentSize_;
+    uint64_t             sequence_;
+
+    Shard& GetShard(const std::string& instancePublicId);
+
+    uint64_t GetNextSequence();
+
+    void UpdateSize(size_t added,
+                    size_t removed);
+
+    bool EvictOldest();
+
+    void MakeRoom();
+
+    ItemPointer Acquire(const std::string& instancePublicId);
+
+  public:
+    class Accessor : public boost::noncopyable
+    {
+    private:
+      ItemPointer                item_;
+      boost::mutex::scoped_lock  lock_;
+
+    public:
+      Accessor(ParsedDicomCache& cache,
+               const std::string& instancePublicId);
+
+      ParsedDicomFile& GetDicom();
+    };
+
+    // Setting "maxSize" to zero disables the caching
+    ParsedDicomCache(IProvider& provider,
+                     size_t maxSize,
+                     size_t countShards);
+
+    ~ParsedDicomCache();
+
+    void Invalidate(const std::string& instancePublicId);
+
+    size_t GetMaximumSize() const
+    {
+      return maxSize_;
+    }
+
+    size_t GetCurrentSize();
+
+    size_t GetNumberOfItems();
+  };
+}
@@ -0,0 +1,221 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2019 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#include "PrecompiledHeadersServer.h"
+#include "RenderedFrameCache.h"
+
+#include "../Core/Logging.h"
+
+#include <boost/lexical_cast.hpp>
+
+
+namespace Orthanc
+{
+  std::string RenderedFrameCache::FormatKey(const std::string& instancePublicId,
+                                            unsigned int frame,
+                                            ImageExtractionMode mode,
+                                            MimeType format,
+                                            unsigned int quality,
+                                            const std::string& parameters)
+  {
+    return (instancePublicId + "|" +
+            boost::lexical_cast<std::string>(frame) + "|" +
+            boost::lexical_cast<std::string>(static_cast<int>(mode)) + "|" +
+            EnumerationToString(format) + "|" +
+            boost::lexical_cast<std::string>(quality) + "|" +
+            parameters);
+  }
+
+
+  void RenderedFrameCache::RemoveInternal(const std::string& key)
+  {
+    // The mutex must be locked by the caller
+    Item* item = index_.Invalidate(key);
+    assert(item != NULL);
+
+    InstanceKeys::iterator found = instanceKeys_.find(item->instancePublicId_);
+    if (found != instanceKeys_.end())
+    {
+      found->second.erase(key);
+      if (found->second.empty())
+      {
+        instanceKeys_.erase(found);
+      }
+    }
+
+    assert(currentSize_ >= item->content_.size());
+    currentSize_ -= item->content_.size();
+    delete item;
+  }
+
+
+  RenderedFrameCache::RenderedFrameCache(size_t maxSize) :
+    maxSize_(maxSize),
+    currentSize_(0),
+    hits_(0),
+    misses_(0),
+    generation_(0)
+  {
+  }
+
+
+  RenderedFrameCache::~RenderedFrameCache()
+  {
+    while (!index_.IsEmpty())
+    {
+      Item* item = NULL;
+      index_.RemoveOldest(item);
+      assert(item != NULL);
+      delete item;
+    }
+  }
+
+
+  bool RenderedFrameCache::Lookup(std::string& content,
+                                  uint64_t& generation,
+                                  const std::string& instancePublicId,
+                                  unsigned int frame,
+                                  ImageExtractionMode mode,
+                                  MimeType format,
+                                  unsigned int quality,
+                                  const std::string& parameters)
+  {
+    const std::string key = FormatKey(instancePublicId, frame, mode, format, quality, parameters);
+
+    boost::mutex::scoped_lock lock(mutex_);
+
+    generation = generation_;
+
+    Item* item = NULL;
+    if (index_.Contains(key, item))
+    {
+      assert(item != NULL);
+      index_.MakeMostRecent(key);
+      content = item->content_;
+      hits_++;
+      return true;
+    }
+    else
+    {
+      misses_++;
+      return false;
+    }
+  }
+
+
+  void RenderedFrameCache::Store(uint64_t generation,
+                                 const std::string& instancePublicId,
+                                 unsigned int frame,
+                                 ImageExtractionMode mode,
+                                 MimeType format,
+                                 unsigned int quality,
+                                 const std::string& parameters,
+                                 const std::string& content)
+  {
+    if (content.size() > maxSize_)
+    {
+      return;  // Too large to be cached (or cache disabled)
+    }
+
+    const std::string key = FormatKey(instancePublicId, frame, mode, format, quality, parameters);
+
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (generation_ != generation)
+    {
+      // Some instance was invalidated while rendering, don't store a
+      // possibly outdated rendering
+      return;
+    }
+
+    if (index_.Contains(key))
+    {
+      // Concurrently rendered by another thread
+      index_.MakeMostRecent(key);
+      return;
+    }
+
+    while (currentSize_ + content.size() > maxSize_)
+    {
+      assert(!index_.IsEmpty());
+      VLOG(1) << "Dropping the oldest rendered frame from the cache";
+      const std::string oldest = index_.GetOldest();  // Copy, as "RemoveInternal()" invalidates the reference
+      RemoveInternal(oldest);
+    }
+
+    std::auto_ptr<Item> item(new Item);
+    item->instancePublicId_ = instancePublicId;
+    item->content_ = content;
+
+    index_.Add(key, item.release());
+    instanceKeys_[instancePublicId].insert(key);
+    currentSize_ += content.size();
+  }
+
+
+  void RenderedFrameCache::Invalidate(const std::string& instancePublicId)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    // Even if nothing is cached yet, a rendering of this instance
+    // might be in progress
+    generation_++;
+
+    InstanceKeys::iterator found = instanceKeys_.find(instancePublicId);
+    if (found != instanceKeys_.end())
+    {
+      VLOG(1) << "Invalidating the rendered frames of instance " << instancePublicId;
+
+      // Copy the keys, as "RemoveInternal()" modifies "instanceKeys_"
+      std::set<std::string> keys = found->second;
+      for (std::set<std::string>::const_iterator it = keys.begin(); it != keys.end(); ++it)
+      {
+        RemoveInternal(*it);
+      }
+    }
+  }
+
+
+  void RenderedFrameCache::GetStatistics(size_t& currentSize,
+                                         size_t& count,
+                                         uint64_t& hits,
+                                         uint64_t& misses)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    currentSize = currentSize_;
+    count = index_.GetSize();
+    hits = hits_;
+    misses = misses_;
+  }
+}
@@ -0,0 +1,117 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2019 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+
+#pragma once
+
+#include "../Core/Cache/LeastRecentlyUsedIndex.h"
+#include "../Core/Enumerations.h"
+
+#include <boost/thread/mutex.hpp>
+#include <map>
+#include <set>
+
+namespace Orthanc
+{
+  /**
+   * Thread-safe, memory-bounded cache of the encoded renderings of
+   * the frames of DICOM instances (PNG, JPEG or PAM), as produced by
+   * the "/instances/{id}/frames/{frame}/preview" family of URIs.
+   **/
+  class RenderedFrameCache : public boost::noncopyable
+  {
+  private:
+    struct Item
+    {
+      std::string  instancePublicId_;
+      std::string  content_;
+    };
+
+    typedef LeastRecentlyUsedIndex<std::string, Item*>         Index;
+    typedef std::map<std::string, std::set<std::string> >     InstanceKeys;
+
+    boost::mutex  mutex_;
+    size_t        maxSize_;
+    size_t        currentSize_;
+    Index         index_;
+    InstanceKeys  instanceKeys_;
+    uint64_t      hits_;
+    uint64_t      misses_;
+    uint64_t      generation_;  // Incremented by each invalidation
+
+    static std::string FormatKey(const std::string& instancePublicId,
+                                 unsigned int frame,
+                                 ImageExtractionMode mode,
+                                 MimeType format,
+                                 unsigned int quality,
+                                 const std::string& parameters);
+
+    void RemoveInternal(const std::string& key);
+
+  public:
+    // Setting "maxSize" to zero disables the caching
+    RenderedFrameCache(size_t maxSize);
+
+    ~RenderedFrameCache();
+
+    // "parameters" is a free-form description of the additional
+    // rendering options (such as windowing or resizing), that is part
+    // of the key of the cache. On a miss, "generation" must be given
+    // back to "Store()", that drops the content if the instance was
+    // invalidated while it was being rendered.
+    bool Lookup(std::string& content,
+                uint64_t& generation,
+                const std::string& instancePublicId,
+                unsigned int frame,
+                ImageExtractionMode mode,
+                MimeType format,
+                unsigned int quality,
+                const std::string& parameters);
+
+    void Store(uint64_t generation,
+               const std::string& instancePublicId,
+               unsigned int frame,
+               ImageExtractionMode mode,
+               MimeType format,
+               unsigned int quality,
+               const std::string& parameters,
+               const std::string& content);
+
+    void Invalidate(const std::string& instancePublicId);
+
+    void GetStatistics(size_t& currentSize,
+                       size_t& count,
+                       uint64_t& hits,
+                       uint64_t& misses);
+  };
+}
@@ -41,8 +41,7 @@
 #include "../../Core/OrthancException.h"
 #include "../../Core/Toolbox.h"
 #include "DatabaseConstraint.h"
-
-#include <boost/regex.hpp>
+#include "WildcardMatcher.h"
 
 namespace Orthanc
 {
@@ -79,26 +78,6 @@ namespace Orthanc
   };
 
 
-  class DicomTagConstraint::RegularExpression : public boost::noncopyable
-  {
-  private:
-    boost::regex  regex_;
-
-  public:
-    RegularExpression(const std::string& source,
-                      bool caseSensitive)
-    {
-      NormalizedString normalized(source, caseSensitive);
-      regex_ = boost::regex(Toolbox::WildcardToRegularExpression(normalized.GetValue()));
-    }
-
-    const boost::regex& GetValue() const
-    {
-      return regex_;
-    }
-  };
-
-
   void DicomTagConstraint::AssignSingleValue(const std::string& value)
   {
     if (constraintType_ != ConstraintType_Wildcard &&
@@ -214,8 +193,26 @@ namespace Orthanc
   }
 
 
+  void DicomTagConstraint::SetCaseSensitive(bool caseSensitive)
+  {
+    caseSensitive_ = caseSensitive;
+    wildcard_.reset();  // The pattern must be compiled again
+  }
+
+
   bool DicomTagConstraint::IsMatch(const std::string& value)
   {
+    if (constraintType_ == ConstraintType_Wildcard)
+    {
+      // The pattern is compiled once, then reused for all the values
+      if (wildcard_.get() == NULL)
+      {
+        wildcard_.reset(new WildcardMatcher(GetValue(), caseSensitive_));
+      }
+
+      return wildcard_->IsMatch(value);
+    }
+
     NormalizedString source(value, caseSensitive_);
 
     switch (constraintType_)
@@ -238,16 +235,6 @@ namespace Orthanc
         return source.GetValue() >= reference.GetValue();
       }
 
-      case ConstraintType_Wildcard:
-      {
-        if (regex_.get() == NULL)
-        {
-          regex_.reset(new RegularExpression(GetValue(), caseSensitive_));
-        }
-
-        return boost::regex_match(source.GetValue(), regex_->GetValue());
-      }
-
       case ConstraintType_List:
       {
         for (std::set<std::string>::const_iterator
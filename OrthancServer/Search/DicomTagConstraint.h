@@ -41,11 +41,12 @@
 
 namespace Orthanc
 {
+  class WildcardMatcher;
+
   class DicomTagConstraint : public boost::noncopyable
   {
   private:
     class NormalizedString;
-    class RegularExpression;
 
     DicomTag                tag_;
     ConstraintType          constraintType_;
@@ -53,7 +54,7 @@ namespace Orthanc
     bool                    caseSensitive_;
     bool                    mandatory_;
 
-    boost::shared_ptr<RegularExpression>  regex_;
+    boost::shared_ptr<WildcardMatcher>  wildcard_;
 
     void AssignSingleValue(const std::string& value);
 
@@ -87,10 +88,7 @@ namespace Orthanc
       return caseSensitive_;
     }
 
-    void SetCaseSensitive(bool caseSensitive)
-    {
-      caseSensitive_ = caseSensitive;
-    }
+    void SetCaseSensitive(bool caseSensitive);
 
     bool IsMandatory() const
     {
@@ -0,0 +1,205 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2019 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "../PrecompiledHeadersServer.h"
+#include "WildcardMatcher.h"
+
+#include "../../Core/Toolbox.h"
+
+#include <cassert>
+
+namespace Orthanc
+{
+  bool WildcardMatcher::IsSegmentAt(const std::string& value,
+                                    size_t position,
+                                    const Segment& segment)
+  {
+    const std::string& text = segment.text_;
+    
+    if (position + text.size() > value.size())
+    {
+      return false;
+    }
+    else if (!segment.hasJoker_)
+    {
+      return value.compare(position, text.size(), text) == 0;
+    }
+    else
+    {
+      for (size_t i = 0; i < text.size(); i++)
+      {
+        if (text[i] != '?' &&
+            text[i] != value[position + i])
+        {
+          return false;
+        }
+      }
+
+      return true;
+    }
+  }
+
+
+  bool WildcardMatcher::FindSegment(size_t& position,
+                                    const std::string& value,
+                                    size_t end,
+                                    const Segment& segment)
+  {
+    // Look for the leftmost occurrence of the segment in the range
+    // [position, end[ of the value
+    const size_t size = segment.text_.size();
+
+    if (position + size > end)
+    {
+      return false;
+    }
+    else if (!segment.hasJoker_)
+    {
+      size_t found = value.find(segment.text_, position);
+      if (found == std::string::npos ||
+          found + size > end)
+      {
+        return false;
+      }
+      else
+      {
+        position = found;
+        return true;
+      }
+    }
+    else
+    {
+      for (size_t i = position; i + size <= end; i++)
+      {
+        if (IsSegmentAt(value, i, segment))
+        {
+          position = i;
+          return true;
+        }
+      }
+
+      return false;
+    }
+  }
+
+  
+  WildcardMatcher::WildcardMatcher(const std::string& pattern,
+                                   bool caseSensitive) :
+    caseSensitive_(caseSensitive)
+  {
+    const std::string normalized = (caseSensitive ? pattern :
+                                    Toolbox::ToUpperCaseWithAccents(pattern));
+
+    Segment current;
+    current.hasJoker_ = false;
+
+    for (size_t i = 0; i < normalized.size(); i++)
+    {
+      if (normalized[i] == '*')
+      {
+        segments_.push_back(current);
+        current.text_.clear();
+        current.hasJoker_ = false;
+      }
+      else
+      {
+        if (normalized[i] == '?')
+        {
+          current.hasJoker_ = true;
+        }
+        
+        current.text_.push_back(normalized[i]);
+      }
+    }
+
+    segments_.push_back(current);
+  }
+
+
+  bool WildcardMatcher::IsMatchNormalized(const std::string& value) const
+  {
+    assert(!segments_.empty());
+
+    const Segment& first = segments_.front();
+    
+    if (segments_.size() == 1)
+    {
+      // No "*" in the pattern
+      return (value.size() == first.text_.size() &&
+              IsSegmentAt(value, 0, first));
+    }
+
+    // The first segment is anchored at the beginning of the value,
+    // and the last segment is anchored at its end
+    const Segment& last = segments_.back();
+
+    if (first.text_.size() + last.text_.size() > value.size() ||
+        !IsSegmentAt(value, 0, first) ||
+        !IsSegmentAt(value, value.size() - last.text_.size(), last))
+    {
+      return false;
+    }
+
+    // The segments in between can float, and taking their leftmost
+    // occurrence is always the best choice
+    size_t position = first.text_.size();
+    const size_t end = value.size() - last.text_.size();
+
+    for (size_t i = 1; i + 1 < segments_.size(); i++)
+    {
+      if (FindSegment(position, value, end, segments_[i]))
+      {
+        position += segments_[i].text_.size();
+      }
+      else
+      {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+
+  bool WildcardMatcher::IsMatch(const std::string& value) const
+  {
+    if (caseSensitive_)
+    {
+      return IsMatchNormalized(value);
+    }
+    else
+    {
+      return IsMatchNormalized(Toolbox::ToUpperCaseWithAccents(value));
+    }
+  }
+}
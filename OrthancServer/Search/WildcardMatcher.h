@@ -0,0 +1,87 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2019 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+
+#include <boost/noncopyable.hpp>
+#include <string>
+#include <vector>
+
+namespace Orthanc
+{
+  /**
+   * Matcher for the DICOM wildcards ("*" matches any sequence of
+   * characters, "?" matches one single character). The pattern is
+   * compiled once, then the matcher can be applied to a large number
+   * of values without resorting to regular expressions.
+   **/
+  class WildcardMatcher : public boost::noncopyable
+  {
+  private:
+    // Part of the pattern between two "*"
+    struct Segment
+    {
+      std::string  text_;
+      bool         hasJoker_;   // Whether the segment contains "?"
+    };
+
+    std::vector<Segment>  segments_;
+    bool                  caseSensitive_;
+
+    static bool IsSegmentAt(const std::string& value,
+                            size_t position,
+                            const Segment& segment);
+
+    static bool FindSegment(size_t& position,
+                            const std::string& value,
+                            size_t end,
+                            const Segment& segment);
+
+  public:
+    // If "caseSensitive" is false, the pattern and the values are
+    // made uppercase, taking the accents into account
+    WildcardMatcher(const std::string& pattern,
+                    bool caseSensitive);
+
+    bool IsCaseSensitive() const
+    {
+      return caseSensitive_;
+    }
+
+    // The value must already be uppercase if the matcher is not
+    // case-sensitive
+    bool IsMatchNormalized(const std::string& value) const;
+
+    bool IsMatch(const std::string& value) const;
+  };
+}
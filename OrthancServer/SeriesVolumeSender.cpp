@@ -0,0 +1,490 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2019 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "PrecompiledHeadersServer.h"
+#include "SeriesVolumeSender.h"
+
+#include "../Core/DicomParsing/Internals/DicomImageDecoder.h"
+#include "../Core/DicomParsing/ParsedDicomFile.h"
+#include "../Core/Images/ParallelImageProcessing.h"
+#include "../Core/OrthancException.h"
+#include "../Core/Toolbox.h"
+#include "../Plugins/Engine/OrthancPlugins.h"
+#include "ServerContext.h"
+#include "SliceOrdering.h"
+
+#include <algorithm>
+#include <boost/lexical_cast.hpp>
+#include <cmath>
+#include <json/writer.h>
+
+
+namespace Orthanc
+{
+  static const DicomTag DICOM_TAG_SPACING_BETWEEN_SLICES(0x0018, 0x0088);
+
+
+  static bool TokenizeVector(std::vector<double>& result,
+                             const DicomMap& map,
+                             const DicomTag& tag,
+                             size_t expectedSize)
+  {
+    std::string value;
+    if (!map.CopyToString(value, tag, false))
+    {
+      return false;
+    }
+
+    std::vector<std::string> tokens;
+    Toolbox::TokenizeString(tokens, value, '\\');
+
+    if (tokens.size() != expectedSize)
+    {
+      return false;
+    }
+
+    result.resize(tokens.size());
+
+    for (size_t i = 0; i < tokens.size(); i++)
+    {
+      try
+      {
+        result[i] = boost::lexical_cast<double>(Toolbox::StripSpaces(tokens[i]));
+      }
+      catch (boost::bad_lexical_cast&)
+      {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+
+  static size_t GetBytesPerSample(PixelFormat format)
+  {
+    switch (format)
+    {
+      case PixelFormat_Grayscale8:
+      case PixelFormat_RGB24:
+        return 1;
+
+      case PixelFormat_Grayscale16:
+      case PixelFormat_SignedGrayscale16:
+        return 2;
+
+      case PixelFormat_Grayscale32:
+      case PixelFormat_Float32:
+        return 4;
+
+      default:
+        throw OrthancException(ErrorCode_NotImplemented,
+                               "Unsupported pixel format in a volume: " +
+                               std::string(EnumerationToString(format)));
+    }
+  }
+
+
+  static ImageAccessor* DecodeSlice(ServerContext& context,
+                                    const std::string& instance,
+                                    unsigned int frame,
+                                    bool isMultiFrame)
+  {
+    std::auto_ptr<ImageAccessor> decoded;
+
+#if ORTHANC_ENABLE_PLUGINS == 1
+    if (context.HasPlugins() &&
+        context.GetPlugins().HasCustomImageDecoder())
+    {
+      std::string dicom;
+      context.ReadDicom(dicom, instance);
+      decoded.reset(context.GetPlugins().DecodeUnsafe(dicom.c_str(), dicom.size(), frame));
+    }
+#endif
+
+    if (decoded.get() == NULL)
+    {
+      if (isMultiFrame)
+      {
+        // The frames of the same instance share the parsed file
+        ServerContext::DicomCacheLocker locker(context, instance);
+        decoded.reset(DicomImageDecoder::Decode(locker.GetDicom(), frame));
+      }
+      else
+      {
+        // Bypass the cache of parsed files, that would be flushed by
+        // the slices of a large series
+        std::string dicom;
+        context.ReadDicom(dicom, instance);
+
+        ParsedDicomFile parsed(dicom);
+        decoded.reset(DicomImageDecoder::Decode(parsed, frame));
+      }
+    }
+
+    if (decoded.get() == NULL)
+    {
+      throw OrthancException(ErrorCode_NotImplemented,
+                             "Cannot decode frame " + boost::lexical_cast<std::string>(frame) +
+                             " of instance " + instance);
+    }
+
+    return decoded.release();
+  }
+
+
+  class SeriesVolumeSender::SlicesDecoder : public ParallelImageProcessing::IBandOperation
+  {
+  private:
+    ServerContext&                context_;
+    const std::vector<Slice>&     slices_;
+    size_t                        firstSlice_;
+    std::vector<ImageAccessor*>   decoded_;
+
+  public:
+    SlicesDecoder(ServerContext& context,
+                  const std::vector<Slice>& slices,
+                  size_t firstSlice,
+                  size_t endSlice) :
+      context_(context),
+      slices_(slices),
+      firstSlice_(firstSlice),
+      decoded_(endSlice - firstSlice, NULL)
+    {
+      assert(firstSlice <= endSlice &&
+             endSlice <= slices.size());
+    }
+
+    virtual ~SlicesDecoder()
+    {
+      for (size_t i = 0; i < decoded_.size(); i++)
+      {
+        delete decoded_[i];
+      }
+    }
+
+    virtual void Apply(unsigned int firstItem,
+                       unsigned int endItem)
+    {
+      for (unsigned int i = firstItem; i < endItem; i++)
+      {
+        const Slice& slice = slices_[firstSlice_ + i];
+        decoded_[i] = DecodeSlice(context_, slice.instance_, slice.frame_, slice.isMultiFrame_);
+      }
+    }
+
+    void Decode()
+    {
+      const unsigned int count = static_cast<unsigned int>(decoded_.size());
+
+      if (!ParallelImageProcessing::ApplyToItems(*this, count))
+      {
+        Apply(0, count);
+      }
+    }
+
+    const ImageAccessor& GetSlice(size_t i) const
+    {
+      assert(i < decoded_.size() &&
+             decoded_[i] != NULL);
+      return *decoded_[i];
+    }
+  };
+
+
+  void SeriesVolumeSender::DecodeBatch(std::string& target,
+                                       size_t firstSlice,
+                                       size_t endSlice)
+  {
+    SlicesDecoder decoder(context_, slices_, firstSlice, endSlice);
+    decoder.Decode();
+
+    if (firstSlice == 0)
+    {
+      // The first slice defines the format of the volume
+      const ImageAccessor& first = decoder.GetSlice(0);
+      format_ = first.GetFormat();
+      width_ = first.GetWidth();
+      height_ = first.GetHeight();
+    }
+
+    const size_t sampleSize = GetBytesPerSample(format_);
+    const size_t lineSize = width_ * GetBytesPerPixel(format_);
+    const size_t sliceSize = lineSize * height_;
+    const bool swap = (sampleSize > 1 &&
+                       Toolbox::DetectEndianness() == Endianness_Big);
+
+    target.resize(sliceSize * (endSlice - firstSlice));
+
+    for (size_t i = 0; i < endSlice - firstSlice; i++)
+    {
+      const ImageAccessor& slice = decoder.GetSlice(i);
+
+      if (slice.GetFormat() != format_)
+      {
+        throw OrthancException(ErrorCode_IncompatibleImageFormat,
+                               "The slices of the series do not share the same pixel format");
+      }
+
+      if (slice.GetWidth() != width_ ||
+          slice.GetHeight() != height_)
+      {
+        throw OrthancException(ErrorCode_IncompatibleImageSize,
+                               "The slices of the series do not share the same size");
+      }
+
+      for (unsigned int y = 0; y < height_; y++)
+      {
+        if (lineSize == 0)
+        {
+          continue;
+        }
+
+        uint8_t* q = reinterpret_cast<uint8_t*>(&target[i * sliceSize + y * lineSize]);
+        memcpy(q, slice.GetConstRow(y), lineSize);
+
+        if (swap)
+        {
+          // The voxels are always sent as little-endian
+          for (size_t j = 0; j < lineSize; j += sampleSize)
+          {
+            std::reverse(q + j, q + j + sampleSize);
+          }
+        }
+      }
+    }
+  }
+
+
+  void SeriesVolumeSender::ComputeGeometry(const std::string& seriesId,
+                                           bool isVolume)
+  {
+    geometry_ = Json::objectValue;
+    geometry_["Series"] = seriesId;
+    geometry_["Type"] = (isVolume ? "Volume" : "Sequence");
+    geometry_["Width"] = width_;
+    geometry_["Height"] = height_;
+    geometry_["Depth"] = static_cast<unsigned int>(slices_.size());
+    geometry_["PixelFormat"] = EnumerationToString(format_);
+    geometry_["BytesPerVoxel"] = GetBytesPerPixel(format_);
+
+    DicomMap first;
+
+    {
+      Json::Value tmp;
+      context_.ReadDicomAsJson(tmp, slices_[0].instance_);
+      first.FromDicomAsJson(tmp);
+    }
+
+    // The "PixelSpacing" tag contains the spacing between the rows,
+    // then the spacing between the columns
+    std::vector<double> pixelSpacing;
+    if (!TokenizeVector(pixelSpacing, first, DICOM_TAG_PIXEL_SPACING, 2))
+    {
+      pixelSpacing.resize(2);
+      pixelSpacing[0] = 1;
+      pixelSpacing[1] = 1;
+    }
+
+    std::vector<double> orientation, origin;
+    const bool hasOrientation = TokenizeVector(orientation, first, DICOM_TAG_IMAGE_ORIENTATION_PATIENT, 6);
+    const bool hasOrigin = TokenizeVector(origin, first, DICOM_TAG_IMAGE_POSITION_PATIENT, 3);
+
+    double spacingZ = 0;
+
+    if (isVolume &&
+        hasOrientation &&
+        hasOrigin &&
+        slices_.size() >= 2 &&
+        slices_[1].instance_ != slices_[0].instance_)
+    {
+      // Distance between the two first slices along the normal
+      DicomMap second;
+      std::vector<double> position;
+
+      if (context_.GetIndex().GetMainDicomTags(second, slices_[1].instance_,
+                                               ResourceType_Instance, ResourceType_Instance) &&
+          TokenizeVector(position, second, DICOM_TAG_IMAGE_POSITION_PATIENT, 3))
+      {
+        const double normal[3] = {
+          orientation[1] * orientation[5] - orientation[2] * orientation[4],
+          orientation[2] * orientation[3] - orientation[0] * orientation[5],
+          orientation[0] * orientation[4] - orientation[1] * orientation[3]
+        };
+
+        spacingZ = std::fabs(normal[0] * (position[0] - origin[0]) +
+                             normal[1] * (position[1] - origin[1]) +
+                             normal[2] * (position[2] - origin[2]));
+      }
+    }
+
+    if (spacingZ <= 0 &&
+        !first.ParseDouble(spacingZ, DICOM_TAG_SPACING_BETWEEN_SLICES) &&
+        !first.ParseDouble(spacingZ, DICOM_TAG_SLICE_THICKNESS))
+    {
+      spacingZ = 1;
+    }
+
+    Json::Value spacing = Json::arrayValue;
+    spacing.append(pixelSpacing[1]);
+    spacing.append(pixelSpacing[0]);
+    spacing.append(spacingZ);
+    geometry_["VoxelSpacing"] = spacing;
+
+    if (hasOrientation)
+    {
+      Json::Value tmp = Json::arrayValue;
+      for (size_t i = 0; i < 6; i++)
+      {
+        tmp.append(orientation[i]);
+      }
+
+      geometry_["ImageOrientationPatient"] = tmp;
+    }
+
+    if (hasOrigin)
+    {
+      Json::Value tmp = Json::arrayValue;
+      for (size_t i = 0; i < 3; i++)
+      {
+        tmp.append(origin[i]);
+      }
+
+      geometry_["ImagePositionPatient"] = tmp;
+    }
+  }
+
+
+  SeriesVolumeSender::SeriesVolumeSender(ServerContext& context,
+                                         const std::string& seriesId) :
+    context_(context),
+    format_(PixelFormat_Grayscale8),
+    width_(0),
+    height_(0),
+    nextSlice_(0),
+    isFirstChunk_(true)
+  {
+    SliceOrdering ordering(context.GetIndex(), seriesId);
+
+    for (size_t i = 0; i < ordering.GetInstancesCount(); i++)
+    {
+      const unsigned int frames = ordering.GetFramesCount(i);
+
+      for (unsigned int j = 0; j < frames; j++)
+      {
+        Slice slice;
+        slice.instance_ = ordering.GetInstanceId(i);
+        slice.frame_ = j;
+        slice.isMultiFrame_ = (frames > 1);
+        slices_.push_back(slice);
+      }
+    }
+
+    if (slices_.empty())
+    {
+      throw OrthancException(ErrorCode_BadFileFormat,
+                             "Series without frames: " + seriesId);
+    }
+
+    // Two batches per thread, so that the slow slices are balanced
+    batchSize_ = 2 * std::max(1u, ParallelImageProcessing::GetThreadsCount());
+
+    // Decode the first batch now, in order to know the size of the
+    // volume before the HTTP headers are sent
+    std::string batch;
+    nextSlice_ = std::min(batchSize_, slices_.size());
+    DecodeBatch(batch, 0, nextSlice_);
+
+    ComputeGeometry(seriesId, ordering.IsVolume());
+
+    Json::FastWriter writer;
+    std::string json = writer.write(geometry_);
+
+    const uint32_t size = static_cast<uint32_t>(json.size());
+    header_.resize(4);
+    header_[0] = static_cast<char>(size & 0xff);
+    header_[1] = static_cast<char>((size >> 8) & 0xff);
+    header_[2] = static_cast<char>((size >> 16) & 0xff);
+    header_[3] = static_cast<char>((size >> 24) & 0xff);
+    header_ += json;
+
+    chunk_ = header_;
+    chunk_ += batch;
+
+    SetContentType(MimeType_Binary);
+  }
+
+
+  uint64_t SeriesVolumeSender::GetContentLength()
+  {
+    return (static_cast<uint64_t>(header_.size()) +
+            static_cast<uint64_t>(slices_.size()) *
+            static_cast<uint64_t>(width_) *
+            static_cast<uint64_t>(height_) *
+            static_cast<uint64_t>(GetBytesPerPixel(format_)));
+  }
+
+
+  bool SeriesVolumeSender::ReadNextChunk()
+  {
+    if (isFirstChunk_)
+    {
+      // The header, followed by the first batch of slices
+      isFirstChunk_ = false;
+      return true;
+    }
+    else if (nextSlice_ >= slices_.size())
+    {
+      return false;
+    }
+    else
+    {
+      const size_t end = std::min(nextSlice_ + batchSize_, slices_.size());
+      DecodeBatch(chunk_, nextSlice_, end);
+      nextSlice_ = end;
+      return true;
+    }
+  }
+
+
+  const char* SeriesVolumeSender::GetChunkContent()
+  {
+    return chunk_.empty() ? NULL : chunk_.c_str();
+  }
+
+
+  size_t SeriesVolumeSender::GetChunkSize()
+  {
+    return chunk_.size();
+  }
+}
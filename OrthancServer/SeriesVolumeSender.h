@@ -0,0 +1,106 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2019 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+
+#include "../Core/HttpServer/HttpFileSender.h"
+#include "../Core/Images/ImageAccessor.h"
+
+#include <json/value.h>
+
+namespace Orthanc
+{
+  class ServerContext;
+
+  /**
+   * Streams the frames of a series, ordered by "SliceOrdering", as
+   * one contiguous buffer of little-endian voxels. The answer starts
+   * with a header made of the size of a JSON object (32-bit unsigned
+   * integer, little-endian), followed by this JSON object that
+   * describes the geometry of the volume. The slices are decoded in
+   * parallel by batches, which bounds the memory that is used.
+   **/
+  class SeriesVolumeSender : public HttpFileSender
+  {
+  private:
+    struct Slice
+    {
+      std::string   instance_;
+      unsigned int  frame_;
+      bool          isMultiFrame_;
+    };
+
+    class SlicesDecoder;
+
+    ServerContext&      context_;
+    std::vector<Slice>  slices_;
+    Json::Value         geometry_;
+    std::string         header_;
+    PixelFormat         format_;
+    unsigned int        width_;
+    unsigned int        height_;
+    size_t              batchSize_;
+    size_t              nextSlice_;
+    bool                isFirstChunk_;
+    std::string         chunk_;
+
+    void DecodeBatch(std::string& target,
+                     size_t firstSlice,
+                     size_t endSlice);
+
+    void ComputeGeometry(const std::string& seriesId,
+                         bool isVolume);
+
+  public:
+    SeriesVolumeSender(ServerContext& context,
+                       const std::string& seriesId);
+
+    const Json::Value& GetGeometry() const
+    {
+      return geometry_;
+    }
+
+
+    /**
+     * Implementation of the IHttpStreamAnswer interface.
+     **/
+
+    virtual uint64_t GetContentLength();
+
+    virtual bool ReadNextChunk();
+
+    virtual const char* GetChunkContent();
+
+    virtual size_t GetChunkSize();
+  };
+}
@@ -35,11 +35,15 @@
 #include "ServerContext.h"
 
 #include "../Core/Cache/SharedArchive.h"
+#include "../Core/DicomFormat/CompactDicomAsJson.h"
+#include "../Core/DicomFormat/DicomFrameOffsets.h"
+#include "../Core/DicomFormat/DicomImageInformation.h"
 #include "../Core/DicomParsing/FromDcmtkBridge.h"
 #include "../Core/FileStorage/StorageAccessor.h"
 #include "../Core/HttpServer/FilesystemHttpSender.h"
 #include "../Core/HttpServer/HttpStreamTranscoder.h"
 #include "../Core/JobsEngine/SetOfInstancesJob.h"
+#include "../Core/JsonStreamWriter.h"
 #include "../Core/Logging.h"
 #include "../Core/MetricsRegistry.h"
 #include "../Plugins/Engine/OrthancPlugins.h"
@@ -49,15 +53,14 @@
 #include "Search/DatabaseLookup.h"
 #include "ServerJobs/OrthancJobUnserializer.h"
 #include "ServerToolbox.h"
+#include "SliceOrdering.h"
 
 #include <EmbeddedResources.h>
 #include <dcmtk/dcmdata/dcfilefo.h>
 
 
 
-#define ENABLE_DICOM_CACHE  1
-
-static const size_t DICOM_CACHE_SIZE = 2;
+static const size_t DICOM_CACHE_SHARDS = 16;
 
 /**
  * IMPORTANT: We make the assumption that the same instance of
@@ -70,6 +73,72 @@ static const size_t DICOM_CACHE_SIZE = 2;
 
 namespace Orthanc
 {
+  static void ConfigureJobsScheduling(JobsRegistry& registry)
+  {
+    OrthancConfiguration::ReaderLock lock;
+
+    const Json::Value& config = lock.GetJson();
+
+    static const char* const TYPES_CONCURRENCY = "JobsTypesConcurrency";
+    static const char* const TYPES_WEIGHTS = "JobsTypesWeights";
+
+    if (config.isMember(TYPES_CONCURRENCY))
+    {
+      const Json::Value& parameter = config[TYPES_CONCURRENCY];
+      if (parameter.type() != Json::objectValue)
+      {
+        throw OrthancException(ErrorCode_BadParameterType,
+                               "The configuration option \"" + std::string(TYPES_CONCURRENCY) +
+                               "\" must be an object");
+      }
+
+      Json::Value::Members members = parameter.getMemberNames();
+      for (size_t i = 0; i < members.size(); i++)
+      {
+        const std::string& type = members[i];
+
+        if (!parameter[type].isUInt())
+        {
+          throw OrthancException(ErrorCode_BadParameterType,
+                                 "Not a positive integer in the maximum concurrency of jobs of type: " + type);
+        }
+
+        registry.SetTypeMaxConcurrency(type, parameter[type].asUInt());
+      }
+    }
+
+    if (config.isMember(TYPES_WEIGHTS))
+    {
+      const Json::Value& parameter = config[TYPES_WEIGHTS];
+      if (parameter.type() != Json::objectValue)
+      {
+        throw OrthancException(ErrorCode_BadParameterType,
+                               "The configuration option \"" + std::string(TYPES_WEIGHTS) +
+                               "\" must be an object");
+      }
+
+      Json::Value::Members members = parameter.getMemberNames();
+      for (size_t i = 0; i < members.size(); i++)
+      {
+        const std::string& type = members[i];
+
+        if (!parameter[type].isUInt() ||
+            parameter[type].asUInt() == 0)
+        {
+          throw OrthancException(ErrorCode_BadParameterType,
+                                 "Not a strictly positive integer in the weight of jobs of type: " + type);
+        }
+
+        LOG(INFO) << "Weight of the jobs of type \"" << type << "\": " << parameter[type].asUInt();
+        registry.SetTypeWeight(type, parameter[type].asUInt());
+      }
+    }
+
+    registry.SetTargetMaxConcurrency
+      (lock.GetConfiguration().GetUnsignedIntegerParameter("JobsConcurrencyPerTarget", 0));
+  }
+
+
   void ServerContext::ChangeThread(ServerContext* that,
                                    unsigned int sleepDelay)
   {
@@ -81,6 +150,27 @@ namespace Orthanc
       {
         const ServerIndexChange& change = dynamic_cast<const ServerIndexChange&>(*obj.get());
 
+        if (change.GetChangeType() == ChangeType_StableSeries)
+        {
+          try
+          {
+            // Compute the ordering of the slices once for all, which
+            // stores it as a metadata of the series
+            SliceOrdering ordering(that->index_, change.GetPublicId());
+          }
+          catch (OrthancException& e)
+          {
+            LOG(INFO) << "Cannot order the slices of series "
+                      << change.GetPublicId() << ": " << e.What();
+          }
+
+          if (that->seriesThumbnails_)
+          {
+            // Don't block the dispatching of the changes while rendering
+            that->pendingThumbnails_.Enqueue(new SingleValueObject<std::string>(change.GetPublicId()));
+          }
+        }
+
         boost::recursive_mutex::scoped_lock lock(that->listenersMutex_);
         for (ServerListeners::iterator it = that->listeners_.begin(); 
              it != that->listeners_.end(); ++it)
@@ -136,6 +226,31 @@ namespace Orthanc
   }
   
 
+  void ServerContext::ThumbnailsThread(ServerContext* that,
+                                       unsigned int sleepDelay)
+  {
+    while (!that->done_)
+    {
+      std::auto_ptr<IDynamicObject> obj(that->pendingThumbnails_.Dequeue(sleepDelay));
+
+      if (obj.get() != NULL)
+      {
+        const std::string& seriesId = dynamic_cast<const SingleValueObject<std::string>&>(*obj).GetValue();
+
+        try
+        {
+          that->StoreSeriesThumbnail(seriesId);
+        }
+        catch (OrthancException& e)
+        {
+          LOG(INFO) << "Cannot generate the thumbnail of series "
+                    << seriesId << ": " << e.What();
+        }
+      }
+    }
+  }
+
+
   void ServerContext::SignalJobSubmitted(const std::string& jobId)
   {
     haveJobsChanged_ = true;
@@ -162,31 +277,64 @@ namespace Orthanc
   {
     if (loadJobsFromDatabase)
     {
-      std::string serialized;
-      if (index_.LookupGlobalProperty(serialized, GlobalProperty_JobsRegistry))
+      JobsRegistry::SerializedJobs records;
+
+      try
       {
-        LOG(WARNING) << "Reloading the jobs from the last execution of Orthanc";
-        OrthancJobUnserializer unserializer(*this);
+        index_.GetStoredJobs(records);
+      }
+      catch (OrthancException& e)
+      {
+        LOG(WARNING) << "Cannot read the jobs from the database, starting anyway: " << e.What();
+      }
 
-        try
-        {
-          jobsEngine_.LoadRegistryFromString(unserializer, serialized);
-        }
-        catch (OrthancException& e)
-        {
-          LOG(WARNING) << "Cannot unserialize the jobs engine, starting anyway: " << e.What();
-        }
+      if (records.empty())
+      {
+        LOG(INFO) << "The last execution of Orthanc has archived no job";
       }
       else
       {
-        LOG(INFO) << "The last execution of Orthanc has archived no job";
+        LOG(WARNING) << "Reloading " << records.size()
+                     << " job(s) from the last execution of Orthanc";
+
+        // The jobs themselves are only unserialized once accessed
+        jobsEngine_.LoadRegistryFromRecords(jobsUnserializer_, records);
       }
     }
     else
     {
       LOG(INFO) << "Not reloading the jobs from the last execution of Orthanc";
+
+      if (saveJobs_)
+      {
+        // The jobs of the last execution are discarded
+        try
+        {
+          JobsRegistry::SerializedJobs records;
+          index_.GetStoredJobs(records);
+
+          std::set<std::string> removed;
+          for (JobsRegistry::SerializedJobs::const_iterator
+                 it = records.begin(); it != records.end(); ++it)
+          {
+            removed.insert(it->first);
+          }
+
+          index_.UpdateStoredJobs(JobsRegistry::SerializedJobs(), removed);
+        }
+        catch (OrthancException& e)
+        {
+          LOG(WARNING) << "Cannot discard the jobs from the last execution of Orthanc: " << e.What();
+        }
+      }
     }
 
+    // The scheduling parameters must be set after the registry has
+    // been reloaded, as reloading replaces the registry
+    ConfigureJobsScheduling(jobsEngine_.GetRegistry());
+
+    // Only the jobs whose state has changed are written to the database
+    jobsEngine_.GetRegistry().SetTrackChanges(saveJobs_);
     jobsEngine_.GetRegistry().SetObserver(*this);
     jobsEngine_.Start();
     isJobsEngineUnserialized_ = true;
@@ -199,21 +347,28 @@ namespace Orthanc
   {
     if (saveJobs_)
     {
-      VLOG(1) << "Serializing the content of the jobs engine";
-    
+      JobsRegistry::SerializedJobs changed;
+      std::set<std::string> removed;
+
       try
       {
-        Json::Value value;
-        jobsEngine_.GetRegistry().Serialize(value);
-
-        Json::FastWriter writer;
-        std::string serialized = writer.write(value);
+        jobsEngine_.GetRegistry().ConsumeChanges(changed, removed);
 
-        index_.SetGlobalProperty(GlobalProperty_JobsRegistry, serialized);
+        if (!changed.empty() ||
+            !removed.empty())
+        {
+          VLOG(1) << "Saving the changes in the jobs engine: " << changed.size()
+                  << " job(s) updated, " << removed.size() << " job(s) removed";
+          index_.UpdateStoredJobs(changed, removed);
+        }
       }
       catch (OrthancException& e)
       {
         LOG(ERROR) << "Cannot serialize the jobs engine: " << e.What();
+
+        // Retry at the next call, otherwise the database would keep
+        // outdated records
+        jobsEngine_.GetRegistry().RestoreChanges(changed, removed);
       }
     }
   }
@@ -227,11 +382,13 @@ namespace Orthanc
     area_(area),
     compressionEnabled_(false),
     storeMD5_(true),
+    compactDicomAsJson_(false),
+    storeDicomAsJson_(true),
     provider_(*this),
-    dicomCache_(provider_, DICOM_CACHE_SIZE),
     mainLua_(*this),
     filterLua_(*this),
     luaListener_(*this),
+    jobsUnserializer_(*this),
     jobsEngine_(maxCompletedJobs),
 #if ORTHANC_ENABLE_PLUGINS == 1
     plugins_(NULL),
@@ -252,12 +409,35 @@ namespace Orthanc
       jobsEngine_.SetWorkersCount(lock.GetConfiguration().GetUnsignedIntegerParameter("ConcurrentJobs", 2));
       saveJobs_ = lock.GetConfiguration().GetBooleanParameter("SaveJobs", true);
       metricsRegistry_->SetEnabled(lock.GetConfiguration().GetBooleanParameter("MetricsEnabled", true));
+
+      // The size of the cache of parsed DICOM files is expressed in MB
+      size_t dicomCacheSize = static_cast<size_t>(
+        lock.GetConfiguration().GetUnsignedIntegerParameter("DicomCacheSize", 128)) * 1024 * 1024;
+      dicomCache_.reset(new ParsedDicomCache(provider_, dicomCacheSize, DICOM_CACHE_SHARDS));
+
+      size_t renderedFrameCacheSize = static_cast<size_t>(
+        lock.GetConfiguration().GetUnsignedIntegerParameter("RenderedFrameCacheSize", 64)) * 1024 * 1024;
+      renderedFrameCache_.reset(new RenderedFrameCache(renderedFrameCacheSize));
+
+      seriesThumbnails_ = lock.GetConfiguration().GetBooleanParameter("SeriesThumbnails", false);
+      seriesThumbnailSize_ = lock.GetConfiguration().GetUnsignedIntegerParameter("SeriesThumbnailSize", 128);
+
+      if (seriesThumbnailSize_ == 0)
+      {
+        throw OrthancException(ErrorCode_ParameterOutOfRange,
+                               "The size of the series thumbnails must be positive");
+      }
     }
 
     jobsEngine_.SetThreadSleep(unitTesting ? 20 : 200);
 
     listeners_.push_back(ServerListener(luaListener_, "Lua"));
     changeThread_ = boost::thread(ChangeThread, this, (unitTesting ? 20 : 100));
+
+    if (seriesThumbnails_)
+    {
+      thumbnailsThread_ = boost::thread(ThumbnailsThread, this, (unitTesting ? 20 : 100));
+    }
   }
 
 
@@ -293,6 +473,11 @@ namespace Orthanc
         saveJobsThread_.join();
       }
 
+      if (thumbnailsThread_.joinable())
+      {
+        thumbnailsThread_.join();
+      }
+
       jobsEngine_.GetRegistry().ResetObserver();
 
       if (isJobsEngineUnserialized_)
@@ -327,6 +512,30 @@ namespace Orthanc
   }
 
 
+  static bool ComputeFrameOffsets(std::string& target,
+                                  DicomInstanceToStore& dicom)
+  {
+    try
+    {
+      DicomImageInformation information(dicom.GetSummary());
+
+      DicomFrameOffsets offsets;
+      if (offsets.Compute(dicom.GetBufferData(), dicom.GetBufferSize(),
+                          information.GetNumberOfFrames(), information.GetFrameSize()))
+      {
+        offsets.Serialize(target);
+        return true;
+      }
+    }
+    catch (OrthancException&)
+    {
+      // This instance is not an image
+    }
+
+    return false;
+  }
+
+
   StoreStatus ServerContext::Store(std::string& resultPublicId,
                                    DicomInstanceToStore& dicom)
   {
@@ -337,8 +546,29 @@ namespace Orthanc
 
       resultPublicId = dicom.GetHasher().HashInstance();
 
-      Json::Value simplifiedTags;
-      ServerToolbox::SimplifyTags(simplifiedTags, dicom.GetJson(), DicomToJsonFormat_Human);
+      // The simplified tags require the JSON version of the instance,
+      // whose computation is skipped if no one needs it
+      bool hasJson = storeDicomAsJson_;
+
+      if (!hasJson)
+      {
+        boost::recursive_mutex::scoped_lock lock(listenersMutex_);
+
+        for (ServerListeners::iterator it = listeners_.begin(); it != listeners_.end(); ++it)
+        {
+          if (it->GetListener().IsSimplifiedTagsRequired())
+          {
+            hasJson = true;
+            break;
+          }
+        }
+      }
+
+      Json::Value simplifiedTags = Json::objectValue;
+      if (hasJson)
+      {
+        ServerToolbox::SimplifyTags(simplifiedTags, dicom.GetJson(), DicomToJsonFormat_Human);
+      }
 
       // Test if the instance must be filtered out
       bool accepted = true;
@@ -375,8 +605,8 @@ namespace Orthanc
       {
         // Remove the file from the DicomCache (useful if
         // "OverwriteInstances" is set to "true")
-        boost::mutex::scoped_lock lock(dicomCacheMutex_);
-        dicomCache_.Invalidate(resultPublicId);
+        dicomCache_->Invalidate(resultPublicId);
+        renderedFrameCache_->Invalidate(resultPublicId);
       }
 
       // TODO Should we use "gzip" instead?
@@ -384,12 +614,27 @@ namespace Orthanc
 
       FileInfo dicomInfo = accessor.Write(dicom.GetBufferData(), dicom.GetBufferSize(), 
                                           FileContentType_Dicom, compression, storeMD5_);
-      FileInfo jsonInfo = accessor.Write(dicom.GetJson().toStyledString(), 
-                                         FileContentType_DicomAsJson, compression, storeMD5_);
-
       ServerIndex::Attachments attachments;
       attachments.push_back(dicomInfo);
-      attachments.push_back(jsonInfo);
+
+      FileInfo jsonInfo;
+      if (storeDicomAsJson_)
+      {
+        std::string dicomAsJson;
+        EncodeDicomAsJson(dicomAsJson, dicom.GetJson());
+
+        jsonInfo = accessor.Write(dicomAsJson, FileContentType_DicomAsJson,
+                                  compression, storeMD5_);
+        attachments.push_back(jsonInfo);
+      }
+
+      {
+        std::string offsets;
+        if (ComputeFrameOffsets(offsets, dicom))
+        {
+          dicom.GetMetadata()[std::make_pair(ResourceType_Instance, MetadataType_Instance_FrameOffsets)] = offsets;
+        }
+      }
 
       typedef std::map<MetadataType, std::string>  InstanceMetadata;
       InstanceMetadata  instanceMetadata;
@@ -408,7 +653,11 @@ namespace Orthanc
       if (status != StoreStatus_Success)
       {
         accessor.Remove(dicomInfo);
-        accessor.Remove(jsonInfo);
+
+        if (storeDicomAsJson_)
+        {
+          accessor.Remove(jsonInfo);
+        }
       }
 
       switch (status)
@@ -525,6 +774,120 @@ namespace Orthanc
   }
 
 
+  void ServerContext::SetCompactDicomAsJson(bool compact)
+  {
+    LOG(INFO) << "Encoding of the DICOM-as-JSON attachments: "
+              << (compact ? "compact binary" : "JSON text");
+    compactDicomAsJson_ = compact;
+  }
+
+
+  void ServerContext::SetStoreDicomAsJson(bool store)
+  {
+    if (!store)
+    {
+      LOG(WARNING) << "The DICOM-as-JSON attachments will be generated "
+                   << "on their first access, not while receiving instances";
+    }
+
+    storeDicomAsJson_ = store;
+  }
+
+
+  void ServerContext::EncodeDicomAsJson(std::string& target,
+                                        const Json::Value& dicomAsJson) const
+  {
+    if (compactDicomAsJson_ &&
+        CompactDicomAsJson::Encode(target, dicomAsJson))
+    {
+      return;
+    }
+
+    // Compact serialization, which is much faster than "toStyledString()"
+    target.clear();
+    JsonStreamWriter writer(target);
+    writer.WriteValue(dicomAsJson);
+  }
+
+
+  void ServerContext::EncodeDicomAsJson(std::string& target,
+                                        ParsedDicomFile& dicom) const
+  {
+    if (compactDicomAsJson_)
+    {
+      Json::Value json;
+      dicom.DatasetToJson(json);
+      EncodeDicomAsJson(target, json);
+    }
+    else
+    {
+      // Direct serialization, without building the JSON tree
+      dicom.DatasetToJson(target);
+    }
+  }
+
+
+  bool ServerContext::ConvertDicomAsJson(const std::string& instancePublicId)
+  {
+    FileInfo attachment;
+    if (!index_.LookupAttachment(attachment, instancePublicId, FileContentType_DicomAsJson))
+    {
+      return false;  // Will be reconstructed on the next access
+    }
+
+    std::string content;
+    ReadAttachment(content, attachment);
+
+    if (CompactDicomAsJson::IsCompact(content) == compactDicomAsJson_)
+    {
+      return false;
+    }
+
+    Json::Value json;
+    CompactDicomAsJson::Parse(json, content);
+
+    std::string encoded;
+    EncodeDicomAsJson(encoded, json);
+
+    if (CompactDicomAsJson::IsCompact(encoded) != compactDicomAsJson_)
+    {
+      return false;  // This summary cannot be stored in the compact encoding
+    }
+
+    if (!AddAttachment(instancePublicId, FileContentType_DicomAsJson,
+                       encoded.c_str(), encoded.size()))
+    {
+      throw OrthancException(ErrorCode_InternalError,
+                             "Cannot convert the DICOM-as-JSON summary of instance: " + instancePublicId);
+    }
+
+    return true;
+  }
+
+
+  void ServerContext::ReconstructDicomAsJson(std::string& result,
+                                             const std::string& instancePublicId)
+  {
+    std::string dicom;
+    ReadDicom(dicom, instancePublicId);
+
+    LOG(INFO) << "Reconstructing the missing DICOM-as-JSON summary for instance: "
+              << instancePublicId;
+
+    // Only the tags are needed: Skip the parsing of the pixel data
+    std::auto_ptr<ParsedDicomFile> parsed
+      (ParsedDicomFile::CreateWithoutPixelData(dicom.empty() ? NULL : dicom.c_str(), dicom.size()));
+    EncodeDicomAsJson(result, *parsed);
+
+    if (!AddAttachment(instancePublicId, FileContentType_DicomAsJson,
+                       result.c_str(), result.size()))
+    {
+      throw OrthancException(ErrorCode_InternalError,
+                             "Cannot associate the DICOM-as-JSON summary to instance: " + instancePublicId);
+    }
+  }
+
+
   void ServerContext::ReadDicomAsJsonInternal(std::string& result,
                                               const std::string& instancePublicId)
   {
@@ -537,25 +900,23 @@ namespace Orthanc
     {
       // The "DICOM as JSON" summary is not available from the Orthanc
       // store (most probably deleted), reconstruct it from the DICOM file
-      std::string dicom;
-      ReadDicom(dicom, instancePublicId);
-
-      LOG(INFO) << "Reconstructing the missing DICOM-as-JSON summary for instance: "
-                << instancePublicId;
-    
-      ParsedDicomFile parsed(dicom);
-
-      Json::Value summary;
-      parsed.DatasetToJson(summary);
+      ReconstructDicomAsJson(result, instancePublicId);
+    }
+  }
 
-      result = summary.toStyledString();
 
-      if (!AddAttachment(instancePublicId, FileContentType_DicomAsJson,
-                         result.c_str(), result.size()))
-      {
-        throw OrthancException(ErrorCode_InternalError,
-                               "Cannot associate the DICOM-as-JSON summary to instance: " + instancePublicId);
-      }
+  bool ServerContext::ReconstructMissingDicomAsJson(const std::string& instancePublicId)
+  {
+    FileInfo attachment;
+    if (index_.LookupAttachment(attachment, instancePublicId, FileContentType_DicomAsJson))
+    {
+      return false;
+    }
+    else
+    {
+      std::string summary;
+      ReconstructDicomAsJson(summary, instancePublicId);
+      return true;
     }
   }
 
@@ -567,12 +928,27 @@ namespace Orthanc
     if (ignoreTagLength.empty())
     {
       ReadDicomAsJsonInternal(result, instancePublicId);
+
+      if (CompactDicomAsJson::IsCompact(result))
+      {
+        // The callers expect JSON text
+        Json::Value json;
+        CompactDicomAsJson::Decode(json, result);
+
+        result.clear();
+        JsonStreamWriter writer(result);
+        writer.WriteValue(json);
+      }
     }
     else
     {
-      Json::Value tmp;
-      ReadDicomAsJson(tmp, instancePublicId, ignoreTagLength);
-      result = tmp.toStyledString();
+      // The "DicomAsJson" attachment might have stored some tags as
+      // "too long". Directly serialize the re-parsed DICOM file.
+      std::string dicom;
+      ReadDicom(dicom, instancePublicId);
+
+      ParsedDicomFile parsed(dicom);
+      parsed.DatasetToJson(result, ignoreTagLength);
     }
   }
 
@@ -585,12 +961,7 @@ namespace Orthanc
     {
       std::string tmp;
       ReadDicomAsJsonInternal(tmp, instancePublicId);
-
-      Json::Reader reader;
-      if (!reader.parse(tmp, result))
-      {
-        throw OrthancException(ErrorCode_CorruptedFile);
-      }
+      CompactDicomAsJson::Parse(result, tmp);
     }
     else
     {
@@ -643,30 +1014,19 @@ namespace Orthanc
   }
 
 
-  IDynamicObject* ServerContext::DicomCacheProvider::Provide(const std::string& instancePublicId)
+  ParsedDicomFile* ServerContext::DicomCacheProvider::Provide(size_t& fileSize,
+                                                              const std::string& instancePublicId)
   {
     std::string content;
     context_.ReadDicom(content, instancePublicId);
+    fileSize = content.size();
     return new ParsedDicomFile(content);
   }
 
 
   ServerContext::DicomCacheLocker::DicomCacheLocker(ServerContext& that,
                                                     const std::string& instancePublicId) : 
-    that_(that),
-    lock_(that_.dicomCacheMutex_)
-  {
-#if ENABLE_DICOM_CACHE == 0
-    static std::auto_ptr<IDynamicObject> p;
-    p.reset(provider_.Provide(instancePublicId));
-    dicom_ = dynamic_cast<ParsedDicomFile*>(p.get());
-#else
-    dicom_ = &dynamic_cast<ParsedDicomFile&>(that_.dicomCache_.Access(instancePublicId));
-#endif
-  }
-
-
-  ServerContext::DicomCacheLocker::~DicomCacheLocker()
+    accessor_(*that.dicomCache_, instancePublicId)
   {
   }
 
@@ -678,10 +1038,12 @@ namespace Orthanc
   }
 
 
-  bool ServerContext::AddAttachment(const std::string& resourceId,
-                                    FileContentType attachmentType,
-                                    const void* data,
-                                    size_t size)
+  bool ServerContext::AddAttachmentInternal(const std::string& resourceId,
+                                            FileContentType attachmentType,
+                                            const void* data,
+                                            size_t size,
+                                            bool onlyIfStable,
+                                            uint64_t epoch)
   {
     LOG(INFO) << "Adding attachment " << EnumerationToString(attachmentType) << " to resource " << resourceId;
     
@@ -691,7 +1053,9 @@ namespace Orthanc
     StorageAccessor accessor(area_, GetMetricsRegistry());
     FileInfo attachment = accessor.Write(data, size, attachmentType, compression, storeMD5_);
 
-    StoreStatus status = index_.AddAttachment(attachment, resourceId);
+    StoreStatus status = (onlyIfStable ?
+                          index_.AddAttachmentIfStable(attachment, resourceId, epoch) :
+                          index_.AddAttachment(attachment, resourceId));
     if (status != StoreStatus_Success)
     {
       accessor.Remove(attachment);
@@ -704,6 +1068,127 @@ namespace Orthanc
   }
 
 
+  bool ServerContext::AddAttachment(const std::string& resourceId,
+                                    FileContentType attachmentType,
+                                    const void* data,
+                                    size_t size)
+  {
+    return AddAttachmentInternal(resourceId, attachmentType, data, size, false, 0 /* unused */);
+  }
+
+
+  bool ServerContext::LookupFrameOffsets(DicomFrameOffsets& offsets,
+                                         const std::string& instancePublicId)
+  {
+    std::string s;
+    if (index_.LookupMetadata(s, instancePublicId, MetadataType_Instance_FrameOffsets))
+    {
+      offsets.Unserialize(s);
+      return true;
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+
+  bool ServerContext::ReadRawFrames(std::vector<std::string>& frames,
+                                    const DicomFrameOffsets& offsets,
+                                    const std::string& instancePublicId,
+                                    unsigned int firstFrame,
+                                    unsigned int endFrame)
+  {
+    if (firstFrame >= endFrame ||
+        endFrame > offsets.GetFramesCount())
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+
+    FileInfo attachment;
+    if (!index_.LookupAttachment(attachment, instancePublicId, FileContentType_Dicom))
+    {
+      throw OrthancException(ErrorCode_UnknownResource);
+    }
+
+    if (attachment.GetCompressionType() != CompressionType_None ||
+        !area_.HasReadRange())
+    {
+      // Reading a range would imply reading and uncompressing the
+      // whole file, which is better done through the DICOM cache
+      return false;
+    }
+
+    // The frames are stored in increasing order in the DICOM file
+    uint64_t start, end, tmp;
+    offsets.GetFrameRange(start, tmp, firstFrame);
+    offsets.GetFrameRange(tmp, end, endFrame - 1);
+
+    std::string region;
+    StorageAccessor accessor(area_, GetMetricsRegistry());
+    accessor.ReadRange(region, attachment, start, end);
+
+    frames.resize(endFrame - firstFrame);
+    for (unsigned int i = firstFrame; i < endFrame; i++)
+    {
+      offsets.ExtractFrame(frames[i - firstFrame], region, start, i);
+    }
+
+    return true;
+  }
+
+
+  bool ServerContext::ReadRawFrame(std::string& frame,
+                                   MimeType& mime,
+                                   const std::string& instancePublicId,
+                                   unsigned int frameIndex)
+  {
+    DicomFrameOffsets offsets;
+    if (!LookupFrameOffsets(offsets, instancePublicId))
+    {
+      return false;
+    }
+
+    std::vector<std::string> frames;
+    if (!ReadRawFrames(frames, offsets, instancePublicId, frameIndex, frameIndex + 1))
+    {
+      return false;
+    }
+
+    assert(frames.size() == 1);
+    frame.swap(frames[0]);
+    mime = offsets.GetMimeType();
+
+    return true;
+  }
+
+
+  void ServerContext::RenderSeriesThumbnail(std::string& jpeg,
+                                            const std::string& seriesId)
+  {
+    ServerToolbox::RenderSeriesThumbnail(jpeg, *this, seriesId, seriesThumbnailSize_);
+  }
+
+
+  void ServerContext::StoreSeriesThumbnail(const std::string& seriesId)
+  {
+    const uint64_t epoch = index_.GetInvalidationEpoch(seriesId);
+
+    std::string jpeg;
+    RenderSeriesThumbnail(jpeg, seriesId);
+
+    // The thumbnail is only kept if the instances of the series have
+    // not changed since the rendering started, otherwise it would be
+    // outdated
+    if (!AddAttachmentInternal(seriesId, FileContentType_Thumbnail,
+                               jpeg.c_str(), jpeg.size(), true /* only if stable */, epoch))
+    {
+      LOG(INFO) << "Not storing the thumbnail of series " << seriesId
+                << ", as this series is not stable yet";
+    }
+  }
+
+
   bool ServerContext::DeleteResource(Json::Value& target,
                                      const std::string& uuid,
                                      ResourceType expectedType)
@@ -711,8 +1196,7 @@ namespace Orthanc
     if (expectedType == ResourceType_Instance)
     {
       // remove the file from the DicomCache
-      boost::mutex::scoped_lock lock(dicomCacheMutex_);
-      dicomCache_.Invalidate(uuid);
+      dicomCache_->Invalidate(uuid);
     }
 
     return index_.DeleteResource(target, uuid, expectedType);
@@ -721,6 +1205,24 @@ namespace Orthanc
 
   void ServerContext::SignalChange(const ServerIndexChange& change)
   {
+    if (change.GetChangeType() == ChangeType_Deleted &&
+        change.GetResourceType() == ResourceType_Instance)
+    {
+      // This is called for each removed instance, including those
+      // removed together with their series, study or patient, or by
+      // the recycling mechanism (the caches do not exist yet while
+      // the index is being constructed)
+      if (dicomCache_.get() != NULL)
+      {
+        dicomCache_->Invalidate(change.GetPublicId());
+      }
+
+      if (renderedFrameCache_.get() != NULL)
+      {
+        renderedFrameCache_->Invalidate(change.GetPublicId());
+      }
+    }
+
     pendingChanges_.Enqueue(change.Clone());
   }
 
@@ -850,6 +1352,16 @@ namespace Orthanc
     size_t skipped = 0;
 
     const bool isDicomAsJsonNeeded = visitor.IsDicomAsJsonNeeded();
+
+    // The tags to be extracted from the "DICOM-as-JSON" attachment in
+    // Case (2): Those of the constraints, and the main DICOM tags
+    std::set<DicomTag> lookupTags;
+    DicomMap::GetMainDicomTags(lookupTags);
+
+    for (size_t i = 0; i < lookup.GetConstraintsCount(); i++)
+    {
+      lookupTags.insert(lookup.GetConstraint(i).GetTag());
+    }
     
     for (size_t i = 0; i < instances.size(); i++)
     {
@@ -857,6 +1369,7 @@ namespace Orthanc
       // the disk if only "main DICOM tags" are to be returned
 
       std::auto_ptr<Json::Value> dicomAsJson;
+      std::string serializedDicomAsJson;
 
       bool hasOnlyMainDicomTags;
       DicomMap dicom;
@@ -880,13 +1393,12 @@ namespace Orthanc
       else
       {
         // Case (2): Need to read the "DICOM-as-JSON" attachment from
-        // the storage area
-        dicomAsJson.reset(new Json::Value);
-        ReadDicomAsJson(*dicomAsJson, instances[i]);
+        // the storage area. Only the tags of interest are parsed:
+        // The full JSON is only built if the resource matches.
+        ReadDicomAsJsonInternal(serializedDicomAsJson, instances[i]);
+        CompactDicomAsJson::ExtractTags(dicom, serializedDicomAsJson, lookupTags);
 
-        dicom.FromDicomAsJson(*dicomAsJson);
-
-        // This map contains the entire JSON, i.e. more than the main DICOM tags
+        // This map contains more than the main DICOM tags
         hasOnlyMainDicomTags = false;   
       }
       
@@ -911,7 +1423,16 @@ namespace Orthanc
               isDicomAsJsonNeeded)
           {
             dicomAsJson.reset(new Json::Value);
-            ReadDicomAsJson(*dicomAsJson, instances[i]);
+
+            if (serializedDicomAsJson.empty())
+            {
+              ReadDicomAsJson(*dicomAsJson, instances[i]);
+            }
+            else
+            {
+              // Case (2): Reuse the attachment that was already read
+              CompactDicomAsJson::Parse(*dicomAsJson, serializedDicomAsJson);
+            }
           }
 
           if (hasOnlyMainDicomTags)
@@ -981,11 +1502,14 @@ namespace Orthanc
             throw OrthancException(ErrorCode_InternalError);
         }
       
-        Json::Value dicomAsJson;
-        ReadDicomAsJson(dicomAsJson, publicId);
+        std::string dicomAsJson;
+        ReadDicomAsJsonInternal(dicomAsJson, publicId);
+
+        std::set<DicomTag> toExtract;
+        toExtract.insert(tag);
 
         DicomMap tags;
-        tags.FromDicomAsJson(dicomAsJson);
+        CompactDicomAsJson::ExtractTags(tags, dicomAsJson, toExtract);
 
         const DicomValue* value = tags.TestAndGetValue(tag);
 
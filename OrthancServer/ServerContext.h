@@ -36,13 +36,15 @@
 #include "IServerListener.h"
 #include "LuaScripting.h"
 #include "OrthancHttpHandler.h"
+#include "ParsedDicomCache.h"
+#include "RenderedFrameCache.h"
 #include "ServerIndex.h"
-
-#include "../Core/Cache/MemoryCache.h"
+#include "ServerJobs/OrthancJobUnserializer.h"
 
 
 namespace Orthanc
 {
+  class DicomFrameOffsets;
   class DicomInstanceToStore;
   class IStorageArea;
   class JobsEngine;
@@ -118,9 +120,15 @@ namespace Orthanc
       {
         return context_.filterLua_.FilterIncomingInstance(instance, simplified);
       }
+
+      virtual bool IsSimplifiedTagsRequired()
+      {
+        return (context_.mainLua_.HasInstanceCallbacks() ||
+                context_.filterLua_.HasInstanceCallbacks());
+      }
     };
     
-    class DicomCacheProvider : public ICachePageProvider
+    class DicomCacheProvider : public ParsedDicomCache::IProvider
     {
     private:
       ServerContext& context_;
@@ -130,7 +138,8 @@ namespace Orthanc
       {
       }
       
-      virtual IDynamicObject* Provide(const std::string& id);
+      virtual ParsedDicomFile* Provide(size_t& fileSize,
+                                       const std::string& instancePublicId);
     };
 
     class ServerListener
@@ -167,11 +176,28 @@ namespace Orthanc
     static void SaveJobsThread(ServerContext* that,
                                unsigned int sleepDelay);
 
+    static void ThumbnailsThread(ServerContext* that,
+                                 unsigned int sleepDelay);
+
+    void StoreSeriesThumbnail(const std::string& seriesId);
+
+    void ReconstructDicomAsJson(std::string& result,
+                                const std::string& instancePublicId);
+
+    // The content of the attachment is returned as such, so it might
+    // use the compact encoding (cf. "CompactDicomAsJson")
     void ReadDicomAsJsonInternal(std::string& result,
                                  const std::string& instancePublicId);
 
     void SaveJobsEngine();
 
+    bool AddAttachmentInternal(const std::string& resourceId,
+                               FileContentType attachmentType,
+                               const void* data,
+                               size_t size,
+                               bool onlyIfStable,
+                               uint64_t epoch);
+
     virtual void SignalJobSubmitted(const std::string& jobId);
 
     virtual void SignalJobSuccess(const std::string& jobId);
@@ -183,15 +209,23 @@ namespace Orthanc
 
     bool compressionEnabled_;
     bool storeMD5_;
+    bool compactDicomAsJson_;
+    bool storeDicomAsJson_;
     
     DicomCacheProvider provider_;
-    boost::mutex dicomCacheMutex_;
-    MemoryCache dicomCache_;
+    std::auto_ptr<ParsedDicomCache>  dicomCache_;
+    std::auto_ptr<RenderedFrameCache>  renderedFrameCache_;
+    bool seriesThumbnails_;
+    unsigned int seriesThumbnailSize_;
 
     LuaScripting mainLua_;
     LuaScripting filterLua_;
     LuaServerListener  luaListener_;
     std::auto_ptr<SharedArchive>  mediaArchive_;
+
+    // The jobs reloaded from the database are lazily unserialized,
+    // so the unserializer must outlive the "JobsEngine"
+    OrthancJobUnserializer  jobsUnserializer_;
     
     // The "JobsEngine" must be *after* "LuaScripting", as
     // "LuaScripting" embeds "LuaJobManager" that registers as an
@@ -213,6 +247,8 @@ namespace Orthanc
     SharedMessageQueue  pendingChanges_;
     boost::thread  changeThread_;
     boost::thread  saveJobsThread_;
+    SharedMessageQueue  pendingThumbnails_;
+    boost::thread  thumbnailsThread_;
         
     std::auto_ptr<SharedArchive>  queryRetrieveArchive_;
     std::string defaultLocalAet_;
@@ -225,19 +261,15 @@ namespace Orthanc
     class DicomCacheLocker : public boost::noncopyable
     {
     private:
-      ServerContext& that_;
-      ParsedDicomFile *dicom_;
-      boost::mutex::scoped_lock lock_;
+      ParsedDicomCache::Accessor  accessor_;
 
     public:
       DicomCacheLocker(ServerContext& that,
                        const std::string& instancePublicId);
 
-      ~DicomCacheLocker();
-
       ParsedDicomFile& GetDicom()
       {
-        return *dicom_;
+        return accessor_.GetDicom();
       }
     };
 
@@ -282,6 +314,70 @@ namespace Orthanc
                                      FileContentType attachmentType,
                                      CompressionType compression);
 
+    void SetCompactDicomAsJson(bool compact);
+
+    bool IsCompactDicomAsJson() const
+    {
+      return compactDicomAsJson_;
+    }
+
+    // If set to "false", the "DICOM-as-JSON" attachment is not
+    // written while receiving an instance, but only once it is
+    // accessed for the first time (or by the job created by
+    // "/tools/reconstruct-derived-data")
+    void SetStoreDicomAsJson(bool store);
+
+    bool IsStoreDicomAsJson() const
+    {
+      return storeDicomAsJson_;
+    }
+
+    // Serializes the "DICOM-as-JSON" attachment of an instance,
+    // either as JSON text or using "CompactDicomAsJson"
+    void EncodeDicomAsJson(std::string& target,
+                           const Json::Value& dicomAsJson) const;
+
+    void EncodeDicomAsJson(std::string& target,
+                           ParsedDicomFile& dicom) const;
+
+    // Re-encodes the "DICOM-as-JSON" attachment of an instance if it
+    // does not use the encoding of the configuration. Returns "false"
+    // if nothing was changed.
+    bool ConvertDicomAsJson(const std::string& instancePublicId);
+
+    // Returns "true" iff the "DICOM-as-JSON" attachment of the
+    // instance was missing, and has been reconstructed
+    bool ReconstructMissingDicomAsJson(const std::string& instancePublicId);
+
+    // Reads one frame of an instance using the table of frame offsets
+    // computed when the instance was stored, which avoids to load and
+    // parse the whole DICOM file. Returns "false" if this table is
+    // not available (e.g. instances stored by older versions), or if
+    // the storage area cannot read the frames without loading the
+    // whole file (compressed file, or no support for range reads).
+    bool ReadRawFrame(std::string& frame,
+                      MimeType& mime,
+                      const std::string& instancePublicId,
+                      unsigned int frameIndex);
+
+    // Returns "false" if no table of frame offsets is available
+    bool LookupFrameOffsets(DicomFrameOffsets& offsets,
+                            const std::string& instancePublicId);
+
+    // Batch version of "ReadRawFrame()": The frames in the range
+    // [firstFrame, endFrame[ are read using one single access to the
+    // storage area. Returns "false" in the same situations as
+    // "ReadRawFrame()", except the missing table of frame offsets.
+    bool ReadRawFrames(std::vector<std::string>& frames,
+                       const DicomFrameOffsets& offsets,
+                       const std::string& instancePublicId,
+                       unsigned int firstFrame,
+                       unsigned int endFrame);
+
+    // Renders the thumbnail of a series, without storing it
+    void RenderSeriesThumbnail(std::string& jpeg,
+                               const std::string& seriesId);
+
     void ReadDicomAsJson(std::string& result,
                          const std::string& instancePublicId,
                          const std::set<DicomTag>& ignoreTagLength);
@@ -402,5 +498,15 @@ namespace Orthanc
     {
       return *metricsRegistry_;
     }
+
+    ParsedDicomCache& GetDicomCache()
+    {
+      return *dicomCache_;
+    }
+
+    RenderedFrameCache& GetRenderedFrameCache()
+    {
+      return *renderedFrameCache_;
+    }
   };
 }
@@ -70,9 +70,12 @@ namespace Orthanc
     dictMetadataType_.Add(MetadataType_Instance_RemoteIp, "RemoteIP");
     dictMetadataType_.Add(MetadataType_Instance_CalledAet, "CalledAET");
     dictMetadataType_.Add(MetadataType_Instance_HttpUsername, "HttpUsername");
+    dictMetadataType_.Add(MetadataType_Instance_FrameOffsets, "FrameOffsets");
+    dictMetadataType_.Add(MetadataType_Series_OrderedSlices, "OrderedSlices");
 
     dictContentType_.Add(FileContentType_Dicom, "dicom");
     dictContentType_.Add(FileContentType_DicomAsJson, "dicom-as-json");
+    dictContentType_.Add(FileContentType_Thumbnail, "thumbnail");
   }
 
   void RegisterUserMetadata(int metadata,
@@ -181,6 +184,9 @@ namespace Orthanc
       case FileContentType_DicomAsJson:
         return MIME_JSON_UTF8;
 
+      case FileContentType_Thumbnail:
+        return MIME_JPEG;
+
       default:
         return EnumerationToString(MimeType_Binary);
     }
@@ -129,6 +129,8 @@ namespace Orthanc
     MetadataType_Instance_RemoteIp = 11,       // New in Orthanc 1.4.0
     MetadataType_Instance_CalledAet = 12,      // New in Orthanc 1.4.0
     MetadataType_Instance_HttpUsername = 13,   // New in Orthanc 1.4.0
+    MetadataType_Instance_FrameOffsets = 14,   // New in Orthanc 1.5.7
+    MetadataType_Series_OrderedSlices = 15,    // New in Orthanc 1.5.7
 
     // Make sure that the value "65535" can be stored into this enumeration
     MetadataType_StartUser = 1024,
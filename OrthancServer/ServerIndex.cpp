@@ -58,6 +58,7 @@
 #include <stdio.h>
 
 static const uint64_t MEGA_BYTES = 1024 * 1024;
+static const size_t MAX_INVALIDATION_EPOCHS = 10000;
 
 namespace Orthanc
 {
@@ -436,11 +437,25 @@ namespace Orthanc
       
     db_.DeleteResource(id);
 
+    int64_t invalidatedSeries = -1;
+
     if (listener_->HasRemainingLevel())
     {
       ResourceType type = listener_->GetRemainingType();
       const std::string& uuid = listener_->GetRemainingPublicId();
 
+      int64_t series;
+      ResourceType tmp;
+      if (type == ResourceType_Series &&
+          db_.LookupResource(series, tmp, uuid))
+      {
+        // An instance was removed from this series: The cached
+        // ordering of its slices and its thumbnail are now outdated
+        db_.DeleteMetadata(series, MetadataType_Series_OrderedSlices);
+        db_.DeleteAttachment(series, FileContentType_Thumbnail);
+        invalidatedSeries = series;
+      }
+
       target["RemainingAncestor"] = Json::Value(Json::objectValue);
       target["RemainingAncestor"]["Path"] = GetBasePath(type, uuid);
       target["RemainingAncestor"]["Type"] = EnumerationToString(type);
@@ -453,6 +468,12 @@ namespace Orthanc
 
     t.Commit(0);
 
+    if (invalidatedSeries != -1)
+    {
+      // Only once the transaction has succeeded
+      BumpInvalidationEpoch(invalidatedSeries);
+    }
+
     return true;
   }
 
@@ -653,7 +674,9 @@ namespace Orthanc
     maximumStorageSize_(0),
     maximumPatients_(0),
     overwrite_(false),
-    mainDicomTagsRegistry_(new MainDicomTagsRegistry)
+    mainDicomTagsRegistry_(new MainDicomTagsRegistry),
+    invalidationSequence_(0),
+    invalidationFloor_(0)
   {
     listener_.reset(new Listener(context));
     db_.SetListener(*listener_);
@@ -976,6 +999,14 @@ namespace Orthanc
       }
       
 
+      if (!status.isNewSeries_)
+      {
+        // The cached ordering of the slices of the series and its
+        // thumbnail are now outdated
+        db_.DeleteMetadata(status.seriesId_, MetadataType_Series_OrderedSlices);
+        db_.DeleteAttachment(status.seriesId_, FileContentType_Thumbnail);
+      }
+
       // Mark the parent resources of this instance as unstable
       MarkAsUnstable(status.seriesId_, ResourceType_Series, hashSeries);
       MarkAsUnstable(status.studyId_, ResourceType_Study, hashStudy);
@@ -983,6 +1014,11 @@ namespace Orthanc
 
       t.Commit(instanceSize);
 
+      if (!status.isNewSeries_)
+      {
+        BumpInvalidationEpoch(status.seriesId_);
+      }
+
       return StoreStatus_Success;
     }
     catch (OrthancException& e)
@@ -1317,6 +1353,22 @@ namespace Orthanc
   }
 
 
+  void ServerIndex::GetAllUuidsAfter(std::list<std::string>& target,
+                                     ResourceType resourceType,
+                                     const std::string& after,
+                                     size_t limit)
+  {
+    if (limit == 0)
+    {
+      target.clear();
+      return;
+    }
+
+    boost::mutex::scoped_lock lock(mutex_);
+    db_.GetAllPublicIdsAfter(target, resourceType, after, limit);
+  }
+
+
   template <typename T>
   static void FormatLog(Json::Value& target,
                         const std::list<T>& log,
@@ -1801,6 +1853,84 @@ namespace Orthanc
   }
 
 
+  void ServerIndex::BumpInvalidationEpoch(int64_t id)
+  {
+    // WARNING: Before calling this method, "mutex_" must be locked.
+
+    // The epochs are strictly increasing, so that a reader can detect
+    // any invalidation that occurred since it has read the epoch
+    invalidationSequence_++;
+    invalidationEpochs_[id] = invalidationSequence_;
+
+    if (invalidationEpochs_.size() > MAX_INVALIDATION_EPOCHS)
+    {
+      // Forget about the individual resources. This invalidates all
+      // the readers that are running, which is safe.
+      invalidationEpochs_.clear();
+      invalidationFloor_ = invalidationSequence_;
+    }
+  }
+
+
+  uint64_t ServerIndex::GetInvalidationEpochInternal(int64_t id) const
+  {
+    // WARNING: Before calling this method, "mutex_" must be locked.
+
+    InvalidationEpochs::const_iterator found = invalidationEpochs_.find(id);
+    if (found == invalidationEpochs_.end())
+    {
+      return invalidationFloor_;
+    }
+    else
+    {
+      return found->second;
+    }
+  }
+
+
+  uint64_t ServerIndex::GetInvalidationEpoch(const std::string& publicId)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    ResourceType rtype;
+    int64_t id;
+    if (!db_.LookupResource(id, rtype, publicId))
+    {
+      throw OrthancException(ErrorCode_UnknownResource);
+    }
+
+    return GetInvalidationEpochInternal(id);
+  }
+
+
+  bool ServerIndex::SetMetadataIfStable(const std::string& publicId,
+                                        MetadataType type,
+                                        const std::string& value,
+                                        uint64_t epoch)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    Transaction t(*this);
+
+    ResourceType rtype;
+    int64_t id;
+    if (!db_.LookupResource(id, rtype, publicId))
+    {
+      throw OrthancException(ErrorCode_UnknownResource);
+    }
+
+    if (unstableResources_.Contains(id) ||
+        GetInvalidationEpochInternal(id) != epoch)
+    {
+      return false;
+    }
+
+    db_.SetMetadata(id, type, value);
+    t.Commit(0);
+
+    return true;
+  }
+
+
   void ServerIndex::DeleteMetadata(const std::string& publicId,
                                    MetadataType type)
   {
@@ -2162,8 +2292,10 @@ namespace Orthanc
   }
 
 
-  StoreStatus ServerIndex::AddAttachment(const FileInfo& attachment,
-                                         const std::string& publicId)
+  StoreStatus ServerIndex::AddAttachmentInternal(const FileInfo& attachment,
+                                                 const std::string& publicId,
+                                                 bool onlyIfStable,
+                                                 uint64_t epoch)
   {
     boost::mutex::scoped_lock lock(mutex_);
 
@@ -2176,6 +2308,13 @@ namespace Orthanc
       return StoreStatus_Failure;  // Inexistent resource
     }
 
+    if (onlyIfStable &&
+        (unstableResources_.Contains(resourceId) ||
+         GetInvalidationEpochInternal(resourceId) != epoch))
+    {
+      return StoreStatus_Failure;  // The resource has changed recently
+    }
+
     // Remove possible previous attachment
     db_.DeleteAttachment(resourceId, attachment.GetContentType());
 
@@ -2213,6 +2352,21 @@ namespace Orthanc
   }
 
 
+  StoreStatus ServerIndex::AddAttachment(const FileInfo& attachment,
+                                         const std::string& publicId)
+  {
+    return AddAttachmentInternal(attachment, publicId, false, 0 /* unused */);
+  }
+
+
+  StoreStatus ServerIndex::AddAttachmentIfStable(const FileInfo& attachment,
+                                                 const std::string& publicId,
+                                                 uint64_t epoch)
+  {
+    return AddAttachmentInternal(attachment, publicId, true, epoch);
+  }
+
+
   void ServerIndex::DeleteAttachment(const std::string& publicId,
                                      FileContentType type)
   {
@@ -2272,6 +2426,24 @@ namespace Orthanc
   }
 
 
+  void ServerIndex::GetStoredJobs(std::map<std::string, std::string>& target)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    db_.GetStoredJobs(target);
+  }
+
+
+  void ServerIndex::UpdateStoredJobs(const std::map<std::string, std::string>& changed,
+                                     const std::set<std::string>& removed)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    Transaction transaction(*this);
+    db_.UpdateStoredJobs(changed, removed);
+    transaction.Commit(0);
+  }
+
+
   bool ServerIndex::GetMainDicomTags(DicomMap& result,
                                      const std::string& publicId,
                                      ResourceType expectedType,
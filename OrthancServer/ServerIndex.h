@@ -74,6 +74,13 @@ namespace Orthanc
     bool         overwrite_;
     std::auto_ptr<MainDicomTagsRegistry>  mainDicomTagsRegistry_;
 
+    // Epoch of the last invalidation of the resources whose list of
+    // children has changed (cf. "GetInvalidationEpoch()")
+    typedef std::map<int64_t, uint64_t>  InvalidationEpochs;
+    InvalidationEpochs  invalidationEpochs_;
+    uint64_t            invalidationSequence_;
+    uint64_t            invalidationFloor_;
+
     static void FlushThread(ServerIndex* that,
                             unsigned int threadSleep);
 
@@ -114,6 +121,15 @@ namespace Orthanc
     SeriesStatus GetSeriesStatus(int64_t id,
                                  int64_t expectedNumberOfInstances);
 
+    StoreStatus AddAttachmentInternal(const FileInfo& attachment,
+                                      const std::string& publicId,
+                                      bool onlyIfStable,
+                                      uint64_t epoch);
+
+    void BumpInvalidationEpoch(int64_t id);
+
+    uint64_t GetInvalidationEpochInternal(int64_t id) const;
+
   public:
     ServerIndex(ServerContext& context,
                 IDatabaseWrapper& database,
@@ -168,6 +184,12 @@ namespace Orthanc
                      size_t since,
                      size_t limit);
 
+    // Keyset iteration, which stays fast on large databases
+    void GetAllUuidsAfter(std::list<std::string>& target,
+                          ResourceType resourceType,
+                          const std::string& after,
+                          size_t limit);
+
     bool DeleteResource(Json::Value& target /* out */,
                         const std::string& uuid,
                         ResourceType expectedType);
@@ -205,6 +227,20 @@ namespace Orthanc
     void DeleteMetadata(const std::string& publicId,
                         MetadataType type);
 
+    // Returns a value that changes each time an instance is added to,
+    // or removed from an existing resource. It must be read before
+    // computing some information from the children of the resource.
+    uint64_t GetInvalidationEpoch(const std::string& publicId);
+
+    // Sets a metadata that caches some information computed from the
+    // children of the resource. Returns "false" (and does nothing)
+    // if the resource has received new instances recently, or if its
+    // children have changed since "epoch" was read.
+    bool SetMetadataIfStable(const std::string& publicId,
+                             MetadataType type,
+                             const std::string& value,
+                             uint64_t epoch);
+
     void GetAllMetadata(std::map<MetadataType, std::string>& target,
                         const std::string& publicId);
 
@@ -246,6 +282,12 @@ namespace Orthanc
     StoreStatus AddAttachment(const FileInfo& attachment,
                               const std::string& publicId);
 
+    // Same as "AddAttachment()", but fails if the resource has
+    // received new instances recently (cf. "SetMetadataIfStable()")
+    StoreStatus AddAttachmentIfStable(const FileInfo& attachment,
+                                      const std::string& publicId,
+                                      uint64_t epoch);
+
     void DeleteAttachment(const std::string& publicId,
                           FileContentType type);
 
@@ -258,6 +300,11 @@ namespace Orthanc
     std::string GetGlobalProperty(GlobalProperty property,
                                   const std::string& defaultValue);
 
+    void GetStoredJobs(std::map<std::string, std::string>& target);
+
+    void UpdateStoredJobs(const std::map<std::string, std::string>& changed,
+                          const std::set<std::string>& removed);
+
     bool GetMainDicomTags(DicomMap& result,
                           const std::string& publicId,
                           ResourceType expectedType,
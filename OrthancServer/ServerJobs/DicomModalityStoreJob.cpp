@@ -178,6 +178,12 @@ namespace Orthanc
   }
 
 
+  void DicomModalityStoreJob::GetTarget(std::string& target)
+  {
+    target = remote_.FormatTarget();
+  }
+
+
   void DicomModalityStoreJob::GetPublicContent(Json::Value& value)
   {
     SetOfInstancesJob::GetPublicContent(value);
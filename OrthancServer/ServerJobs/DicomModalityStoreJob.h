@@ -33,6 +33,7 @@
 
 #pragma once
 
+#include "../../Core/JobsEngine/ITargetedJob.h"
 #include "../../Core/JobsEngine/SetOfInstancesJob.h"
 #include "../../Core/DicomNetworking/DicomUserConnection.h"
 
@@ -40,7 +41,7 @@ namespace Orthanc
 {
   class ServerContext;
   
-  class DicomModalityStoreJob : public SetOfInstancesJob
+  class DicomModalityStoreJob : public SetOfInstancesJob, public ITargetedJob
   {
   private:
     ServerContext&                      context_;
@@ -96,6 +97,8 @@ namespace Orthanc
       target = "DicomModalityStore";
     }
 
+    virtual void GetTarget(std::string& target);
+
     virtual void GetPublicContent(Json::Value& value);
 
     virtual bool Serialize(Json::Value& target);
@@ -190,6 +190,12 @@ namespace Orthanc
   }
   
 
+  void DicomMoveScuJob::GetTarget(std::string& target)
+  {
+    target = remote_.FormatTarget();
+  }
+
+
   void DicomMoveScuJob::GetPublicContent(Json::Value& value)
   {
     SetOfCommandsJob::GetPublicContent(value);
@@ -33,6 +33,7 @@
 
 #pragma once
 
+#include "../../Core/JobsEngine/ITargetedJob.h"
 #include "../../Core/JobsEngine/SetOfCommandsJob.h"
 #include "../../Core/DicomNetworking/DicomUserConnection.h"
 
@@ -42,7 +43,7 @@ namespace Orthanc
 {
   class ServerContext;
   
-  class DicomMoveScuJob : public SetOfCommandsJob
+  class DicomMoveScuJob : public SetOfCommandsJob, public ITargetedJob
   {
   private:
     class Command;
@@ -100,6 +101,8 @@ namespace Orthanc
       target = "DicomMoveScu";
     }
 
+    virtual void GetTarget(std::string& target);
+
     virtual void GetPublicContent(Json::Value& value);
 
     virtual bool Serialize(Json::Value& target);
@@ -82,15 +82,16 @@ namespace Orthanc
   bool MergeStudyJob::HandleInstance(const std::string& instance)
   {
     /**
-     * Retrieve the DICOM instance to be modified
+     * Retrieve the DICOM instance to be modified. Only the tags are
+     * modified, so if possible, only the header that precedes the
+     * pixel data is parsed, and the pixel data is copied verbatim.
      **/
     
-    std::auto_ptr<ParsedDicomFile> modified;
+    std::string original;
 
     try
     {
-      ServerContext::DicomCacheLocker locker(context_, instance);
-      modified.reset(locker.GetDicom().Clone(true));
+      context_.ReadDicom(original, instance);
     }
     catch (OrthancException&)
     {
@@ -98,6 +99,21 @@ namespace Orthanc
       return false;
     }
 
+    uint64_t pixelDataOffset = 0;
+    std::auto_ptr<ParsedDicomFile> modified;
+
+    if (!original.empty())
+    {
+      modified.reset(ParsedDicomFile::CreateHeader(pixelDataOffset, original.c_str(), original.size()));
+    }
+
+    const bool headerOnly = (modified.get() != NULL);
+
+    if (!headerOnly)
+    {
+      modified.reset(new ParsedDicomFile(original));
+    }
+
 
     /**
      * Chose the target UIDs
@@ -139,7 +155,17 @@ namespace Orthanc
 
     DicomInstanceToStore toStore;
     toStore.SetOrigin(origin_);
-    toStore.SetParsedDicomFile(*modified);
+
+    std::string buffer;
+    if (headerOnly)
+    {
+      modified->SaveHeaderWithRawPixelData(buffer, original.c_str(), original.size(), pixelDataOffset);
+      toStore.SetBuffer(buffer);
+    }
+    else
+    {
+      toStore.SetParsedDicomFile(*modified);
+    }
 
     std::string modifiedInstance;
     if (context_.Store(modifiedInstance, toStore) != StoreStatus_Success)
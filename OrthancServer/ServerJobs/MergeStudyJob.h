@@ -92,6 +92,9 @@ namespace Orthanc
     
     void SetKeepSource(bool keep);
 
+    // The instances can be modified concurrently (New in Orthanc 1.5.7)
+    using SetOfCommandsJob::SetMaxConcurrency;
+
     void SetOrigin(const DicomInstanceOrigin& origin);
 
     void SetOrigin(const RestApiCall& call);
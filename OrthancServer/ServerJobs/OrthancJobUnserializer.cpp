@@ -50,6 +50,7 @@
 #include "DicomModalityStoreJob.h"
 #include "DicomMoveScuJob.h"
 #include "OrthancPeerStoreJob.h"
+#include "ReconstructDerivedDataJob.h"
 #include "ResourceModificationJob.h"
 #include "MergeStudyJob.h"
 #include "SplitStudyJob.h"
@@ -96,6 +97,10 @@ namespace Orthanc
     {
       return new DicomMoveScuJob(context_, source);
     }
+    else if (type == "ReconstructDerivedData")
+    {
+      return new ReconstructDerivedDataJob(context_, source);
+    }
     else
     {
       return GenericJobUnserializer::UnserializeJob(source);
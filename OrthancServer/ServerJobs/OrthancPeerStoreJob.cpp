@@ -40,22 +40,15 @@
 
 namespace Orthanc
 {
-  bool OrthancPeerStoreJob::HandleInstance(const std::string& instance)
+  bool OrthancPeerStoreJob::SendInstance(HttpClient& client,
+                                         const std::string& instance)
   {
-    //boost::this_thread::sleep(boost::posix_time::milliseconds(500));
-
-    if (client_.get() == NULL)
-    {
-      client_.reset(new HttpClient(peer_, "instances"));
-      client_->SetMethod(HttpMethod_Post);
-    }
-      
     LOG(INFO) << "Sending instance " << instance << " to peer \"" 
               << peer_.GetUrl() << "\"";
 
     try
     {
-      context_.ReadDicom(client_->GetBody(), instance);
+      context_.ReadDicom(client.GetBody(), instance);
     }
     catch (OrthancException& e)
     {
@@ -64,7 +57,7 @@ namespace Orthanc
     }
 
     std::string answer;
-    if (client_->Apply(answer))
+    if (client.Apply(answer))
     {
       return true;
     }
@@ -73,6 +66,29 @@ namespace Orthanc
       throw OrthancException(ErrorCode_NetworkProtocol);
     }
   }
+
+
+  bool OrthancPeerStoreJob::HandleInstance(const std::string& instance)
+  {
+    //boost::this_thread::sleep(boost::posix_time::milliseconds(500));
+
+    if (GetMaxConcurrency() > 1)
+    {
+      // The instances are sent concurrently by several workers, each
+      // of them using its own connection
+      HttpClient client(peer_, "instances");
+      client.SetMethod(HttpMethod_Post);
+      return SendInstance(client, instance);
+    }
+
+    if (client_.get() == NULL)
+    {
+      client_.reset(new HttpClient(peer_, "instances"));
+      client_->SetMethod(HttpMethod_Post);
+    }
+
+    return SendInstance(*client_, instance);
+  }
     
 
   bool OrthancPeerStoreJob::HandleTrailingStep()
@@ -100,6 +116,12 @@ namespace Orthanc
   }
 
 
+  void OrthancPeerStoreJob::GetTarget(std::string& target)
+  {
+    target = "HTTP:" + peer_.GetUrl();
+  }
+
+
   void OrthancPeerStoreJob::GetPublicContent(Json::Value& value)
   {
     SetOfInstancesJob::GetPublicContent(value);
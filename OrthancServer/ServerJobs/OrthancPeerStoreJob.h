@@ -33,6 +33,7 @@
 
 #pragma once
 
+#include "../../Core/JobsEngine/ITargetedJob.h"
 #include "../../Core/JobsEngine/SetOfInstancesJob.h"
 #include "../../Core/HttpClient.h"
 
@@ -41,13 +42,16 @@ namespace Orthanc
 {
   class ServerContext;
   
-  class OrthancPeerStoreJob : public SetOfInstancesJob
+  class OrthancPeerStoreJob : public SetOfInstancesJob, public ITargetedJob
   {
   private:
     ServerContext&             context_;
     WebServiceParameters       peer_;
     std::auto_ptr<HttpClient>  client_;
 
+    bool SendInstance(HttpClient& client,
+                      const std::string& instance);
+
   protected:
     virtual bool HandleInstance(const std::string& instance);
     
@@ -64,6 +68,9 @@ namespace Orthanc
 
     void SetPeer(const WebServiceParameters& peer);
 
+    // The instances can be sent concurrently (New in Orthanc 1.5.7)
+    using SetOfCommandsJob::SetMaxConcurrency;
+
     const WebServiceParameters& GetPeer() const
     {
       return peer_;
@@ -76,6 +83,8 @@ namespace Orthanc
       target = "OrthancPeerStore";
     }
 
+    virtual void GetTarget(std::string& target);
+
     virtual void GetPublicContent(Json::Value& value);
 
     virtual bool Serialize(Json::Value& target);
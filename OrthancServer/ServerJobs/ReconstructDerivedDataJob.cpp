@@ -0,0 +1,427 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2019 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#include "../PrecompiledHeadersServer.h"
+#include "ReconstructDerivedDataJob.h"
+
+#include "../../Core/Logging.h"
+#include "../../Core/OrthancException.h"
+#include "../../Core/SerializationToolbox.h"
+#include "../ServerContext.h"
+
+#include <boost/thread/condition_variable.hpp>
+#include <cassert>
+#include <vector>
+
+namespace Orthanc
+{
+  class ReconstructDerivedDataJob::Batch : public boost::noncopyable
+  {
+  private:
+    ReconstructDerivedDataJob&       that_;
+    std::vector<std::string>         instances_;
+    size_t                           position_;
+    size_t                           remaining_;
+    boost::mutex                     mutex_;
+    boost::condition_variable        finished_;
+
+  public:
+    Batch(ReconstructDerivedDataJob& that,
+          const std::list<std::string>& instances) :
+      that_(that),
+      instances_(instances.begin(), instances.end()),
+      position_(0),
+      remaining_(instances_.size())
+    {
+    }
+
+    // Returns "false" iff. there is no instance left. Once "Wait()"
+    // has returned, this method never accesses the job anymore.
+    bool ProcessNextInstance()
+    {
+      std::string instance;
+
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+
+        if (position_ >= instances_.size())
+        {
+          return false;
+        }
+
+        instance = instances_[position_];
+        position_++;
+      }
+
+      try
+      {
+        that_.ProcessInstance(instance);
+      }
+      catch (...)
+      {
+        LOG(ERROR) << "Native exception while reconstructing the derived data of instance " << instance;
+      }
+
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        assert(remaining_ > 0);
+        remaining_--;
+
+        if (remaining_ == 0)
+        {
+          finished_.notify_all();
+        }
+      }
+
+      return true;
+    }
+
+    void Wait()
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      while (remaining_ > 0)
+      {
+        finished_.wait(lock);
+      }
+    }
+  };
+
+
+  class ReconstructDerivedDataJob::BatchRunnable : public IRunnableBySteps
+  {
+  private:
+    boost::shared_ptr<Batch>  batch_;
+
+  public:
+    explicit BatchRunnable(const boost::shared_ptr<Batch>& batch) :
+      batch_(batch)
+    {
+    }
+
+    virtual bool Step()
+    {
+      while (batch_->ProcessNextInstance())
+      {
+      }
+
+      return false;  // Done with this batch
+    }
+  };
+
+
+  void ReconstructDerivedDataJob::ProcessInstance(const std::string& instance)
+  {
+    bool reconstructedJson = false;
+    bool convertedJson = false;
+    unsigned int reconstructedMetadata = 0;
+    bool failure = false;
+
+    try
+    {
+      if (context_.ReconstructMissingDicomAsJson(instance))
+      {
+        reconstructedJson = true;
+      }
+      else if (context_.ConvertDicomAsJson(instance))
+      {
+        convertedJson = true;
+      }
+
+      static const MetadataType METADATA[] = {
+        MetadataType_Instance_SopClassUid,
+        MetadataType_Instance_TransferSyntax
+      };
+
+      for (size_t i = 0; i < sizeof(METADATA) / sizeof(MetadataType); i++)
+      {
+        std::string value;
+        if (!context_.GetIndex().LookupMetadata(value, instance, METADATA[i]) &&
+            context_.LookupOrReconstructMetadata(value, instance, METADATA[i]))
+        {
+          reconstructedMetadata++;
+        }
+      }
+    }
+    catch (OrthancException& e)
+    {
+      // The instance might have been deleted in the meantime
+      LOG(WARNING) << "Cannot reconstruct the derived data of instance "
+                   << instance << ": " << e.What();
+      failure = true;
+    }
+
+    boost::mutex::scoped_lock lock(mutex_);
+    processedInstances_++;
+
+    if (reconstructedJson)
+    {
+      reconstructedDicomAsJson_++;
+    }
+
+    if (convertedJson)
+    {
+      convertedDicomAsJson_++;
+    }
+
+    reconstructedMetadata_ += reconstructedMetadata;
+
+    if (failure)
+    {
+      failedInstances_++;
+    }
+  }
+
+
+  void ReconstructDerivedDataJob::ProcessBatch(const std::list<std::string>& instances)
+  {
+    boost::shared_ptr<Batch> batch(new Batch(*this, instances));
+
+    if (threadsCount_ > 1 &&
+        instances.size() > 1)
+    {
+      // The pool is created once, and reused by all the batches of
+      // the job. The calling thread processes instances too.
+      if (pool_.get() == NULL)
+      {
+        pool_.reset(new RunnableWorkersPool(threadsCount_ - 1));
+      }
+
+      for (unsigned int i = 1; i < threadsCount_ && i < instances.size(); i++)
+      {
+        pool_->Add(new BatchRunnable(batch));
+      }
+    }
+
+    while (batch->ProcessNextInstance())
+    {
+    }
+
+    batch->Wait();
+  }
+
+
+  ReconstructDerivedDataJob::ReconstructDerivedDataJob(ServerContext& context) :
+    context_(context),
+    done_(false),
+    batchSize_(100),
+    threadsCount_(4),
+    throttle_(0),
+    totalInstances_(0),
+    processedInstances_(0),
+    reconstructedDicomAsJson_(0),
+    convertedDicomAsJson_(0),
+    reconstructedMetadata_(0),
+    failedInstances_(0)
+  {
+  }
+
+
+  void ReconstructDerivedDataJob::SetBatchSize(unsigned int size)
+  {
+    if (size == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+    else
+    {
+      batchSize_ = size;
+    }
+  }
+
+
+  void ReconstructDerivedDataJob::SetThreadsCount(unsigned int count)
+  {
+    if (count == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+    else
+    {
+      threadsCount_ = count;
+      pool_.reset(NULL);
+    }
+  }
+
+
+  void ReconstructDerivedDataJob::Start()
+  {
+    uint64_t diskSize, uncompressedSize, countPatients, countStudies, countSeries;
+    context_.GetIndex().GetGlobalStatistics(diskSize, uncompressedSize, countPatients,
+                                            countStudies, countSeries, totalInstances_);
+  }
+
+
+  JobStepResult ReconstructDerivedDataJob::Step()
+  {
+    if (done_)
+    {
+      return JobStepResult::Success();
+    }
+
+    std::list<std::string> instances;
+    context_.GetIndex().GetAllUuidsAfter(instances, ResourceType_Instance, cursor_, batchSize_);
+
+    if (instances.empty())
+    {
+      LOG(INFO) << "Reconstruction of the derived data is over: " << processedInstances_
+                << " instance(s) processed, " << failedInstances_ << " failure(s)";
+      done_ = true;
+      return JobStepResult::Success();
+    }
+
+    ProcessBatch(instances);
+    cursor_ = instances.back();
+
+    if (instances.size() < batchSize_)
+    {
+      // This was the last batch
+      done_ = true;
+      return JobStepResult::Success();
+    }
+    else if (throttle_ > 0)
+    {
+      // Leave some room to the other activities of Orthanc
+      return JobStepResult::Retry(throttle_);
+    }
+    else
+    {
+      return JobStepResult::Continue();
+    }
+  }
+
+
+  void ReconstructDerivedDataJob::Stop(JobStopReason reason)
+  {
+    if (reason != JobStopReason_Retry)
+    {
+      // Release the threads, unless the job is only throttled
+      pool_.reset(NULL);
+    }
+  }
+
+
+  void ReconstructDerivedDataJob::Reset()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    cursor_.clear();
+    done_ = false;
+    processedInstances_ = 0;
+    reconstructedDicomAsJson_ = 0;
+    convertedDicomAsJson_ = 0;
+    reconstructedMetadata_ = 0;
+    failedInstances_ = 0;
+  }
+
+
+  float ReconstructDerivedDataJob::GetProgress()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    if (done_)
+    {
+      return 1.0f;
+    }
+    else if (totalInstances_ == 0 ||
+             processedInstances_ >= totalInstances_)
+    {
+      return 0.99f;  // The index has grown since the job was started
+    }
+    else
+    {
+      return (static_cast<float>(processedInstances_) /
+              static_cast<float>(totalInstances_));
+    }
+  }
+
+
+  static const char* CURSOR = "Cursor";
+  static const char* DONE = "Done";
+  static const char* BATCH_SIZE = "BatchSize";
+  static const char* THREADS = "Threads";
+  static const char* THROTTLE = "Throttle";
+  static const char* PROCESSED_INSTANCES = "ProcessedInstances";
+  static const char* RECONSTRUCTED_DICOM_AS_JSON = "ReconstructedDicomAsJson";
+  static const char* CONVERTED_DICOM_AS_JSON = "ConvertedDicomAsJson";
+  static const char* RECONSTRUCTED_METADATA = "ReconstructedMetadata";
+  static const char* FAILED_INSTANCES = "FailedInstances";
+
+
+  void ReconstructDerivedDataJob::GetPublicContent(Json::Value& value)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    value = Json::objectValue;
+    value[CURSOR] = cursor_;
+    value[BATCH_SIZE] = batchSize_;
+    value[THREADS] = threadsCount_;
+    value[THROTTLE] = throttle_;
+    value[PROCESSED_INSTANCES] = processedInstances_;
+    value[RECONSTRUCTED_DICOM_AS_JSON] = reconstructedDicomAsJson_;
+    value[CONVERTED_DICOM_AS_JSON] = convertedDicomAsJson_;
+    value[RECONSTRUCTED_METADATA] = reconstructedMetadata_;
+    value[FAILED_INSTANCES] = failedInstances_;
+  }
+
+
+  ReconstructDerivedDataJob::ReconstructDerivedDataJob(ServerContext& context,
+                                                       const Json::Value& serialized) :
+    context_(context),
+    totalInstances_(0)
+  {
+    cursor_ = SerializationToolbox::ReadString(serialized, CURSOR);
+    done_ = SerializationToolbox::ReadBoolean(serialized, DONE);
+    SetBatchSize(SerializationToolbox::ReadUnsignedInteger(serialized, BATCH_SIZE));
+    SetThreadsCount(SerializationToolbox::ReadUnsignedInteger(serialized, THREADS));
+    throttle_ = SerializationToolbox::ReadUnsignedInteger(serialized, THROTTLE);
+    processedInstances_ = SerializationToolbox::ReadUnsignedInteger(serialized, PROCESSED_INSTANCES);
+    reconstructedDicomAsJson_ = SerializationToolbox::ReadUnsignedInteger(serialized, RECONSTRUCTED_DICOM_AS_JSON);
+    convertedDicomAsJson_ = SerializationToolbox::ReadUnsignedInteger(serialized, CONVERTED_DICOM_AS_JSON);
+    reconstructedMetadata_ = SerializationToolbox::ReadUnsignedInteger(serialized, RECONSTRUCTED_METADATA);
+    failedInstances_ = SerializationToolbox::ReadUnsignedInteger(serialized, FAILED_INSTANCES);
+  }
+
+
+  bool ReconstructDerivedDataJob::Serialize(Json::Value& value)
+  {
+    GetPublicContent(value);
+
+    std::string type;
+    GetJobType(type);
+    value["Type"] = type;
+    value[DONE] = done_;
+
+    return true;
+  }
+}
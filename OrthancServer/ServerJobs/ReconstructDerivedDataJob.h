@@ -0,0 +1,141 @@
+/**
+ * Orthanc - A Lightweight, RESTful DICOM Store
+ * Copyright (C) 2012-2016 Sebastien Jodogne, Medical Physics
+ * Department, University Hospital of Liege, Belgium
+ * Copyright (C) 2017-2019 Osimis S.A., Belgium
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * In addition, as a special exception, the copyright holders of this
+ * program give permission to link the code of its release with the
+ * OpenSSL project's "OpenSSL" library (or with modified versions of it
+ * that use the same license as the "OpenSSL" library), and distribute
+ * the linked executables. You must obey the GNU General Public License
+ * in all respects for all of the code used other than "OpenSSL". If you
+ * modify file(s) with this exception, you may extend this exception to
+ * your version of the file(s), but you are not obligated to do so. If
+ * you do not wish to do so, delete this exception statement from your
+ * version. If you delete this exception statement from all source files
+ * in the program, then also delete it here.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#pragma once
+
+#include "../../Core/JobsEngine/IJob.h"
+#include "../../Core/MultiThreading/RunnableWorkersPool.h"
+
+#include <boost/thread/mutex.hpp>
+#include <list>
+#include <stdint.h>
+
+namespace Orthanc
+{
+  class ServerContext;
+
+  /**
+   * Background job that walks over all the instances of the index,
+   * by batches of consecutive public identifiers (keyset iteration),
+   * and regenerates the derived data that are missing (the
+   * "DICOM-as-JSON" attachment and the mandatory metadata of the
+   * instances). The job can be paused and resumed, as it only has to
+   * remember the last processed instance.
+   **/
+  class ReconstructDerivedDataJob : public IJob
+  {
+  private:
+    class Batch;
+    class BatchRunnable;
+
+    ServerContext&  context_;
+    std::string     cursor_;
+    bool            done_;
+    unsigned int    batchSize_;
+    unsigned int    threadsCount_;
+    unsigned int    throttle_;   // In milliseconds
+    uint64_t        totalInstances_;
+
+    boost::mutex    mutex_;      // Protects the counters below
+    unsigned int    processedInstances_;
+    unsigned int    reconstructedDicomAsJson_;
+    unsigned int    convertedDicomAsJson_;
+    unsigned int    reconstructedMetadata_;
+    unsigned int    failedInstances_;
+
+    // Threads shared by all the batches (only used by the thread
+    // running the job)
+    std::auto_ptr<RunnableWorkersPool>  pool_;
+
+    void ProcessInstance(const std::string& instance);
+
+    void ProcessBatch(const std::list<std::string>& instances);
+
+  public:
+    ReconstructDerivedDataJob(ServerContext& context);
+
+    ReconstructDerivedDataJob(ServerContext& context,
+                              const Json::Value& serialized);
+
+    void SetBatchSize(unsigned int size);
+
+    unsigned int GetBatchSize() const
+    {
+      return batchSize_;
+    }
+
+    void SetThreadsCount(unsigned int count);
+
+    unsigned int GetThreadsCount() const
+    {
+      return threadsCount_;
+    }
+
+    // Delay between two batches, in milliseconds
+    void SetThrottle(unsigned int throttle)
+    {
+      throttle_ = throttle;
+    }
+
+    unsigned int GetThrottle() const
+    {
+      return throttle_;
+    }
+
+    virtual void Start();
+
+    virtual JobStepResult Step();
+
+    virtual void Reset();
+
+    virtual void Stop(JobStopReason reason);
+
+    virtual float GetProgress();
+
+    virtual void GetJobType(std::string& target)
+    {
+      target = "ReconstructDerivedData";
+    }
+
+    virtual void GetPublicContent(Json::Value& value);
+
+    virtual bool Serialize(Json::Value& value);
+
+    virtual bool GetOutput(std::string& output,
+                           MimeType& mime,
+                           const std::string& key)
+    {
+      return false;
+    }
+  };
+}
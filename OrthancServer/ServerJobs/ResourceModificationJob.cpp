@@ -38,6 +38,10 @@
 #include "../../Core/SerializationToolbox.h"
 #include "../ServerContext.h"
 
+#include <boost/thread/condition_variable.hpp>
+#include <cassert>
+#include <vector>
+
 namespace Orthanc
 {
   class ResourceModificationJob::Output : public boost::noncopyable
@@ -130,10 +134,203 @@ namespace Orthanc
 
 
 
-  bool ResourceModificationJob::HandleInstance(const std::string& instance)
+  class ResourceModificationJob::PreparedInstance : public boost::noncopyable
   {
-    if (modification_.get() == NULL ||
-        output_.get() == NULL)
+  private:
+    std::auto_ptr<DicomInstanceHasher>  originalHasher_;
+    std::auto_ptr<ParsedDicomFile>      modified_;
+    std::auto_ptr<OrthancException>     error_;
+
+  public:
+    void SetResult(const DicomInstanceHasher& originalHasher,
+                   ParsedDicomFile* modified)  // Takes ownership
+    {
+      originalHasher_.reset(new DicomInstanceHasher(originalHasher));
+      modified_.reset(modified);
+    }
+
+    void SetError(const OrthancException& error)
+    {
+      error_.reset(new OrthancException(error));
+    }
+
+    void CheckError() const
+    {
+      if (error_.get() != NULL)
+      {
+        throw OrthancException(*error_);
+      }
+    }
+
+    // Returns "false" iff the instance was removed after the job was issued
+    bool HasResult() const
+    {
+      return modified_.get() != NULL;
+    }
+
+    DicomInstanceHasher& GetOriginalHasher() const
+    {
+      assert(HasResult());
+      return *originalHasher_;
+    }
+
+    ParsedDicomFile& GetModified() const
+    {
+      assert(HasResult());
+      return *modified_;
+    }
+  };
+
+
+  class ResourceModificationJob::Prefetcher : public boost::noncopyable
+  {
+  private:
+    ResourceModificationJob&         that_;
+    std::vector<std::string>         instances_;
+    std::vector<PreparedInstance*>   results_;
+    size_t                           position_;
+    size_t                           remaining_;
+    boost::mutex                     mutex_;
+    boost::condition_variable        finished_;
+
+    void Process(size_t index)
+    {
+      std::auto_ptr<PreparedInstance> prepared(new PreparedInstance);
+
+      try
+      {
+        // The DICOM cache is bypassed, as it would serialize the
+        // parsing of the files by the different threads
+        that_.PrepareInstance(*prepared, instances_[index], false /* no cache */);
+      }
+      catch (OrthancException& e)
+      {
+        prepared->SetError(e);
+      }
+      catch (std::bad_alloc&)
+      {
+        prepared->SetError(OrthancException(ErrorCode_NotEnoughMemory));
+      }
+      catch (...)
+      {
+        prepared->SetError(OrthancException(ErrorCode_InternalError));
+      }
+
+      // Each thread writes to a distinct slot of the vector
+      results_[index] = prepared.release();
+    }
+
+  public:
+    Prefetcher(ResourceModificationJob& that,
+               const std::vector<std::string>& instances) :
+      that_(that),
+      instances_(instances),
+      results_(instances.size(), NULL),
+      position_(0),
+      remaining_(instances.size())
+    {
+    }
+
+    ~Prefetcher()
+    {
+      for (size_t i = 0; i < results_.size(); i++)
+      {
+        if (results_[i] != NULL)
+        {
+          delete results_[i];
+        }
+      }
+    }
+
+    // Returns "false" iff. there is no instance left. Once "Wait()"
+    // has returned, this method never accesses the job anymore.
+    bool ProcessNextInstance()
+    {
+      size_t index;
+
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+
+        if (position_ >= instances_.size())
+        {
+          return false;
+        }
+
+        index = position_;
+        position_++;
+      }
+
+      Process(index);
+
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        assert(remaining_ > 0);
+        remaining_--;
+
+        if (remaining_ == 0)
+        {
+          finished_.notify_all();
+        }
+      }
+
+      return true;
+    }
+
+    void Wait()
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+
+      while (remaining_ > 0)
+      {
+        finished_.wait(lock);
+      }
+    }
+
+    void Transfer(PreparedInstances& target)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      assert(remaining_ == 0);
+
+      for (size_t i = 0; i < results_.size(); i++)
+      {
+        if (results_[i] != NULL &&
+            target.find(instances_[i]) == target.end())
+        {
+          target[instances_[i]] = results_[i];
+          results_[i] = NULL;
+        }
+      }
+    }
+  };
+
+
+  class ResourceModificationJob::PrefetcherRunnable : public IRunnableBySteps
+  {
+  private:
+    boost::shared_ptr<Prefetcher>  prefetcher_;
+
+  public:
+    explicit PrefetcherRunnable(const boost::shared_ptr<Prefetcher>& prefetcher) :
+      prefetcher_(prefetcher)
+    {
+    }
+
+    virtual bool Step()
+    {
+      while (prefetcher_->ProcessNextInstance())
+      {
+      }
+
+      return false;  // Done with this prefetcher
+    }
+  };
+
+
+  bool ResourceModificationJob::PrepareInstance(PreparedInstance& target,
+                                                const std::string& instance,
+                                                bool useCache)
+  {
+    if (modification_.get() == NULL)
     {
       throw OrthancException(ErrorCode_BadSequenceOfCalls,
                              "No modification was provided for this job");
@@ -144,7 +341,8 @@ namespace Orthanc
 
 
     /**
-     * Retrieve the original instance from the DICOM cache.
+     * Retrieve the original instance, either from the DICOM cache, or
+     * directly from the storage area.
      **/
     
     std::auto_ptr<DicomInstanceHasher> originalHasher;
@@ -152,11 +350,23 @@ namespace Orthanc
 
     try
     {
-      ServerContext::DicomCacheLocker locker(context_, instance);
-      ParsedDicomFile& original = locker.GetDicom();
+      if (useCache)
+      {
+        ServerContext::DicomCacheLocker locker(context_, instance);
+        ParsedDicomFile& original = locker.GetDicom();
 
-      originalHasher.reset(new DicomInstanceHasher(original.GetHasher()));
-      modified.reset(original.Clone(true));
+        originalHasher.reset(new DicomInstanceHasher(original.GetHasher()));
+        modified.reset(original.Clone(true));
+      }
+      else
+      {
+        std::string dicom;
+        context_.ReadDicom(dicom, instance);
+
+        // This is a private copy of the instance, no need to clone it
+        modified.reset(new ParsedDicomFile(dicom));
+        originalHasher.reset(new DicomInstanceHasher(modified->GetHasher()));
+      }
     }
     catch (OrthancException&)
     {
@@ -171,9 +381,119 @@ namespace Orthanc
 
     modification_->Apply(*modified);
 
+    target.SetResult(*originalHasher, modified.release());
+    return true;
+  }
+
+
+  void ResourceModificationJob::PrepareNextInstances()
+  {
+    assert(threadsCount_ > 1);
+
+    // Modify the next instances of the job in parallel, at most one
+    // per thread to bound the memory consumption. The position of
+    // the job corresponds to the instance that is currently handled.
+    std::vector<std::string> instances;
+
+    for (size_t i = GetPosition(); 
+         i < GetInstancesCount() && i < GetPosition() + threadsCount_; i++)
+    {
+      instances.push_back(GetInstance(i));
+    }
+
+    boost::shared_ptr<Prefetcher> prefetcher(new Prefetcher(*this, instances));
+
+    if (instances.size() > 1)
+    {
+      // The thread running the job is the first worker
+      if (pool_.get() == NULL)
+      {
+        pool_.reset(new RunnableWorkersPool(threadsCount_ - 1));
+      }
+
+      for (size_t i = 1; i < instances.size(); i++)
+      {
+        pool_->Add(new PrefetcherRunnable(prefetcher));
+      }
+    }
+
+    while (prefetcher->ProcessNextInstance())
+    {
+    }
+
+    prefetcher->Wait();
+    prefetcher->Transfer(prepared_);
+  }
+
+
+  void ResourceModificationJob::ClearPreparedInstances()
+  {
+    for (PreparedInstances::iterator it = prepared_.begin();
+         it != prepared_.end(); ++it)
+    {
+      assert(it->second != NULL);
+      delete it->second;
+    }
+
+    prepared_.clear();
+  }
+
+
+  bool ResourceModificationJob::HandleInstance(const std::string& instance)
+  {
+    if (modification_.get() == NULL ||
+        output_.get() == NULL)
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls,
+                             "No modification was provided for this job");
+    }
+
+    std::auto_ptr<PreparedInstance> prepared;
+
+    if (threadsCount_ <= 1)
+    {
+      prepared.reset(new PreparedInstance);
+      PrepareInstance(*prepared, instance, true /* use the DICOM cache */);
+    }
+    else
+    {
+      PreparedInstances::iterator found = prepared_.find(instance);
+
+      if (found == prepared_.end())
+      {
+        PrepareNextInstances();
+        found = prepared_.find(instance);
+      }
+
+      if (found == prepared_.end())
+      {
+        throw OrthancException(ErrorCode_InternalError);
+      }
+
+      prepared.reset(found->second);
+      prepared_.erase(found);
+
+      // Report the errors of the worker thread as if the
+      // modification had been done by the job thread
+      prepared->CheckError();
+    }
+
+    if (!prepared->HasResult())
+    {
+      return false;
+    }
+
+    DicomInstanceHasher& originalHasher = prepared->GetOriginalHasher();
+    ParsedDicomFile& modified = prepared->GetModified();
+
+
+    /**
+     * Prepare the storage of the resulting DICOM instance.
+     **/
+
     DicomInstanceToStore toStore;
     toStore.SetOrigin(origin_);
-    toStore.SetParsedDicomFile(*modified);
+    toStore.SetParsedDicomFile(modified);
 
 
     /**
@@ -181,28 +501,28 @@ namespace Orthanc
      * resulting DICOM instance (AnonymizedFrom/ModifiedFrom).
      **/
 
-    DicomInstanceHasher modifiedHasher = modified->GetHasher();
+    DicomInstanceHasher modifiedHasher = modified.GetHasher();
       
     MetadataType metadataType = (isAnonymization_ ?
                                  MetadataType_AnonymizedFrom :
                                  MetadataType_ModifiedFrom);
 
-    if (originalHasher->HashSeries() != modifiedHasher.HashSeries())
+    if (originalHasher.HashSeries() != modifiedHasher.HashSeries())
     {
-      toStore.AddMetadata(ResourceType_Series, metadataType, originalHasher->HashSeries());
+      toStore.AddMetadata(ResourceType_Series, metadataType, originalHasher.HashSeries());
     }
 
-    if (originalHasher->HashStudy() != modifiedHasher.HashStudy())
+    if (originalHasher.HashStudy() != modifiedHasher.HashStudy())
     {
-      toStore.AddMetadata(ResourceType_Study, metadataType, originalHasher->HashStudy());
+      toStore.AddMetadata(ResourceType_Study, metadataType, originalHasher.HashStudy());
     }
 
-    if (originalHasher->HashPatient() != modifiedHasher.HashPatient())
+    if (originalHasher.HashPatient() != modifiedHasher.HashPatient())
     {
-      toStore.AddMetadata(ResourceType_Patient, metadataType, originalHasher->HashPatient());
+      toStore.AddMetadata(ResourceType_Patient, metadataType, originalHasher.HashPatient());
     }
 
-    assert(instance == originalHasher->HashInstance());
+    assert(instance == originalHasher.HashInstance());
     toStore.AddMetadata(ResourceType_Instance, metadataType, instance);
 
 
@@ -231,6 +551,51 @@ namespace Orthanc
   }
 
 
+  ResourceModificationJob::~ResourceModificationJob()
+  {
+    ClearPreparedInstances();
+  }
+
+
+  void ResourceModificationJob::SetThreadsCount(unsigned int count)
+  {
+    if (count == 0)
+    {
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+    }
+    else if (IsStarted())
+    {
+      throw OrthancException(ErrorCode_BadSequenceOfCalls);
+    }
+    else
+    {
+      threadsCount_ = count;
+    }
+  }
+
+
+  void ResourceModificationJob::Reset()
+  {
+    SetOfInstancesJob::Reset();
+    ClearPreparedInstances();
+  }
+
+
+  void ResourceModificationJob::Stop(JobStopReason reason)
+  {
+    // Release the memory used by the instances that were modified
+    // ahead of time. They will be modified again if the job resumes,
+    // which is harmless as they have not been stored yet.
+    ClearPreparedInstances();
+
+    if (reason != JobStopReason_Retry)
+    {
+      // Release the threads, unless the job is only throttled
+      pool_.reset(NULL);
+    }
+  }
+
+
   void ResourceModificationJob::SetModification(DicomModification* modification,
                                                 ResourceType level,
                                                 bool isAnonymization)
@@ -300,6 +665,7 @@ namespace Orthanc
   static const char* MODIFICATION = "Modification";
   static const char* ORIGIN = "Origin";
   static const char* IS_ANONYMIZATION = "IsAnonymization";
+  static const char* THREADS = "Threads";
   
 
   ResourceModificationJob::ResourceModificationJob(ServerContext& context,
@@ -310,6 +676,21 @@ namespace Orthanc
     isAnonymization_ = SerializationToolbox::ReadBoolean(serialized, IS_ANONYMIZATION);
     origin_ = DicomInstanceOrigin(serialized[ORIGIN]);
     modification_.reset(new DicomModification(serialized[MODIFICATION]));
+
+    if (serialized.isMember(THREADS))
+    {
+      threadsCount_ = SerializationToolbox::ReadUnsignedInteger(serialized, THREADS);
+
+      if (threadsCount_ == 0)
+      {
+        throw OrthancException(ErrorCode_BadFileFormat);
+      }
+    }
+    else
+    {
+      // Backward compatibility with Orthanc <= 1.5.6
+      threadsCount_ = 1;
+    }
   }
   
   bool ResourceModificationJob::Serialize(Json::Value& value)
@@ -321,6 +702,7 @@ namespace Orthanc
     else
     {
       value[IS_ANONYMIZATION] = isAnonymization_;
+      value[THREADS] = threadsCount_;
       origin_.Serialize(value[ORIGIN]);
       
       Json::Value tmp;
@@ -35,8 +35,11 @@
 
 #include "../../Core/JobsEngine/SetOfInstancesJob.h"
 #include "../../Core/DicomParsing/DicomModification.h"
+#include "../../Core/MultiThreading/RunnableWorkersPool.h"
 #include "../DicomInstanceOrigin.h"
 
+#include <map>
+
 namespace Orthanc
 {
   class ServerContext;
@@ -45,12 +48,33 @@ namespace Orthanc
   {
   private:
     class Output;
+    class PreparedInstance;
+    class Prefetcher;
+    class PrefetcherRunnable;
+
+    // Instances that were modified ahead of time by the worker
+    // threads, indexed by their public identifier
+    typedef std::map<std::string, PreparedInstance*>  PreparedInstances;
     
     ServerContext&                    context_;
     std::auto_ptr<DicomModification>  modification_;
     boost::shared_ptr<Output>         output_;
     bool                              isAnonymization_;
     DicomInstanceOrigin               origin_;
+    unsigned int                      threadsCount_;
+    PreparedInstances                 prepared_;
+
+    // Threads shared by all the prefetchers (only used by the thread
+    // running the job)
+    std::auto_ptr<RunnableWorkersPool>  pool_;
+
+    bool PrepareInstance(PreparedInstance& target,
+                         const std::string& instance,
+                         bool useCache);
+
+    void PrepareNextInstances();
+
+    void ClearPreparedInstances();
 
   protected:
     virtual bool HandleInstance(const std::string& instance);
@@ -60,13 +84,16 @@ namespace Orthanc
   public:
     ResourceModificationJob(ServerContext& context) :
       context_(context),
-      isAnonymization_(false)
+      isAnonymization_(false),
+      threadsCount_(1)
     {
     }
 
     ResourceModificationJob(ServerContext& context,
                             const Json::Value& serialized);
 
+    virtual ~ResourceModificationJob();
+
     void SetModification(DicomModification* modification,   // Takes ownership
                          ResourceType level,
                          bool isAnonymization);
@@ -87,10 +114,25 @@ namespace Orthanc
       return origin_;
     }
 
-    virtual void Stop(JobStopReason reason)
+    /**
+     * Number of threads that read, parse and modify the next
+     * instances of the job in parallel. The modified instances are
+     * still stored one by one, in the order of the job, which
+     * preserves the tracking of the failed instances and the
+     * serialization of the job. The default value of 1 disables the
+     * worker threads.
+     **/
+    void SetThreadsCount(unsigned int count);
+
+    unsigned int GetThreadsCount() const
     {
+      return threadsCount_;
     }
 
+    virtual void Reset();
+
+    virtual void Stop(JobStopReason reason);
+
     virtual void GetJobType(std::string& target)
     {
       target = "ResourceModification";
@@ -68,15 +68,16 @@ namespace Orthanc
   bool SplitStudyJob::HandleInstance(const std::string& instance)
   {
     /**
-     * Retrieve the DICOM instance to be modified
+     * Retrieve the DICOM instance to be modified. Only the tags are
+     * modified, so if possible, only the header that precedes the
+     * pixel data is parsed, and the pixel data is copied verbatim.
      **/
     
-    std::auto_ptr<ParsedDicomFile> modified;
+    std::string original;
 
     try
     {
-      ServerContext::DicomCacheLocker locker(context_, instance);
-      modified.reset(locker.GetDicom().Clone(true));
+      context_.ReadDicom(original, instance);
     }
     catch (OrthancException&)
     {
@@ -84,6 +85,21 @@ namespace Orthanc
       return false;
     }
 
+    uint64_t pixelDataOffset = 0;
+    std::auto_ptr<ParsedDicomFile> modified;
+
+    if (!original.empty())
+    {
+      modified.reset(ParsedDicomFile::CreateHeader(pixelDataOffset, original.c_str(), original.size()));
+    }
+
+    const bool headerOnly = (modified.get() != NULL);
+
+    if (!headerOnly)
+    {
+      modified.reset(new ParsedDicomFile(original));
+    }
+
 
     /**
      * Chose the target UIDs
@@ -125,14 +141,27 @@ namespace Orthanc
     modified->ReplacePlainString(DICOM_TAG_STUDY_INSTANCE_UID, targetStudyUid_);
     modified->ReplacePlainString(DICOM_TAG_SERIES_INSTANCE_UID, targetSeriesUid->second);
 
-    if (targetStudy_.empty())
     {
-      targetStudy_ = modified->GetHasher().HashStudy();
+      boost::mutex::scoped_lock lock(targetStudyMutex_);
+      if (targetStudy_.empty())
+      {
+        targetStudy_ = modified->GetHasher().HashStudy();
+      }
     }
     
     DicomInstanceToStore toStore;
     toStore.SetOrigin(origin_);
-    toStore.SetParsedDicomFile(*modified);
+
+    std::string buffer;
+    if (headerOnly)
+    {
+      modified->SaveHeaderWithRawPixelData(buffer, original.c_str(), original.size(), pixelDataOffset);
+      toStore.SetBuffer(buffer);
+    }
+    else
+    {
+      toStore.SetParsedDicomFile(*modified);
+    }
 
     std::string modifiedInstance;
     if (context_.Store(modifiedInstance, toStore) != StoreStatus_Success)
@@ -307,9 +336,10 @@ namespace Orthanc
   {
     SetOfInstancesJob::GetPublicContent(value);
 
-    if (!targetStudy_.empty())
+    std::string targetStudy = GetTargetStudy();
+    if (!targetStudy.empty())
     {
-      value["TargetStudy"] = targetStudy_;
+      value["TargetStudy"] = targetStudy;
     }
     
     value["TargetStudyUID"] = targetStudyUid_;
@@ -360,7 +390,7 @@ namespace Orthanc
     {
       target[KEEP_SOURCE] = keepSource_;
       target[SOURCE_STUDY] = sourceStudy_;
-      target[TARGET_STUDY] = targetStudy_;
+      target[TARGET_STUDY] = GetTargetStudy();
       target[TARGET_STUDY_UID] = targetStudyUid_;
       SerializationToolbox::WriteMapOfStrings(target, seriesUidMap_, SERIES_UID_MAP);
       origin_.Serialize(target[ORIGIN]);
@@ -52,7 +52,8 @@ namespace Orthanc
     std::set<DicomTag>     allowedTags_;
     bool                   keepSource_;
     std::string            sourceStudy_;
-    std::string            targetStudy_;
+    mutable boost::mutex   targetStudyMutex_;
+    std::string            targetStudy_;   // Set by the first handled instance
     std::string            targetStudyUid_;
     SeriesUidMap           seriesUidMap_;
     DicomInstanceOrigin    origin_;
@@ -80,8 +81,9 @@ namespace Orthanc
       return sourceStudy_;
     }
 
-    const std::string& GetTargetStudy() const
+    std::string GetTargetStudy() const
     {
+      boost::mutex::scoped_lock lock(targetStudyMutex_);
       return targetStudy_;
     }
 
@@ -99,6 +101,9 @@ namespace Orthanc
     
     void SetKeepSource(bool keep);
 
+    // The instances can be modified concurrently (New in Orthanc 1.5.7)
+    using SetOfCommandsJob::SetMaxConcurrency;
+
     bool LookupTargetSeriesUid(std::string& uid,
                                const std::string& series) const;
 
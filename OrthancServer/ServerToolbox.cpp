@@ -35,13 +35,19 @@
 #include "ServerToolbox.h"
 
 #include "../Core/DicomFormat/DicomArray.h"
+#include "../Core/DicomParsing/Internals/DicomImageDecoder.h"
 #include "../Core/DicomParsing/ParsedDicomFile.h"
 #include "../Core/FileStorage/StorageAccessor.h"
+#include "../Core/Images/Image.h"
+#include "../Core/Images/ImageProcessing.h"
+#include "../Core/Images/JpegWriter.h"
 #include "../Core/Logging.h"
 #include "../Core/OrthancException.h"
 #include "Database/IDatabaseWrapper.h"
 #include "Database/ResourcesContent.h"
 #include "ServerContext.h"
+#include "SliceOrdering.h"
+#include "../Plugins/Engine/OrthancPlugins.h"
 
 #include <cassert>
 
@@ -440,16 +446,94 @@ namespace Orthanc
       for (std::list<std::string>::const_iterator 
              it = instances.begin(); it != instances.end(); ++it)
       {
-        ServerContext::DicomCacheLocker locker(context, *it);
+        // Only the tags are needed: Parse the file without its pixel
+        // data, and bypass the cache of parsed DICOM files that would
+        // be flushed by the reconstruction of a large resource
+        std::string content;
+        context.ReadDicom(content, *it);
+
+        std::auto_ptr<ParsedDicomFile> dicom
+          (ParsedDicomFile::CreateWithoutPixelData(content.empty() ? NULL : content.c_str(),
+                                                   content.size()));
+
+        std::string s;
+        context.EncodeDicomAsJson(s, *dicom);
+        context.AddAttachment(*it, FileContentType_DicomAsJson, s.c_str(), s.size());
 
-        Json::Value dicomAsJson;
-        locker.GetDicom().DatasetToJson(dicomAsJson);
+        context.GetIndex().ReconstructInstance(*dicom);
+      }
+    }
+  
 
-        std::string s = dicomAsJson.toStyledString();
-        context.AddAttachment(*it, FileContentType_DicomAsJson, s.c_str(), s.size());
+    void RenderSeriesThumbnail(std::string& jpeg,
+                               ServerContext& context,
+                               const std::string& seriesId,
+                               unsigned int size)
+    {
+      SliceOrdering ordering(context.GetIndex(), seriesId);
 
-        context.GetIndex().ReconstructInstance(locker.GetDicom());
+      if (ordering.GetInstancesCount() == 0)
+      {
+        throw OrthancException(ErrorCode_UnknownResource);
       }
+
+      // Use the middle slice, which is more representative of the
+      // series than its (often blank) first slice
+      const size_t index = ordering.GetInstancesCount() / 2;
+      const std::string& instance = ordering.GetInstanceId(index);
+      const unsigned int frame = ordering.GetFramesCount(index) / 2;
+
+      bool invert = false;
+      std::auto_ptr<ImageAccessor> decoded;
+
+      {
+        ServerContext::DicomCacheLocker locker(context, instance);
+
+        PhotometricInterpretation photometric;
+        if (locker.GetDicom().LookupPhotometricInterpretation(photometric))
+        {
+          invert = (photometric == PhotometricInterpretation_Monochrome1);
+        }
+
+#if ORTHANC_ENABLE_PLUGINS == 1
+        if (!context.HasPlugins() ||
+            !context.GetPlugins().HasCustomImageDecoder())
+#endif
+        {
+          decoded.reset(DicomImageDecoder::Decode(locker.GetDicom(), frame));
+        }
+      }
+
+#if ORTHANC_ENABLE_PLUGINS == 1
+      if (decoded.get() == NULL)
+      {
+        std::string dicom;
+        context.ReadDicom(dicom, instance);
+        decoded.reset(context.GetPlugins().Decode(dicom.c_str(), dicom.size(), frame));
+      }
+#endif
+
+      if (decoded.get() == NULL)
+      {
+        throw OrthancException(ErrorCode_NotImplemented);
+      }
+
+      DicomImageDecoder::ApplyExtractionMode(decoded, ImageExtractionMode_Preview, invert);
+
+      unsigned int width, height;
+      ImageProcessing::FitInside(width, height, decoded->GetWidth(), decoded->GetHeight(), size, size);
+
+      if (width != decoded->GetWidth() ||
+          height != decoded->GetHeight())
+      {
+        std::auto_ptr<ImageAccessor> resized(new Image(decoded->GetFormat(), width, height, false));
+        ImageProcessing::Resize(*resized, *decoded);
+        decoded = resized;
+      }
+
+      JpegWriter writer;
+      writer.SetQuality(90);
+      writer.WriteToMemory(jpeg, *decoded);
     }
   }
 }
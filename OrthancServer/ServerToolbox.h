@@ -71,5 +71,12 @@ namespace Orthanc
 
     void ReconstructResource(ServerContext& context,
                              const std::string& resource);
+
+    // Renders the middle frame of a series as a JPEG preview that
+    // fits inside a "size" x "size" box
+    void RenderSeriesThumbnail(std::string& jpeg,
+                               ServerContext& context,
+                               const std::string& seriesId,
+                               unsigned int size);
   }
 }
@@ -42,6 +42,8 @@
 #include <algorithm>
 #include <boost/lexical_cast.hpp>
 #include <boost/noncopyable.hpp>
+#include <json/reader.h>
+#include <json/writer.h>
 
 
 namespace Orthanc
@@ -164,6 +166,18 @@ namespace Orthanc
     unsigned int  framesCount_;
 
   public:
+    // Instance whose position in the series is already known
+    Instance(const std::string& instanceId,
+             unsigned int framesCount) :
+      instanceId_(instanceId),
+      hasPosition_(false),
+      hasNormal_(false),
+      hasIndexInSeries_(false),
+      indexInSeries_(0),
+      framesCount_(framesCount)
+    {
+    }
+
     Instance(ServerIndex& index,
              const std::string& instanceId) :
       instanceId_(instanceId),
@@ -396,12 +410,95 @@ namespace Orthanc
   }
 
 
+  static const char* const TYPE = "Type";
+  static const char* const INSTANCES = "Instances";
+
+
+  void SliceOrdering::Serialize(std::string& target) const
+  {
+    Json::Value value = Json::objectValue;
+    value[TYPE] = (isVolume_ ? "Volume" : "Sequence");
+
+    Json::Value instances = Json::arrayValue;
+    for (size_t i = 0; i < instances_.size(); i++)
+    {
+      Json::Value item = Json::arrayValue;
+      item.append(instances_[i]->GetIdentifier());
+      item.append(instances_[i]->GetFramesCount());
+      instances.append(item);
+    }
+
+    value[INSTANCES] = instances;
+
+    Json::FastWriter writer;
+    target = writer.write(value);
+  }
+
+
+  bool SliceOrdering::Unserialize(const std::string& source)
+  {
+    assert(instances_.empty());
+
+    Json::Value value;
+    Json::Reader reader;
+    if (!reader.parse(source, value) ||
+        value.type() != Json::objectValue ||
+        !value.isMember(TYPE) ||
+        !value.isMember(INSTANCES) ||
+        value[TYPE].type() != Json::stringValue ||
+        value[INSTANCES].type() != Json::arrayValue)
+    {
+      return false;
+    }
+
+    const Json::Value& instances = value[INSTANCES];
+
+    for (Json::Value::ArrayIndex i = 0; i < instances.size(); i++)
+    {
+      if (instances[i].type() != Json::arrayValue ||
+          instances[i].size() != 2 ||
+          instances[i][0].type() != Json::stringValue ||
+          (instances[i][1].type() != Json::intValue &&
+           instances[i][1].type() != Json::uintValue))
+      {
+        return false;
+      }
+    }
+
+    instances_.reserve(instances.size());
+    for (Json::Value::ArrayIndex i = 0; i < instances.size(); i++)
+    {
+      instances_.push_back(new Instance(instances[i][0].asString(), instances[i][1].asUInt()));
+    }
+
+    isVolume_ = (value[TYPE].asString() == "Volume");
+    return true;
+  }
+
+
   SliceOrdering::SliceOrdering(ServerIndex& index,
                                const std::string& seriesId) :
     index_(index),
     seriesId_(seriesId),
     isVolume_(false)
   {
+    std::string cached;
+    if (index_.LookupMetadata(cached, seriesId, MetadataType_Series_OrderedSlices))
+    {
+      if (Unserialize(cached))
+      {
+        return;
+      }
+      else
+      {
+        LOG(WARNING) << "Ignoring the invalid cached ordering of the slices of series " << seriesId;
+      }
+    }
+
+    // Read before listing the instances, in order to detect the
+    // deletions that would occur during the computation
+    const uint64_t epoch = index_.GetInvalidationEpoch(seriesId);
+
     ComputeNormal();
     CreateInstances();
 
@@ -411,6 +508,11 @@ namespace Orthanc
       throw OrthancException(ErrorCode_CannotOrderSlices,
                              "Unable to order the slices of series " + seriesId);
     }
+
+    // Cache the ordering, unless the instances have changed meanwhile
+    std::string s;
+    Serialize(s);
+    index_.SetMetadataIfStable(seriesId, MetadataType_Series_OrderedSlices, s, epoch);
   }
 
 
@@ -71,7 +71,15 @@ namespace Orthanc
 
     bool SortUsingIndexInSeries();
 
+    void Serialize(std::string& target) const;
+
+    bool Unserialize(const std::string& source);
+
   public:
+    // The ordering is read from the metadata "OrderedSlices" of the
+    // series if available. Otherwise, it is computed from the main
+    // DICOM tags of the instances, and cached as this metadata if
+    // the series is stable.
     SliceOrdering(ServerIndex& index,
                   const std::string& seriesId);
 
@@ -86,6 +94,12 @@ namespace Orthanc
 
     unsigned int GetFramesCount(size_t index) const;
 
+    // Whether the slices are sorted along their normal
+    bool IsVolume() const
+    {
+      return isVolume_;
+    }
+
     void Format(Json::Value& result) const;
   };
 }
@@ -1136,6 +1136,12 @@ static bool ConfigureServerContext(IDatabaseWrapper& database,
     context.SetCompressionEnabled(lock.GetConfiguration().GetBooleanParameter("StorageCompression", false));
     context.SetStoreMD5ForAttachments(lock.GetConfiguration().GetBooleanParameter("StoreMD5ForAttachments", true));
 
+    // New option in Orthanc 1.5.7
+    context.SetCompactDicomAsJson(lock.GetConfiguration().GetBooleanParameter("CompactDicomAsJson", false));
+
+    // New option in Orthanc 1.5.7
+    context.SetStoreDicomAsJson(lock.GetConfiguration().GetBooleanParameter("StoreDicomAsJson", true));
+
     // New option in Orthanc 1.4.2
     context.GetIndex().SetOverwriteInstances(lock.GetConfiguration().GetBooleanParameter("OverwriteInstances", false));
 
@@ -43,6 +43,7 @@
 #include "../../Core/OrthancException.h"
 #include "PluginsEnumerations.h"
 
+#include <algorithm>
 #include <cassert>
 
 namespace Orthanc
@@ -229,7 +230,9 @@ namespace Orthanc
     errorDictionary_(errorDictionary),
     backend_(backend),
     payload_(payload),
-    listener_(NULL)
+    listener_(NULL),
+    hasSortedIds_(false),
+    sortedIdsLevel_(ResourceType_Patient)
   {
     static const char* const MISSING = "  Missing extension in database index plugin: ";
     
@@ -522,6 +525,58 @@ namespace Orthanc
   }
 
 
+  void OrthancPluginDatabase::GetAllPublicIdsAfter(std::list<std::string>& target,
+                                                   ResourceType resourceType,
+                                                   const std::string& after,
+                                                   size_t limit)
+  {
+    // The database plugin SDK has no such primitive: Fallback
+    // implementation that pages on a sorted snapshot of the public
+    // IDs. The snapshot is only built once for a sequence of calls
+    // that walk over the same level, which is the case of the
+    // successive steps of the "ReconstructDerivedData" job.
+    target.clear();
+
+    if (limit == 0)
+    {
+      return;
+    }
+
+    if (!hasSortedIds_ ||
+        sortedIdsLevel_ != resourceType ||
+        sortedIdsCursor_ != after ||
+        after.empty())
+    {
+      std::list<std::string> tmp;
+      GetAllPublicIds(tmp, resourceType);
+
+      sortedIds_.assign(tmp.begin(), tmp.end());
+      std::sort(sortedIds_.begin(), sortedIds_.end());
+      sortedIdsLevel_ = resourceType;
+      hasSortedIds_ = true;
+    }
+
+    for (std::vector<std::string>::const_iterator
+           it = std::upper_bound(sortedIds_.begin(), sortedIds_.end(), after);
+         it != sortedIds_.end() && target.size() < limit; ++it)
+    {
+      target.push_back(*it);
+    }
+
+    if (target.size() < limit)
+    {
+      // The walk is over: Release the memory used by the snapshot
+      std::vector<std::string> empty;
+      sortedIds_.swap(empty);
+      hasSortedIds_ = false;
+    }
+    else
+    {
+      sortedIdsCursor_ = target.back();
+    }
+  }
+
+
 
   void OrthancPluginDatabase::GetChanges(std::list<ServerIndexChange>& target /*out*/,
                                          bool& done /*out*/,
@@ -41,6 +41,7 @@
 #include "../../OrthancServer/Database/Compatibility/ILookupResources.h"
 #include "../../OrthancServer/Database/Compatibility/ILookupResourceAndParent.h"
 #include "../../OrthancServer/Database/Compatibility/ISetResourcesContent.h"
+#include "../../OrthancServer/Database/Compatibility/IStoredJobs.h"
 #include "../Include/orthanc/OrthancCDatabasePlugin.h"
 #include "PluginsErrorDictionary.h"
 
@@ -52,7 +53,8 @@ namespace Orthanc
     public Compatibility::IGetChildrenMetadata,
     public Compatibility::ILookupResources,
     public Compatibility::ILookupResourceAndParent,
-    public Compatibility::ISetResourcesContent
+    public Compatibility::ISetResourcesContent,
+    public Compatibility::IStoredJobs
   {
   private:
     class Transaction;
@@ -85,6 +87,14 @@ namespace Orthanc
     std::list<std::string>*        answerMatchingInstances_;
     AnswerMetadata*                answerMetadata_;
 
+    // Snapshot of the sorted public IDs of one level, that is shared
+    // by the successive calls to "GetAllPublicIdsAfter()" (new in
+    // Orthanc 1.5.7)
+    bool                      hasSortedIds_;
+    ResourceType              sortedIdsLevel_;
+    std::vector<std::string>  sortedIds_;
+    std::string               sortedIdsCursor_;  // Last returned ID
+
     OrthancPluginDatabaseContext* GetContext()
     {
       return reinterpret_cast<OrthancPluginDatabaseContext*>(this);
@@ -178,6 +188,12 @@ namespace Orthanc
                                  size_t limit) 
       ORTHANC_OVERRIDE;
 
+    virtual void GetAllPublicIdsAfter(std::list<std::string>& target,
+                                      ResourceType resourceType,
+                                      const std::string& after,
+                                      size_t limit) 
+      ORTHANC_OVERRIDE;
+
     virtual void GetChanges(std::list<ServerIndexChange>& target /*out*/,
                             bool& done /*out*/,
                             int64_t since,
@@ -370,6 +386,21 @@ namespace Orthanc
                                          std::string& parentPublicId,
                                          const std::string& publicId)
       ORTHANC_OVERRIDE;
+
+    // The database plugin SDK has no such primitive: Fallback to the
+    // global property that was used by Orthanc <= 1.5.6
+    virtual void GetStoredJobs(std::map<std::string, std::string>& target)
+      ORTHANC_OVERRIDE
+    {
+      IStoredJobs::Load(*this, target);
+    }
+
+    virtual void UpdateStoredJobs(const std::map<std::string, std::string>& changed,
+                                  const std::set<std::string>& removed)
+      ORTHANC_OVERRIDE
+    {
+      IStoredJobs::Update(*this, changed, removed);
+    }
   };
 }
 
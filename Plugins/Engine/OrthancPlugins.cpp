@@ -3243,20 +3243,22 @@ namespace Orthanc
         DicomWebJsonVisitor visitor;
         visitor.SetFormatter(formatter);
 
-        {
-          ParsedDicomFile dicom(p.dicom, p.dicomSize);
-          dicom.Apply(visitor);
-        }
-
         std::string s;
 
-        if (service == _OrthancPluginService_EncodeDicomWebJson)
-        {
-          s = visitor.GetResult().toStyledString();
-        }
-        else
         {
-          visitor.FormatXml(s);
+          ParsedDicomFile dicom(p.dicom, p.dicomSize);
+
+          if (service == _OrthancPluginService_EncodeDicomWebJson)
+          {
+            visitor.OpenStream(s);
+            dicom.Apply(visitor);
+            visitor.CloseStream();
+          }
+          else
+          {
+            dicom.Apply(visitor);
+            visitor.FormatXml(s);
+          }
         }
         
         *p.target = CopyString(s);
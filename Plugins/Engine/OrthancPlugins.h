@@ -238,6 +238,11 @@ namespace Orthanc
       return true; // TODO Enable filtering of instances from plugins
     }
 
+    virtual bool IsSimplifiedTagsRequired()
+    {
+      return false;  // The plugins access the tags through "GetJson()"
+    }
+
     bool HasStorageArea() const;
 
     IStorageArea* CreateStorageArea();  // To be freed after use
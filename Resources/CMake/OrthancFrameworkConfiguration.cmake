@@ -128,6 +128,7 @@ set(ORTHANC_CORE_SOURCES_INTERNAL
   ${ORTHANC_ROOT}/Core/EnumerationDictionary.h
   ${ORTHANC_ROOT}/Core/Enumerations.cpp
   ${ORTHANC_ROOT}/Core/FileStorage/MemoryStorageArea.cpp
+  ${ORTHANC_ROOT}/Core/JsonStreamWriter.cpp
   ${ORTHANC_ROOT}/Core/Logging.cpp
   ${ORTHANC_ROOT}/Core/SerializationToolbox.cpp
   ${ORTHANC_ROOT}/Core/Toolbox.cpp
@@ -145,12 +146,16 @@ if (ENABLE_MODULE_IMAGES)
     ${ORTHANC_ROOT}/Core/Images/ImageProcessing.cpp
     ${ORTHANC_ROOT}/Core/Images/PamReader.cpp
     ${ORTHANC_ROOT}/Core/Images/PamWriter.cpp
+    ${ORTHANC_ROOT}/Core/Images/ParallelImageProcessing.cpp
+    ${ORTHANC_ROOT}/Core/Images/SimdKernels.cpp
     )
 endif()
 
 if (ENABLE_MODULE_DICOM)
   list(APPEND ORTHANC_CORE_SOURCES_INTERNAL
+    ${ORTHANC_ROOT}/Core/DicomFormat/CompactDicomAsJson.cpp
     ${ORTHANC_ROOT}/Core/DicomFormat/DicomArray.cpp
+    ${ORTHANC_ROOT}/Core/DicomFormat/DicomFrameOffsets.cpp
     ${ORTHANC_ROOT}/Core/DicomFormat/DicomImageInformation.cpp
     ${ORTHANC_ROOT}/Core/DicomFormat/DicomInstanceHasher.cpp
     ${ORTHANC_ROOT}/Core/DicomFormat/DicomIntegerPixelAccessor.cpp
@@ -35,7 +35,12 @@
 #include "gtest/gtest.h"
 
 #include "../OrthancServer/Search/DatabaseLookup.h"
+#include "../OrthancServer/Search/WildcardMatcher.h"
 #include "../Core/OrthancException.h"
+#include "../Core/Toolbox.h"
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/regex.hpp>
 
 using namespace Orthanc;
 
@@ -277,3 +282,122 @@ TEST(DatabaseLookup, FromDicom)
     ASSERT_FALSE(lookup.GetConstraint(1).IsMandatory());
   }
 }
+
+
+TEST(WildcardMatcher, Basic)
+{
+  ASSERT_TRUE(WildcardMatcher("", true).IsMatch(""));
+  ASSERT_FALSE(WildcardMatcher("", true).IsMatch("a"));
+  ASSERT_TRUE(WildcardMatcher("*", true).IsMatch(""));
+  ASSERT_TRUE(WildcardMatcher("*", true).IsMatch("abc"));
+  ASSERT_TRUE(WildcardMatcher("**", true).IsMatch("abc"));
+  ASSERT_TRUE(WildcardMatcher("?", true).IsMatch("a"));
+  ASSERT_FALSE(WildcardMatcher("?", true).IsMatch(""));
+  ASSERT_FALSE(WildcardMatcher("?", true).IsMatch("ab"));
+  ASSERT_TRUE(WildcardMatcher("abc", true).IsMatch("abc"));
+  ASSERT_FALSE(WildcardMatcher("abc", true).IsMatch("abcd"));
+  ASSERT_TRUE(WildcardMatcher("ab*", true).IsMatch("abcd"));
+  ASSERT_FALSE(WildcardMatcher("ab*", true).IsMatch("a"));
+  ASSERT_TRUE(WildcardMatcher("*cd", true).IsMatch("abcd"));
+  ASSERT_FALSE(WildcardMatcher("*cd", true).IsMatch("abcde"));
+  ASSERT_TRUE(WildcardMatcher("a*a", true).IsMatch("aa"));
+  ASSERT_FALSE(WildcardMatcher("a*a", true).IsMatch("a"));
+  ASSERT_TRUE(WildcardMatcher("*b?d*", true).IsMatch("abcde"));
+  ASSERT_TRUE(WildcardMatcher("*b?d*", true).IsMatch("abbxd"));
+  ASSERT_TRUE(WildcardMatcher("D*E^J*", true).IsMatch("DOE^JOHN"));
+  ASSERT_TRUE(WildcardMatcher("a.c", true).IsMatch("a.c"));
+  ASSERT_FALSE(WildcardMatcher("a.c", true).IsMatch("abc"));
+  ASSERT_TRUE(WildcardMatcher("(a)[b]\\", true).IsMatch("(a)[b]\\"));
+
+  ASSERT_FALSE(WildcardMatcher("d*e^j*", true).IsMatch("DOE^JOHN"));
+  ASSERT_TRUE(WildcardMatcher("d*e^j*", false).IsMatch("DOE^JOHN"));
+  ASSERT_TRUE(WildcardMatcher("D*E^J*", false).IsMatch("doe^john"));
+}
+
+
+TEST(WildcardMatcher, SameAsRegularExpression)
+{
+  // Compare with the former implementation, for random patterns
+  static const char ALPHABET[] = "ab*?";
+
+  unsigned int seed = 42;
+
+  for (unsigned int i = 0; i < 20000; i++)
+  {
+    std::string pattern, value;
+
+    seed = seed * 1103515245 + 12345;
+    const size_t patternLength = (seed >> 16) % 7;
+    for (size_t j = 0; j < patternLength; j++)
+    {
+      seed = seed * 1103515245 + 12345;
+      pattern.push_back(ALPHABET[(seed >> 16) % 4]);
+    }
+
+    seed = seed * 1103515245 + 12345;
+    const size_t valueLength = (seed >> 16) % 7;
+    for (size_t j = 0; j < valueLength; j++)
+    {
+      seed = seed * 1103515245 + 12345;
+      value.push_back(ALPHABET[(seed >> 16) % 2]);
+    }
+
+    boost::regex regex(Toolbox::WildcardToRegularExpression(pattern));
+    ASSERT_EQ(boost::regex_match(value, regex),
+              WildcardMatcher(pattern, true).IsMatch(value)) << pattern << " " << value;
+  }
+}
+
+
+TEST(WildcardMatcher, DISABLED_Benchmark)
+{
+  static const char* PATTERNS[] = { "DOE*", "*JOHN*", "D?E^J*N", "*^*^*", "SMITH^JANE" };
+  static const size_t COUNT = 1000000;
+
+  std::vector<std::string> values;
+  values.reserve(COUNT);
+
+  for (size_t i = 0; i < COUNT; i++)
+  {
+    char buffer[64];
+    sprintf(buffer, "%s^%s%u^M", (i % 3 == 0 ? "DOE" : "SMITH"), 
+            (i % 7 == 0 ? "JOHN" : "JANE"), static_cast<unsigned int>(i));
+    values.push_back(buffer);
+  }
+
+  for (size_t i = 0; i < sizeof(PATTERNS) / sizeof(const char*); i++)
+  {
+    size_t countRegex = 0, countMatcher = 0;
+
+    boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+    boost::regex regex(Toolbox::WildcardToRegularExpression(PATTERNS[i]));
+    for (size_t j = 0; j < COUNT; j++)
+    {
+      if (boost::regex_match(values[j], regex))
+      {
+        countRegex++;
+      }
+    }
+
+    boost::posix_time::ptime middle = boost::posix_time::microsec_clock::universal_time();
+
+    WildcardMatcher matcher(PATTERNS[i], true);
+    for (size_t j = 0; j < COUNT; j++)
+    {
+      if (matcher.IsMatch(values[j]))
+      {
+        countMatcher++;
+      }
+    }
+
+    boost::posix_time::ptime end = boost::posix_time::microsec_clock::universal_time();
+
+    ASSERT_EQ(countRegex, countMatcher);
+
+    printf("Pattern %-12s on %d values (%d matches): %d ms with regex, %d ms with WildcardMatcher\n",
+           PATTERNS[i], static_cast<int>(COUNT), static_cast<int>(countMatcher),
+           static_cast<int>((middle - start).total_milliseconds()),
+           static_cast<int>((end - middle).total_milliseconds()));
+  }
+}
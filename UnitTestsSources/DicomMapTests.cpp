@@ -35,15 +35,20 @@
 #include "gtest/gtest.h"
 
 #include "../Core/OrthancException.h"
+#include "../Core/DicomFormat/CompactDicomAsJson.h"
+#include "../Core/DicomFormat/DicomArray.h"
 #include "../Core/DicomFormat/DicomMap.h"
 #include "../Core/DicomParsing/FromDcmtkBridge.h"
 #include "../Core/DicomParsing/ToDcmtkBridge.h"
 #include "../Core/DicomParsing/ParsedDicomFile.h"
 #include "../Core/DicomParsing/DicomWebJsonVisitor.h"
+#include "../Core/JsonStreamWriter.h"
 
 #include "../OrthancServer/DicomInstanceToStore.h"
 
 #include <memory>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/lexical_cast.hpp>
 #include <dcmtk/dcmdata/dcdeftag.h>
 #include <dcmtk/dcmdata/dcvrat.h>
 
@@ -510,6 +515,400 @@ TEST(DicomMap, DicomAsJson)
 }
 
 
+TEST(DicomMap, PartialDicomAsJson)
+{
+  Json::Value json = Json::objectValue;
+  json["0008,0005"]["Name"] = "SpecificCharacterSet";
+  json["0008,0005"]["Type"] = "String";
+  json["0008,0005"]["Value"] = "ISO_IR 192";
+  json["0010,0010"]["Name"] = "PatientName";
+  json["0010,0010"]["Type"] = "String";
+  json["0010,0010"]["Value"] = "Hello \"World\" {[,]}";
+  json["0010,0020"]["Name"] = "PatientID";
+  json["0010,0020"]["Type"] = "TooLong";
+  json["0010,0020"]["Value"] = Json::nullValue;
+  json["0008,1030"]["Name"] = "StudyDescription";
+  json["0008,1030"]["Type"] = "String";
+  json["0008,1030"]["Value"] = "Study \\ \xc3\xa9";
+  json["0040,0100"]["Name"] = "ScheduledProcedureStepSequence";
+  json["0040,0100"]["Type"] = "Sequence";
+  json["0040,0100"]["Value"] = Json::arrayValue;
+  json["0040,0100"]["Value"].append(json["0008,0005"]);
+
+  std::set<DicomTag> tags;
+  tags.insert(DICOM_TAG_PATIENT_NAME);
+  tags.insert(DICOM_TAG_PATIENT_ID);
+  tags.insert(DICOM_TAG_STUDY_DESCRIPTION);
+  tags.insert(DICOM_TAG_SERIES_DESCRIPTION);   // Absent
+
+  DicomMap full;
+  full.FromDicomAsJson(json);
+  ASSERT_EQ(3u, full.GetSize());
+
+  for (unsigned int styled = 0; styled < 2; styled++)
+  {
+    Json::FastWriter writer;
+    const std::string s = (styled ? json.toStyledString() : writer.write(json));
+
+    DicomMap m;
+    m.FromDicomAsJson(s, tags);
+    ASSERT_EQ(2u, m.GetSize());
+    ASSERT_EQ(full.GetValue(DICOM_TAG_PATIENT_NAME).GetContent(),
+              m.GetValue(DICOM_TAG_PATIENT_NAME).GetContent());
+    ASSERT_EQ("Study \\ \xc3\xa9", m.GetValue(DICOM_TAG_STUDY_DESCRIPTION).GetContent());
+
+    std::set<DicomTag> one;
+    one.insert(DicomTag(0x0008, 0x0005));
+    m.FromDicomAsJson(s, one);
+    ASSERT_EQ(1u, m.GetSize());
+    ASSERT_EQ("ISO_IR 192", m.GetValue(0x0008, 0x0005).GetContent());
+  }
+
+  DicomMap m;
+  m.FromDicomAsJson("{}", tags);
+  ASSERT_EQ(0u, m.GetSize());
+  ASSERT_THROW(m.FromDicomAsJson("", tags), OrthancException);
+  ASSERT_THROW(m.FromDicomAsJson("{\"0010,0010\":", tags), OrthancException);
+  ASSERT_THROW(m.FromDicomAsJson("{\"nope\":{}}", tags), OrthancException);
+  ASSERT_THROW(m.FromDicomAsJson("{\"0008,0005\":{\"Type\":\"String\"", tags), OrthancException);
+}
+
+
+TEST(JsonStreamWriter, Basic)
+{
+  std::string s;
+
+  {
+    JsonStreamWriter writer(s);
+    ASSERT_FALSE(writer.IsComplete());
+    writer.StartObject();
+    ASSERT_FALSE(writer.IsComplete());
+    writer.WriteKey("a");
+    writer.WriteInteger(-42);
+    writer.WriteKey(std::string("b"));
+    writer.StartArray();
+    writer.WriteUnsignedInteger(42);
+    writer.WriteBoolean(true);
+    writer.WriteBoolean(false);
+    writer.WriteNull();
+    writer.WriteDouble(1.5);
+    writer.WriteDouble(2);
+    writer.StartObject();
+    writer.EndObject();
+    writer.StartArray();
+    writer.EndArray();
+    writer.EndArray();
+    writer.WriteKey("c");
+    writer.WriteString("hello");
+    writer.EndObject();
+    ASSERT_TRUE(writer.IsComplete());
+  }
+
+  ASSERT_EQ("{\"a\":-42,\"b\":[42,true,false,null,1.5,2.0,{},[]],\"c\":\"hello\"}", s);
+
+  Json::Value v;
+  Json::Reader reader;
+  ASSERT_TRUE(reader.parse(s, v));
+  ASSERT_EQ(-42, v["a"].asInt());
+  ASSERT_DOUBLE_EQ(2.0, v["b"][5].asDouble());
+}
+
+
+TEST(JsonStreamWriter, Escaping)
+{
+  std::string s;
+
+  {
+    JsonStreamWriter writer(s);
+    writer.StartArray();
+    writer.WriteString("a\"b\\c/d\ne\tf\r\x01");
+    writer.WriteString("S\xc3\xa9" "bastien");  // UTF-8 is kept as such
+    writer.WriteString(std::string("a\0b", 3));
+    writer.EndArray();
+  }
+
+  ASSERT_EQ("[\"a\\\"b\\\\c/d\\ne\\tf\\r\\u0001\",\"S\xc3\xa9" "bastien\",\"a\\u0000b\"]", s);
+
+  Json::Value v;
+  Json::Reader reader;
+  ASSERT_TRUE(reader.parse(s, v));
+  ASSERT_EQ("a\"b\\c/d\ne\tf\r\x01", v[0].asString());
+  ASSERT_EQ("S\xc3\xa9" "bastien", v[1].asString());
+}
+
+
+TEST(JsonStreamWriter, WriteValue)
+{
+  Json::Value source = Json::objectValue;
+  source["int"] = -3;
+  source["uint"] = 4000000000u;
+  source["real"] = 0.1;
+  source["string"] = "Hello \"World\"";
+  source["null"] = Json::nullValue;
+  source["array"] = Json::arrayValue;
+  source["array"].append(true);
+  source["array"].append(Json::objectValue);
+  source["array"][1]["nested"] = Json::arrayValue;
+  source["empty"] = Json::objectValue;
+
+  std::string s;
+
+  {
+    JsonStreamWriter writer(s);
+    writer.WriteValue(source);
+    ASSERT_TRUE(writer.IsComplete());
+  }
+
+  Json::Value target;
+  Json::Reader reader;
+  ASSERT_TRUE(reader.parse(s, target));
+  ASSERT_EQ(source, target);
+
+  Json::FastWriter fast;
+  Json::Value fromFast;
+  ASSERT_TRUE(reader.parse(fast.write(source), fromFast));
+  ASSERT_EQ(fromFast, target);
+}
+
+
+TEST(JsonStreamWriter, BadSequence)
+{
+  std::string s;
+  JsonStreamWriter writer(s);
+  ASSERT_THROW(writer.EndObject(), OrthancException);
+  ASSERT_THROW(writer.WriteKey("a"), OrthancException);
+
+  writer.StartObject();
+  ASSERT_THROW(writer.WriteInteger(1), OrthancException);  // Missing key
+  ASSERT_THROW(writer.EndArray(), OrthancException);
+  writer.WriteKey("a");
+  ASSERT_THROW(writer.WriteKey("b"), OrthancException);
+  ASSERT_THROW(writer.EndObject(), OrthancException);  // Missing value
+  writer.WriteInteger(1);
+  writer.EndObject();
+
+  ASSERT_THROW(writer.StartArray(), OrthancException);  // Already complete
+}
+
+
+static void CreateDicomAsJsonSample(Json::Value& target,
+                                    unsigned int countTags)
+{
+  target = Json::objectValue;
+
+  for (unsigned int i = 0; i < countTags; i++)
+  {
+    DicomTag tag(0x0009 + 2 * (i % 16), 0x1000 + i);
+    Json::Value& item = target[tag.Format()];
+    item["Name"] = "Tag" + boost::lexical_cast<std::string>(i % 7);
+
+    switch (i % 5)
+    {
+      case 0:
+        item["Type"] = "Null";
+        item["Value"] = Json::nullValue;
+        break;
+
+      case 1:
+        item["Type"] = "TooLong";
+        item["Value"] = Json::nullValue;
+        break;
+
+      case 2:
+        item["Type"] = "Binary";
+        item["Value"] = "data:application/octet-stream;base64,SGVsbG8=";
+        break;
+
+      default:
+        item["Type"] = "String";
+        item["Value"] = "Value \"" + boost::lexical_cast<std::string>(i) + "\" \xc3\xa9";
+        item["PrivateCreator"] = "Orthanc";
+        break;
+    }
+  }
+
+  Json::Value& sequence = target["0040,0100"];
+  sequence["Name"] = "ScheduledProcedureStepSequence";
+  sequence["Type"] = "Sequence";
+  sequence["Value"] = Json::arrayValue;
+
+  Json::Value item = Json::objectValue;
+  item["0008,0060"]["Name"] = "Modality";
+  item["0008,0060"]["Type"] = "String";
+  item["0008,0060"]["Value"] = "MR";
+  sequence["Value"].append(item);
+  sequence["Value"].append(Json::objectValue);
+  sequence["Value"].append(item);
+
+  target["0010,0010"]["Name"] = "PatientName";
+  target["0010,0010"]["Type"] = "String";
+  target["0010,0010"]["Value"] = "Hello^World";
+}
+
+
+TEST(CompactDicomAsJson, Basic)
+{
+  Json::Value source;
+  CreateDicomAsJsonSample(source, 100);
+
+  std::string compact;
+  ASSERT_TRUE(CompactDicomAsJson::Encode(compact, source));
+  ASSERT_TRUE(CompactDicomAsJson::IsCompact(compact));
+  ASSERT_FALSE(CompactDicomAsJson::IsCompact(source.toStyledString()));
+  ASSERT_FALSE(CompactDicomAsJson::IsCompact(""));
+  ASSERT_LT(compact.size(), source.toStyledString().size() / 2);
+
+  Json::Value decoded;
+  CompactDicomAsJson::Decode(decoded, compact);
+  ASSERT_EQ(source, decoded);
+
+  Json::Value parsed;
+  CompactDicomAsJson::Parse(parsed, compact);
+  ASSERT_EQ(source, parsed);
+  CompactDicomAsJson::Parse(parsed, source.toStyledString());
+  ASSERT_EQ(source, parsed);
+
+  // Same tags as with the JSON text
+  std::set<DicomTag> tags;
+  tags.insert(DICOM_TAG_PATIENT_NAME);
+  tags.insert(DicomTag(0x0040, 0x0100));  // Sequence
+  tags.insert(DicomTag(0x000f, 0x1003));  // String
+  tags.insert(DicomTag(0x000b, 0x1001));  // TooLong
+  tags.insert(DicomTag(0x000d, 0x1002));  // Binary
+  tags.insert(DICOM_TAG_SERIES_DESCRIPTION);  // Absent
+
+  DicomMap a, b, c;
+  CompactDicomAsJson::ExtractTags(a, compact, tags);
+  CompactDicomAsJson::ExtractTags(b, source.toStyledString(), tags);
+  c.FromDicomAsJson(source);
+
+  ASSERT_EQ(2u, a.GetSize());
+  ASSERT_EQ(2u, b.GetSize());
+  ASSERT_EQ("Hello^World", a.GetValue(DICOM_TAG_PATIENT_NAME).GetContent());
+  ASSERT_EQ(b.GetValue(0x000f, 0x1003).GetContent(), a.GetValue(0x000f, 0x1003).GetContent());
+  ASSERT_EQ(c.GetValue(0x000f, 0x1003).GetContent(), a.GetValue(0x000f, 0x1003).GetContent());
+
+  // Empty dataset
+  ASSERT_TRUE(CompactDicomAsJson::Encode(compact, Json::objectValue));
+  CompactDicomAsJson::Decode(decoded, compact);
+  ASSERT_EQ(Json::objectValue, decoded.type());
+  ASSERT_EQ(0u, decoded.size());
+}
+
+
+TEST(CompactDicomAsJson, Errors)
+{
+  Json::Value source;
+  CreateDicomAsJsonSample(source, 10);
+
+  std::string compact;
+
+  // Summaries that cannot be encoded are stored as JSON text
+  Json::Value v = source;
+  v["0010,0010"]["Type"] = "Unknown";
+  ASSERT_FALSE(CompactDicomAsJson::Encode(compact, v));
+
+  v = source;
+  v["0010,0010"]["Value"] = 42;
+  ASSERT_FALSE(CompactDicomAsJson::Encode(compact, v));
+
+  v = source;
+  v["0010,0010"]["Other"] = "Nope";
+  ASSERT_FALSE(CompactDicomAsJson::Encode(compact, v));
+
+  v = source;
+  v["PatientName"] = source["0010,0010"];  // Human format
+  ASSERT_FALSE(CompactDicomAsJson::Encode(compact, v));
+
+  ASSERT_FALSE(CompactDicomAsJson::Encode(compact, Json::arrayValue));
+
+  // Truncated or corrupted files
+  ASSERT_TRUE(CompactDicomAsJson::Encode(compact, source));
+
+  Json::Value decoded;
+  for (size_t size = 0; size < compact.size(); size += 7)
+  {
+    ASSERT_THROW(CompactDicomAsJson::Decode(decoded, compact.substr(0, size)), OrthancException);
+  }
+
+  for (size_t i = 16; i < compact.size(); i++)
+  {
+    std::string s = compact;
+    s[i] = static_cast<char>(0xff);
+
+    try
+    {
+      // Must not crash
+      CompactDicomAsJson::Decode(decoded, s);
+    }
+    catch (OrthancException&)
+    {
+    }
+  }
+
+  ASSERT_THROW(CompactDicomAsJson::Parse(decoded, "{"), OrthancException);
+}
+
+
+TEST(CompactDicomAsJson, DISABLED_Benchmark)
+{
+  Json::Value source;
+  CreateDicomAsJsonSample(source, 300);
+
+  const std::string text = source.toStyledString();
+
+  std::string compact;
+  ASSERT_TRUE(CompactDicomAsJson::Encode(compact, source));
+
+  std::set<DicomTag> tags;
+  DicomMap::GetMainDicomTags(tags);
+  tags.insert(DicomTag(0x000f, 0x1003));
+
+  printf("Size of the attachment: %d bytes as JSON text, %d bytes as compact binary\n",
+         static_cast<int>(text.size()), static_cast<int>(compact.size()));
+
+  const unsigned int repetitions = 1000;
+
+  for (unsigned int mode = 0; mode < 4; mode++)
+  {
+    boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+    for (unsigned int i = 0; i < repetitions; i++)
+    {
+      Json::Value json;
+      DicomMap map;
+
+      switch (mode)
+      {
+        case 0:
+          CompactDicomAsJson::Parse(json, text);
+          break;
+
+        case 1:
+          CompactDicomAsJson::Parse(json, compact);
+          break;
+
+        case 2:
+          CompactDicomAsJson::ExtractTags(map, text, tags);
+          break;
+
+        case 3:
+          CompactDicomAsJson::ExtractTags(map, compact, tags);
+          break;
+
+        default:
+          throw OrthancException(ErrorCode_InternalError);
+      }
+    }
+
+    boost::posix_time::time_duration duration = boost::posix_time::microsec_clock::universal_time() - start;
+
+    printf("%s from %s: %.2f us\n", (mode < 2 ? "Full tree" : "Lookup tags"),
+           (mode % 2 == 0 ? "JSON text" : "compact binary"),
+           static_cast<float>(duration.total_microseconds()) / static_cast<float>(repetitions));
+  }
+}
+
 
 TEST(DicomMap, ExtractMainDicomTags)
 {
@@ -556,6 +955,222 @@ TEST(DicomMap, ExtractMainDicomTags)
 }
 
 
+TEST(DicomMap, FlatStorage)
+{
+  DicomMap m;
+
+  // Insertion in decreasing order, and overwriting
+  m.SetValue(DICOM_TAG_SOP_INSTANCE_UID, "1.2.3", false);
+  m.SetValue(DICOM_TAG_PATIENT_ID, "A", false);
+  m.SetValue(DICOM_TAG_STUDY_INSTANCE_UID, "1.2", false);
+  m.SetNullValue(DICOM_TAG_PATIENT_NAME);
+  m.SetValue(DICOM_TAG_PATIENT_ID, "B", false);
+  m.SetValue(DICOM_TAG_PIXEL_DATA, std::string("\0\1", 2), true);
+  ASSERT_EQ(5u, m.GetSize());
+  ASSERT_EQ("B", m.GetValue(DICOM_TAG_PATIENT_ID).GetContent());
+  ASSERT_TRUE(m.GetValue(DICOM_TAG_PATIENT_NAME).IsNull());
+  ASSERT_TRUE(m.GetValue(DICOM_TAG_PIXEL_DATA).IsBinary());
+  ASSERT_EQ(2u, m.GetValue(DICOM_TAG_PIXEL_DATA).GetContent().size());
+  ASSERT_TRUE(m.TestAndGetValue(DICOM_TAG_SERIES_INSTANCE_UID) == NULL);
+
+  {
+    // The elements are sorted by tag
+    DicomArray a(m);
+    ASSERT_EQ(5u, a.GetSize());
+    for (size_t i = 1; i < a.GetSize(); i++)
+    {
+      ASSERT_TRUE(a.GetElement(i - 1).GetTag() < a.GetElement(i).GetTag());
+    }
+  }
+
+  // Setting a value that is stored in the same map
+  m.SetValue(DICOM_TAG_SERIES_INSTANCE_UID, m.GetValue(DICOM_TAG_STUDY_INSTANCE_UID));
+  ASSERT_EQ("1.2", m.GetValue(DICOM_TAG_SERIES_INSTANCE_UID).GetContent());
+
+  m.Remove(DICOM_TAG_PATIENT_NAME);
+  m.Remove(DICOM_TAG_PIXEL_DATA);
+  m.Remove(DICOM_TAG_PIXEL_DATA);
+  ASSERT_EQ(4u, m.GetSize());
+  ASSERT_FALSE(m.HasTag(DICOM_TAG_PATIENT_NAME));
+  ASSERT_EQ("B", m.GetValue(DICOM_TAG_PATIENT_ID).GetContent());
+  ASSERT_EQ("1.2.3", m.GetValue(DICOM_TAG_SOP_INSTANCE_UID).GetContent());
+
+  m.Merge(m);
+  ASSERT_EQ(4u, m.GetSize());
+
+  DicomMap n;
+  n.Assign(m);
+  m.Clear();
+  ASSERT_EQ(0u, m.GetSize());
+  ASSERT_EQ(4u, n.GetSize());
+  ASSERT_EQ("1.2.3", n.GetValue(DICOM_TAG_SOP_INSTANCE_UID).GetContent());
+
+  // Many tags, inserted in a pseudo-random order
+  for (unsigned int i = 0; i < 1000; i++)
+  {
+    uint16_t element = static_cast<uint16_t>((i * 7919) % 1000);
+    m.SetValue(0x0009, element, boost::lexical_cast<std::string>(element), false);
+  }
+
+  ASSERT_EQ(1000u, m.GetSize());
+  for (uint16_t i = 0; i < 1000; i++)
+  {
+    ASSERT_EQ(boost::lexical_cast<std::string>(i), m.GetValue(0x0009, i).GetContent());
+  }
+
+  for (uint16_t i = 0; i < 1000; i += 2)
+  {
+    m.Remove(DicomTag(0x0009, i));
+  }
+
+  ASSERT_EQ(500u, m.GetSize());
+  for (uint16_t i = 0; i < 1000; i++)
+  {
+    if (i % 2 == 0)
+    {
+      ASSERT_FALSE(m.HasTag(0x0009, i));
+    }
+    else
+    {
+      ASSERT_EQ(boost::lexical_cast<std::string>(i), m.GetValue(0x0009, i).GetContent());
+    }
+  }
+}
+
+
+namespace
+{
+  class DicomMapBenchmark : public boost::noncopyable
+  {
+  private:
+    std::vector<DicomTag>     tags_;
+    std::vector<std::string>  values_;
+    unsigned int              repetitions_;
+    boost::posix_time::ptime  start_;
+
+  public:
+    DicomMapBenchmark(unsigned int repetitions) :
+      repetitions_(repetitions)
+    {
+      // A typical summary: The main DICOM tags, plus other tags
+      std::set<DicomTag> tags;
+      DicomMap::GetMainDicomTags(tags);
+
+      for (uint16_t i = 0; i < 40; i++)
+      {
+        tags.insert(DicomTag(0x0018, 0x1000 + i));
+      }
+
+      for (std::set<DicomTag>::const_iterator it = tags.begin(); it != tags.end(); ++it)
+      {
+        tags_.push_back(*it);
+        values_.push_back("1.2.840.113619.2.55.3." + boost::lexical_cast<std::string>(values_.size()));
+      }
+    }
+
+    size_t GetTagsCount() const
+    {
+      return tags_.size();
+    }
+
+    unsigned int GetRepetitions() const
+    {
+      return repetitions_;
+    }
+
+    const DicomTag& GetTag(size_t i) const
+    {
+      return tags_[i];
+    }
+
+    void Fill(DicomMap& target) const
+    {
+      for (size_t i = 0; i < tags_.size(); i++)
+      {
+        target.SetValue(tags_[i], values_[i], false);
+      }
+    }
+
+    void FillReversed(DicomMap& target) const
+    {
+      for (size_t i = tags_.size(); i > 0; i--)
+      {
+        target.SetValue(tags_[i - 1], values_[i - 1], false);
+      }
+    }
+
+    void Start()
+    {
+      start_ = boost::posix_time::microsec_clock::universal_time();
+    }
+
+    void Stop(const char* operation) const
+    {
+      boost::posix_time::time_duration duration =
+        boost::posix_time::microsec_clock::universal_time() - start_;
+
+      printf("DicomMap with %d tags, %s: %.3f us\n", static_cast<int>(tags_.size()), operation,
+             static_cast<float>(duration.total_microseconds()) / static_cast<float>(repetitions_));
+    }
+  };
+}
+
+
+TEST(DicomMap, DISABLED_Benchmark)
+{
+  DicomMapBenchmark benchmark(100000);
+
+  benchmark.Start();
+  for (unsigned int i = 0; i < benchmark.GetRepetitions(); i++)
+  {
+    DicomMap m;
+    benchmark.Fill(m);
+  }
+  benchmark.Stop("construction in increasing order");
+
+  benchmark.Start();
+  for (unsigned int i = 0; i < benchmark.GetRepetitions(); i++)
+  {
+    DicomMap m;
+    benchmark.FillReversed(m);
+  }
+  benchmark.Stop("construction in decreasing order");
+
+  DicomMap source;
+  benchmark.Fill(source);
+
+  size_t found = 0;
+  benchmark.Start();
+  for (unsigned int i = 0; i < benchmark.GetRepetitions(); i++)
+  {
+    for (size_t j = 0; j < benchmark.GetTagsCount(); j++)
+    {
+      if (source.TestAndGetValue(benchmark.GetTag(j)) != NULL)
+      {
+        found++;
+      }
+    }
+  }
+  benchmark.Stop("lookup of all the tags");
+  ASSERT_EQ(found, benchmark.GetTagsCount() * benchmark.GetRepetitions());
+
+  benchmark.Start();
+  for (unsigned int i = 0; i < benchmark.GetRepetitions(); i++)
+  {
+    std::auto_ptr<DicomMap> copy(source.Clone());
+  }
+  benchmark.Stop("copy");
+
+  benchmark.Start();
+  for (unsigned int i = 0; i < benchmark.GetRepetitions(); i++)
+  {
+    DicomMap main;
+    main.ExtractMainDicomTags(source);
+  }
+  benchmark.Stop("extraction of the main DICOM tags");
+}
+
+
 
 TEST(DicomWebJson, Multiplicity)
 {
@@ -37,6 +37,7 @@
 #include <ctype.h>
 
 #include "../Core/FileStorage/FilesystemStorage.h"
+#include "../Core/FileStorage/MemoryStorageArea.h"
 #include "../Core/FileStorage/StorageAccessor.h"
 #include "../Core/HttpServer/BufferHttpSender.h"
 #include "../Core/HttpServer/FilesystemHttpSender.h"
@@ -163,6 +164,87 @@ TEST(StorageAccessor, Compression)
 }
 
 
+TEST(StorageAccessor, ReadRange)
+{
+  FilesystemStorage s("UnitTestsStorage");
+  StorageAccessor accessor(s);
+
+  std::string data = "Hello world";
+  FileInfo uncompressed = accessor.Write(data, FileContentType_Dicom, CompressionType_None, false);
+  FileInfo compressed = accessor.Write(data, FileContentType_Dicom, CompressionType_ZlibWithSize, false);
+
+  std::string r;
+  accessor.ReadRange(r, uncompressed, 6, 11);
+  ASSERT_EQ("world", r);
+  accessor.ReadRange(r, uncompressed, 3, 3);
+  ASSERT_TRUE(r.empty());
+
+  // Compressed files are read entirely, then cropped
+  accessor.ReadRange(r, compressed, 0, 5);
+  ASSERT_EQ("Hello", r);
+
+  ASSERT_THROW(accessor.ReadRange(r, uncompressed, 6, 12), OrthancException);
+  ASSERT_THROW(accessor.ReadRange(r, compressed, 5, 4), OrthancException);
+
+  MemoryStorageArea memory;
+  StorageAccessor memoryAccessor(memory);
+  FileInfo info = memoryAccessor.Write(data, FileContentType_Dicom, CompressionType_None, false);
+  memoryAccessor.ReadRange(r, info, 4, 7);
+  ASSERT_EQ("o w", r);
+}
+
+
+namespace
+{
+  // Storage area that only implements the mandatory primitives
+  class BasicStorageArea : public IStorageArea
+  {
+  private:
+    MemoryStorageArea  memory_;
+
+  public:
+    virtual void Create(const std::string& uuid,
+                        const void* content,
+                        size_t size,
+                        FileContentType type)
+    {
+      memory_.Create(uuid, content, size, type);
+    }
+
+    virtual void Read(std::string& content,
+                      const std::string& uuid,
+                      FileContentType type)
+    {
+      memory_.Read(content, uuid, type);
+    }
+
+    virtual void Remove(const std::string& uuid,
+                        FileContentType type)
+    {
+      memory_.Remove(uuid, type);
+    }
+  };
+}
+
+
+TEST(StorageAccessor, DefaultReadRange)
+{
+  BasicStorageArea area;
+  ASSERT_FALSE(area.HasReadRange());
+
+  area.Create("a", "Hello world", 11, FileContentType_Dicom);
+
+  std::string r;
+  area.ReadRange(r, "a", FileContentType_Dicom, 6, 11);
+  ASSERT_EQ("world", r);
+  area.ReadRange(r, "a", FileContentType_Dicom, 3, 3);
+  ASSERT_TRUE(r.empty());
+
+  ASSERT_THROW(area.ReadRange(r, "a", FileContentType_Dicom, 6, 12), OrthancException);
+  ASSERT_THROW(area.ReadRange(r, "a", FileContentType_Dicom, 5, 4), OrthancException);
+}
+
+
 TEST(StorageAccessor, Mix)
 {
   FilesystemStorage s("UnitTestsStorage");
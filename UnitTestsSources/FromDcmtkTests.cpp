@@ -34,6 +34,7 @@
 #include "PrecompiledHeadersUnitTests.h"
 #include "gtest/gtest.h"
 
+#include "../Core/DicomFormat/DicomFrameOffsets.h"
 #include "../Core/DicomNetworking/DicomFindAnswers.h"
 #include "../Core/DicomParsing/DicomModification.h"
 #include "../Core/DicomParsing/DicomWebJsonVisitor.h"
@@ -55,6 +56,9 @@
 #include <dcmtk/dcmdata/dcelem.h>
 #include <dcmtk/dcmdata/dcdeftag.h>
 #include <boost/algorithm/string/predicate.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread.hpp>
 
 #if ORTHANC_ENABLE_PUGIXML == 1
 #  include <pugixml.hpp>
@@ -155,6 +159,71 @@ TEST(DicomModification, Anonymization)
 }
 
 
+static void ApplyModificationThread(DicomModification* modification,
+                                    ParsedDicomFile* dicom)
+{
+  modification->Apply(*dicom);
+}
+
+
+TEST(DicomModification, Concurrency)
+{
+  DicomModification m;
+  m.SetupAnonymization(DicomVersion_2008);
+
+  std::vector<ParsedDicomFile*> files;
+  for (size_t i = 0; i < 16; i++)
+  {
+    files.push_back(new ParsedDicomFile(true));
+    files.back()->ReplacePlainString(DICOM_TAG_STUDY_INSTANCE_UID, "1.2.3");
+    files.back()->ReplacePlainString(DICOM_TAG_SERIES_INSTANCE_UID, (i % 2 == 0) ? "1.2.3.4" : "1.2.3.5");
+  }
+
+  boost::thread_group threads;
+  for (size_t i = 0; i < files.size(); i++)
+  {
+    threads.create_thread(boost::bind(ApplyModificationThread, &m, files[i]));
+  }
+
+  threads.join_all();
+
+  // The instances of the same study/series must share the same new
+  // identifiers, whatever the thread that has modified them
+  std::string study, series[2], s;
+
+  for (size_t i = 0; i < files.size(); i++)
+  {
+    ASSERT_TRUE(files[i]->GetTagValue(s, DICOM_TAG_STUDY_INSTANCE_UID));
+    ASSERT_NE("1.2.3", s);
+    if (i == 0)
+    {
+      study = s;
+    }
+    else
+    {
+      ASSERT_EQ(study, s);
+    }
+
+    ASSERT_TRUE(files[i]->GetTagValue(s, DICOM_TAG_SERIES_INSTANCE_UID));
+    if (i < 2)
+    {
+      series[i] = s;
+    }
+    else
+    {
+      ASSERT_EQ(series[i % 2], s);
+    }
+  }
+
+  ASSERT_NE(series[0], series[1]);
+
+  for (size_t i = 0; i < files.size(); i++)
+  {
+    delete files[i];
+  }
+}
+
+
 #include <dcmtk/dcmdata/dcuid.h>
 
 TEST(DicomModification, Png)
@@ -1870,3 +1939,525 @@ TEST(Toolbox, EncodingsSimplifiedChinese3)
   ASSERT_TRUE(lines[3].empty());
 }
 
+
+
+static void CreateMultiFrameInstance(std::string& dicom,
+                                     unsigned int width,
+                                     unsigned int height,
+                                     unsigned int frames)
+{
+  Image image(PixelFormat_Grayscale16, width, height * frames, false);
+  ImageProcessing::Set(image, 1024);
+
+  ParsedDicomFile f(true);
+  f.ReplacePlainString(DICOM_TAG_PATIENT_NAME, "Multi^Frame");
+  f.ReplacePlainString(DICOM_TAG_SERIES_DESCRIPTION, "Header only");
+  f.EmbedImage(image);
+  f.ReplacePlainString(DICOM_TAG_ROWS, boost::lexical_cast<std::string>(height));
+  f.ReplacePlainString(DICOM_TAG_NUMBER_OF_FRAMES, boost::lexical_cast<std::string>(frames));
+  f.SaveToMemoryBuffer(dicom);
+}
+
+
+TEST(ParsedDicomFile, WithoutPixelData)
+{
+  std::string dicom;
+  CreateMultiFrameInstance(dicom, 16, 8, 3);
+
+  ParsedDicomFile full(dicom);
+  std::auto_ptr<ParsedDicomFile> header
+    (ParsedDicomFile::CreateWithoutPixelData(dicom.c_str(), dicom.size()));
+
+  // The pixel data is replaced by an empty placeholder
+  DcmElement* element = NULL;
+  ASSERT_TRUE(header->GetDcmtkObject().getDataset()->findAndGetElement(DCM_PixelData, element).good());
+  ASSERT_TRUE(element != NULL);
+  ASSERT_EQ(0u, element->getLength());
+  ASSERT_LT(header->GetDcmtkObject().getDataset()->getLength(),
+            full.GetDcmtkObject().getDataset()->getLength());
+
+  // Same summary and same "DICOM-as-JSON" as with the full parsing
+  DicomMap a, b;
+  full.ExtractDicomSummary(a);
+  header->ExtractDicomSummary(b);
+  Json::Value sa, sb;
+  a.Serialize(sa);
+  b.Serialize(sb);
+  ASSERT_EQ(sa.toStyledString(), sb.toStyledString());
+  ASSERT_EQ("Multi^Frame", b.GetValue(DICOM_TAG_PATIENT_NAME).GetContent());
+  ASSERT_EQ("3", b.GetValue(DICOM_TAG_NUMBER_OF_FRAMES).GetContent());
+
+  Json::Value c, d;
+  full.DatasetToJson(c);
+  header->DatasetToJson(d);
+  ASSERT_EQ(c.toStyledString(), d.toStyledString());
+  ASSERT_EQ("Null", d["7fe0,0010"]["Type"].asString());
+
+  // A truncated file cannot be parsed
+  ASSERT_THROW(ParsedDicomFile::CreateWithoutPixelData(dicom.c_str(), 100), OrthancException);
+}
+
+
+TEST(ParsedDicomFile, HeaderWithRawPixelData)
+{
+  std::string dicom;
+  CreateMultiFrameInstance(dicom, 16, 8, 3);
+
+  uint64_t offset;
+  std::auto_ptr<ParsedDicomFile> header
+    (ParsedDicomFile::CreateHeader(offset, dicom.c_str(), dicom.size()));
+  ASSERT_TRUE(header.get() != NULL);
+  ASSERT_LT(offset, dicom.size());
+  ASSERT_FALSE(header->GetDcmtkObject().getDataset()->tagExists(DCM_PixelData));
+
+  header->ReplacePlainString(DICOM_TAG_SERIES_DESCRIPTION, "This is a longer description");
+  header->ReplacePlainString(DICOM_TAG_STUDY_INSTANCE_UID, "1.2.3.4");
+
+  std::string modified;
+  header->SaveHeaderWithRawPixelData(modified, dicom.c_str(), dicom.size(), offset);
+
+  // The pixel data of the resulting file is a verbatim copy
+  uint64_t modifiedOffset;
+  ASSERT_TRUE(DicomFrameOffsets::LookupPixelDataOffset(modifiedOffset, modified.c_str(), modified.size()));
+  ASSERT_EQ(dicom.size() - offset, modified.size() - modifiedOffset);
+  ASSERT_EQ(0, memcmp(dicom.c_str() + offset, modified.c_str() + modifiedOffset, dicom.size() - offset));
+
+  // The resulting file can be parsed by DCMTK, and is the same as
+  // if the whole file had been modified
+  ParsedDicomFile full(dicom);
+  full.ReplacePlainString(DICOM_TAG_SERIES_DESCRIPTION, "This is a longer description");
+  full.ReplacePlainString(DICOM_TAG_STUDY_INSTANCE_UID, "1.2.3.4");
+
+  std::string expected;
+  full.SaveToMemoryBuffer(expected);
+  ASSERT_EQ(expected, modified);
+
+  ParsedDicomFile reparsed(modified);
+  std::string s;
+  ASSERT_TRUE(reparsed.GetTagValue(s, DICOM_TAG_STUDY_INSTANCE_UID));
+  ASSERT_EQ("1.2.3.4", s);
+  ASSERT_EQ(3u, reparsed.GetFramesCount());
+
+  // Cannot be used with an object that contains pixel data
+  ASSERT_THROW(full.SaveHeaderWithRawPixelData(s, dicom.c_str(), dicom.size(), offset), OrthancException);
+}
+
+
+TEST(ParsedDicomFile, DISABLED_BenchmarkWithoutPixelData)
+{
+  static const unsigned int FRAMES = 200;
+
+  std::string dicom;
+  CreateMultiFrameInstance(dicom, 512, 512, FRAMES);
+
+  const unsigned int repetitions = 10;
+
+  for (unsigned int headerOnly = 0; headerOnly < 2; headerOnly++)
+  {
+    boost::posix_time::time_duration duration;
+    uint32_t memory = 0;
+
+    for (unsigned int i = 0; i < repetitions; i++)
+    {
+      boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+      std::auto_ptr<ParsedDicomFile> parsed;
+      if (headerOnly)
+      {
+        parsed.reset(ParsedDicomFile::CreateWithoutPixelData(dicom.c_str(), dicom.size()));
+      }
+      else
+      {
+        parsed.reset(new ParsedDicomFile(dicom));
+      }
+
+      DicomMap summary;
+      parsed->ExtractDicomSummary(summary);
+
+      Json::Value json;
+      parsed->DatasetToJson(json);
+
+      duration += boost::posix_time::microsec_clock::universal_time() - start;
+
+      // Size of the parsed dataset, which is held in memory
+      memory = parsed->GetDcmtkObject().getDataset()->getLength();
+    }
+
+    printf("%s parsing of a %u-frame instance of %.1f MB: %.3f ms, %.1f MB held in memory\n",
+           headerOnly ? "Header-only" : "Full", FRAMES,
+           static_cast<float>(dicom.size()) / (1024.0f * 1024.0f),
+           static_cast<float>(duration.total_microseconds()) / 1000.0f / static_cast<float>(repetitions),
+           static_cast<float>(memory) / (1024.0f * 1024.0f));
+  }
+}
+
+
+TEST(ParsedDicomFile, StreamedJson)
+{
+  Json::Value v;
+  v["SpecificCharacterSet"] = "ISO_IR 100";
+  v["PatientName"] = "S\xc3\xa9" "bastien \"Quote\"";
+  v["StudyDescription"] = "Line1\nLine2";
+  v["0040,0100"] = Json::arrayValue;  // ScheduledProcedureStepSequence
+
+  for (unsigned int i = 0; i < 3; i++)
+  {
+    Json::Value item;
+    item["Modality"] = (i == 1 ? "CT" : "MR");
+    item["0008,1140"] = Json::arrayValue;  // ReferencedImageSequence
+
+    if (i != 2)
+    {
+      Json::Value nested;
+      nested["ReferencedSOPInstanceUID"] = "1.2.3." + boost::lexical_cast<std::string>(i);
+      item["0008,1140"].append(nested);
+      item["0008,1140"].append(nested);
+    }
+    
+    v["0040,0100"].append(item);
+  }
+
+  std::auto_ptr<ParsedDicomFile> dicom
+    (ParsedDicomFile::CreateFromJson(v, static_cast<DicomFromJsonFlags>(DicomFromJsonFlags_GenerateIdentifiers)));
+
+  Json::Reader reader;
+
+  for (unsigned int format = 0; format < 3; format++)
+  {
+    DicomToJsonFormat f = (format == 0 ? DicomToJsonFormat_Full :
+                           format == 1 ? DicomToJsonFormat_Short : DicomToJsonFormat_Human);
+    Json::Value dom, parsed;
+    std::string streamed;
+    dicom->DatasetToJson(dom, f, DicomToJsonFlags_Default, 0);
+    dicom->DatasetToJson(streamed, f, DicomToJsonFlags_Default, 0);
+    ASSERT_TRUE(reader.parse(streamed, parsed));
+    ASSERT_EQ(dom, parsed);
+  }
+
+  {
+    // The "DICOM-as-JSON" format, with long strings
+    Json::Value dom, parsed;
+    std::string streamed;
+    dicom->DatasetToJson(dom, DicomToJsonFormat_Full, DicomToJsonFlags_Default, 4);
+    dicom->DatasetToJson(streamed, DicomToJsonFormat_Full, DicomToJsonFlags_Default, 4);
+    ASSERT_TRUE(reader.parse(streamed, parsed));
+    ASSERT_EQ(dom, parsed);
+    ASSERT_EQ("TooLong", parsed["0010,0010"]["Type"].asString());
+  }
+
+  {
+    // The DICOMweb JSON
+    DicomWebJsonVisitor a;
+    dicom->Apply(a);
+
+    DicomWebJsonVisitor b;
+    std::string streamed;
+    b.OpenStream(streamed);
+    dicom->Apply(b);
+    b.CloseStream();
+
+    Json::Value parsed;
+    ASSERT_TRUE(reader.parse(streamed, parsed));
+    ASSERT_EQ(a.GetResult(), parsed);
+    ASSERT_EQ(3u, parsed["00400100"]["Value"].size());
+    ASSERT_EQ(2u, parsed["00400100"]["Value"][0]["00081140"]["Value"].size());
+    ASSERT_FALSE(parsed["00400100"]["Value"][2]["00081140"].isMember("Value"));
+  }
+
+  {
+    // Partial extraction of a "DICOM-as-JSON" summary
+    std::string streamed;
+    dicom->DatasetToJson(streamed);
+
+    std::set<DicomTag> tags;
+    tags.insert(DICOM_TAG_PATIENT_NAME);
+    tags.insert(DICOM_TAG_STUDY_DESCRIPTION);
+    tags.insert(DicomTag(0x0040, 0x0100));  // Sequences are ignored
+
+    DicomMap m;
+    m.FromDicomAsJson(streamed, tags);
+    ASSERT_EQ(2u, m.GetSize());
+    ASSERT_EQ("S\xc3\xa9" "bastien \"Quote\"", m.GetValue(DICOM_TAG_PATIENT_NAME).GetContent());
+    ASSERT_EQ("Line1\nLine2", m.GetValue(DICOM_TAG_STUDY_DESCRIPTION).GetContent());
+  }
+}
+
+
+namespace
+{
+  // Helpers to forge raw DICOM streams, in little endian
+  class DicomStreamWriter
+  {
+  private:
+    std::string  buffer_;
+
+  public:
+    DicomStreamWriter(const std::string& transferSyntax)
+    {
+      buffer_.assign(128, '\0');
+      buffer_ += "DICM";
+
+      std::string uid = transferSyntax;
+      if (uid.size() % 2 != 0)
+      {
+        uid.push_back('\0');
+      }
+
+      AddExplicit(0x0002, 0x0010, "UI", uid);
+    }
+
+    void AddUInt16(uint16_t value)
+    {
+      buffer_.push_back(static_cast<char>(value & 0xff));
+      buffer_.push_back(static_cast<char>(value >> 8));
+    }
+
+    void AddUInt32(uint32_t value)
+    {
+      AddUInt16(static_cast<uint16_t>(value & 0xffff));
+      AddUInt16(static_cast<uint16_t>(value >> 16));
+    }
+
+    void AddTag(uint16_t group,
+                uint16_t element)
+    {
+      AddUInt16(group);
+      AddUInt16(element);
+    }
+
+    void AddExplicit(uint16_t group,
+                     uint16_t element,
+                     const std::string& vr,
+                     const std::string& value)
+    {
+      AddTag(group, element);
+      buffer_ += vr;
+
+      if (vr == "OB" || vr == "OW" || vr == "SQ" || vr == "UN" || vr == "UT")
+      {
+        AddUInt16(0);
+        AddUInt32(static_cast<uint32_t>(value.size()));
+      }
+      else
+      {
+        AddUInt16(static_cast<uint16_t>(value.size()));
+      }
+
+      buffer_ += value;
+    }
+
+    void AddImplicit(uint16_t group,
+                     uint16_t element,
+                     const std::string& value)
+    {
+      AddTag(group, element);
+      AddUInt32(static_cast<uint32_t>(value.size()));
+      buffer_ += value;
+    }
+
+    void AddRaw(const std::string& value)
+    {
+      buffer_ += value;
+    }
+
+    size_t GetSize() const
+    {
+      return buffer_.size();
+    }
+
+    const std::string& GetBuffer() const
+    {
+      return buffer_;
+    }
+  };
+}
+
+
+TEST(DicomFrameOffsets, Uncompressed)
+{
+  DicomStreamWriter w("1.2.840.10008.1.2.1");
+  w.AddExplicit(0x0008, 0x0016, "UI", "1.2.3.4.");
+
+  // Sequence and item of undefined lengths, that must be skipped
+  w.AddTag(0x0008, 0x1115);
+  w.AddRaw(std::string("SQ\0\0", 4));
+  w.AddUInt32(0xffffffffu);
+  w.AddTag(0xfffe, 0xe000);
+  w.AddUInt32(0xffffffffu);
+  w.AddExplicit(0x0008, 0x1155, "UI", "1.2.");
+  w.AddTag(0xfffe, 0xe00d);
+  w.AddUInt32(0);
+  w.AddTag(0xfffe, 0xe0dd);
+  w.AddUInt32(0);
+
+  w.AddExplicit(0x0028, 0x0010, "US", std::string("\x02\x00", 2));
+
+  const size_t pixelData = w.GetSize() + 12;
+  w.AddExplicit(0x7fe0, 0x0010, "OW", "abcdefgh");
+
+  DicomFrameOffsets offsets;
+  ASSERT_TRUE(offsets.Compute(w.GetBuffer().c_str(), w.GetSize(), 2, 4));
+  ASSERT_EQ(2u, offsets.GetFramesCount());
+  ASSERT_EQ(MimeType_Binary, offsets.GetMimeType());
+
+  uint64_t start, end;
+  offsets.GetFrameRange(start, end, 1);
+  ASSERT_EQ(pixelData + 4, start);
+  ASSERT_EQ(pixelData + 8, end);
+  ASSERT_THROW(offsets.GetFrameRange(start, end, 2), OrthancException);
+
+  std::string frame;
+  offsets.ExtractFrame(frame, w.GetBuffer(), 0, 0);
+  ASSERT_EQ("abcd", frame);
+  offsets.ExtractFrame(frame, w.GetBuffer().substr(start, end - start), start, 1);
+  ASSERT_EQ("efgh", frame);
+
+  std::string s;
+  offsets.Serialize(s);
+
+  DicomFrameOffsets unserialized;
+  unserialized.Unserialize(s);
+  ASSERT_EQ(2u, unserialized.GetFramesCount());
+  unserialized.ExtractFrame(frame, w.GetBuffer(), 0, 1);
+  ASSERT_EQ("efgh", frame);
+
+  // The pixel data is too small for 3 frames
+  ASSERT_FALSE(offsets.Compute(w.GetBuffer().c_str(), w.GetSize(), 3, 4));
+  ASSERT_EQ(0u, offsets.GetFramesCount());
+
+  // Truncated file
+  ASSERT_FALSE(offsets.Compute(w.GetBuffer().c_str(), w.GetSize() - 10, 2, 4));
+  ASSERT_FALSE(offsets.Compute(w.GetBuffer().c_str(), 100, 2, 4));
+}
+
+
+TEST(DicomFrameOffsets, ImplicitVR)
+{
+  DicomStreamWriter w("1.2.840.10008.1.2");
+  w.AddImplicit(0x0008, 0x0016, "1.2.3.4.");
+  w.AddImplicit(0x7fe0, 0x0010, "abcdef");
+
+  DicomFrameOffsets offsets;
+  ASSERT_TRUE(offsets.Compute(w.GetBuffer().c_str(), w.GetSize(), 3, 2));
+
+  std::string frame;
+  offsets.ExtractFrame(frame, w.GetBuffer(), 0, 2);
+  ASSERT_EQ("ef", frame);
+
+  // Unsupported transfer syntaxes
+  DicomStreamWriter deflated("1.2.840.10008.1.2.1.99");
+  deflated.AddImplicit(0x7fe0, 0x0010, "abcdef");
+  ASSERT_FALSE(offsets.Compute(deflated.GetBuffer().c_str(), deflated.GetSize(), 3, 2));
+
+  DicomStreamWriter bigEndian("1.2.840.10008.1.2.2");
+  bigEndian.AddImplicit(0x7fe0, 0x0010, "abcdef");
+  ASSERT_FALSE(offsets.Compute(bigEndian.GetBuffer().c_str(), bigEndian.GetSize(), 3, 2));
+
+  // No pixel data
+  DicomStreamWriter empty("1.2.840.10008.1.2");
+  empty.AddImplicit(0x0008, 0x0016, "1.2.3.4.");
+  ASSERT_FALSE(offsets.Compute(empty.GetBuffer().c_str(), empty.GetSize(), 1, 2));
+}
+
+
+TEST(DicomFrameOffsets, Encapsulated)
+{
+  DicomStreamWriter w("1.2.840.10008.1.2.4.50");
+  w.AddTag(0x7fe0, 0x0010);
+  w.AddRaw(std::string("OB\0\0", 4));
+  w.AddUInt32(0xffffffffu);
+
+  // Basic offset table: The first frame is made of 2 fragments
+  w.AddTag(0xfffe, 0xe000);
+  w.AddUInt32(8);
+  w.AddUInt32(0);
+  w.AddUInt32(8 + 4 + 8 + 2);
+
+  w.AddTag(0xfffe, 0xe000);
+  w.AddUInt32(4);
+  w.AddRaw("abcd");
+  w.AddTag(0xfffe, 0xe000);
+  w.AddUInt32(2);
+  w.AddRaw("ef");
+  w.AddTag(0xfffe, 0xe000);
+  w.AddUInt32(6);
+  w.AddRaw("ghijkl");
+  w.AddTag(0xfffe, 0xe0dd);
+  w.AddUInt32(0);
+
+  DicomFrameOffsets offsets;
+  ASSERT_TRUE(offsets.Compute(w.GetBuffer().c_str(), w.GetSize(), 2, 0));
+  ASSERT_EQ(2u, offsets.GetFramesCount());
+  ASSERT_EQ(MimeType_Jpeg, offsets.GetMimeType());
+
+  uint64_t start, end;
+  std::string frame;
+
+  offsets.GetFrameRange(start, end, 0);
+  ASSERT_EQ(4u + 8u + 2u, end - start);  // The header of the 2nd fragment is in the range
+  offsets.ExtractFrame(frame, w.GetBuffer().substr(start, end - start), start, 0);
+  ASSERT_EQ("abcdef", frame);
+
+  offsets.GetFrameRange(start, end, 1);
+  offsets.ExtractFrame(frame, w.GetBuffer().substr(start, end - start), start, 1);
+  ASSERT_EQ("ghijkl", frame);
+  ASSERT_THROW(offsets.ExtractFrame(frame, w.GetBuffer().substr(start, 2), start, 1), OrthancException);
+
+  std::string s;
+  offsets.Serialize(s);
+
+  DicomFrameOffsets unserialized;
+  unserialized.Unserialize(s);
+  ASSERT_EQ(MimeType_Jpeg, unserialized.GetMimeType());
+  ASSERT_EQ(2u, unserialized.GetFramesCount());
+  unserialized.ExtractFrame(frame, w.GetBuffer(), 0, 0);
+  ASSERT_EQ("abcdef", frame);
+
+  // One fragment per frame
+  ASSERT_TRUE(offsets.Compute(w.GetBuffer().c_str(), w.GetSize(), 3, 0));
+  offsets.ExtractFrame(frame, w.GetBuffer(), 0, 1);
+  ASSERT_EQ("ef", frame);
+
+  // All the fragments for a single frame
+  ASSERT_TRUE(offsets.Compute(w.GetBuffer().c_str(), w.GetSize(), 1, 0));
+  offsets.ExtractFrame(frame, w.GetBuffer(), 0, 0);
+  ASSERT_EQ("abcdefghijkl", frame);
+
+  // Not enough fragments
+  ASSERT_FALSE(offsets.Compute(w.GetBuffer().c_str(), w.GetSize(), 4, 0));
+
+  ASSERT_THROW(unserialized.Unserialize("nope"), OrthancException);
+  ASSERT_THROW(unserialized.Unserialize("{\"MimeType\":\"image/jpeg\"}"), OrthancException);
+}
+
+
+TEST(DicomFrameOffsets, LookupPixelDataOffset)
+{
+  DicomStreamWriter w("1.2.840.10008.1.2.1");
+  w.AddExplicit(0x0008, 0x0016, "UI", "1.2.3.4.");
+
+  const size_t pixelData = w.GetSize();
+  w.AddExplicit(0x7fe0, 0x0010, "OW", "abcdefgh");
+  w.AddExplicit(0xfffc, 0xfffc, "OB", "pa");  // Trailing padding
+
+  uint64_t offset;
+  ASSERT_TRUE(DicomFrameOffsets::LookupPixelDataOffset(offset, w.GetBuffer().c_str(), w.GetSize()));
+  ASSERT_EQ(pixelData, offset);
+
+  DicomStreamWriter implicit("1.2.840.10008.1.2");
+  implicit.AddImplicit(0x0008, 0x0016, "1.2.3.4.");
+  implicit.AddImplicit(0x7fe0, 0x0010, "abcdef");
+  ASSERT_TRUE(DicomFrameOffsets::LookupPixelDataOffset(offset, implicit.GetBuffer().c_str(), implicit.GetSize()));
+  ASSERT_EQ(implicit.GetSize() - 8 - 6, offset);
+
+  DicomStreamWriter bigEndian("1.2.840.10008.1.2.2");
+  bigEndian.AddImplicit(0x7fe0, 0x0010, "abcdef");
+  ASSERT_FALSE(DicomFrameOffsets::LookupPixelDataOffset(offset, bigEndian.GetBuffer().c_str(), bigEndian.GetSize()));
+
+  DicomStreamWriter empty("1.2.840.10008.1.2");
+  empty.AddImplicit(0x0008, 0x0016, "1.2.3.4.");
+  ASSERT_FALSE(DicomFrameOffsets::LookupPixelDataOffset(offset, empty.GetBuffer().c_str(), empty.GetSize()));
+
+  ASSERT_FALSE(DicomFrameOffsets::LookupPixelDataOffset(offset, w.GetBuffer().c_str(), 100));
+  ASSERT_FALSE(DicomFrameOffsets::LookupPixelDataOffset(offset, NULL, 0));
+}
@@ -38,6 +38,11 @@
 #include "../Core/Images/Image.h"
 #include "../Core/Images/ImageProcessing.h"
 #include "../Core/Images/ImageTraits.h"
+#include "../Core/Images/ParallelImageProcessing.h"
+#include "../Core/Images/SimdKernels.h"
+#include "../Core/OrthancException.h"
+
+#include <boost/date_time/posix_time/posix_time.hpp>
 
 #include <memory>
 
@@ -223,3 +228,712 @@ TYPED_TEST(TestIntegerImageTraits, FillPolygon)
   ASSERT_FLOAT_EQ(255, TestFixture::ImageTraits::GetFloatPixel(image, 1, 2));
   ASSERT_FLOAT_EQ(255, TestFixture::ImageTraits::GetFloatPixel(image, 2, 4));
 }
+
+
+
+namespace
+{
+  // Restores the default instruction set at the end of a test
+  class SimdInstructionSetRestorer : public boost::noncopyable
+  {
+  private:
+    SimdInstructionSet  instructionSet_;
+
+  public:
+    SimdInstructionSetRestorer() :
+      instructionSet_(SimdKernels::GetInstructionSet())
+    {
+    }
+
+    ~SimdInstructionSetRestorer()
+    {
+      SimdKernels::SetInstructionSet(instructionSet_);
+    }
+  };
+}
+
+
+static void FillRandom(ImageAccessor& image,
+                       uint32_t seed)
+{
+  const unsigned int size = image.GetBytesPerPixel() * image.GetWidth();
+
+  for (unsigned int y = 0; y < image.GetHeight(); y++)
+  {
+    uint8_t* p = reinterpret_cast<uint8_t*>(image.GetRow(y));
+
+    for (unsigned int x = 0; x < size; x++, p++)
+    {
+      seed = seed * 1103515245u + 12345u;  // Linear congruential generator
+      *p = static_cast<uint8_t>(seed >> 16);
+    }
+  }
+}
+
+
+static bool IsSameImage(const ImageAccessor& a,
+                        const ImageAccessor& b)
+{
+  if (a.GetFormat() != b.GetFormat() ||
+      a.GetWidth() != b.GetWidth() ||
+      a.GetHeight() != b.GetHeight())
+  {
+    return false;
+  }
+
+  for (unsigned int y = 0; y < a.GetHeight(); y++)
+  {
+    if (memcmp(a.GetConstRow(y), b.GetConstRow(y), a.GetBytesPerPixel() * a.GetWidth()) != 0)
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+namespace
+{
+  enum SimdOperation
+  {
+    SimdOperation_ShiftScale,
+    SimdOperation_MultiplyConstant,
+    SimdOperation_AddConstant,
+    SimdOperation_Invert
+  };
+}
+
+
+static void ApplySimdOperation(ImageAccessor& target,
+                               const ImageAccessor& source,
+                               SimdInstructionSet instructionSet,
+                               SimdOperation operation,
+                               float a,
+                               float b,
+                               bool useRound)
+{
+  SimdKernels::SetInstructionSet(instructionSet);
+  ImageProcessing::Copy(target, source);
+
+  switch (operation)
+  {
+    case SimdOperation_ShiftScale:
+      ImageProcessing::ShiftScale(target, a, b, useRound);
+      break;
+
+    case SimdOperation_MultiplyConstant:
+      ImageProcessing::MultiplyConstant(target, a, useRound);
+      break;
+
+    case SimdOperation_AddConstant:
+      ImageProcessing::AddConstant(target, static_cast<int64_t>(a));
+      break;
+
+    case SimdOperation_Invert:
+      ImageProcessing::Invert(target, static_cast<int64_t>(a));
+      break;
+
+    default:
+      throw OrthancException(ErrorCode_ParameterOutOfRange);
+  }
+}
+
+
+static bool CheckSimdOperation(const ImageAccessor& source,
+                               SimdInstructionSet instructionSet,
+                               SimdOperation operation,
+                               float a,
+                               float b = 0,
+                               bool useRound = false)
+{
+  Image expected(source.GetFormat(), source.GetWidth(), source.GetHeight(), false);
+  Image actual(source.GetFormat(), source.GetWidth(), source.GetHeight(), false);
+  ApplySimdOperation(expected, source, SimdInstructionSet_None, operation, a, b, useRound);
+  ApplySimdOperation(actual, source, instructionSet, operation, a, b, useRound);
+  return IsSameImage(expected, actual);
+}
+
+
+TEST(SimdKernels, Equivalence)
+{
+  SimdInstructionSetRestorer restorer;
+
+  ASSERT_THROW(SimdKernels::SetInstructionSet(static_cast<SimdInstructionSet>(
+                 static_cast<int>(SimdInstructionSet_AVX2) + 1)), OrthancException);
+
+  const PixelFormat formats[] = {
+    PixelFormat_Grayscale8,
+    PixelFormat_Grayscale16,
+    PixelFormat_SignedGrayscale16
+  };
+
+  const float shiftScale[][2] = {
+    { 0.0f, 1.0f },
+    { -100.5f, 0.37f },
+    { 1000.0f, -2.25f },
+    { 32768.0f, 1.0f / 257.0f },
+    { -1024.0f, 255.0f / 4095.0f },
+    { 0.5f, 0.5f }
+  };
+
+  const float factors[] = { 0.0f, 0.5f, 1.0f, 2.7f, -1.3f, 300.0f };
+
+  const float constants[] = { -70000.0f, -40000.0f, -300.0f, -1.0f, 0.0f, 1.0f, 200.0f, 40000.0f, 70000.0f };
+
+  const float invert[] = { 0.0f, 100.0f, 255.0f, 4095.0f, 65535.0f };
+
+  for (int i = static_cast<int>(SimdInstructionSet_None) + 1;
+       i <= static_cast<int>(SimdKernels::GetSupportedInstructionSet()); i++)
+  {
+    SimdInstructionSet instructionSet = static_cast<SimdInstructionSet>(i);
+
+    for (size_t f = 0; f < sizeof(formats) / sizeof(PixelFormat); f++)
+    {
+      // Odd width, so that the scalar tail of the rows is tested
+      Image source(formats[f], 67, 5, false);
+      FillRandom(source, 42 + f);
+
+      {
+        int64_t expectedMin, expectedMax, actualMin, actualMax;
+        SimdKernels::SetInstructionSet(SimdInstructionSet_None);
+        ImageProcessing::GetMinMaxIntegerValue(expectedMin, expectedMax, source);
+        SimdKernels::SetInstructionSet(instructionSet);
+        ImageProcessing::GetMinMaxIntegerValue(actualMin, actualMax, source);
+        ASSERT_EQ(expectedMin, actualMin);
+        ASSERT_EQ(expectedMax, actualMax);
+      }
+
+      for (size_t j = 0; j < sizeof(shiftScale) / sizeof(shiftScale[0]); j++)
+      {
+        ASSERT_TRUE(CheckSimdOperation(source, instructionSet, SimdOperation_ShiftScale,
+                                       shiftScale[j][0], shiftScale[j][1], true));
+        ASSERT_TRUE(CheckSimdOperation(source, instructionSet, SimdOperation_ShiftScale,
+                                       shiftScale[j][0], shiftScale[j][1], false));
+      }
+
+      for (size_t j = 0; j < sizeof(factors) / sizeof(float); j++)
+      {
+        ASSERT_TRUE(CheckSimdOperation(source, instructionSet, SimdOperation_MultiplyConstant, factors[j], 0, true));
+        ASSERT_TRUE(CheckSimdOperation(source, instructionSet, SimdOperation_MultiplyConstant, factors[j], 0, false));
+      }
+
+      for (size_t j = 0; j < sizeof(constants) / sizeof(float); j++)
+      {
+        ASSERT_TRUE(CheckSimdOperation(source, instructionSet, SimdOperation_AddConstant, constants[j]));
+      }
+
+      if (formats[f] != PixelFormat_SignedGrayscale16)
+      {
+        for (size_t j = 0; j < sizeof(invert) / sizeof(float); j++)
+        {
+          ASSERT_TRUE(CheckSimdOperation(source, instructionSet, SimdOperation_Invert, invert[j]));
+        }
+      }
+
+      for (size_t g = 0; g < sizeof(formats) / sizeof(PixelFormat); g++)
+      {
+        Image expected(formats[g], source.GetWidth(), source.GetHeight(), false);
+        Image actual(formats[g], source.GetWidth(), source.GetHeight(), false);
+
+        SimdKernels::SetInstructionSet(SimdInstructionSet_None);
+        ImageProcessing::Convert(expected, source);
+        SimdKernels::SetInstructionSet(instructionSet);
+        ImageProcessing::Convert(actual, source);
+        ASSERT_TRUE(IsSameImage(expected, actual));
+      }
+    }
+  }
+}
+
+
+TEST(SimdKernels, Rounding)
+{
+  SimdInstructionSetRestorer restorer;
+
+  // Halfway values must be rounded away from zero, both in the
+  // vectorized part and in the scalar tail of the row
+  Image image(PixelFormat_SignedGrayscale16, 20, 1, false);
+
+  for (unsigned int x = 0; x < image.GetWidth(); x++)
+  {
+    reinterpret_cast<int16_t*>(image.GetRow(0)) [x] = static_cast<int16_t>(x) - 10;
+  }
+
+  ImageProcessing::ShiftScale(image, 0, 0.5f, true);
+
+  for (unsigned int x = 0; x < image.GetWidth(); x++)
+  {
+    int v = static_cast<int>(x) - 10;
+    int expected = (v < 0 ? -((-v + 1) / 2) : (v + 1) / 2);
+    ASSERT_EQ(expected, reinterpret_cast<const int16_t*>(image.GetConstRow(0)) [x]);
+  }
+}
+
+
+/**
+ * Benchmarks of the scalar and vectorized implementations. They are
+ * disabled by default, and are run by the "Benchmarks" target of
+ * CMake, that must be used with a release build.
+ **/
+
+static void BenchmarkRendering(const char* name,
+                               PixelFormat format)
+{
+  SimdInstructionSetRestorer restorer;
+
+  Image source(format, 2048, 2048, false);
+  FillRandom(source, 1);
+
+  Image work(format, source.GetWidth(), source.GetHeight(), false);
+  Image target(PixelFormat_Grayscale8, source.GetWidth(), source.GetHeight(), false);
+
+  const unsigned int repetitions = 20;
+
+  for (int i = static_cast<int>(SimdInstructionSet_None);
+       i <= static_cast<int>(SimdKernels::GetSupportedInstructionSet()); i++)
+  {
+    SimdInstructionSet instructionSet = static_cast<SimdInstructionSet>(i);
+    SimdKernels::SetInstructionSet(instructionSet);
+
+    boost::posix_time::time_duration minMax, shiftScale, convert;
+
+    for (unsigned int j = 0; j < repetitions; j++)
+    {
+      ImageProcessing::Copy(work, source);
+
+      // Same steps as the rendering of a preview by "DicomImageDecoder"
+      boost::posix_time::ptime a = boost::posix_time::microsec_clock::universal_time();
+
+      int64_t minValue, maxValue;
+      ImageProcessing::GetMinMaxIntegerValue(minValue, maxValue, work);
+
+      boost::posix_time::ptime b = boost::posix_time::microsec_clock::universal_time();
+
+      ImageProcessing::ShiftScale(work, static_cast<float>(-minValue),
+                                  255.0f / static_cast<float>(maxValue - minValue + 1), true);
+
+      boost::posix_time::ptime c = boost::posix_time::microsec_clock::universal_time();
+
+      ImageProcessing::Convert(target, work);
+
+      boost::posix_time::ptime d = boost::posix_time::microsec_clock::universal_time();
+
+      minMax += b - a;
+      shiftScale += c - b;
+      convert += d - c;
+    }
+
+    printf("%s [%s]: min/max %.3f ms, shift-scale %.3f ms, convert %.3f ms\n",
+           name, SimdKernels::EnumerationToString(instructionSet),
+           static_cast<float>(minMax.total_microseconds()) / 1000.0f / static_cast<float>(repetitions),
+           static_cast<float>(shiftScale.total_microseconds()) / 1000.0f / static_cast<float>(repetitions),
+           static_cast<float>(convert.total_microseconds()) / 1000.0f / static_cast<float>(repetitions));
+  }
+}
+
+
+TEST(SimdKernels, DISABLED_BenchmarkGrayscale16)
+{
+  BenchmarkRendering("Grayscale16", PixelFormat_Grayscale16);
+}
+
+
+TEST(SimdKernels, DISABLED_BenchmarkSignedGrayscale16)
+{
+  BenchmarkRendering("SignedGrayscale16", PixelFormat_SignedGrayscale16);
+}
+
+
+TEST(SimdKernels, DISABLED_BenchmarkGrayscale8)
+{
+  BenchmarkRendering("Grayscale8", PixelFormat_Grayscale8);
+}
+
+
+
+namespace
+{
+  class ParallelImageProcessingInitializer : public boost::noncopyable
+  {
+  public:
+    ParallelImageProcessingInitializer(unsigned int countThreads,
+                                       uint64_t minimumPixels)
+    {
+      ParallelImageProcessing::Initialize(countThreads, minimumPixels);
+    }
+
+    ~ParallelImageProcessingInitializer()
+    {
+      ParallelImageProcessing::Finalize();
+    }
+  };
+}
+
+
+TEST(ParallelImageProcessing, Equivalence)
+{
+  const PixelFormat formats[] = {
+    PixelFormat_Grayscale8,
+    PixelFormat_Grayscale16,
+    PixelFormat_SignedGrayscale16
+  };
+
+  for (size_t f = 0; f < sizeof(formats) / sizeof(PixelFormat); f++)
+  {
+    // The height is not a multiple of the number of bands
+    Image source(formats[f], 37, 101, false);
+    FillRandom(source, 10 + f);
+
+    int64_t expectedMin, expectedMax;
+    ImageProcessing::GetMinMaxIntegerValue(expectedMin, expectedMax, source);
+
+    Image expected(formats[f], source.GetWidth(), source.GetHeight(), false);
+    ImageProcessing::Copy(expected, source);
+    ImageProcessing::ShiftScale(expected, -100.0f, 0.7f, true);
+    ImageProcessing::AddConstant(expected, 17);
+    ImageProcessing::MultiplyConstant(expected, 1.3f, false);
+
+    Image expectedConverted(PixelFormat_Grayscale8, source.GetWidth(), source.GetHeight(), false);
+    ImageProcessing::Convert(expectedConverted, expected);
+    ImageProcessing::Invert(expectedConverted);
+
+    Image expectedResized(PixelFormat_Grayscale8, 15, 45, false);
+    ImageProcessing::Resize(expectedResized, expectedConverted);
+
+    {
+      ParallelImageProcessingInitializer initializer(4, 0);
+      ASSERT_EQ(4u, ParallelImageProcessing::GetThreadsCount());
+      ASSERT_TRUE(ParallelImageProcessing::IsParallelizable(source));
+
+      int64_t actualMin, actualMax;
+      ImageProcessing::GetMinMaxIntegerValue(actualMin, actualMax, source);
+      ASSERT_EQ(expectedMin, actualMin);
+      ASSERT_EQ(expectedMax, actualMax);
+
+      Image actual(formats[f], source.GetWidth(), source.GetHeight(), false);
+      ImageProcessing::Copy(actual, source);
+      ImageProcessing::ShiftScale(actual, -100.0f, 0.7f, true);
+      ImageProcessing::AddConstant(actual, 17);
+      ImageProcessing::MultiplyConstant(actual, 1.3f, false);
+      ASSERT_TRUE(IsSameImage(expected, actual));
+
+      Image actualConverted(PixelFormat_Grayscale8, source.GetWidth(), source.GetHeight(), false);
+      ImageProcessing::Convert(actualConverted, actual);
+      ImageProcessing::Invert(actualConverted);
+      ASSERT_TRUE(IsSameImage(expectedConverted, actualConverted));
+
+      Image actualResized(PixelFormat_Grayscale8, 15, 45, false);
+      ImageProcessing::Resize(actualResized, actualConverted);
+      ASSERT_TRUE(IsSameImage(expectedResized, actualResized));
+
+      // Errors are reported to the caller
+      Image rgb(PixelFormat_RGB24, source.GetWidth(), source.GetHeight(), false);
+      ASSERT_THROW(ImageProcessing::ShiftScale(rgb, 0, 1, false), OrthancException);
+    }
+
+    ASSERT_EQ(1u, ParallelImageProcessing::GetThreadsCount());
+    ASSERT_FALSE(ParallelImageProcessing::IsParallelizable(source));
+  }
+}
+
+
+TEST(ParallelImageProcessing, Threshold)
+{
+  ParallelImageProcessingInitializer initializer(2, 1000);
+
+  Image small(PixelFormat_Grayscale8, 10, 10, false);
+  Image large(PixelFormat_Grayscale8, 10, 100, false);
+  Image singleRow(PixelFormat_Grayscale8, 1000, 1, false);
+  ASSERT_FALSE(ParallelImageProcessing::IsParallelizable(small));
+  ASSERT_TRUE(ParallelImageProcessing::IsParallelizable(large));
+  ASSERT_FALSE(ParallelImageProcessing::IsParallelizable(singleRow));
+
+  ImageProcessing::Set(large, 42);
+
+  int64_t a, b;
+  ImageProcessing::GetMinMaxIntegerValue(a, b, large);
+  ASSERT_EQ(42, a);
+  ASSERT_EQ(42, b);
+}
+
+
+namespace
+{
+  class ItemsCounter : public ParallelImageProcessing::IBandOperation
+  {
+  private:
+    std::vector<unsigned int>  visits_;
+    unsigned int               failingItem_;
+
+  public:
+    ItemsCounter(unsigned int countItems,
+                 unsigned int failingItem) :
+      visits_(countItems, 0),
+      failingItem_(failingItem)
+    {
+    }
+
+    virtual void Apply(unsigned int firstItem,
+                       unsigned int endItem)
+    {
+      for (unsigned int i = firstItem; i < endItem; i++)
+      {
+        if (i == failingItem_)
+        {
+          throw OrthancException(ErrorCode_CorruptedFile);
+        }
+
+        visits_[i]++;  // Disjoint ranges, no need for a mutex
+      }
+    }
+
+    unsigned int GetVisits(unsigned int i) const
+    {
+      return visits_[i];
+    }
+  };
+}
+
+
+TEST(ParallelImageProcessing, Items)
+{
+  {
+    ParallelImageProcessingInitializer initializer(1, 0);
+    ItemsCounter counter(10, 100);
+    ASSERT_FALSE(ParallelImageProcessing::ApplyToItems(counter, 10));
+  }
+
+  ParallelImageProcessingInitializer initializer(3, 1000000);
+
+  {
+    // The threshold on the number of pixels is not applicable to items
+    ItemsCounter counter(37, 100);
+    ASSERT_TRUE(ParallelImageProcessing::ApplyToItems(counter, 37));
+
+    for (unsigned int i = 0; i < 37; i++)
+    {
+      ASSERT_EQ(1u, counter.GetVisits(i));
+    }
+  }
+
+  {
+    ItemsCounter counter(1, 100);
+    ASSERT_FALSE(ParallelImageProcessing::ApplyToItems(counter, 1));
+  }
+
+  {
+    ItemsCounter counter(20, 13);
+
+    try
+    {
+      ParallelImageProcessing::ApplyToItems(counter, 20);
+      FAIL();
+    }
+    catch (OrthancException& e)
+    {
+      ASSERT_EQ(ErrorCode_CorruptedFile, e.GetErrorCode());
+    }
+  }
+}
+
+
+TEST(ParallelImageProcessing, DISABLED_Benchmark)
+{
+  // Size of a digital mammography
+  Image source(PixelFormat_Grayscale16, 4096, 5120, false);
+  FillRandom(source, 1);
+
+  Image work(source.GetFormat(), source.GetWidth(), source.GetHeight(), false);
+  Image target(PixelFormat_Grayscale8, source.GetWidth(), source.GetHeight(), false);
+
+  const unsigned int threads[] = { 1, 2, 4, 8 };
+
+  for (size_t i = 0; i < sizeof(threads) / sizeof(unsigned int); i++)
+  {
+    ParallelImageProcessingInitializer initializer(threads[i], 0);
+
+    const unsigned int repetitions = 10;
+    boost::posix_time::time_duration duration;
+
+    for (unsigned int j = 0; j < repetitions; j++)
+    {
+      ImageProcessing::Copy(work, source);
+
+      boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+      int64_t minValue, maxValue;
+      ImageProcessing::GetMinMaxIntegerValue(minValue, maxValue, work);
+      ImageProcessing::ShiftScale(work, static_cast<float>(-minValue),
+                                  255.0f / static_cast<float>(maxValue - minValue + 1), true);
+      ImageProcessing::Convert(target, work);
+
+      duration += boost::posix_time::microsec_clock::universal_time() - start;
+    }
+
+    printf("Rendering of a %ux%u image using %u threads: %.3f ms\n",
+           source.GetWidth(), source.GetHeight(), threads[i],
+           static_cast<float>(duration.total_microseconds()) / 1000.0f / static_cast<float>(repetitions));
+  }
+}
+
+
+
+TEST(ImageProcessing, ApplyWindowing)
+{
+  // CT image, soft-tissue window
+  Image source(PixelFormat_Grayscale16, 5, 1, false);
+  uint16_t* p = reinterpret_cast<uint16_t*>(source.GetRow(0));
+  p[0] = 0;
+  p[1] = 1000;
+  p[2] = 1064;
+  p[3] = 1263;
+  p[4] = 2000;
+
+  Image target(PixelFormat_Grayscale8, 5, 1, false);
+  ImageProcessing::ApplyWindowing(target, source, 40, 400, 1, -1024, false);
+
+  const uint8_t* q = reinterpret_cast<const uint8_t*>(target.GetConstRow(0));
+  ASSERT_EQ(0, q[0]);
+  ASSERT_EQ(87, q[1]);
+  ASSERT_EQ(128, q[2]);
+  ASSERT_EQ(255, q[3]);
+  ASSERT_EQ(255, q[4]);
+
+  ImageProcessing::ApplyWindowing(target, source, 40, 400, 1, -1024, true);
+  ASSERT_EQ(255, q[0]);
+  ASSERT_EQ(168, q[1]);
+  ASSERT_EQ(0, q[4]);
+
+  // The lookup table gives the same results as the direct computation
+  Image floatSource(PixelFormat_Float32, 5, 1, false);
+  for (unsigned int x = 0; x < 5; x++)
+  {
+    reinterpret_cast<float*>(floatSource.GetRow(0)) [x] = static_cast<float>(p[x]);
+  }
+
+  Image floatTarget(PixelFormat_Grayscale8, 5, 1, false);
+  ImageProcessing::ApplyWindowing(floatTarget, floatSource, 40, 400, 1, -1024, true);
+  ASSERT_TRUE(IsSameImage(target, floatTarget));
+
+  // A window of width 1 is a threshold
+  ImageProcessing::ApplyWindowing(target, source, 1064.5f, 1, 1, 0, false);
+  ASSERT_EQ(0, q[2]);
+  ASSERT_EQ(255, q[3]);
+
+  ASSERT_THROW(ImageProcessing::ApplyWindowing(target, source, 40, 0.5f, 1, 0, false), OrthancException);
+
+  Image rgb(PixelFormat_RGB24, 5, 1, false);
+  ASSERT_THROW(ImageProcessing::ApplyWindowing(target, rgb, 40, 400, 1, 0, false), OrthancException);
+  ASSERT_THROW(ImageProcessing::ApplyWindowing(source, source, 40, 400, 1, 0, false), OrthancException);
+}
+
+
+TEST(ImageProcessing, Resize)
+{
+  Image source(PixelFormat_Grayscale8, 2, 2, false);
+  reinterpret_cast<uint8_t*>(source.GetRow(0)) [0] = 0;
+  reinterpret_cast<uint8_t*>(source.GetRow(0)) [1] = 100;
+  reinterpret_cast<uint8_t*>(source.GetRow(1)) [0] = 200;
+  reinterpret_cast<uint8_t*>(source.GetRow(1)) [1] = 100;
+
+  Image small(PixelFormat_Grayscale8, 1, 1, false);
+  ImageProcessing::Resize(small, source);
+  ASSERT_EQ(100, reinterpret_cast<const uint8_t*>(small.GetConstRow(0)) [0]);
+
+  Image same(PixelFormat_Grayscale8, 2, 2, false);
+  ImageProcessing::Resize(same, source);
+  ASSERT_TRUE(IsSameImage(source, same));
+
+  Image constant(PixelFormat_RGB24, 3, 5, false);
+  ImageProcessing::Set(constant, 10, 20, 30, 255);
+
+  Image large(PixelFormat_RGB24, 7, 11, false);
+  ImageProcessing::Resize(large, constant);
+
+  for (unsigned int y = 0; y < large.GetHeight(); y++)
+  {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(large.GetConstRow(y));
+    for (unsigned int x = 0; x < large.GetWidth(); x++, p += 3)
+    {
+      ASSERT_EQ(10, p[0]);
+      ASSERT_EQ(20, p[1]);
+      ASSERT_EQ(30, p[2]);
+    }
+  }
+
+  ASSERT_THROW(ImageProcessing::Resize(large, source), OrthancException);
+}
+
+
+TEST(ImageProcessing, ResizeAreaAveraging)
+{
+  // Integer ratio: Each target pixel is the mean of a 2x3 block
+  Image source(PixelFormat_Grayscale8, 6, 3, false);
+  for (unsigned int y = 0; y < 3; y++)
+  {
+    uint8_t* p = reinterpret_cast<uint8_t*>(source.GetRow(y));
+    for (unsigned int x = 0; x < 6; x++)
+    {
+      p[x] = static_cast<uint8_t>(10 * x + y);
+    }
+  }
+
+  Image target(PixelFormat_Grayscale8, 3, 1, false);
+  ImageProcessing::Resize(target, source);
+  ASSERT_EQ(6, reinterpret_cast<const uint8_t*>(target.GetConstRow(0)) [0]);
+  ASSERT_EQ(26, reinterpret_cast<const uint8_t*>(target.GetConstRow(0)) [1]);
+  ASSERT_EQ(46, reinterpret_cast<const uint8_t*>(target.GetConstRow(0)) [2]);
+
+  // Non-integer ratio: The middle source pixel is shared by the two
+  // target pixels
+  Image row(PixelFormat_Grayscale8, 3, 1, false);
+  reinterpret_cast<uint8_t*>(row.GetRow(0)) [0] = 0;
+  reinterpret_cast<uint8_t*>(row.GetRow(0)) [1] = 90;
+  reinterpret_cast<uint8_t*>(row.GetRow(0)) [2] = 180;
+
+  Image half(PixelFormat_Grayscale8, 2, 1, false);
+  ImageProcessing::Resize(half, row);
+  ASSERT_EQ(30, reinterpret_cast<const uint8_t*>(half.GetConstRow(0)) [0]);
+  ASSERT_EQ(150, reinterpret_cast<const uint8_t*>(half.GetConstRow(0)) [1]);
+
+  // Constant images are left unchanged, without overflow
+  Image constant(PixelFormat_RGBA32, 7, 11, false);
+  ImageProcessing::Set(constant, 255, 0, 128, 255);
+
+  Image small(PixelFormat_RGBA32, 3, 4, false);
+  ImageProcessing::Resize(small, constant);
+
+  for (unsigned int y = 0; y < small.GetHeight(); y++)
+  {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(small.GetConstRow(y));
+    for (unsigned int x = 0; x < small.GetWidth(); x++, p += 4)
+    {
+      ASSERT_EQ(255, p[0]);
+      ASSERT_EQ(0, p[1]);
+      ASSERT_EQ(128, p[2]);
+      ASSERT_EQ(255, p[3]);
+    }
+  }
+}
+
+
+TEST(ImageProcessing, FitInside)
+{
+  unsigned int w, h;
+  ImageProcessing::FitInside(w, h, 512, 256, 128, 128);
+  ASSERT_EQ(128u, w);
+  ASSERT_EQ(64u, h);
+
+  ImageProcessing::FitInside(w, h, 256, 512, 128, 0);
+  ASSERT_EQ(128u, w);
+  ASSERT_EQ(256u, h);
+
+  ImageProcessing::FitInside(w, h, 100, 50, 128, 128);  // Never upscale
+  ASSERT_EQ(100u, w);
+  ASSERT_EQ(50u, h);
+
+  ImageProcessing::FitInside(w, h, 4000, 1, 100, 100);
+  ASSERT_EQ(100u, w);
+  ASSERT_EQ(1u, h);
+}
@@ -42,6 +42,8 @@
 #include "../Core/Cache/SharedArchive.h"
 #include "../Core/IDynamicObject.h"
 #include "../Core/Logging.h"
+#include "../OrthancServer/ParsedDicomCache.h"
+#include "../OrthancServer/RenderedFrameCache.h"
 
 
 TEST(LRU, Basic)
@@ -231,6 +233,178 @@ TEST(MemoryCache, Basic)
 
 
 
+namespace
+{
+  class ParsedDicomProvider : public Orthanc::ParsedDicomCache::IProvider
+  {
+  public:
+    std::string log_;
+
+    virtual Orthanc::ParsedDicomFile* Provide(size_t& fileSize,
+                                              const std::string& id) ORTHANC_OVERRIDE
+    {
+      log_ += id + " ";
+      fileSize = boost::lexical_cast<size_t>(id);
+
+      std::auto_ptr<Orthanc::ParsedDicomFile> dicom(new Orthanc::ParsedDicomFile(true));
+      dicom->ReplacePlainString(Orthanc::DICOM_TAG_PATIENT_ID, id);
+      return dicom.release();
+    }
+  };
+}
+
+
+TEST(ParsedDicomCache, Basic)
+{
+  ParsedDicomProvider provider;
+  Orthanc::ParsedDicomCache cache(provider, 100, 4);
+
+  std::string s;
+
+  {
+    Orthanc::ParsedDicomCache::Accessor accessor(cache, "40");
+    ASSERT_TRUE(accessor.GetDicom().GetTagValue(s, Orthanc::DICOM_TAG_PATIENT_ID));
+    ASSERT_EQ("40", s);
+  }
+
+  {
+    Orthanc::ParsedDicomCache::Accessor accessor(cache, "50");
+  }
+
+  ASSERT_EQ(2u, cache.GetNumberOfItems());
+  ASSERT_EQ(90u, cache.GetCurrentSize());
+
+  {
+    // Reused from the cache
+    Orthanc::ParsedDicomCache::Accessor accessor(cache, "40");
+  }
+
+  ASSERT_EQ("40 50 ", provider.log_);
+
+  {
+    // "50" is the least recently used entry, and is evicted
+    Orthanc::ParsedDicomCache::Accessor accessor(cache, "30");
+  }
+
+  ASSERT_EQ(2u, cache.GetNumberOfItems());
+  ASSERT_EQ(70u, cache.GetCurrentSize());
+
+  {
+    // Too large to be cached
+    Orthanc::ParsedDicomCache::Accessor accessor(cache, "200");
+    ASSERT_TRUE(accessor.GetDicom().GetTagValue(s, Orthanc::DICOM_TAG_PATIENT_ID));
+    ASSERT_EQ("200", s);
+  }
+
+  ASSERT_EQ(2u, cache.GetNumberOfItems());
+  ASSERT_EQ(70u, cache.GetCurrentSize());
+
+  cache.Invalidate("40");
+  cache.Invalidate("nope");
+  ASSERT_EQ(1u, cache.GetNumberOfItems());
+  ASSERT_EQ(30u, cache.GetCurrentSize());
+
+  {
+    Orthanc::ParsedDicomCache::Accessor accessor(cache, "40");
+    Orthanc::ParsedDicomCache::Accessor accessor2(cache, "50");
+  }
+
+  ASSERT_EQ("40 50 30 200 40 50 ", provider.log_);
+  ASSERT_EQ(2u, cache.GetNumberOfItems());
+  ASSERT_EQ(90u, cache.GetCurrentSize());
+}
+
+
+TEST(ParsedDicomCache, Disabled)
+{
+  ParsedDicomProvider provider;
+  Orthanc::ParsedDicomCache cache(provider, 0, 1);
+
+  {
+    Orthanc::ParsedDicomCache::Accessor accessor(cache, "10");
+  }
+
+  {
+    Orthanc::ParsedDicomCache::Accessor accessor(cache, "10");
+  }
+
+  ASSERT_EQ("10 10 ", provider.log_);
+  ASSERT_EQ(0u, cache.GetNumberOfItems());
+  ASSERT_EQ(0u, cache.GetCurrentSize());
+}
+
+
+
+TEST(RenderedFrameCache, Basic)
+{
+  Orthanc::RenderedFrameCache cache(10);
+
+  std::string s;
+  uint64_t g;
+  ASSERT_FALSE(cache.Lookup(s, g, "a", 0, Orthanc::ImageExtractionMode_Preview, Orthanc::MimeType_Png, 0, ""));
+
+  cache.Store(g, "a", 0, Orthanc::ImageExtractionMode_Preview, Orthanc::MimeType_Png, 0, "", "hello");
+  cache.Store(g, "a", 1, Orthanc::ImageExtractionMode_Preview, Orthanc::MimeType_Png, 0, "", "world");
+  cache.Store(g, "b", 0, Orthanc::ImageExtractionMode_Preview, Orthanc::MimeType_Png, 0, "", "too large for the cache");
+
+  ASSERT_TRUE(cache.Lookup(s, g, "a", 0, Orthanc::ImageExtractionMode_Preview, Orthanc::MimeType_Png, 0, ""));
+  ASSERT_EQ("hello", s);
+  ASSERT_FALSE(cache.Lookup(s, g, "a", 0, Orthanc::ImageExtractionMode_Preview, Orthanc::MimeType_Jpeg, 90, ""));
+  ASSERT_FALSE(cache.Lookup(s, g, "a", 0, Orthanc::ImageExtractionMode_UInt8, Orthanc::MimeType_Png, 0, ""));
+  ASSERT_FALSE(cache.Lookup(s, g, "b", 0, Orthanc::ImageExtractionMode_Preview, Orthanc::MimeType_Png, 0, ""));
+  ASSERT_FALSE(cache.Lookup(s, g, "a", 0, Orthanc::ImageExtractionMode_Preview, Orthanc::MimeType_Png, 0, "window=40,400"));
+
+  // Frame 1 of "a" is the least recently used, and is evicted
+  cache.Store(g, "b", 0, Orthanc::ImageExtractionMode_Preview, Orthanc::MimeType_Jpeg, 50, "", "b0");
+  ASSERT_FALSE(cache.Lookup(s, g, "a", 1, Orthanc::ImageExtractionMode_Preview, Orthanc::MimeType_Png, 0, ""));
+  ASSERT_TRUE(cache.Lookup(s, g, "b", 0, Orthanc::ImageExtractionMode_Preview, Orthanc::MimeType_Jpeg, 50, ""));
+  ASSERT_EQ("b0", s);
+
+  size_t size, count;
+  uint64_t hits, misses;
+  cache.GetStatistics(size, count, hits, misses);
+  ASSERT_EQ(7u, size);
+  ASSERT_EQ(2u, count);
+  ASSERT_EQ(2u, hits);
+  ASSERT_EQ(6u, misses);
+
+  cache.Invalidate("a");
+  ASSERT_FALSE(cache.Lookup(s, g, "a", 0, Orthanc::ImageExtractionMode_Preview, Orthanc::MimeType_Png, 0, ""));
+  ASSERT_TRUE(cache.Lookup(s, g, "b", 0, Orthanc::ImageExtractionMode_Preview, Orthanc::MimeType_Jpeg, 50, ""));
+
+  cache.GetStatistics(size, count, hits, misses);
+  ASSERT_EQ(2u, size);
+  ASSERT_EQ(1u, count);
+}
+
+
+TEST(RenderedFrameCache, ConcurrentInvalidation)
+{
+  Orthanc::RenderedFrameCache cache(10);
+
+  std::string s;
+  uint64_t g1, g2;
+  ASSERT_FALSE(cache.Lookup(s, g1, "a", 0, Orthanc::ImageExtractionMode_Preview, Orthanc::MimeType_Png, 0, ""));
+  ASSERT_FALSE(cache.Lookup(s, g2, "b", 0, Orthanc::ImageExtractionMode_Preview, Orthanc::MimeType_Png, 0, ""));
+
+  // "a" is modified while its frame is being rendered: The outdated
+  // rendering must not be stored. As the generation is shared by all
+  // the instances, the pending rendering of "b" is dropped as well.
+  cache.Invalidate("a");
+  cache.Store(g1, "a", 0, Orthanc::ImageExtractionMode_Preview, Orthanc::MimeType_Png, 0, "", "old");
+  cache.Store(g2, "b", 0, Orthanc::ImageExtractionMode_Preview, Orthanc::MimeType_Png, 0, "", "old");
+  ASSERT_FALSE(cache.Lookup(s, g1, "a", 0, Orthanc::ImageExtractionMode_Preview, Orthanc::MimeType_Png, 0, ""));
+  ASSERT_FALSE(cache.Lookup(s, g2, "b", 0, Orthanc::ImageExtractionMode_Preview, Orthanc::MimeType_Png, 0, ""));
+
+  // Renderings that start after the invalidation are cached
+  cache.Store(g1, "a", 0, Orthanc::ImageExtractionMode_Preview, Orthanc::MimeType_Png, 0, "", "new");
+  ASSERT_TRUE(cache.Lookup(s, g1, "a", 0, Orthanc::ImageExtractionMode_Preview, Orthanc::MimeType_Png, 0, ""));
+  ASSERT_EQ("new", s);
+}
+
+
+
+
 namespace
 {
   class S : public Orthanc::IDynamicObject
@@ -35,6 +35,7 @@
 #include "gtest/gtest.h"
 
 #include "../Core/FileStorage/MemoryStorageArea.h"
+#include "../Core/JobsEngine/ITargetedJob.h"
 #include "../Core/JobsEngine/JobsEngine.h"
 #include "../Core/Logging.h"
 #include "../Core/MultiThreading/SharedMessageQueue.h"
@@ -715,6 +716,375 @@ TEST(JobsRegistry, Cancel)
 }
 
 
+namespace
+{
+  class TargetedJob : public DummyJob, public ITargetedJob
+  {
+  private:
+    std::string  type_;
+    std::string  target_;
+
+  public:
+    TargetedJob(const std::string& type,
+                const std::string& target) :
+      type_(type),
+      target_(target)
+    {
+    }
+
+    virtual void GetJobType(std::string& type) ORTHANC_OVERRIDE
+    {
+      type = type_;
+    }
+
+    virtual void GetTarget(std::string& target) ORTHANC_OVERRIDE
+    {
+      target = target_;
+    }
+  };
+}
+
+
+TEST(JobsRegistry, TypeConcurrency)
+{
+  JobsRegistry registry(10);
+  registry.SetTypeMaxConcurrency("A", 1);
+
+  std::string a1, a2, b;
+  registry.Submit(a1, new TargetedJob("A", ""), 20);
+  registry.Submit(a2, new TargetedJob("A", ""), 10);
+  registry.Submit(b, new TargetedJob("B", ""), 0);
+
+  {
+    JobsRegistry::RunningJob job1(registry, 0);
+    ASSERT_TRUE(job1.IsValid());
+    ASSERT_EQ(a1, job1.GetId());
+
+    {
+      // "a2" has a higher priority, but only one job of type "A" can run
+      JobsRegistry::RunningJob job2(registry, 0);
+      ASSERT_TRUE(job2.IsValid());
+      ASSERT_EQ(b, job2.GetId());
+
+      ASSERT_FALSE(registry.HasPendingJobs());
+
+      JobsRegistry::RunningJob job3(registry, 1);
+      ASSERT_FALSE(job3.IsValid());
+    }
+
+    ASSERT_TRUE(CheckState(registry, a2, JobState_Pending));
+  }
+
+  ASSERT_TRUE(registry.HasPendingJobs());
+
+  {
+    JobsRegistry::RunningJob job(registry, 0);
+    ASSERT_TRUE(job.IsValid());
+    ASSERT_EQ(a2, job.GetId());
+  }
+
+  // Removing the limit
+  registry.Submit(a1, new TargetedJob("A", ""), 0);
+  registry.Submit(a2, new TargetedJob("A", ""), 0);
+  registry.SetTypeMaxConcurrency("A", 0);
+
+  {
+    JobsRegistry::RunningJob job1(registry, 0);
+    JobsRegistry::RunningJob job2(registry, 0);
+    ASSERT_TRUE(job1.IsValid());
+    ASSERT_TRUE(job2.IsValid());
+  }
+}
+
+
+TEST(JobsRegistry, TargetConcurrency)
+{
+  JobsRegistry registry(10);
+  registry.SetTargetMaxConcurrency(1);
+
+  std::string t1, t2, t3, none1, none2;
+  registry.Submit(t1, new TargetedJob("A", "modality1"), 40);
+  registry.Submit(t2, new TargetedJob("B", "modality1"), 30);
+  registry.Submit(t3, new TargetedJob("A", "modality2"), 20);
+  registry.Submit(none1, new TargetedJob("A", ""), 10);
+  registry.Submit(none2, new TargetedJob("A", ""), 10);
+
+  {
+    JobsRegistry::RunningJob job1(registry, 0);
+    ASSERT_EQ(t1, job1.GetId());
+
+    // "t2" shares its target with "t1", even if its type differs
+    JobsRegistry::RunningJob job2(registry, 0);
+    ASSERT_EQ(t3, job2.GetId());
+
+    // The jobs without a target are not limited
+    JobsRegistry::RunningJob job3(registry, 0);
+    JobsRegistry::RunningJob job4(registry, 0);
+    ASSERT_TRUE(job3.IsValid());
+    ASSERT_TRUE(job4.IsValid());
+
+    JobsRegistry::RunningJob job5(registry, 1);
+    ASSERT_FALSE(job5.IsValid());
+    ASSERT_TRUE(CheckState(registry, t2, JobState_Pending));
+
+    std::list<JobsRegistry::JobClassStatistics> classes;
+    registry.GetClassesStatistics(classes);
+    ASSERT_EQ(4u, classes.size());
+
+    for (std::list<JobsRegistry::JobClassStatistics>::const_iterator
+           it = classes.begin(); it != classes.end(); ++it)
+    {
+      if (it->type_ == "B")
+      {
+        ASSERT_EQ("modality1", it->target_);
+        ASSERT_EQ(1u, it->pending_);
+        ASSERT_EQ(0u, it->running_);
+        ASSERT_EQ(0u, it->dispatched_);
+      }
+      else if (it->target_.empty())
+      {
+        ASSERT_EQ("A", it->type_);
+        ASSERT_EQ(0u, it->pending_);
+        ASSERT_EQ(2u, it->running_);
+        ASSERT_EQ(2u, it->dispatched_);
+      }
+      else
+      {
+        ASSERT_EQ("A", it->type_);
+        ASSERT_EQ(0u, it->pending_);
+        ASSERT_EQ(1u, it->running_);
+        ASSERT_EQ(1u, it->dispatched_);
+      }
+    }
+  }
+
+  {
+    JobsRegistry::RunningJob job(registry, 0);
+    ASSERT_EQ(t2, job.GetId());
+  }
+}
+
+
+TEST(JobsRegistry, TypeWeights)
+{
+  JobsRegistry registry(100);
+  ASSERT_THROW(registry.SetTypeWeight("A", 0), OrthancException);
+  registry.SetTypeWeight("A", 3);
+
+  for (unsigned int i = 0; i < 20; i++)
+  {
+    registry.Submit(new TargetedJob("A", ""), 0);
+    registry.Submit(new TargetedJob("B", ""), 0);
+  }
+
+  std::map<std::string, unsigned int> count;
+
+  for (unsigned int i = 0; i < 16; i++)
+  {
+    JobsRegistry::RunningJob job(registry, 0);
+    ASSERT_TRUE(job.IsValid());
+
+    std::string type;
+    job.GetJob().GetJobType(type);
+    count[type] ++;
+  }
+
+  // The jobs of type "A" get three times more workers
+  ASSERT_EQ(12u, count["A"]);
+  ASSERT_EQ(4u, count["B"]);
+
+  // The priority still prevails over the weights
+  std::string id;
+  registry.Submit(id, new TargetedJob("B", ""), 10);
+
+  {
+    JobsRegistry::RunningJob job(registry, 0);
+    ASSERT_EQ(id, job.GetId());
+  }
+}
+
+
+
+TEST(JobsRegistry, Dependencies)
+{
+  JobsRegistry registry(10);
+
+  std::set<std::string> dependencies;
+  dependencies.insert("nope");
+
+  std::string a, b, c, d;
+  ASSERT_THROW(registry.Submit(a, new DummyJob(), 0, dependencies), OrthancException);
+
+  registry.Submit(a, new DummyJob(), 0);
+
+  dependencies.clear();
+  dependencies.insert(a);
+  registry.Submit(b, new DummyJob(), 10, dependencies);
+  registry.Submit(d, new DummyJob(), 0, dependencies);
+
+  dependencies.clear();
+  dependencies.insert(b);
+  registry.Submit(c, new DummyJob(), 20, dependencies);
+
+  ASSERT_TRUE(CheckState(registry, b, JobState_Pending));
+  ASSERT_TRUE(CheckState(registry, c, JobState_Pending));
+
+  {
+    // "b" and "c" have a higher priority, but wait for "a"
+    JobsRegistry::RunningJob job(registry, 0);
+    ASSERT_EQ(a, job.GetId());
+    ASSERT_FALSE(registry.HasPendingJobs());
+
+    JobsRegistry::RunningJob job2(registry, 1);
+    ASSERT_FALSE(job2.IsValid());
+
+    job.MarkSuccess();
+  }
+
+  // Pausing then resuming a job that waits for other jobs
+  ASSERT_TRUE(registry.Pause(c));
+  ASSERT_TRUE(CheckState(registry, c, JobState_Paused));
+  ASSERT_TRUE(registry.Resume(c));
+  ASSERT_TRUE(CheckState(registry, c, JobState_Pending));
+
+  {
+    JobsRegistry::RunningJob job(registry, 0);
+    ASSERT_EQ(b, job.GetId());
+    job.MarkFailure();
+  }
+
+  // The failure of "b" cancels "c", but not "d"
+  ASSERT_TRUE(CheckState(registry, b, JobState_Failure));
+  ASSERT_TRUE(CheckState(registry, c, JobState_Failure));
+  ASSERT_TRUE(CheckErrorCode(registry, c, ErrorCode_CanceledJob));
+  ASSERT_TRUE(CheckState(registry, d, JobState_Pending));
+
+  {
+    JobsRegistry::RunningJob job(registry, 0);
+    ASSERT_EQ(d, job.GetId());
+    job.MarkSuccess();
+  }
+
+  {
+    JobsRegistry::RunningJob job(registry, 1);
+    ASSERT_FALSE(job.IsValid());
+  }
+
+  // Once "b" is resubmitted, "c" can be resubmitted as well
+  ASSERT_TRUE(registry.Resubmit(b));
+  ASSERT_TRUE(registry.Resubmit(c));
+  ASSERT_TRUE(CheckState(registry, c, JobState_Pending));
+
+  {
+    JobsRegistry::RunningJob job(registry, 0);
+    ASSERT_EQ(b, job.GetId());
+    job.MarkSuccess();
+  }
+
+  {
+    JobsRegistry::RunningJob job(registry, 0);
+    ASSERT_EQ(c, job.GetId());
+    job.MarkSuccess();
+  }
+
+  ASSERT_TRUE(CheckState(registry, c, JobState_Success));
+
+  // Depending on jobs that have already completed
+  std::string e, f;
+  
+  dependencies.clear();
+  dependencies.insert(a);
+  registry.Submit(e, new DummyJob(), 0, dependencies);
+  ASSERT_TRUE(registry.HasPendingJobs());
+
+  {
+    JobsRegistry::RunningJob job(registry, 0);
+    ASSERT_EQ(e, job.GetId());
+    job.MarkFailure();
+  }
+
+  dependencies.insert(e);
+  registry.Submit(f, new DummyJob(), 0, dependencies);
+  ASSERT_TRUE(CheckState(registry, f, JobState_Failure));
+  ASSERT_TRUE(CheckErrorCode(registry, f, ErrorCode_CanceledJob));
+  ASSERT_FALSE(registry.HasPendingJobs());
+}
+
+
+
+TEST(JobsRegistry, ListJobs)
+{
+  JobsRegistry registry(100);
+
+  std::vector<std::string> ids;
+  for (unsigned int i = 0; i < 10; i++)
+  {
+    std::string id;
+    registry.Submit(id, new TargetedJob(i % 2 == 0 ? "A" : "B", ""), 0);
+    ids.push_back(id);
+
+    SystemToolbox::USleep(2000);  // To get distinct creation times
+  }
+
+  ASSERT_TRUE(registry.Pause(ids[2]));
+  ASSERT_TRUE(registry.Pause(ids[3]));
+
+  std::list<JobInfo> jobs;
+  std::set<JobState> states;
+  registry.ListJobs(jobs, states, "", 0, 0);
+  ASSERT_EQ(10u, jobs.size());
+
+  size_t i = 0;
+  for (std::list<JobInfo>::const_iterator it = jobs.begin(); it != jobs.end(); ++it, i++)
+  {
+    ASSERT_EQ(ids[i], it->GetIdentifier());
+  }
+
+  registry.ListJobs(jobs, states, "", 3, 4);
+  ASSERT_EQ(4u, jobs.size());
+  ASSERT_EQ(ids[3], jobs.front().GetIdentifier());
+  ASSERT_EQ(ids[6], jobs.back().GetIdentifier());
+
+  registry.ListJobs(jobs, states, "", 8, 4);
+  ASSERT_EQ(2u, jobs.size());
+  ASSERT_EQ(ids[8], jobs.front().GetIdentifier());
+
+  registry.ListJobs(jobs, states, "", 10, 0);
+  ASSERT_TRUE(jobs.empty());
+
+  registry.ListJobs(jobs, states, "A", 1, 2);
+  ASSERT_EQ(2u, jobs.size());
+  ASSERT_EQ(ids[2], jobs.front().GetIdentifier());
+  ASSERT_EQ(ids[4], jobs.back().GetIdentifier());
+  ASSERT_EQ("A", jobs.front().GetStatus().GetJobType());
+
+  states.insert(JobState_Paused);
+  registry.ListJobs(jobs, states, "", 0, 0);
+  ASSERT_EQ(2u, jobs.size());
+  ASSERT_EQ(ids[2], jobs.front().GetIdentifier());
+  ASSERT_EQ(JobState_Paused, jobs.front().GetState());
+  ASSERT_EQ(ids[3], jobs.back().GetIdentifier());
+
+  registry.ListJobs(jobs, states, "B", 0, 0);
+  ASSERT_EQ(1u, jobs.size());
+  ASSERT_EQ(ids[3], jobs.front().GetIdentifier());
+
+  states.insert(JobState_Success);
+  registry.ListJobs(jobs, states, "C", 0, 0);
+  ASSERT_TRUE(jobs.empty());
+
+  std::list<std::string> identifiers;
+  registry.ListJobs(identifiers, std::set<JobState>(), "", 3, 4);
+  ASSERT_EQ(4u, identifiers.size());
+  ASSERT_EQ(ids[3], identifiers.front());
+  ASSERT_EQ(ids[6], identifiers.back());
+
+  registry.ListJobs(identifiers, states, "B", 0, 0);
+  ASSERT_EQ(1u, identifiers.size());
+  ASSERT_EQ(ids[3], identifiers.front());
+}
+
+
 
 TEST(JobsEngine, SubmitAndWait)
 {
@@ -736,6 +1106,176 @@ TEST(JobsEngine, SubmitAndWait)
 }
 
 
+namespace
+{
+  class ConcurrentInstancesJob : public SetOfInstancesJob
+  {
+  private:
+    boost::mutex           mutex_;
+    std::set<std::string>  handled_;
+    unsigned int           running_;
+    unsigned int           maxRunning_;
+    bool                   trailingStepOk_;
+
+  protected:
+    virtual bool HandleInstance(const std::string& instance) ORTHANC_OVERRIDE
+    {
+      if (instance == "fail")
+      {
+        throw OrthancException(ErrorCode_NetworkProtocol);
+      }
+
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        running_++;
+        maxRunning_ = std::max(maxRunning_, running_);
+      }
+
+      boost::this_thread::sleep(boost::posix_time::milliseconds(5));
+
+      boost::mutex::scoped_lock lock(mutex_);
+      running_--;
+      handled_.insert(instance);
+      return (instance != "nope");
+    }
+
+    virtual bool HandleTrailingStep() ORTHANC_OVERRIDE
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      trailingStepOk_ = (running_ == 0 &&
+                         handled_.size() == GetInstancesCount());
+      return true;
+    }
+
+  public:
+    ConcurrentInstancesJob() :
+      running_(0),
+      maxRunning_(0),
+      trailingStepOk_(false)
+    {
+    }
+
+    using SetOfCommandsJob::SetMaxConcurrency;
+
+    size_t GetHandledCount()
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      return handled_.size();
+    }
+
+    unsigned int GetMaxRunning()
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      return maxRunning_;
+    }
+
+    bool IsTrailingStepOk() const
+    {
+      return trailingStepOk_;
+    }
+
+    virtual void Stop(JobStopReason reason) ORTHANC_OVERRIDE
+    {
+    }
+
+    virtual void GetJobType(std::string& s) ORTHANC_OVERRIDE
+    {
+      s = "ConcurrentInstancesJob";
+    }
+  };
+}
+
+
+TEST(JobsEngine, ConcurrentWorkItems)
+{
+  JobsEngine engine(10);
+  engine.SetThreadSleep(10);
+  engine.SetWorkersCount(4);
+  engine.Start();
+
+  {
+    std::auto_ptr<ConcurrentInstancesJob> job(new ConcurrentInstancesJob);
+    for (unsigned int i = 0; i < 100; i++)
+    {
+      job->AddInstance(boost::lexical_cast<std::string>(i));
+    }
+    job->AddInstance("nope");
+    job->AddTrailingStep();
+    job->SetPermissive(true);
+    job->SetMaxConcurrency(3);
+
+    std::string id;
+    ConcurrentInstancesJob& tmp = *job;
+    engine.GetRegistry().Submit(id, job.release(), 0);
+
+    JobState state;
+    while (engine.GetRegistry().GetState(state, id) &&
+           state != JobState_Success &&
+           state != JobState_Failure)
+    {
+      boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+    }
+
+    ASSERT_EQ(JobState_Success, state);
+    ASSERT_EQ(101u, tmp.GetHandledCount());
+    ASSERT_TRUE(tmp.IsTrailingStepOk());
+    ASSERT_LE(tmp.GetMaxRunning(), 3u);
+    ASSERT_GT(tmp.GetMaxRunning(), 1u);   // Idle workers have helped
+    ASSERT_EQ(1u, tmp.GetFailedInstances().size());
+    ASSERT_TRUE(tmp.IsFailedInstance("nope"));
+    ASSERT_FLOAT_EQ(1.0f, tmp.GetProgress());
+  }
+
+  {
+    // Non-permissive job: The failure of a work item is reported
+    std::auto_ptr<ConcurrentInstancesJob> job(new ConcurrentInstancesJob);
+    for (unsigned int i = 0; i < 50; i++)
+    {
+      job->AddInstance(i == 20 ? "fail" : boost::lexical_cast<std::string>(i));
+    }
+    job->AddTrailingStep();
+    job->SetMaxConcurrency(4);
+
+    Json::Value content;
+    ASSERT_THROW(engine.GetRegistry().SubmitAndWait(content, job.release(), 0), OrthancException);
+  }
+
+  engine.Stop();
+}
+
+
+TEST(JobsSerialization, MaxConcurrency)
+{
+  ConcurrentInstancesJob job;
+  job.AddInstance("hello");
+  job.AddInstance("world");
+  job.AddTrailingStep();
+  ASSERT_EQ(1u, job.GetMaxConcurrency());
+  ASSERT_FALSE(job.ExecuteWorkItem());  // Not started
+  ASSERT_THROW(job.SetMaxConcurrency(0), OrthancException);
+  job.SetMaxConcurrency(2);
+
+  job.Start();
+  ASSERT_THROW(job.SetMaxConcurrency(3), OrthancException);
+
+  // The trailing step is never executed by a helper
+  ASSERT_TRUE(job.ExecuteWorkItem());
+  ASSERT_TRUE(job.ExecuteWorkItem());
+  ASSERT_FALSE(job.ExecuteWorkItem());
+  ASSERT_EQ(2u, job.GetPosition());
+  ASSERT_FALSE(job.IsTrailingStepOk());
+
+  Json::Value s;
+  ASSERT_TRUE(job.Serialize(s));
+  ASSERT_EQ(2u, s["MaxConcurrency"].asUInt());
+  ASSERT_EQ(2u, s["Position"].asUInt());
+
+  ASSERT_EQ(JobStepCode_Success, job.Step().GetCode());
+  ASSERT_TRUE(job.IsTrailingStepOk());
+  ASSERT_EQ(3u, job.GetPosition());
+}
+
+
 TEST(JobsEngine, DISABLED_SequenceOfOperationsJob)
 {
   JobsEngine engine(10);
@@ -1556,6 +2096,7 @@ TEST_F(OrthancJobsSerialization, Jobs)
     ResourceModificationJob job(GetContext());
     job.SetModification(modification.release(), ResourceType_Patient, true);
     job.SetOrigin(DicomInstanceOrigin::FromLua());
+    job.SetThreadsCount(4);
     
     ASSERT_TRUE(CheckIdempotentSetOfInstances(unserializer, job));
     ASSERT_TRUE(job.Serialize(s));
@@ -1569,6 +2110,7 @@ TEST_F(OrthancJobsSerialization, Jobs)
     ASSERT_TRUE(tmp.IsAnonymization());
     ASSERT_EQ(RequestOrigin_Lua, tmp.GetOrigin().GetRequestOrigin());
     ASSERT_TRUE(tmp.GetModification().IsRemoved(DICOM_TAG_STUDY_DESCRIPTION));
+    ASSERT_EQ(4u, tmp.GetThreadsCount());
   }
 
   // SplitStudyJob
@@ -1704,6 +2246,76 @@ TEST_F(OrthancJobsSerialization, Jobs)
 }
 
 
+TEST_F(OrthancJobsSerialization, ModifySeries)
+{
+  std::string instance;
+  ASSERT_TRUE(CreateInstance(instance));
+
+  std::string study, series, sop;
+
+  {
+    ServerContext::DicomCacheLocker lock(GetContext(), instance);
+    study = lock.GetDicom().GetHasher().GetStudyUid();
+    series = lock.GetDicom().GetHasher().GetSeriesUid();
+    sop = lock.GetDicom().GetHasher().GetInstanceUid();
+  }
+
+  std::auto_ptr<DicomModification> modification(new DicomModification);
+  modification->SetLevel(ResourceType_Series);
+
+  ResourceModificationJob job(GetContext());
+  job.SetModification(modification.release(), ResourceType_Series, false);
+  job.SetOrigin(DicomInstanceOrigin::FromLua());
+  job.AddInstance(instance);
+  job.Start();
+
+  JobStepResult result;
+  do
+  {
+    result = job.Step();
+  }
+  while (result.GetCode() == JobStepCode_Continue);
+
+  ASSERT_EQ(JobStepCode_Success, result.GetCode());
+
+  std::string modified;
+
+  {
+    Json::Value content;
+    job.GetPublicContent(content);
+    ASSERT_EQ("Series", content["Type"].asString());
+
+    std::list<std::string> children;
+    GetContext().GetIndex().GetChildren(children, content["ID"].asString());
+    ASSERT_EQ(1u, children.size());
+    modified = children.front();
+  }
+
+  std::string newSeries, newSop;
+
+  {
+    ServerContext::DicomCacheLocker lock(GetContext(), modified);
+    ASSERT_EQ(study, lock.GetDicom().GetHasher().GetStudyUid());
+    newSeries = lock.GetDicom().GetHasher().GetSeriesUid();
+    newSop = lock.GetDicom().GetHasher().GetInstanceUid();
+  }
+
+  ASSERT_NE(series, newSeries);
+  ASSERT_NE(sop, newSop);
+
+  // The modification must have been applied exactly once: Each
+  // original UID is mapped onto the UID that was actually stored
+  Json::Value s;
+  job.GetModification().Serialize(s);
+
+  ASSERT_EQ(0u, s["MapStudies"].size());
+  ASSERT_EQ(1u, s["MapSeries"].size());
+  ASSERT_EQ(newSeries, s["MapSeries"][series].asString());
+  ASSERT_EQ(1u, s["MapInstances"].size());
+  ASSERT_EQ(newSop, s["MapInstances"][sop].asString());
+}
+
+
 TEST(JobsSerialization, Registry)
 {   
   Json::Value s;
@@ -1727,6 +2339,265 @@ TEST(JobsSerialization, Registry)
 }
 
 
+TEST(JobsSerialization, Dependencies)
+{   
+  Json::Value s;
+  JobsRegistry::SerializedJobs records;
+  std::string a, b, c;
+
+  {
+    JobsRegistry registry(10);
+    registry.SetTrackChanges(true);
+    registry.Submit(a, new DummyJob(), 0);
+
+    std::set<std::string> dependencies;
+    dependencies.insert(a);
+    registry.Submit(b, new DummyJob(), 0, dependencies);
+
+    dependencies.clear();
+    dependencies.insert(b);
+    registry.Submit(c, new DummyJob(), 0, dependencies);
+
+    registry.Serialize(s);
+
+    std::set<std::string> removed;
+    registry.ConsumeChanges(records, removed);
+    ASSERT_EQ(3u, records.size());
+  }
+
+  for (unsigned int i = 0; i < 2; i++)
+  {
+    DummyUnserializer unserializer;
+
+    std::auto_ptr<JobsRegistry> registry;
+    if (i == 0)
+    {
+      registry.reset(new JobsRegistry(unserializer, s, 10));
+    }
+    else
+    {
+      registry.reset(new JobsRegistry(unserializer, records, 10));
+    }
+
+    // The dependencies are restored, whatever the order of loading
+    {
+      JobsRegistry::RunningJob job(*registry, 0);
+      ASSERT_EQ(a, job.GetId());
+
+      JobsRegistry::RunningJob job2(*registry, 1);
+      ASSERT_FALSE(job2.IsValid());
+
+      job.MarkSuccess();
+    }
+
+    {
+      JobsRegistry::RunningJob job(*registry, 0);
+      ASSERT_EQ(b, job.GetId());
+      job.MarkFailure();
+    }
+
+    ASSERT_TRUE(CheckState(*registry, c, JobState_Failure));
+    ASSERT_TRUE(CheckErrorCode(*registry, c, ErrorCode_CanceledJob));
+  }
+}
+
+
+TEST(JobsSerialization, IncrementalPersistence)
+{
+  JobsRegistry::SerializedJobs records;
+  std::set<std::string> removed;
+  std::string i1, i2;
+
+  {
+    JobsRegistry registry(1);
+    registry.Submit(i1, new DummyJob(), 10);
+
+    registry.ConsumeChanges(records, removed);
+    ASSERT_TRUE(records.empty());  // Changes are not tracked by default
+    ASSERT_TRUE(removed.empty());
+
+    registry.SetTrackChanges(true);
+    registry.ConsumeChanges(records, removed);
+    ASSERT_EQ(1u, records.size());
+    ASSERT_TRUE(records.find(i1) != records.end());
+    ASSERT_TRUE(removed.empty());
+
+    registry.ConsumeChanges(records, removed);
+    ASSERT_TRUE(records.empty());
+    ASSERT_TRUE(removed.empty());
+
+    registry.Submit(i2, new DummyJob(), 20);
+    ASSERT_TRUE(registry.Pause(i1));
+    registry.ConsumeChanges(records, removed);
+    ASSERT_EQ(2u, records.size());
+    ASSERT_TRUE(removed.empty());
+
+    Json::Value v;
+    Json::Reader reader;
+    ASSERT_TRUE(reader.parse(records[i1], v));
+    ASSERT_EQ("Paused", v["State"].asString());
+    ASSERT_EQ("DummyJob", v["Job"]["Type"].asString());
+
+    // The history has size 1: "i1" is forgotten once "i2" completes
+    ASSERT_TRUE(registry.Cancel(i1));
+    ASSERT_TRUE(registry.Cancel(i2));
+    registry.ConsumeChanges(records, removed);
+    ASSERT_EQ(1u, records.size());
+    ASSERT_TRUE(records.find(i2) != records.end());
+    ASSERT_EQ(1u, removed.size());
+    ASSERT_TRUE(removed.find(i1) != removed.end());
+  }
+
+  {
+    JobsRegistry registry(10);
+    registry.SetTrackChanges(true);
+    registry.Submit(i1, new DummyJob(), 10);
+    registry.Submit(i2, new DummyJob(), 20);
+    ASSERT_TRUE(registry.Cancel(i2));
+    registry.ConsumeChanges(records, removed);
+    ASSERT_EQ(2u, records.size());
+  }
+
+  const std::string now = boost::posix_time::to_iso_string(
+    boost::posix_time::microsec_clock::universal_time());
+
+  records["bad"] = "nope";
+  records["unknown"] = ("{ \"State\" : \"Pending\", \"Priority\" : 100, "
+                        "\"CreationTime\" : \"" + now + "\", "
+                        "\"LastChangeTime\" : \"" + now + "\", "
+                        "\"Runtime\" : 0, \"Job\" : { \"Type\" : \"Unknown\" } }");
+
+  {
+    DummyUnserializer unserializer;
+    JobsRegistry registry(unserializer, records, 10);
+
+    std::set<std::string> jobs;
+    registry.ListJobs(jobs);
+    ASSERT_EQ(3u, jobs.size());
+    ASSERT_TRUE(jobs.find(i1) != jobs.end());
+    ASSERT_TRUE(jobs.find(i2) != jobs.end());
+    ASSERT_TRUE(jobs.find("unknown") != jobs.end());
+
+    JobState state;
+    ASSERT_TRUE(registry.GetState(state, i1));
+    ASSERT_EQ(JobState_Pending, state);
+    ASSERT_TRUE(registry.GetState(state, i2));
+    ASSERT_EQ(JobState_Failure, state);
+
+    // Only the unparseable record is to be removed
+    JobsRegistry::SerializedJobs changed;
+    registry.ConsumeChanges(changed, removed);
+    ASSERT_TRUE(changed.empty());
+    ASSERT_EQ(1u, removed.size());
+    ASSERT_TRUE(removed.find("bad") != removed.end());
+
+    JobInfo info;
+    ASSERT_TRUE(registry.GetJobInfo(info, i2));
+    ASSERT_EQ("DummyJob", info.GetStatus().GetJobType());
+
+    {
+      // The job with the highest priority cannot be unserialized
+      JobsRegistry::RunningJob job(registry, 10);
+      ASSERT_TRUE(job.IsValid());
+      ASSERT_EQ("unknown", job.GetId());
+      ASSERT_EQ(JobStepCode_Failure, job.GetJob().Step().GetCode());
+      job.MarkFailure();
+    }
+
+    registry.ConsumeChanges(changed, removed);
+    ASSERT_EQ(1u, changed.size());
+    ASSERT_TRUE(removed.empty());
+
+    Json::Value v;
+    Json::Reader reader;
+    ASSERT_TRUE(reader.parse(changed["unknown"], v));
+    ASSERT_EQ("Failure", v["State"].asString());
+    ASSERT_EQ("Unknown", v["Job"]["Type"].asString());  // Content is preserved
+  }
+}
+
+
+static void StoreJobsChanges(const JobsRegistry::SerializedJobs& changed,
+                             const std::set<std::string>& removed)
+{
+  // Emulates a failure of "ServerIndex::UpdateStoredJobs()"
+  throw OrthancException(ErrorCode_Database);
+}
+
+
+static void SaveJobsChanges(JobsRegistry& registry)
+{
+  // Same logic as "ServerContext::SaveJobsEngine()"
+  JobsRegistry::SerializedJobs changed;
+  std::set<std::string> removed;
+
+  try
+  {
+    registry.ConsumeChanges(changed, removed);
+    StoreJobsChanges(changed, removed);
+  }
+  catch (OrthancException&)
+  {
+    registry.RestoreChanges(changed, removed);
+  }
+}
+
+
+TEST(JobsSerialization, FailedPersistence)
+{
+  JobsRegistry::SerializedJobs records;
+  std::set<std::string> removed;
+  std::string i1, i2, i3;
+
+  JobsRegistry registry(1);
+  registry.SetTrackChanges(true);
+  registry.Submit(i1, new DummyJob(), 10);
+  registry.Submit(i2, new DummyJob(), 20);
+
+  // The changes are not lost if the database cannot be written
+  SaveJobsChanges(registry);
+  registry.ConsumeChanges(records, removed);
+  ASSERT_EQ(2u, records.size());
+  ASSERT_TRUE(records.find(i1) != records.end());
+  ASSERT_TRUE(records.find(i2) != records.end());
+  ASSERT_TRUE(removed.empty());
+
+  // The history has size 1: "i1" is forgotten once "i2" completes
+  ASSERT_TRUE(registry.Cancel(i1));
+  ASSERT_TRUE(registry.Cancel(i2));
+  SaveJobsChanges(registry);
+  registry.ConsumeChanges(records, removed);
+  ASSERT_EQ(1u, records.size());
+  ASSERT_TRUE(records.find(i2) != records.end());
+  ASSERT_EQ(1u, removed.size());
+  ASSERT_TRUE(removed.find(i1) != removed.end());
+
+  // A job that leaves the registry after its record was consumed
+  // must be removed from the database, not stored again
+  registry.Submit(i3, new DummyJob(), 30);
+  registry.ConsumeChanges(records, removed);
+  ASSERT_EQ(1u, records.size());
+  ASSERT_TRUE(records.find(i3) != records.end());
+  ASSERT_TRUE(registry.Cancel(i3));  // Forgets about "i2"
+  registry.RestoreChanges(records, removed);
+
+  registry.ConsumeChanges(records, removed);
+  ASSERT_EQ(1u, records.size());
+  ASSERT_TRUE(records.find(i3) != records.end());
+  ASSERT_EQ(1u, removed.size());
+  ASSERT_TRUE(removed.find(i2) != removed.end());
+
+  Json::Value v;
+  Json::Reader reader;
+  ASSERT_TRUE(reader.parse(records[i3], v));
+  ASSERT_EQ("Failure", v["State"].asString());  // The record is up-to-date
+
+  registry.ConsumeChanges(records, removed);
+  ASSERT_TRUE(records.empty());
+  ASSERT_TRUE(removed.empty());
+}
+
+
 TEST(JobsSerialization, TrailingStep)
 {
   {
@@ -1897,6 +2768,7 @@ TEST(JobsSerialization, RemoteModalityParameters)
     ASSERT_TRUE(modality.IsRequestAllowed(DicomRequestType_Get));
     ASSERT_TRUE(modality.IsRequestAllowed(DicomRequestType_Store));
     ASSERT_TRUE(modality.IsRequestAllowed(DicomRequestType_Move));
+    ASSERT_EQ("DICOM:ORTHANC@127.0.0.1:104", modality.FormatTarget());
   }
 
   s = Json::nullValue;
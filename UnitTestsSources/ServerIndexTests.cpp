@@ -36,11 +36,14 @@
 
 #include "../Core/FileStorage/FilesystemStorage.h"
 #include "../Core/FileStorage/MemoryStorageArea.h"
+#include "../Core/Images/Image.h"
 #include "../Core/Logging.h"
 #include "../OrthancServer/Database/SQLiteDatabaseWrapper.h"
 #include "../OrthancServer/Search/DatabaseLookup.h"
+#include "../OrthancServer/SeriesVolumeSender.h"
 #include "../OrthancServer/ServerContext.h"
 #include "../OrthancServer/ServerToolbox.h"
+#include "../OrthancServer/SliceOrdering.h"
 
 #include <ctype.h>
 #include <algorithm>
@@ -245,6 +248,26 @@ TEST_F(DatabaseWrapperTest, Simple)
 
     index_->GetAllPublicIds(t, ResourceType_Instance);
     ASSERT_EQ(3u, t.size());
+
+    index_->GetAllPublicIdsAfter(t, ResourceType_Instance, "", 2);
+    ASSERT_EQ(2u, t.size());
+    ASSERT_EQ("d", t.front());
+    ASSERT_EQ("e", t.back());
+
+    index_->GetAllPublicIdsAfter(t, ResourceType_Instance, "e", 2);
+    ASSERT_EQ(1u, t.size());
+    ASSERT_EQ("f", t.front());
+
+    index_->GetAllPublicIdsAfter(t, ResourceType_Instance, "f", 2);
+    ASSERT_EQ(0u, t.size());
+
+    index_->GetAllPublicIdsAfter(t, ResourceType_Study, "", 10);
+    ASSERT_EQ(2u, t.size());
+    ASSERT_EQ("b", t.front());
+    ASSERT_EQ("g", t.back());
+
+    index_->GetAllPublicIdsAfter(t, ResourceType_Study, "", 0);
+    ASSERT_EQ(0u, t.size());
   }
 
   index_->SetGlobalProperty(GlobalProperty_FlushSleep, "World");
@@ -688,6 +711,61 @@ TEST_F(DatabaseWrapperTest, LookupIdentifier)
 }
 
 
+TEST_F(DatabaseWrapperTest, StoredJobs)
+{
+  std::map<std::string, std::string> jobs, changed;
+  std::set<std::string> removed;
+
+  index_->GetStoredJobs(jobs);
+  ASSERT_TRUE(jobs.empty());
+
+  changed["a"] = "{ \"Job\" : 1 }";
+  changed["b"] = "{ \"Job\" : 2 }";
+  index_->UpdateStoredJobs(changed, removed);
+  CheckTableRecordCount(2, "Jobs");
+
+  changed.clear();
+  changed["b"] = "{ \"Job\" : 3 }";
+  removed.insert("a");
+  index_->UpdateStoredJobs(changed, removed);
+  CheckTableRecordCount(1, "Jobs");
+
+  index_->GetStoredJobs(jobs);
+  ASSERT_EQ(1u, jobs.size());
+  ASSERT_EQ("{ \"Job\" : 3 }", jobs["b"]);
+
+  // Fallback for the database plugins, that store all the jobs in
+  // the global property used by Orthanc <= 1.5.6
+  std::string s;
+  ASSERT_FALSE(index_->LookupGlobalProperty(s, GlobalProperty_JobsRegistry));
+  Compatibility::IStoredJobs::Load(*index_, jobs);
+  ASSERT_TRUE(jobs.empty());
+
+  Compatibility::IStoredJobs::Update(*index_, changed, std::set<std::string>());
+  Compatibility::IStoredJobs::Load(*index_, jobs);
+  ASSERT_EQ(1u, jobs.size());
+
+  Json::Value v;
+  Json::Reader reader;
+  ASSERT_TRUE(reader.parse(jobs["b"], v));
+  ASSERT_EQ(3, v["Job"].asInt());
+
+  ASSERT_TRUE(index_->LookupGlobalProperty(s, GlobalProperty_JobsRegistry));
+  ASSERT_TRUE(reader.parse(s, v));
+  ASSERT_EQ("JobsRegistry", v["Type"].asString());
+  ASSERT_TRUE(v["Jobs"].isMember("b"));
+
+  removed.clear();
+  removed.insert("b");
+  Compatibility::IStoredJobs::Update(*index_, std::map<std::string, std::string>(), removed);
+  Compatibility::IStoredJobs::Load(*index_, jobs);
+  ASSERT_TRUE(jobs.empty());
+
+  index_->SetGlobalProperty(GlobalProperty_JobsRegistry, "nope");
+  ASSERT_THROW(Compatibility::IStoredJobs::Load(*index_, jobs), OrthancException);
+}
+
+
 TEST(ServerIndex, AttachmentRecycling)
 {
   const std::string path = "UnitTestsStorage";
@@ -908,3 +986,200 @@ TEST(ServerIndex, Overwrite)
 }
 
 
+TEST(ServerIndex, OrderedSlicesCache)
+{
+  MemoryStorageArea storage;
+  SQLiteDatabaseWrapper db;   // The SQLite DB is in memory
+  db.Open();
+  ServerContext context(db, storage, true /* running unit tests */, 10);
+  context.SetupJobsEngine(true, false);
+
+  ServerIndex& index = context.GetIndex();
+
+  std::string series;
+  std::vector<std::string> instances;
+
+  for (unsigned int i = 0; i < 2; i++)
+  {
+    DicomMap instance;
+    instance.SetValue(DICOM_TAG_PATIENT_ID, "patient", false);
+    instance.SetValue(DICOM_TAG_STUDY_INSTANCE_UID, "study", false);
+    instance.SetValue(DICOM_TAG_SERIES_INSTANCE_UID, "series", false);
+    instance.SetValue(DICOM_TAG_SOP_INSTANCE_UID, "sop" + boost::lexical_cast<std::string>(i), false);
+    instance.SetValue(DICOM_TAG_INSTANCE_NUMBER, boost::lexical_cast<std::string>(i + 1), false);
+
+    DicomInstanceToStore toStore;
+    toStore.SetSummary(instance);
+    toStore.SetOrigin(DicomInstanceOrigin::FromPlugins());
+
+    std::string id;
+    ASSERT_EQ(StoreStatus_Success, context.Store(id, toStore));
+    ASSERT_TRUE(index.LookupParent(series, id));
+    instances.push_back(id);
+  }
+
+  std::string s;
+
+  {
+    // The series has just received instances: Nothing is cached
+    SliceOrdering ordering(index, series);
+    ASSERT_EQ(2u, ordering.GetInstancesCount());
+    ASSERT_EQ(instances[0], ordering.GetInstanceId(0));
+    ASSERT_EQ(instances[1], ordering.GetInstanceId(1));
+    ASSERT_FALSE(ordering.IsVolume());
+    ASSERT_FALSE(index.LookupMetadata(s, series, MetadataType_Series_OrderedSlices));
+    ASSERT_FALSE(index.SetMetadataIfStable(series, MetadataType_Series_OrderedSlices, "nope",
+                                           index.GetInvalidationEpoch(series)));
+  }
+
+  const std::string reversed = ("{\"Type\":\"Sequence\",\"Instances\":[[\"" + instances[1] +
+                                "\",1],[\"" + instances[0] + "\",4]]}");
+
+  index.SetMetadata(series, MetadataType_Series_OrderedSlices, reversed);
+
+  {
+    // The cached ordering is used, even if it does not match the instances
+    SliceOrdering ordering(index, series);
+    ASSERT_EQ(2u, ordering.GetInstancesCount());
+    ASSERT_EQ(instances[1], ordering.GetInstanceId(0));
+    ASSERT_EQ(instances[0], ordering.GetInstanceId(1));
+    ASSERT_EQ(4u, ordering.GetFramesCount(1));
+  }
+
+  index.SetMetadata(series, MetadataType_Series_OrderedSlices, "nope");
+
+  {
+    // Invalid cache
+    SliceOrdering ordering(index, series);
+    ASSERT_EQ(instances[0], ordering.GetInstanceId(0));
+    ASSERT_EQ(instances[1], ordering.GetInstanceId(1));
+  }
+
+  {
+    // Adding an instance to the series invalidates the cache
+    index.SetMetadata(series, MetadataType_Series_OrderedSlices, reversed);
+
+    DicomMap instance;
+    instance.SetValue(DICOM_TAG_PATIENT_ID, "patient", false);
+    instance.SetValue(DICOM_TAG_STUDY_INSTANCE_UID, "study", false);
+    instance.SetValue(DICOM_TAG_SERIES_INSTANCE_UID, "series", false);
+    instance.SetValue(DICOM_TAG_SOP_INSTANCE_UID, "sop2", false);
+    instance.SetValue(DICOM_TAG_INSTANCE_NUMBER, "3", false);
+
+    DicomInstanceToStore toStore;
+    toStore.SetSummary(instance);
+    toStore.SetOrigin(DicomInstanceOrigin::FromPlugins());
+
+    std::string id;
+    ASSERT_EQ(StoreStatus_Success, context.Store(id, toStore));
+    instances.push_back(id);
+
+    ASSERT_FALSE(index.LookupMetadata(s, series, MetadataType_Series_OrderedSlices));
+    ASSERT_EQ(3u, SliceOrdering(index, series).GetInstancesCount());
+  }
+
+  {
+    // Removing an instance from the series invalidates the cache
+    index.SetMetadata(series, MetadataType_Series_OrderedSlices, reversed);
+
+    const uint64_t epoch = index.GetInvalidationEpoch(series);
+
+    Json::Value tmp;
+    ASSERT_TRUE(index.DeleteResource(tmp, instances[2], ResourceType_Instance));
+    ASSERT_EQ(ResourceType_Series, StringToResourceType(tmp["RemainingAncestor"]["Type"].asCString()));
+    ASSERT_FALSE(index.LookupMetadata(s, series, MetadataType_Series_OrderedSlices));
+
+    // An ordering computed before the deletion must not be cached
+    ASSERT_NE(epoch, index.GetInvalidationEpoch(series));
+    ASSERT_FALSE(index.SetMetadataIfStable(series, MetadataType_Series_OrderedSlices, reversed, epoch));
+    ASSERT_FALSE(index.LookupMetadata(s, series, MetadataType_Series_OrderedSlices));
+  }
+
+  db.Close();
+}
+
+
+TEST(ServerIndex, SeriesVolume)
+{
+  MemoryStorageArea storage;
+  SQLiteDatabaseWrapper db;   // The SQLite DB is in memory
+  db.Open();
+  ServerContext context(db, storage, true /* running unit tests */, 10);
+  context.SetupJobsEngine(true, false);
+
+  std::string seriesId;
+
+  for (unsigned int z = 0; z < 3; z++)
+  {
+    // Slices of 4x2 pixels, stored in decreasing order along the Z axis
+    Image image(PixelFormat_Grayscale16, 4, 2, false);
+    for (unsigned int y = 0; y < 2; y++)
+    {
+      uint16_t* p = reinterpret_cast<uint16_t*>(image.GetRow(y));
+      for (unsigned int x = 0; x < 4; x++)
+      {
+        p[x] = 100 * z + 10 * y + x;
+      }
+    }
+
+    ParsedDicomFile dicom(true);
+    dicom.ReplacePlainString(DICOM_TAG_PATIENT_ID, "patient");
+    dicom.ReplacePlainString(DICOM_TAG_STUDY_INSTANCE_UID, "1.2.3");
+    dicom.ReplacePlainString(DICOM_TAG_SERIES_INSTANCE_UID, "1.2.3.4");
+    dicom.ReplacePlainString(DICOM_TAG_SOP_INSTANCE_UID, "1.2.3.4." + boost::lexical_cast<std::string>(z));
+    dicom.ReplacePlainString(DICOM_TAG_IMAGE_ORIENTATION_PATIENT, "1\\0\\0\\0\\1\\0");
+    dicom.ReplacePlainString(DICOM_TAG_IMAGE_POSITION_PATIENT, "0\\0\\" + boost::lexical_cast<std::string>(2.5 * (2 - z)));
+    dicom.ReplacePlainString(DICOM_TAG_PIXEL_SPACING, "0.5\\0.7");
+    dicom.EmbedImage(image);
+
+    DicomInstanceToStore toStore;
+    toStore.SetParsedDicomFile(dicom);
+    toStore.SetOrigin(DicomInstanceOrigin::FromPlugins());
+
+    std::string id;
+    ASSERT_EQ(StoreStatus_Success, context.Store(id, toStore));
+    ASSERT_TRUE(context.GetIndex().LookupParent(seriesId, id));
+  }
+
+  SeriesVolumeSender volume(context, seriesId);
+
+  const Json::Value& geometry = volume.GetGeometry();
+  ASSERT_EQ("Volume", geometry["Type"].asString());
+  ASSERT_EQ(4u, geometry["Width"].asUInt());
+  ASSERT_EQ(2u, geometry["Height"].asUInt());
+  ASSERT_EQ(3u, geometry["Depth"].asUInt());
+  ASSERT_EQ("Grayscale (unsigned 16bpp)", geometry["PixelFormat"].asString());
+  ASSERT_FLOAT_EQ(0.7f, geometry["VoxelSpacing"][0].asFloat());
+  ASSERT_FLOAT_EQ(0.5f, geometry["VoxelSpacing"][1].asFloat());
+  ASSERT_FLOAT_EQ(2.5f, geometry["VoxelSpacing"][2].asFloat());
+  ASSERT_FLOAT_EQ(0.0f, geometry["ImagePositionPatient"][2].asFloat());
+
+  ASSERT_EQ(HttpCompression_None, volume.SetupHttpCompression(true, true));
+
+  std::string body;
+  while (volume.ReadNextChunk())
+  {
+    body.append(volume.GetChunkContent(), volume.GetChunkSize());
+  }
+
+  ASSERT_EQ(volume.GetContentLength(), body.size());
+
+  const uint8_t* b = reinterpret_cast<const uint8_t*>(body.c_str());
+  const size_t headerSize = 4 + (b[0] | (b[1] << 8) | (b[2] << 16) | (b[3] << 24));
+  ASSERT_EQ(headerSize + 3 * 4 * 2 * 2, body.size());
+
+  for (unsigned int z = 0; z < 3; z++)
+  {
+    for (unsigned int y = 0; y < 2; y++)
+    {
+      for (unsigned int x = 0; x < 4; x++)
+      {
+        // The slices are sorted by increasing position along the normal
+        const uint8_t* voxel = b + headerSize + 2 * (x + 4 * (y + 2 * z));
+        ASSERT_EQ(100 * (2 - z) + 10 * y + x, static_cast<unsigned int>(voxel[0] | (voxel[1] << 8)));
+      }
+    }
+  }
+
+  db.Close();
+}
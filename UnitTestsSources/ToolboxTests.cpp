@@ -36,6 +36,8 @@
 #include "../Core/OrthancException.h"
 #include "../Core/Toolbox.h"
 
+#include <boost/date_time/posix_time/posix_time.hpp>
+
 using namespace Orthanc;
 
 TEST(Toolbox, Base64_allByteValues)
@@ -104,6 +106,119 @@ TEST(Toolbox, Base64)
 }
 
 
+TEST(Toolbox, CharsetFastPaths)
+{
+  static const Encoding SINGLE_BYTE[] = {
+    Encoding_Latin1, Encoding_Latin2, Encoding_Latin3, Encoding_Latin4,
+    Encoding_Latin5, Encoding_Cyrillic, Encoding_Windows1251, Encoding_Arabic,
+    Encoding_Greek, Encoding_Hebrew, Encoding_Thai
+  };
+
+  const std::string ascii = "DOE^JOHN^^^ 0123456789 abcdefghijklmnopqrstuvwxyz\nHello";
+
+  for (int e = Encoding_Ascii; e <= Encoding_SimplifiedChinese; e++)
+  {
+    const Encoding encoding = static_cast<Encoding>(e);
+    if (encoding != Encoding_Japanese &&
+        encoding != Encoding_JapaneseKanji &&
+        encoding != Encoding_Korean)
+    {
+      ASSERT_EQ(ascii, Toolbox::ConvertToUtf8(ascii, encoding, false));
+      ASSERT_EQ(ascii, Toolbox::ConvertToUtf8(ascii, encoding, true));
+      ASSERT_EQ(ascii, Toolbox::ConvertFromUtf8(ascii, encoding));
+    }
+  }
+
+  // Valid UTF-8 is left unchanged, invalid sequences are removed
+  const std::string utf8 = "S\xc3\xa9" "bastien \xe2\x82\xac \xf0\x9f\x98\x80 0123456789abcdef";
+  ASSERT_EQ(utf8, Toolbox::ConvertToUtf8(utf8, Encoding_Utf8, false));
+  ASSERT_EQ(utf8, Toolbox::ConvertFromUtf8(utf8, Encoding_Utf8));
+  ASSERT_EQ("ab", Toolbox::ConvertToUtf8("a\xed\xa0\x80" "b", Encoding_Utf8, false));
+  ASSERT_EQ("ab", Toolbox::ConvertToUtf8("a\xc0\xaf" "b", Encoding_Utf8, false));
+
+  // Round trip through the conversion tables of the single-byte charsets
+  for (size_t i = 0; i < sizeof(SINGLE_BYTE) / sizeof(Encoding); i++)
+  {
+    for (unsigned int c = 0x80; c < 0x100; c++)
+    {
+      const std::string s(1, static_cast<char>(c));
+      const std::string u = Toolbox::ConvertToUtf8("a" + s + "b", SINGLE_BYTE[i], false);
+      ASSERT_TRUE(u.size() >= 2);
+
+      if (u.size() > 2)
+      {
+        ASSERT_EQ("a" + s + "b", Toolbox::ConvertFromUtf8(u, SINGLE_BYTE[i]));
+      }
+    }
+  }
+
+  ASSERT_EQ("\xe9", Toolbox::ConvertFromUtf8("\xc3\xa9", Encoding_Latin1));
+  ASSERT_EQ("ab", Toolbox::ConvertFromUtf8("a\xe2\x82\xac" "b", Encoding_Latin1));  // No Euro sign
+  ASSERT_EQ("\xc3\xa9t\xc3\xa9", Toolbox::ConvertToUtf8("\xe9t\xe9", Encoding_Latin1, false));
+  ASSERT_EQ("\xd0\x96", Toolbox::ConvertToUtf8("\xb6", Encoding_Cyrillic, false));
+
+  ASSERT_EQ("DOE^JOHN 42\n", Toolbox::ToUpperCaseWithAccents("Doe^john 42\n"));
+}
+
+
+TEST(Toolbox, DISABLED_CharsetBenchmark)
+{
+  const unsigned int repetitions = 100000;
+  const std::string ascii = "DOE^JOHN^^^";
+  const std::string accents = "S\xc3\xa9" "bastien^J\xc3\xb6rg";  // UTF-8
+
+  for (int e = Encoding_Ascii; e <= Encoding_SimplifiedChinese; e++)
+  {
+    const Encoding encoding = static_cast<Encoding>(e);
+    const std::string native = Toolbox::ConvertFromUtf8(accents, encoding);
+
+    double durations[3];
+
+    for (unsigned int mode = 0; mode < 3; mode++)
+    {
+      boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+
+      for (unsigned int i = 0; i < repetitions; i++)
+      {
+        switch (mode)
+        {
+          case 0:
+            Toolbox::ConvertToUtf8(ascii, encoding, false);
+            break;
+
+          case 1:
+            Toolbox::ConvertToUtf8(native, encoding, false);
+            break;
+
+          case 2:
+            Toolbox::ConvertFromUtf8(accents, encoding);
+            break;
+
+          default:
+            throw OrthancException(ErrorCode_InternalError);
+        }
+      }
+
+      boost::posix_time::ptime end = boost::posix_time::microsec_clock::universal_time();
+      durations[mode] = static_cast<double>((end - start).total_microseconds()) / static_cast<double>(repetitions);
+    }
+
+    printf("%-20s to UTF-8 (ASCII): %.3f us, to UTF-8: %.3f us, from UTF-8: %.3f us\n",
+           EnumerationToString(encoding), durations[0], durations[1], durations[2]);
+  }
+
+  boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+  for (unsigned int i = 0; i < repetitions; i++)
+  {
+    Toolbox::ToUpperCaseWithAccents(ascii);
+  }
+  boost::posix_time::ptime end = boost::posix_time::microsec_clock::universal_time();
+
+  printf("ToUpperCaseWithAccents (ASCII): %.3f us\n",
+         static_cast<double>((end - start).total_microseconds()) / static_cast<double>(repetitions));
+}
+
+
 #if 0 // enable only when compiling in Release with a C++ 11 compiler
 #include <chrono> // I had troubles to link with boost::chrono ...
 